@@ -0,0 +1,806 @@
+// Synthetic dpdk_to_rpc.bin traces for any social_network RPC.
+//
+// Builds the call arguments with the generated types in gen-cpp, serializes
+// them with TBinaryProtocol as the client would, and writes them in the
+// record format PacketLogger uses for dpdk_to_rpc.bin:
+//
+//   [u64 timestamp ns][i64 req_id = flow << 32 | seqid][u16 size][data]
+//
+// so that PacketReplaySocket, TReplayServer and the trace tools take them
+// like a capture. Text lengths, mention, URL and media counts, list sizes,
+// user ids and the request mix are drawn from configurable distributions;
+// the defaults follow the wrk2 social-network scripts.
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/BlockTrace.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TUDPFragment.h>
+
+#include "../../gen-cpp/ComposePostService.h"
+#include "../../gen-cpp/HomeTimelineService.h"
+#include "../../gen-cpp/MediaService.h"
+#include "../../gen-cpp/PostStorageService.h"
+#include "../../gen-cpp/SocialGraphService.h"
+#include "../../gen-cpp/TextService.h"
+#include "../../gen-cpp/UniqueIdService.h"
+#include "../../gen-cpp/UrlShortenService.h"
+#include "../../gen-cpp/UserMentionService.h"
+#include "../../gen-cpp/UserService.h"
+#include "../../gen-cpp/UserTimelineService.h"
+#include "../../gen-cpp/social_network_types.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace social_network;
+
+static void usage() {
+    fprintf(stderr,
+        "usage: trace_generator [options] out\n"
+        "  -m <mix>       request mix, Service.Method[:weight],... or Service[:weight]\n"
+        "                 for all its methods (default UniqueIdService.ComposeUniqueId);\n"
+        "                 -L lists the methods\n"
+        "  -n <count>     requests (default 1000000)\n"
+        "  -f <flows>     connections the requests come in on (default 16)\n"
+        "  -r <rate>      requests per second, Poisson arrivals (default 100000)\n"
+        "  -R <rate>      requests per second, evenly spaced\n"
+        "  -T <ns>        timestamp of the first request (default now)\n"
+        "  -s <seed>      random seed (default 1); same seed and -T, same trace\n"
+        "  -F <framing>   auto (default), framed or none: auto frames the calls\n"
+        "                 of every service but UniqueIdService, as their servers\n"
+        "                 use TFramedTransport; use none for TReplayServer\n"
+        "  -d <bytes>     split calls larger than this into TUDPFragment fragments\n"
+        "                 (TUDPServer); otherwise a call over 65535 bytes spans\n"
+        "                 records as a TCP capture would\n"
+        "  -z             write a compressed block trace (see trace_blocks)\n"
+        "distributions, as fixed:N (or N), uniform:A:B, normal:MEAN:SD,\n"
+        "lognormal:MU:SIGMA, exp:MEAN, poisson:MEAN or zipf:N:S (1..N):\n"
+        "  -t <dist>      text length before mentions and URLs (default 256)\n"
+        "  -M <dist>      user mentions per text (default uniform:1:6)\n"
+        "  -u <dist>      URLs per text (default uniform:1:6)\n"
+        "  -e <dist>      media per post (default uniform:1:5)\n"
+        "  -l <dist>      posts read per ReadPosts and timeline read (default uniform:1:10)\n"
+        "  -U <dist>      user index (default uniform:0:961)\n"
+        "  -w <dist>      length of names and passwords (default uniform:6:12)\n");
+    exit(2);
+}
+
+// A distribution of non-negative integers, from its command line spec
+class Distribution {
+public:
+    enum Kind { FIXED, UNIFORM, NORMAL, LOGNORMAL, EXPONENTIAL, POISSON, ZIPF };
+
+    static Distribution parse(const std::string& spec) {
+        std::vector<std::string> parts;
+        std::stringstream ss(spec);
+        std::string part;
+        while (std::getline(ss, part, ':')) {
+            parts.push_back(part);
+        }
+        if (parts.empty()) {
+            usage();
+        }
+        std::vector<double> params;
+        bool number = parts.size() == 1;
+        for (size_t i = number ? 0 : 1; i < parts.size(); ++i) {
+            char* end;
+            params.push_back(strtod(parts[i].c_str(), &end));
+            if (parts[i].empty() || *end != '\0') {
+                fprintf(stderr, "trace_generator: bad distribution %s\n", spec.c_str());
+                usage();
+            }
+        }
+
+        Distribution d;
+        std::string kind = number ? "fixed" : parts[0];
+        size_t expected = 2;
+        if (kind == "fixed") {
+            d.kind_ = FIXED;
+            expected = 1;
+        } else if (kind == "uniform") {
+            d.kind_ = UNIFORM;
+        } else if (kind == "normal") {
+            d.kind_ = NORMAL;
+        } else if (kind == "lognormal") {
+            d.kind_ = LOGNORMAL;
+        } else if (kind == "exp") {
+            d.kind_ = EXPONENTIAL;
+            expected = 1;
+        } else if (kind == "poisson") {
+            d.kind_ = POISSON;
+            expected = 1;
+        } else if (kind == "zipf") {
+            d.kind_ = ZIPF;
+        } else {
+            fprintf(stderr, "trace_generator: unknown distribution %s\n", spec.c_str());
+            usage();
+        }
+        if (params.size() != expected || params[0] < 0 ||
+            (d.kind_ == UNIFORM && params[1] < params[0]) ||
+            (d.kind_ == ZIPF && params[0] < 1)) {
+            fprintf(stderr, "trace_generator: bad distribution %s\n", spec.c_str());
+            usage();
+        }
+        d.a_ = params[0];
+        d.b_ = expected > 1 ? params[1] : 0;
+        if (d.kind_ == ZIPF) {
+            // Inverse CDF, searched per sample
+            d.cdf_.resize(static_cast<size_t>(d.a_));
+            double sum = 0;
+            for (size_t k = 0; k < d.cdf_.size(); ++k) {
+                sum += 1.0 / std::pow(static_cast<double>(k + 1), d.b_);
+                d.cdf_[k] = sum;
+            }
+            for (double& c : d.cdf_) {
+                c /= sum;
+            }
+        }
+        return d;
+    }
+
+    int64_t sample(std::mt19937_64& rng) const {
+        double x = 0;
+        switch (kind_) {
+        case FIXED:
+            return static_cast<int64_t>(a_);
+        case UNIFORM:
+            return std::uniform_int_distribution<int64_t>(
+                static_cast<int64_t>(a_), static_cast<int64_t>(b_))(rng);
+        case NORMAL:
+            x = std::normal_distribution<double>(a_, b_)(rng);
+            break;
+        case LOGNORMAL:
+            x = std::lognormal_distribution<double>(a_, b_)(rng);
+            break;
+        case EXPONENTIAL:
+            x = a_ > 0 ? std::exponential_distribution<double>(1.0 / a_)(rng) : 0;
+            break;
+        case POISSON:
+            return a_ > 0 ? std::poisson_distribution<int64_t>(a_)(rng) : 0;
+        case ZIPF: {
+            double u = std::uniform_real_distribution<double>(0, 1)(rng);
+            return 1 + (std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin());
+        }
+        }
+        return x > 0 ? static_cast<int64_t>(std::llround(x)) : 0;
+    }
+
+    // As sample(), at most max
+    int64_t sample(std::mt19937_64& rng, int64_t max) const {
+        return std::min(sample(rng), max);
+    }
+
+private:
+    Kind kind_ = FIXED;
+    double a_ = 0;
+    double b_ = 0;
+    std::vector<double> cdf_;
+};
+
+// What the calls are made of, shared by every method
+class Generator {
+public:
+    Distribution textLength = Distribution::parse("256");
+    Distribution mentions = Distribution::parse("uniform:1:6");
+    Distribution urls = Distribution::parse("uniform:1:6");
+    Distribution media = Distribution::parse("uniform:1:5");
+    Distribution listLength = Distribution::parse("uniform:1:10");
+    Distribution userIndex = Distribution::parse("uniform:0:961");
+    Distribution nameLength = Distribution::parse("uniform:6:12");
+
+    std::mt19937_64 rng;
+    uint64_t now = 0;  // ns, timestamp of the call being made
+
+    int64_t reqId() { return static_cast<int64_t>(rng() >> 1); }
+
+    int64_t id() { return static_cast<int64_t>(rng() >> 1); }
+
+    int64_t user() { return userIndex.sample(rng); }
+
+    std::string username() { return username(user()); }
+
+    std::string username(int64_t user) { return "username_" + std::to_string(user); }
+
+    std::string random(size_t len) {
+        static const char charset[] =
+            "qwertyuiopasdfghjklzxcvbnmQWERTYUIOPASDFGHJKLZXCVBNM1234567890";
+        std::string s(len, ' ');
+        for (size_t i = 0; i < len; ++i) {
+            s[i] = charset[rng() % (sizeof(charset) - 1)];
+        }
+        return s;
+    }
+
+    std::string name() { return random(static_cast<size_t>(nameLength.sample(rng, 4096))); }
+
+    std::string url() { return "http://" + random(64); }
+
+    std::string shortUrl() { return "http://short-url/" + random(10); }
+
+    int64_t count(const Distribution& d) { return d.sample(rng, 65535); }
+
+    // Post text as compose-post.lua makes it: random text, then the
+    // mentions and the URLs
+    std::string text() {
+        std::string text = random(static_cast<size_t>(textLength.sample(rng, 1 << 24)));
+        for (int64_t i = count(mentions); i > 0; --i) {
+            text += " @" + username();
+        }
+        for (int64_t i = count(urls); i > 0; --i) {
+            text += " " + url();
+        }
+        return text;
+    }
+
+    PostType::type postType() { return static_cast<PostType::type>(rng() % 4); }
+
+    // Jaeger context of a sampled span, as the services propagate it
+    std::map<std::string, std::string> carrier() {
+        char trace[64];
+        snprintf(trace, sizeof(trace), "%016llx:%016llx:0:1",
+                 static_cast<unsigned long long>(rng()),
+                 static_cast<unsigned long long>(rng()));
+        return {{"uber-trace-id", trace}};
+    }
+
+    Post post() {
+        Post post;
+        post.post_id = id();
+        post.creator.user_id = user();
+        post.creator.username = username(post.creator.user_id);
+        post.req_id = reqId();
+        post.text = random(static_cast<size_t>(textLength.sample(rng, 1 << 24)));
+        for (int64_t i = count(mentions); i > 0; --i) {
+            UserMention mention;
+            mention.user_id = user();
+            mention.username = username(mention.user_id);
+            post.text += " @" + mention.username;
+            post.user_mentions.push_back(mention);
+        }
+        for (int64_t i = count(urls); i > 0; --i) {
+            Url url;
+            url.shortened_url = shortUrl();
+            url.expanded_url = this->url();
+            post.text += " " + url.shortened_url;
+            post.urls.push_back(url);
+        }
+        for (int64_t i = count(media); i > 0; --i) {
+            Media m;
+            m.media_id = id();
+            m.media_type = "png";
+            post.media.push_back(m);
+        }
+        post.timestamp = static_cast<int64_t>(now / 1000000);
+        post.post_type = postType();
+        return post;
+    }
+};
+
+// One RPC: the arguments it is called with, written as its _args struct
+struct Method {
+    const char* service;
+    const char* name;
+    void (*write)(Generator& g, TProtocol& out);
+};
+
+static const Method METHODS[] = {
+    {"UniqueIdService", "ComposeUniqueId", [](Generator& g, TProtocol& out) {
+        UniqueIdService_ComposeUniqueId_args args;
+        args.req_id = g.reqId();
+        args.post_type = g.postType();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"TextService", "ComposeText", [](Generator& g, TProtocol& out) {
+        TextService_ComposeText_args args;
+        args.req_id = g.reqId();
+        args.text = g.text();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "RegisterUser", [](Generator& g, TProtocol& out) {
+        UserService_RegisterUser_args args;
+        args.req_id = g.reqId();
+        args.first_name = g.name();
+        args.last_name = g.name();
+        args.username = g.username();
+        args.password = g.name();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "RegisterUserWithId", [](Generator& g, TProtocol& out) {
+        UserService_RegisterUserWithId_args args;
+        args.req_id = g.reqId();
+        args.first_name = g.name();
+        args.last_name = g.name();
+        args.user_id = g.user();
+        args.username = g.username(args.user_id);
+        args.password = g.name();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "Login", [](Generator& g, TProtocol& out) {
+        UserService_Login_args args;
+        args.req_id = g.reqId();
+        args.username = g.username();
+        args.password = g.name();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "ComposeCreatorWithUserId", [](Generator& g, TProtocol& out) {
+        UserService_ComposeCreatorWithUserId_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.username = g.username(args.user_id);
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "ComposeCreatorWithUsername", [](Generator& g, TProtocol& out) {
+        UserService_ComposeCreatorWithUsername_args args;
+        args.req_id = g.reqId();
+        args.username = g.username();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserService", "GetUserId", [](Generator& g, TProtocol& out) {
+        UserService_GetUserId_args args;
+        args.req_id = g.reqId();
+        args.username = g.username();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"ComposePostService", "ComposePost", [](Generator& g, TProtocol& out) {
+        ComposePostService_ComposePost_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.username = g.username(args.user_id);
+        args.text = g.text();
+        for (int64_t i = g.count(g.media); i > 0; --i) {
+            args.media_ids.push_back(g.id());
+            args.media_types.push_back("png");
+        }
+        args.post_type = PostType::POST;
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"PostStorageService", "StorePost", [](Generator& g, TProtocol& out) {
+        PostStorageService_StorePost_args args;
+        args.req_id = g.reqId();
+        args.post = g.post();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"PostStorageService", "ReadPost", [](Generator& g, TProtocol& out) {
+        PostStorageService_ReadPost_args args;
+        args.req_id = g.reqId();
+        args.post_id = g.id();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"PostStorageService", "ReadPosts", [](Generator& g, TProtocol& out) {
+        PostStorageService_ReadPosts_args args;
+        args.req_id = g.reqId();
+        for (int64_t i = g.count(g.listLength); i > 0; --i) {
+            args.post_ids.push_back(g.id());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"HomeTimelineService", "ReadHomeTimeline", [](Generator& g, TProtocol& out) {
+        HomeTimelineService_ReadHomeTimeline_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.start = static_cast<int32_t>(g.rng() % 101);
+        args.stop = args.start + static_cast<int32_t>(g.count(g.listLength));
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"HomeTimelineService", "WriteHomeTimeline", [](Generator& g, TProtocol& out) {
+        HomeTimelineService_WriteHomeTimeline_args args;
+        args.req_id = g.reqId();
+        args.post_id = g.id();
+        args.user_id = g.user();
+        args.timestamp = static_cast<int64_t>(g.now / 1000000);
+        for (int64_t i = g.count(g.mentions); i > 0; --i) {
+            args.user_mentions_id.push_back(g.user());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserTimelineService", "WriteUserTimeline", [](Generator& g, TProtocol& out) {
+        UserTimelineService_WriteUserTimeline_args args;
+        args.req_id = g.reqId();
+        args.post_id = g.id();
+        args.user_id = g.user();
+        args.timestamp = static_cast<int64_t>(g.now / 1000000);
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserTimelineService", "ReadUserTimeline", [](Generator& g, TProtocol& out) {
+        UserTimelineService_ReadUserTimeline_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.start = static_cast<int32_t>(g.rng() % 101);
+        args.stop = args.start + static_cast<int32_t>(g.count(g.listLength));
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "GetFollowers", [](Generator& g, TProtocol& out) {
+        SocialGraphService_GetFollowers_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "GetFollowees", [](Generator& g, TProtocol& out) {
+        SocialGraphService_GetFollowees_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "Follow", [](Generator& g, TProtocol& out) {
+        SocialGraphService_Follow_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.followee_id = g.user();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "Unfollow", [](Generator& g, TProtocol& out) {
+        SocialGraphService_Unfollow_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.followee_id = g.user();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "FollowWithUsername", [](Generator& g, TProtocol& out) {
+        SocialGraphService_FollowWithUsername_args args;
+        args.req_id = g.reqId();
+        args.user_usernmae = g.username();
+        args.followee_username = g.username();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "UnfollowWithUsername", [](Generator& g, TProtocol& out) {
+        SocialGraphService_UnfollowWithUsername_args args;
+        args.req_id = g.reqId();
+        args.user_usernmae = g.username();
+        args.followee_username = g.username();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"SocialGraphService", "InsertUser", [](Generator& g, TProtocol& out) {
+        SocialGraphService_InsertUser_args args;
+        args.req_id = g.reqId();
+        args.user_id = g.user();
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UserMentionService", "ComposeUserMentions", [](Generator& g, TProtocol& out) {
+        UserMentionService_ComposeUserMentions_args args;
+        args.req_id = g.reqId();
+        for (int64_t i = g.count(g.mentions); i > 0; --i) {
+            args.usernames.push_back(g.username());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UrlShortenService", "ComposeUrls", [](Generator& g, TProtocol& out) {
+        UrlShortenService_ComposeUrls_args args;
+        args.req_id = g.reqId();
+        for (int64_t i = g.count(g.urls); i > 0; --i) {
+            args.urls.push_back(g.url());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"UrlShortenService", "GetExtendedUrls", [](Generator& g, TProtocol& out) {
+        UrlShortenService_GetExtendedUrls_args args;
+        args.req_id = g.reqId();
+        for (int64_t i = g.count(g.urls); i > 0; --i) {
+            args.shortened_urls.push_back(g.shortUrl());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+    {"MediaService", "ComposeMedia", [](Generator& g, TProtocol& out) {
+        MediaService_ComposeMedia_args args;
+        args.req_id = g.reqId();
+        for (int64_t i = g.count(g.media); i > 0; --i) {
+            args.media_types.push_back("png");
+            args.media_ids.push_back(g.id());
+        }
+        args.carrier = g.carrier();
+        args.write(&out);
+    }},
+};
+
+static const size_t NUM_METHODS = sizeof(METHODS) / sizeof(METHODS[0]);
+
+// Method indices and their cumulative weights, from the -m spec
+static void parseMix(const std::string& spec, std::vector<size_t>& methods,
+                     std::vector<double>& cumulative) {
+    std::stringstream ss(spec);
+    std::string entry;
+    double total = 0;
+    while (std::getline(ss, entry, ',')) {
+        double weight = 1;
+        size_t colon = entry.find(':');
+        if (colon != std::string::npos) {
+            char* end;
+            weight = strtod(entry.c_str() + colon + 1, &end);
+            if (*end != '\0' || weight <= 0) {
+                fprintf(stderr, "trace_generator: bad weight in %s\n", entry.c_str());
+                usage();
+            }
+            entry.resize(colon);
+        }
+        size_t dot = entry.find('.');
+        std::string service = entry.substr(0, dot);
+        std::string name = dot == std::string::npos ? "" : entry.substr(dot + 1);
+        std::vector<size_t> matched;
+        for (size_t i = 0; i < NUM_METHODS; ++i) {
+            if (service == METHODS[i].service && (name.empty() || name == METHODS[i].name)) {
+                matched.push_back(i);
+            }
+        }
+        if (matched.empty()) {
+            fprintf(stderr, "trace_generator: no method %s, see -L\n", entry.c_str());
+            usage();
+        }
+        // A whole service shares its weight between its methods
+        for (size_t i : matched) {
+            total += weight / matched.size();
+            methods.push_back(i);
+            cumulative.push_back(total);
+        }
+    }
+    if (methods.empty()) {
+        usage();
+    }
+    for (double& c : cumulative) {
+        c /= total;
+    }
+}
+
+// Records to a .bin trace or, with -z, to a block trace
+class TraceWriter {
+public:
+    TraceWriter(const std::string& path, bool blocks) : path_(path) {
+        if (blocks) {
+            blocks_.reset(new BlockTraceWriter(path));
+        } else if (!(file_ = fopen(path.c_str(), "wb"))) {
+            fprintf(stderr, "trace_generator: cannot write %s: %s\n", path.c_str(), strerror(errno));
+            exit(1);
+        }
+    }
+
+    void append(uint64_t ts, int64_t reqId, const uint8_t* data, uint16_t size) {
+        size_t at = batch_.size();
+        batch_.resize(at + RECORD_HEADER + size);
+        memcpy(&batch_[at], &ts, sizeof(ts));
+        memcpy(&batch_[at + 8], &reqId, sizeof(reqId));
+        memcpy(&batch_[at + 16], &size, sizeof(size));
+        memcpy(&batch_[at + RECORD_HEADER], data, size);
+        records_++;
+        if (batch_.size() >= BATCH_BYTES) {
+            flush();
+        }
+    }
+
+    void close() {
+        flush();
+        if (blocks_) {
+            blocks_->close();
+        } else if (fclose(file_) != 0) {
+            fprintf(stderr, "trace_generator: cannot write %s: %s\n", path_.c_str(), strerror(errno));
+            exit(1);
+        }
+    }
+
+private:
+    static const size_t RECORD_HEADER = 18;
+    // A quarter of a block, as trace_blocks batches
+    static const size_t BATCH_BYTES = BlockTrace::BLOCK_BYTES / 4;
+
+    void flush() {
+        if (batch_.empty()) {
+            return;
+        }
+        if (blocks_) {
+            blocks_->append(batch_.data(), batch_.size(), records_);
+        } else if (fwrite(batch_.data(), 1, batch_.size(), file_) != batch_.size()) {
+            fprintf(stderr, "trace_generator: cannot write %s: %s\n", path_.c_str(), strerror(errno));
+            exit(1);
+        }
+        batch_.clear();
+        records_ = 0;
+    }
+
+    std::string path_;
+    FILE* file_ = nullptr;
+    std::unique_ptr<BlockTraceWriter> blocks_;
+    std::vector<uint8_t> batch_;
+    uint32_t records_ = 0;
+};
+
+struct MethodStats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint32_t maxBytes = 0;
+};
+
+int main(int argc, char* argv[]) {
+    Generator g;
+    std::string mix = "UniqueIdService.ComposeUniqueId";
+    uint64_t count = 1000000;
+    uint32_t flows = 16;
+    double rate = 100000;
+    bool poisson = true;
+    uint64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    uint64_t seed = 1;
+    std::string framing = "auto";
+    uint32_t datagramSize = 0;
+    bool blocks = false;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        std::string opt = argv[i];
+        if (opt == "-L") {
+            for (const Method& m : METHODS) {
+                printf("%s.%s\n", m.service, m.name);
+            }
+            return 0;
+        } else if (opt == "-z") {
+            blocks = true;
+        } else if (i + 1 >= argc) {
+            usage();
+        } else if (opt == "-m") {
+            mix = argv[++i];
+        } else if (opt == "-n") {
+            count = strtoull(argv[++i], nullptr, 10);
+        } else if (opt == "-f") {
+            flows = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (opt == "-r" || opt == "-R") {
+            poisson = opt == "-r";
+            rate = strtod(argv[++i], nullptr);
+        } else if (opt == "-T") {
+            start = strtoull(argv[++i], nullptr, 10);
+        } else if (opt == "-s") {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (opt == "-F") {
+            framing = argv[++i];
+        } else if (opt == "-d") {
+            datagramSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (opt == "-t") {
+            g.textLength = Distribution::parse(argv[++i]);
+        } else if (opt == "-M") {
+            g.mentions = Distribution::parse(argv[++i]);
+        } else if (opt == "-u") {
+            g.urls = Distribution::parse(argv[++i]);
+        } else if (opt == "-e") {
+            g.media = Distribution::parse(argv[++i]);
+        } else if (opt == "-l") {
+            g.listLength = Distribution::parse(argv[++i]);
+        } else if (opt == "-U") {
+            g.userIndex = Distribution::parse(argv[++i]);
+        } else if (opt == "-w") {
+            g.nameLength = Distribution::parse(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+    if (argc - i != 1 || flows == 0 || rate <= 0 ||
+        (framing != "auto" && framing != "framed" && framing != "none") ||
+        (datagramSize != 0 && datagramSize <= TUDPFragment::HEADER_SIZE)) {
+        usage();
+    }
+
+    std::vector<size_t> methods;
+    std::vector<double> cumulative;
+    parseMix(mix, methods, cumulative);
+    g.rng.seed(seed);
+
+    std::unique_ptr<TUDPFragmenter> fragmenter;
+    if (datagramSize != 0) {
+        fragmenter.reset(new TUDPFragmenter(datagramSize));
+    }
+    std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TBinaryProtocol protocol(buffer);
+    std::vector<int32_t> seqids(flows, 0);
+    std::vector<MethodStats> stats(NUM_METHODS);
+    std::exponential_distribution<double> gap(rate / 1e9);
+    double clock = 0;
+
+    try {
+        TraceWriter writer(argv[i], blocks);
+        for (uint64_t n = 0; n < count; ++n) {
+            g.now = start + static_cast<uint64_t>(clock);
+            clock += poisson ? gap(g.rng) : 1e9 / rate;
+            double u = std::uniform_real_distribution<double>(0, 1)(g.rng);
+            size_t pick = std::lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+            const Method& method = METHODS[methods[std::min(pick, methods.size() - 1)]];
+            uint32_t flow = static_cast<uint32_t>(g.rng() % flows);
+            int32_t seqid = seqids[flow]++;
+
+            // Room for the frame size, filled in once the call is written
+            buffer->resetBuffer();
+            bool framed = framing == "framed" ||
+                          (framing == "auto" && strcmp(method.service, "UniqueIdService") != 0);
+            if (framed) {
+                uint32_t placeholder = 0;
+                buffer->write(reinterpret_cast<uint8_t*>(&placeholder), sizeof(placeholder));
+            }
+            protocol.writeMessageBegin(method.name, T_CALL, seqid);
+            method.write(g, protocol);
+            protocol.writeMessageEnd();
+            uint8_t* data;
+            uint32_t size;
+            buffer->getBuffer(&data, &size);
+            if (framed) {
+                uint32_t frame = htonl(size - 4);
+                memcpy(data, &frame, sizeof(frame));
+            }
+
+            MethodStats& s = stats[&method - METHODS];
+            s.calls++;
+            s.bytes += size;
+            s.maxBytes = std::max(s.maxBytes, size);
+
+            // Flows are numbered from 1, as connections are
+            int64_t reqId = (static_cast<int64_t>(flow + 1) << 32) | static_cast<uint32_t>(seqid);
+            if (fragmenter && fragmenter->needsFragments(size)) {
+                std::vector<uint8_t> datagram;
+                fragmenter->split(data, size,
+                    [&](const uint8_t* header, const uint8_t* payload, uint32_t len) {
+                        datagram.assign(header, header + TUDPFragment::HEADER_SIZE);
+                        datagram.insert(datagram.end(), payload, payload + len);
+                        writer.append(g.now, reqId, datagram.data(),
+                                      static_cast<uint16_t>(datagram.size()));
+                    });
+            } else {
+                for (uint32_t offset = 0; offset < size; offset += UINT16_MAX) {
+                    uint32_t len = std::min<uint32_t>(size - offset, UINT16_MAX);
+                    writer.append(g.now, reqId, data + offset, static_cast<uint16_t>(len));
+                }
+            }
+        }
+        writer.close();
+    } catch (const TException& e) {
+        fprintf(stderr, "trace_generator: %s\n", e.what());
+        return 1;
+    }
+
+    printf("%llu requests over %u flows, %.3f s of traffic\n",
+           (unsigned long long)count, flows, clock / 1e9);
+    for (size_t m = 0; m < NUM_METHODS; ++m) {
+        if (stats[m].calls == 0) {
+            continue;
+        }
+        printf("  %-45s %10llu calls, %8.1f bytes mean, %8u max\n",
+               (std::string(METHODS[m].service) + "." + METHODS[m].name).c_str(),
+               (unsigned long long)stats[m].calls,
+               double(stats[m].bytes) / stats[m].calls, stats[m].maxBytes);
+    }
+    return 0;
+}
@@ -118,6 +118,16 @@ run_latency_tests() {
     run_test "latency_4threads" 4 5000 100 "-v"
 }
 
+run_udp_scaling_tests() {
+    echo_info "=== Running UDP Worker Scaling Tests ==="
+    echo_info "Restart the server with --udp-workers N between runs and set UDP_WORKERS=N"
+
+    local workers=${UDP_WORKERS:-1}
+    run_test "udp_${workers}workers_4threads" 4 5000 100 "-u"
+    run_test "udp_${workers}workers_8threads" 8 5000 100 "-u"
+    run_test "udp_${workers}workers_16threads" 16 5000 100 "-u"
+}
+
 analyze_results() {
     echo_info "=== Analyzing Results ==="
     
@@ -156,6 +166,7 @@ print_usage() {
     echo "  baseline  - Run baseline performance tests"
     echo "  stress    - Run stress tests"
     echo "  latency   - Run latency analysis tests"
+    echo "  udp       - Run UDP tests against a server started with --udp-workers"
     echo "  all       - Run all tests"
     echo "  check     - Check server connectivity and client binary"
     echo ""
@@ -164,6 +175,7 @@ print_usage() {
     echo "  SERVER_PORT - Server port (default: 9090)"
     echo "  CLIENT_BINARY - Path to client binary (default: ./uid_client_test)"
     echo "  RESULTS_DIR - Results directory (default: test_results)"
+    echo "  UDP_WORKERS - Worker count the UDP server was started with (default: 1)"
 }
 
 case "${1:-all}" in
@@ -192,6 +204,12 @@ case "${1:-all}" in
         run_latency_tests
         analyze_results
         ;;
+    "udp")
+        check_client
+        setup_results_dir
+        run_udp_scaling_tests
+        analyze_results
+        ;;
     "all")
         check_server
         check_client
@@ -11,6 +11,7 @@
 
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TUDPSocket.h>
 #include <thrift/transport/TTransportUtils.h>
 #include <thrift/transport/TBufferTransports.h>
 
@@ -56,10 +57,18 @@ struct TestMetrics {
 TestMetrics global_metrics;
 
 void client_thread(int thread_id, const std::string& server_host, int server_port, 
-                   int requests_per_thread, int warmup_requests, bool verbose) {
+                   int requests_per_thread, int warmup_requests, bool verbose, bool use_udp) {
     try {
         // Create Thrift client connection
-        std::shared_ptr<TTransport> socket(new TSocket(server_host, server_port));
+        std::shared_ptr<TTransport> socket;
+        if (use_udp) {
+            // One request per datagram; a lost datagram shows up as a timeout
+            std::shared_ptr<TUDPSocket> udp_socket(new TUDPSocket(server_host, server_port));
+            udp_socket->setRecvTimeout(1000);
+            socket = udp_socket;
+        } else {
+            socket = std::make_shared<TSocket>(server_host, server_port);
+        }
         std::shared_ptr<TTransport> transport(new TBufferedTransport(socket));
         std::shared_ptr<TProtocol> protocol(new TBinaryProtocol(transport));
         UniqueIdServiceClient client(protocol);
@@ -245,6 +254,7 @@ void print_usage(const char* program_name) {
     std::cout << "  -w, --warmup <num>      Warmup requests per thread (default: 100)" << std::endl;
     std::cout << "  -v, --verbose           Verbose output" << std::endl;
     std::cout << "  -o, --output <file>     Save results to file" << std::endl;
+    std::cout << "  -u, --udp               Send requests as UDP datagrams" << std::endl;
     std::cout << "  --help                  Show this help message" << std::endl;
 }
 
@@ -256,6 +266,7 @@ int main(int argc, char* argv[]) {
     int requests_per_thread = 1000;
     int warmup_requests = 100;
     bool verbose = false;
+    bool use_udp = false;
     std::string output_file;
     
     // Parse command line arguments
@@ -275,6 +286,8 @@ int main(int argc, char* argv[]) {
             verbose = true;
         } else if (arg == "-o" || arg == "--output") {
             if (i + 1 < argc) output_file = argv[++i];
+        } else if (arg == "-u" || arg == "--udp") {
+            use_udp = true;
         } else if (arg == "--help") {
             print_usage(argv[0]);
             return 0;
@@ -282,7 +295,8 @@ int main(int argc, char* argv[]) {
     }
     
     std::cout << "=== UniqueID Service Client Test ===" << std::endl;
-    std::cout << "Server: " << server_host << ":" << server_port << std::endl;
+    std::cout << "Server: " << server_host << ":" << server_port
+              << (use_udp ? " (udp)" : " (tcp)") << std::endl;
     std::cout << "Threads: " << num_threads << std::endl;
     std::cout << "Requests per thread: " << requests_per_thread << std::endl;
     std::cout << "Warmup requests per thread: " << warmup_requests << std::endl;
@@ -295,7 +309,7 @@ int main(int argc, char* argv[]) {
     
     for (int i = 0; i < num_threads; i++) {
         threads.emplace_back(client_thread, i, server_host, server_port, 
-                           requests_per_thread, warmup_requests, verbose);
+                           requests_per_thread, warmup_requests, verbose, use_udp);
     }
     
     // Wait for all threads to complete
@@ -1,177 +1,238 @@
 #ifndef PACKET_LOGGER_H
 #define PACKET_LOGGER_H
 
-#include <fstream>
+#include <atomic>
 #include <string>
-#include <chrono>
-#include <vector>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <iomanip>
+#include <vector>
+
+#include <thrift/transport/MessageHeader.h>
+#include <thrift/transport/PacketLogEngine.h>
+#include <thrift/transport/PacketSampler.h>
 #include "../../../gen-cpp/UniqueIdService.h"
 
+// Records go through PacketLogEngine: the log calls only copy into a
+// per-thread ring, a background thread writes the files. The binary
+// format is unchanged: a nanosecond timestamp, then the header fields
+// below, then the data.
+//
+// req_id is the same in all four streams for one request: the flow it
+// came in on, in the upper 32 bits, and its seqid, so that the stages can
+// be joined offline (see StageProfiler). The application's own req_id
+// stays in the serialized args.
+//
+// Every call asks the sampler first, before anything is timestamped,
+// copied or serialized, whether to log the request and how much of it.
 class PacketLogger {
 public:
+    typedef apache::thrift::transport::PacketLogEngine Engine;
+    typedef apache::thrift::transport::PacketSampler Sampler;
+    typedef apache::thrift::transport::MessageHeader Message;
+
     static PacketLogger& getInstance() {
         static PacketLogger instance;
         return instance;
     }
-    
-    void initializeLogFiles(const std::string& dirName = "uniqueid_traces", bool binary_mode = true) {
+
+    // With compressed, the binary streams are written as block traces,
+    // <stream>.blk (see BlockTrace), which PacketReplaySocket and
+    // ReplayValidator read as they are
+    void initializeLogFiles(const std::string& dirName = "uniqueid_traces", bool binary_mode = true,
+                            bool compressed = false) {
+        engine_.stop();
         binary_mode_ = binary_mode;
-        //system(("mkdir -p " + dirName).c_str());
-        [[maybe_unused]] int result = system(("mkdir -p " + dirName).c_str()); 
-        
-        std::string ext = binary_mode ? ".bin" : ".csv";
-        auto flags = binary_mode ? (std::ios::out | std::ios::binary) : std::ios::out;
-        
-        dpdk_to_rpc_.open(dirName + "/dpdk_to_rpc" + ext, flags);
-        rpc_to_app_.open(dirName + "/rpc_to_app" + ext, flags);
-        app_to_rpc_.open(dirName + "/app_to_rpc" + ext, flags);
-        rpc_to_dpdk_.open(dirName + "/rpc_to_dpdk" + ext, flags);
-        
-        if (!binary_mode) {
-            writeCSVHeaders();
-        }
+        [[maybe_unused]] int result = system(("mkdir -p " + dirName).c_str());
+
+        compressed = compressed && binary_mode;
+        openStream(DPDK_TO_RPC, dirName + "/dpdk_to_rpc", compressed, basicCSV,
+                   "timestamp,req_id,size,data_hex\n");
+        openStream(RPC_TO_APP, dirName + "/rpc_to_app", compressed, appCSV,
+                   "timestamp,req_id,post_type,size,data_hex\n");
+        openStream(APP_TO_RPC, dirName + "/app_to_rpc", compressed, responseCSV,
+                   "timestamp,req_id,result,size,data_hex\n");
+        openStream(RPC_TO_DPDK, dirName + "/rpc_to_dpdk", compressed, basicCSV,
+                   "timestamp,req_id,size,data_hex\n");
+        engine_.start();
     }
-    
-    void logDpdkToRpc(const void* data, uint16_t size) {
-        writePacket(dpdk_to_rpc_, 0, size, data);
+
+    // A new flow id, one per connection; never 0
+    static uint32_t nextFlowId() {
+        static std::atomic<uint32_t> next(1);
+        uint32_t id = next++;
+        return id ? id : next++;
     }
-    
+
+    static int64_t requestId(uint32_t flow, int32_t seqid) {
+        return static_cast<int64_t>((static_cast<uint64_t>(flow) << 32)
+                                    | static_cast<uint32_t>(seqid));
+    }
+
+    // Which requests are logged and how much of each; all, in full, unless
+    // told otherwise
+    Sampler& sampler() {
+        return sampler_;
+    }
+
+    void logDpdkToRpc(uint32_t flow, const void* data, uint16_t size) {
+        if (!sampler_.enabled()) {
+            return;
+        }
+        Message header;
+        bool parsed = Message::parse(static_cast<const uint8_t*>(data), size, header);
+        int64_t req_id = parsed ? requestId(flow, header.seqid) : 0;
+        uint32_t bytes;
+        if (sampler_.sample(req_id, parsed ? &header : nullptr, size, bytes)) {
+            writePacket(DPDK_TO_RPC, req_id, static_cast<uint16_t>(bytes), data);
+        }
+    }
+
     void logRpcToApp(int64_t req_id, int32_t post_type, const social_network::UniqueIdService_ComposeUniqueId_args& args) {
-        std::vector<uint8_t> buffer;
-        serializeArgs(args, buffer);
-        
-        AppHeader header = {getCurrentTimestamp(), req_id, post_type, static_cast<uint16_t>(buffer.size())};
-        writeAppPacket(rpc_to_app_, header, buffer.data());
+        uint32_t bytes;
+        if (!sampler_.follows(req_id, nullptr, UINT16_MAX, bytes)) {
+            return;
+        }
+        std::vector<uint8_t>& buffer = scratch();
+        buffer.clear();
+        if (bytes > 0) {
+            serializeArgs(args, buffer);
+        }
+
+        AppHeader header = {req_id, post_type, static_cast<uint16_t>(buffer.size())};
+        engine_.log(RPC_TO_APP, &header, sizeof(header), buffer.data(), buffer.size());
     }
-    
+
     void logAppToRpc(int64_t req_id, int64_t result, const social_network::UniqueIdService_ComposeUniqueId_result& res) {
-        std::vector<uint8_t> buffer;
-        serializeResult(res, buffer);
-        
-        ResponseHeader header = {getCurrentTimestamp(), req_id, result, static_cast<uint16_t>(buffer.size())};
-        writeResponsePacket(app_to_rpc_, header, buffer.data());
+        uint32_t bytes;
+        if (!sampler_.follows(req_id, nullptr, UINT16_MAX, bytes)) {
+            return;
+        }
+        std::vector<uint8_t>& buffer = scratch();
+        buffer.clear();
+        if (bytes > 0) {
+            serializeResult(res, buffer);
+        }
+
+        ResponseHeader header = {req_id, result, static_cast<uint16_t>(buffer.size())};
+        engine_.log(APP_TO_RPC, &header, sizeof(header), buffer.data(), buffer.size());
     }
-    
-    void logRpcToDpdk(const void* data, uint16_t size) {
-        writePacket(rpc_to_dpdk_, 0, size, data);
+
+    void logRpcToDpdk(uint32_t flow, const void* data, uint16_t size) {
+        if (!sampler_.enabled()) {
+            return;
+        }
+        Message header;
+        bool parsed = Message::parse(static_cast<const uint8_t*>(data), size, header);
+        int64_t req_id = parsed ? requestId(flow, header.seqid) : 0;
+        uint32_t bytes;
+        if (sampler_.follows(req_id, parsed ? &header : nullptr, size, bytes)) {
+            writePacket(RPC_TO_DPDK, req_id, static_cast<uint16_t>(bytes), data);
+        }
     }
-    
+
+    // Writes out what is still queued and closes the files
+    void close() {
+        engine_.stop();
+    }
+
+    // Records written and dropped because a thread's ring was full
+    Engine::Stats getStats() const {
+        return engine_.getStats();
+    }
+
     ~PacketLogger() {
-        dpdk_to_rpc_.close();
-        rpc_to_app_.close();
-        app_to_rpc_.close();
-        rpc_to_dpdk_.close();
+        engine_.stop();
     }
 
 private:
     PacketLogger() : binary_mode_(true) {}
-    
+
+    enum Stream { DPDK_TO_RPC, RPC_TO_APP, APP_TO_RPC, RPC_TO_DPDK };
+
     bool binary_mode_;
-    
-    // Packed structs for binary format
+    Sampler sampler_;
+    Engine engine_;
+
+    // Packed structs for binary format, after the timestamp
     struct __attribute__((packed)) BasicHeader {
-        uint64_t timestamp;
         int64_t req_id;
         uint16_t size;
     };
-    
+
     struct __attribute__((packed)) AppHeader {
-        uint64_t timestamp;
         int64_t req_id;
         int32_t post_type;
         uint16_t size;
     };
-    
+
     struct __attribute__((packed)) ResponseHeader {
-        uint64_t timestamp;
         int64_t req_id;
         int64_t result;
         uint16_t size;
     };
-    
-    uint64_t getCurrentTimestamp() {
-        return std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-    }
-    
-    void writePacket(std::ofstream& file, int64_t req_id, uint16_t size, const void* data) {
-        if (!file.is_open()) return;
-        
-        if (binary_mode_) {
-            BasicHeader header = {getCurrentTimestamp(), req_id, size};
-            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
-            if (data && size > 0) {
-                file.write(reinterpret_cast<const char*>(data), size);
-            }
+
+    void openStream(Stream stream, const std::string& path, bool compressed,
+                    Engine::Encoder csv, const char* csvHeader) {
+        if (compressed) {
+            engine_.openCompressed(stream, path + ".blk", Engine::timestampNs);
+        } else if (binary_mode_) {
+            engine_.open(stream, path + ".bin", true, Engine::timestampNs);
         } else {
-            // CSV format: timestamp,req_id,size,data_hex
-            file << getCurrentTimestamp() << "," << req_id << "," << size << ",";
-            writeHexData(file, data, size);
-            file << "\n";
+            engine_.open(stream, path + ".csv", false, csv, csvHeader);
         }
-        file.flush();
     }
-    
-    void writeAppPacket(std::ofstream& file, const AppHeader& header, const void* data) {
-        if (!file.is_open()) return;
-        
-        if (binary_mode_) {
-            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
-            if (data && header.size > 0) {
-                file.write(reinterpret_cast<const char*>(data), header.size);
-            }
-        } else {
-            // CSV format: timestamp,req_id,post_type,size,data_hex
-            file << header.timestamp << "," << header.req_id << "," 
-                 << header.post_type << "," << header.size << ",";
-            writeHexData(file, data, header.size);
-            file << "\n";
-        }
-        file.flush();
+
+    void writePacket(Stream stream, int64_t req_id, uint16_t size, const void* data) {
+        BasicHeader header = {req_id, size};
+        engine_.log(stream, &header, sizeof(header), data, data ? size : 0);
     }
-    
-    void writeResponsePacket(std::ofstream& file, const ResponseHeader& header, const void* data) {
-        if (!file.is_open()) return;
-        
-        if (binary_mode_) {
-            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
-            if (data && header.size > 0) {
-                file.write(reinterpret_cast<const char*>(data), header.size);
-            }
-        } else {
-            // CSV format: timestamp,req_id,result,size,data_hex
-            file << header.timestamp << "," << header.req_id << "," 
-                 << header.result << "," << header.size << ",";
-            writeHexData(file, data, header.size);
-            file << "\n";
-        }
-        file.flush();
+
+    // CSV records, formatted on the writer thread
+
+    // timestamp,req_id,size,data_hex
+    static void basicCSV(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len) {
+        BasicHeader header;
+        memcpy(&header, rec, sizeof(header));
+        char line[96];
+        snprintf(line, sizeof(line), "%llu,%lld,%u,", (unsigned long long)ns,
+                 (long long)header.req_id, (unsigned)header.size);
+        out += line;
+        appendHex(out, rec + sizeof(header), len - sizeof(header));
+        out += '\n';
     }
-    
-    void writeCSVHeaders() {
-        if (dpdk_to_rpc_.is_open()) 
-            dpdk_to_rpc_ << "timestamp,req_id,size,data_hex\n";
-        if (rpc_to_app_.is_open()) 
-            rpc_to_app_ << "timestamp,req_id,post_type,size,data_hex\n";
-        if (app_to_rpc_.is_open()) 
-            app_to_rpc_ << "timestamp,req_id,result,size,data_hex\n";
-        if (rpc_to_dpdk_.is_open()) 
-            rpc_to_dpdk_ << "timestamp,req_id,size,data_hex\n";
+
+    // timestamp,req_id,post_type,size,data_hex
+    static void appCSV(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len) {
+        AppHeader header;
+        memcpy(&header, rec, sizeof(header));
+        char line[112];
+        snprintf(line, sizeof(line), "%llu,%lld,%d,%u,", (unsigned long long)ns,
+                 (long long)header.req_id, (int)header.post_type, (unsigned)header.size);
+        out += line;
+        appendHex(out, rec + sizeof(header), len - sizeof(header));
+        out += '\n';
     }
-    
-    void writeHexData(std::ofstream& file, const void* data, uint16_t size) {
-        if (!data || size == 0) return;
-        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
-        for (uint16_t i = 0; i < size; i++) {
-            file << std::hex << std::setfill('0') << std::setw(2) 
-                 << static_cast<int>(bytes[i]);
-        }
-        file << std::dec;
+
+    // timestamp,req_id,result,size,data_hex
+    static void responseCSV(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len) {
+        ResponseHeader header;
+        memcpy(&header, rec, sizeof(header));
+        char line[128];
+        snprintf(line, sizeof(line), "%llu,%lld,%lld,%u,", (unsigned long long)ns,
+                 (long long)header.req_id, (long long)header.result, (unsigned)header.size);
+        out += line;
+        appendHex(out, rec + sizeof(header), len - sizeof(header));
+        out += '\n';
     }
-    
+
+    // Serialization buffer of the calling thread, reused across calls
+    static std::vector<uint8_t>& scratch() {
+        static thread_local std::vector<uint8_t> buffer;
+        return buffer;
+    }
+
     void serializeArgs(const social_network::UniqueIdService_ComposeUniqueId_args& args, std::vector<uint8_t>& buffer) {
         // Calculate total size needed
         size_t carrier_data_size = 0;
@@ -217,23 +278,25 @@ private:
         header->success_isset = result.__isset.success ? 1 : 0;
     }
 
-    std::ofstream dpdk_to_rpc_;
-    std::ofstream rpc_to_app_;
-    std::ofstream app_to_rpc_;
-    std::ofstream rpc_to_dpdk_;
+    static void appendHex(std::string& out, const uint8_t* bytes, uint32_t size) {
+        static const char digits[] = "0123456789abcdef";
+        for (uint32_t i = 0; i < size; i++) {
+            out += digits[bytes[i] >> 4];
+            out += digits[bytes[i] & 0xf];
+        }
+    }
 };
 
-
 // Convenience macros
-#define LOG_DPDK_TO_RPC(data, size) \
-    PacketLogger::getInstance().logDpdkToRpc(data, size)
+#define LOG_DPDK_TO_RPC(flow, data, size) \
+    PacketLogger::getInstance().logDpdkToRpc(flow, data, size)
 
-#define LOG_RPC_TO_APP(args) \
-    PacketLogger::getInstance().logRpcToApp(args.req_id, args.post_type, args)
+#define LOG_RPC_TO_APP(req_id, args) \
+    PacketLogger::getInstance().logRpcToApp(req_id, args.post_type, args)
 
 #define LOG_APP_TO_RPC(req_id, result_) \
     PacketLogger::getInstance().logAppToRpc(req_id, result_.success, result_)
 
-#define LOG_RPC_TO_DPDK(data, size) \
-    PacketLogger::getInstance().logRpcToDpdk(data, size)
+#define LOG_RPC_TO_DPDK(flow, data, size) \
+    PacketLogger::getInstance().logRpcToDpdk(flow, data, size)
 #endif // PACKET_LOGGER_H
@@ -1,6 +1,7 @@
 #include "UniqueIdBusinessLogic.h"
 #include "UniqueIdHandler.h"
 #include <fstream>
+#include <sstream>
 #include <unistd.h>
 
 namespace social_network {
@@ -78,6 +79,27 @@ void UniqueIdBusinessLogic::setTraceConfig(const std::string& file, int requests
     }
 }
 
+void UniqueIdBusinessLogic::setReplaySpeed(double speed, const std::string& report_prefix) {
+    scheduler_.reset(new apache::thrift::transport::ReplayScheduler(speed));
+    report_prefix_ = report_prefix;
+}
+
+void UniqueIdBusinessLogic::reportLatencies() {
+    const apache::thrift::transport::LatencyHistogram* histograms[] = {
+        &scheduler_->queueing(), &scheduler_->service(), &scheduler_->response()};
+    const char* names[] = {"queueing", "service", "response"};
+    for (int i = 0; i < 3; i++) {
+        LOG(info) << "JU:JU " << names[i] << " latency (us): p50 "
+                  << histograms[i]->percentile(50) / 1000.0 << " p99 "
+                  << histograms[i]->percentile(99) / 1000.0 << " p99.9 "
+                  << histograms[i]->percentile(99.9) / 1000.0 << " max "
+                  << histograms[i]->max() / 1000.0;
+    }
+    if (!scheduler_->writeReports(report_prefix_)) {
+        LOG(error) << "Failed to write latency histograms to " << report_prefix_ << "_*.hgrm";
+    }
+}
+
 apache::thrift::transport::TSocket* UniqueIdBusinessLogic::getSocketFromTransport() {
    auto buffered = dynamic_cast<apache::thrift::transport::TBufferedTransport*>(in_->getTransport().get());
    return buffered ? dynamic_cast<apache::thrift::transport::TSocket*>(buffered->getUnderlyingTransport().get()) : nullptr;
@@ -108,7 +130,7 @@ void UniqueIdBusinessLogic::callSWread() {
     }
     args_ = args;  // Store for dispatch
 #ifdef ENABLE_TRACING    
-    LOG_RPC_TO_APP(args);
+    LOG_RPC_TO_APP(PacketLogger::requestId(flow_id_, seqid), args);
 #endif
 }
 
@@ -118,7 +140,7 @@ bool UniqueIdBusinessLogic::callSWdispatch() {
 
 void UniqueIdBusinessLogic::callSWwrite() {
 #ifdef ENABLE_TRACING    
-    LOG_APP_TO_RPC(args_.req_id, result_);
+    LOG_APP_TO_RPC(PacketLogger::requestId(flow_id_, seqid_), result_);
 #endif
     // Write response using stored result
     if (processor_->getEventHandler().get() != NULL) {
@@ -232,6 +254,13 @@ void UniqueIdBusinessLogic::runLoop(apache::thrift::TDispatchProcessor* processo
     write_pos_ = 0;
 
     int runs = 0;
+    auto socket = getSocketFromTransport();
+#ifdef ENABLE_TRACING
+    flow_id_ = socket ? socket->getFlowId() : 0;
+#endif
+    if (scheduler_ && socket) {
+        LOG(info) << "JU:JU Open-loop replay at " << scheduler_->getSpeed() << "x";
+    }
 
     //printf("JU:JU Initial Begin ROI\n");
 
@@ -243,6 +272,10 @@ void UniqueIdBusinessLogic::runLoop(apache::thrift::TDispatchProcessor* processo
             #endif
         }
 
+        if (scheduler_ && socket) {
+            scheduler_->release(socket->getReplaySocket().getCurrentPacketTimestamp());
+        }
+
         #ifdef ENABLE_CEREBELLUM
         callEngineRead();
         bool res = callEngineDispatch();
@@ -253,6 +286,10 @@ void UniqueIdBusinessLogic::runLoop(apache::thrift::TDispatchProcessor* processo
         callSWwrite();
         #endif
 
+        if (scheduler_ && socket) {
+            scheduler_->complete();
+        }
+
         if (!res)
             break;
 
@@ -271,11 +308,20 @@ void UniqueIdBusinessLogic::runLoop(apache::thrift::TDispatchProcessor* processo
     LOG(info) << "JU:JU End ROI";
     #endif
     
+    if (scheduler_ && socket) {
+        reportLatencies();
+    }
+
     #ifdef ENABLE_GEM5
-    if (validateReplay()) {
+    // The generated id depends on the time, so it is not compared
+    apache::thrift::transport::ReplayValidator validator;
+    validator.maskField("ComposeUniqueId", 0);
+    if (validateReplay(validator)) {
         LOG(info) << "JU:JU Replay validation PASSED";
     } else {
-        LOG(info) << "JU:JU Replay validation FAILED";
+        std::ostringstream report;
+        validator.print(report);
+        LOG(info) << "JU:JU Replay validation FAILED\n" << report.str();
     }
     #endif
     
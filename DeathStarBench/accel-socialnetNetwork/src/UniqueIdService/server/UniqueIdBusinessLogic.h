@@ -9,6 +9,7 @@
 #include <string>
 #include <atomic>
 #include <map>
+#include <memory>
 
 #include "../../../gen-cpp/social_network_types.h"
 #include "../../logger.h"
@@ -34,7 +35,8 @@
 #include <thrift/TDispatchProcessor.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h> 
-#include "PacketReplaySocket.h"
+#include <thrift/transport/PacketReplaySocket.h>
+#include <thrift/transport/ReplayScheduler.h>
 #endif // ENABLE_GEM5
 
 namespace social_network {
@@ -71,6 +73,9 @@ class UniqueIdBusinessLogic {
    
   void setHandler(UniqueIdHandler* handler) { handler_ = handler; }
   void setTraceConfig(const std::string& file, int requests);
+  // Releases requests at their recorded arrival, speed times as fast, and
+  // writes latency histograms to report_prefix_*.hgrm after the run
+  void setReplaySpeed(double speed, const std::string& report_prefix);
 #endif // ENABLE_GEM5
  
  private:
@@ -108,6 +113,10 @@ class UniqueIdBusinessLogic {
   // Trace File management
   std::string trace_file_;
   int num_requests_;
+  // Open-loop replay; back to back when not set
+  std::unique_ptr<apache::thrift::transport::ReplayScheduler> scheduler_;
+  std::string report_prefix_;
+  void reportLatencies();
   apache::thrift::transport::TSocket* getSocketFromTransport();
   bool checkReplayEOF() {
      //auto buffered = dynamic_cast<apache::thrift::transport::TBufferedTransport*>(in_->getTransport().get());
@@ -115,11 +124,11 @@ class UniqueIdBusinessLogic {
      auto socket = getSocketFromTransport();
      return socket ? socket->isReplayEOF() : false;
   }
-  bool validateReplay() {
+  bool validateReplay(apache::thrift::transport::ReplayValidator& validator) {
      //auto buffered = dynamic_cast<apache::thrift::transport::TBufferedTransport*>(in_->getTransport().get());
      //auto socket = buffered ? dynamic_cast<apache::thrift::transport::TSocket*>(buffered->getUnderlyingTransport().get()) : nullptr;
      auto socket = getSocketFromTransport();
-     return socket ? socket->getReplaySocket().validateReplay("traces/rpc_to_dpdk.bin") : false;
+     return socket ? socket->getReplaySocket().validateReplay("traces/rpc_to_dpdk.bin", validator) : false;
   }
 #endif // ENABLE_GEM5
  public:
@@ -127,6 +136,9 @@ class UniqueIdBusinessLogic {
 // SW path member variables
   std::string fname_;
   int32_t seqid_;
+#ifdef ENABLE_TRACING
+  uint32_t flow_id_;  // of the socket, for the PacketLogger req_id
+#endif
   void* ctx_;
   apache::thrift::TDispatchProcessor* processor_;
   std::shared_ptr<::apache::thrift::protocol::TProtocol> in_;
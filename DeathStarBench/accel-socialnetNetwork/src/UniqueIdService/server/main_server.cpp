@@ -11,11 +11,20 @@
  *
  */
 #include <signal.h>
+#include <sstream>
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/server/TThreadedServer.h>
 #include <thrift/server/TSimpleServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TServerUDPSocket.h>
+#ifdef THRIFT_TRANSPORT_DPDK
+#include <thrift/server/TDPDKQueueServer.h>
+#else
+#include <thrift/server/TDatagramServer.h>
+#include <thrift/server/TShardedDatagramServer.h>
+#endif
+#include <thrift/server/TReplayServer.h>
 
 #include "../../utils.h"
 #include "../../utils_thrift.h"
@@ -43,9 +52,17 @@ uint64_t* readAddress = nullptr;
 using apache::thrift::protocol::TBinaryProtocolFactory;
 using apache::thrift::server::TThreadedServer;
 using apache::thrift::server::TSimpleServer;
+#ifdef THRIFT_TRANSPORT_DPDK
+using apache::thrift::server::TDPDKQueueServer;
+#else
+using apache::thrift::server::TDatagramServer;
+using apache::thrift::server::TShardedDatagramServer;
+#endif
+using apache::thrift::server::TReplayServer;
 using apache::thrift::transport::TFramedTransportFactory;
 using apache::thrift::transport::TBufferedTransportFactory;
 using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TServerUDPSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { 
@@ -64,16 +81,58 @@ int main(int argc, char *argv[]) {
 
     std::string trace_file = "traces/dpdk_to_rpc.bin";
     int num_requests = -1;  // -1 means read all
+    int udp_workers = 0;    // 0 means serve TCP
+    int udp_batch = 1;
+    int udp_shards = 0;     // SO_REUSEPORT sockets, one pinned thread each
+    int dpdk_queues = 0;    // RSS queue pairs, one lcore each
+    double replay_speed = 0; // 0 replays back to back
+    std::string latency_report = "traces/replay_latency";
+    std::string trace_control;  // log every packet when not set
+    bool trace_compress = false;
+    int replay_workers = 0;  // 0 means serve the network
+    std::string replay_shard_by = "flow";
     
     for (int i = 1; i < argc; i++) {
         if (std::string(argv[i]) == "--trace-file" && i + 1 < argc) {
             trace_file = argv[++i];
         } else if (std::string(argv[i]) == "--num-requests" && i + 1 < argc) {
             num_requests = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--udp-workers" && i + 1 < argc) {
+            udp_workers = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--udp-batch" && i + 1 < argc) {
+            udp_batch = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--udp-shards" && i + 1 < argc) {
+            udp_shards = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--dpdk-queues" && i + 1 < argc) {
+            dpdk_queues = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--replay-speed" && i + 1 < argc) {
+            replay_speed = std::stod(argv[++i]);
+        } else if (std::string(argv[i]) == "--latency-report" && i + 1 < argc) {
+            latency_report = argv[++i];
+        } else if (std::string(argv[i]) == "--trace-control" && i + 1 < argc) {
+            trace_control = argv[++i];
+        } else if (std::string(argv[i]) == "--trace-compress") {
+            trace_compress = true;
+        } else if (std::string(argv[i]) == "--replay-workers" && i + 1 < argc) {
+            replay_workers = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--replay-shard-by" && i + 1 < argc) {
+            replay_shard_by = argv[++i];
         } else if (std::string(argv[i]) == "--help") {
             std::cout << "Usage: " << argv[0] << " [options]\n";
             std::cout << "  --trace-file <file>     Trace file to replay (default: traces/dpdk_to_rpc.bin)\n";
             std::cout << "  --num-requests <num>    Number of requests to process (default: all)\n";
+            std::cout << "  --udp-workers <num>     Serve UDP datagrams with <num> worker threads (default: TCP)\n";
+            std::cout << "  --udp-batch <num>       Datagrams per recvmmsg/sendmmsg in UDP mode (default: 1)\n";
+            std::cout << "  --udp-shards <num>      Serve UDP on <num> SO_REUSEPORT sockets, one per core\n";
+            std::cout << "  --dpdk-queues <num>     Serve over DPDK on <num> RSS queues, one lcore each\n";
+            std::cout << "  --replay-speed <x>      Replay at the recorded arrival times, <x> times as fast\n";
+            std::cout << "                          (default: back to back)\n";
+            std::cout << "  --latency-report <pfx>  Open-loop histograms to <pfx>_*.hgrm (default: traces/replay_latency)\n";
+            std::cout << "  --trace-control <file>  Packet trace sampling policy, reloaded when it changes or on SIGHUP\n";
+            std::cout << "  --trace-compress        Write packet traces as compressed block traces, traces/*.blk\n";
+            std::cout << "  --replay-workers <num>  Replay --trace-file on <num> threads instead of serving, then\n";
+            std::cout << "                          validate against traces/rpc_to_dpdk.bin\n";
+            std::cout << "  --replay-shard-by <by>  Split the trace between replay workers by flow or rr (default: flow)\n";
             std::cout << "  --help                  Show this help\n";
             return 0;
         }
@@ -89,8 +148,17 @@ int main(int argc, char *argv[]) {
   PacketLogger::getInstance().initializeLogFiles("traces", false);
   apache::thrift::transport::TSocket::setTraceConfig(trace_file, num_requests);
 #else
-  PacketLogger::getInstance().initializeLogFiles("traces", true);
+  if (replay_workers > 0) {
+    // Not over the traces being replayed and validated against
+    PacketLogger::getInstance().initializeLogFiles("traces", false);
+  } else {
+    PacketLogger::getInstance().initializeLogFiles("traces", true, trace_compress);
+  }
 #endif  
+  if (!trace_control.empty()) {
+    PacketLogger::getInstance().sampler().watch(trace_control);
+    LOG(info) << "Trace sampling policy: " << trace_control;
+  }
   json config_json;
   if (load_config_file("config/service-config.json", &config_json) != 0) {
     exit(EXIT_FAILURE);
@@ -117,6 +185,9 @@ int main(int argc, char *argv[]) {
   handler->setBusinessLogic(business_logic.get());
 #ifdef ENABLE_GEM5
   handler->setRecvBuffer(business_logic->getRecvBuffer());
+  if (replay_speed > 0) {
+      business_logic->setReplaySpeed(replay_speed, latency_report);
+  }
 
   if (handler->isReadyForRequest()) {
       LOG(info) << "Handler ready for accelerator communication";
@@ -161,6 +232,80 @@ int main(int argc, char *argv[]) {
 
     business_logic->setAddresses(sendAddress, readAddress);
 #endif // ENABLE_CEREBELLUM
+#endif // ENABLE_GEM5
+#ifndef ENABLE_GEM5
+    if (replay_workers > 0) {
+      // Each worker gets its own processor over the shared handler, so
+      // only the handler's own locks are contended
+      TReplayServer replay_server(
+          std::make_shared<UniqueIdServiceProcessorFactory>(
+              std::make_shared<UniqueIdServiceIfSingletonFactory>(handler)),
+          std::make_shared<TBinaryProtocolFactory>(),
+          trace_file,
+          replay_workers,
+          replay_shard_by == "rr" ? PacketReplaySocket::SHARD_ROUND_ROBIN
+                                  : PacketReplaySocket::SHARD_BY_FLOW,
+          num_requests);
+      LOG(info) << "Replaying " << trace_file << " on " << replay_workers << " workers by "
+                << replay_shard_by;
+      replay_server.serve();
+
+      const std::vector<TReplayServer::WorkerStats>& workers = replay_server.getWorkerStats();
+      for (size_t i = 0; i < workers.size(); i++) {
+        LOG(info) << "  worker " << i << ": " << workers[i].requests << " requests in "
+                  << workers[i].elapsedNs / 1000 << " us";
+      }
+      double seconds = replay_server.getElapsedNs() / 1e9;
+      LOG(info) << "Replayed " << replay_server.getRequestCount() << " requests in "
+                << seconds * 1000 << " ms, "
+                << (seconds > 0 ? replay_server.getRequestCount() / seconds : 0) << " requests/s";
+
+      // The generated id depends on the time, so it is not compared
+      apache::thrift::transport::ReplayValidator validator;
+      validator.maskField("ComposeUniqueId", 0);
+      if (replay_server.validate("traces/rpc_to_dpdk.bin", validator)) {
+        LOG(info) << "Replay validation PASSED";
+      } else {
+        std::ostringstream report;
+        validator.print(report);
+        LOG(info) << "Replay validation FAILED\n" << report.str();
+      }
+    } else
+#ifdef THRIFT_TRANSPORT_DPDK
+    if (dpdk_queues > 0) {
+      // Each lcore gets its own processor over the shared handler
+      TDPDKQueueServer dpdk_server(
+          std::make_shared<UniqueIdServiceProcessorFactory>(
+              std::make_shared<UniqueIdServiceIfSingletonFactory>(handler)),
+          std::make_shared<TServerUDPSocket>(port),
+          std::make_shared<TBinaryProtocolFactory>(),
+          dpdk_queues);
+      LOG(info) << "Serving DPDK on " << dpdk_queues << " queues";
+      dpdk_server.serve();
+    } else
+#else
+    if (udp_shards > 0) {
+      TShardedDatagramServer udp_server(
+          std::make_shared<UniqueIdServiceProcessor>(handler),
+          "0.0.0.0",
+          port,
+          std::make_shared<TBinaryProtocolFactory>(),
+          udp_shards,
+          udp_batch);
+      LOG(info) << "Serving UDP on " << udp_shards << " shards, batch " << udp_batch;
+      udp_server.serve();
+    } else if (udp_workers > 0) {
+      // Every datagram is an independent ComposeUniqueId call
+      auto udp_socket = std::make_shared<TServerUDPSocket>("0.0.0.0", port, udp_batch);
+      TDatagramServer udp_server(
+          std::make_shared<UniqueIdServiceProcessor>(handler),
+          udp_socket,
+          std::make_shared<TBinaryProtocolFactory>(),
+          udp_workers);
+      LOG(info) << "Serving UDP with " << udp_workers << " workers, batch " << udp_batch;
+      udp_server.serve();
+    } else
+#endif // THRIFT_TRANSPORT_DPDK
 #endif // ENABLE_GEM5
     server.serve();
 
@@ -181,6 +326,7 @@ int main(int argc, char *argv[]) {
               << rpc_fraction << "% of total";
     LOG(info) << "  Business: " << business_time << " ns avg, "
               << business_fraction << "% of total";
+    LOG(info) << "  Lock contention: " << business_metrics["avg_lock_contention_ns"] << " ns avg";
 
 #ifdef ENABLE_GEM5_TEST
     unmap_m5_mem();
@@ -66,6 +66,10 @@ public:
     gen_moveable_ = false;
     gen_no_ostream_operators_ = false;
     gen_no_skeleton_ = false;
+    gen_views_ = false;
+    gen_arena_ = false;
+    gen_serialized_size_ = false;
+    in_view_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -88,6 +92,12 @@ public:
         gen_no_ostream_operators_ = true;
       } else if ( iter->first.compare("no_skeleton") == 0) {
         gen_no_skeleton_ = true;
+      } else if ( iter->first.compare("views") == 0) {
+        gen_views_ = true;
+      } else if ( iter->first.compare("arena") == 0) {
+        gen_arena_ = true;
+      } else if ( iter->first.compare("serialized_size") == 0) {
+        gen_serialized_size_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
@@ -146,6 +156,7 @@ public:
   void generate_copy_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
   void generate_move_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
   void generate_default_constructor(std::ostream& out, t_struct* tstruct, bool is_exception);
+  void generate_allocator_constructors(std::ostream& out, t_struct* tstruct);
   void generate_constructor_helper(std::ostream& out,
                                    t_struct* tstruct,
                                    bool is_excpetion,
@@ -157,7 +168,9 @@ public:
   void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_sizer(std::ostream& out, t_struct* tstruct, bool result = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
+  void generate_struct_view(std::ostream& out, std::ostream& impl_out, t_struct* tstruct);
   void generate_struct_print_method(std::ostream& out, t_struct* tstruct);
   void generate_exception_what_method(std::ostream& out, t_struct* tstruct);
 
@@ -173,6 +186,7 @@ public:
   void generate_service_client(t_service* tservice, string style);
   void generate_service_processor(t_service* tservice, string style);
   void generate_service_skeleton(t_service* tservice);
+  void generate_reply_reservation(std::ostream& out, t_function* tfunction);
   void generate_process_function(t_service* tservice,
                                  t_function* tfunction,
                                  string style,
@@ -224,6 +238,14 @@ public:
 
   void generate_serialize_list_element(std::ostream& out, t_list* tlist, std::string iter);
 
+  void generate_size_field(std::ostream& out,
+                           t_field* tfield,
+                           std::string prefix = "",
+                           std::string suffix = "",
+                           bool in_field = false);
+
+  void generate_size_container(std::ostream& out, t_type* ttype, std::string prefix);
+
   void generate_function_call(ostream& out,
                               t_function* tfunction,
                               string target,
@@ -238,6 +260,7 @@ public:
   std::string namespace_close(std::string ns);
   std::string type_name(t_type* ttype, bool in_typedef = false, bool arg = false);
   std::string base_type_name(t_base_type::t_base tbase);
+  std::string container_namespace() { return gen_arena_ && !in_view_ ? "std::pmr::" : "std::"; }
   std::string declare_field(t_field* tfield,
                             bool init = false,
                             bool pointer = false,
@@ -268,6 +291,31 @@ public:
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  /**
+   * A string held in a std::pmr::string with the arena option, which the
+   * protocols read and write through the free functions in TProtocol.h.
+   */
+  bool is_arena_string(t_type* ttype) {
+    ttype = get_true_type(ttype);
+    return gen_arena_ && !in_view_ && ttype->is_string()
+           && ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+  }
+
+  /**
+   * A field whose C++ type takes the struct's allocator with the arena
+   * option: a std::pmr string or container, or a struct.
+   */
+  bool is_arena_field(t_field* tfield) {
+    t_type* ttype = get_true_type(tfield->get_type());
+    if (is_reference(tfield)) {
+      return false;
+    }
+    if (ttype->is_container()) {
+      return !((t_container*)ttype)->has_cpp_name();
+    }
+    return is_arena_string(ttype) || ttype->is_struct() || ttype->is_xception();
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -276,6 +324,22 @@ public:
                && (((t_base_type*)ttype)->get_base() == t_base_type::TYPE_STRING));
   }
 
+  /**
+   * A list<i8> held in a std::vector<int8_t>: its elements are contiguous
+   * and are single bytes on the wire of the binary and compact protocols,
+   * so they are read and written with one readBytes()/writeBytes() call.
+   */
+  bool is_byte_list(t_type* ttype) {
+    if (!ttype->is_list() || ((t_container*)ttype)->has_cpp_name()) {
+      return false;
+    }
+    t_type* elem_type = ((t_list*)ttype)->get_elem_type();
+    t_type* true_type = get_true_type(elem_type);
+    return true_type->is_base_type()
+           && ((t_base_type*)true_type)->get_base() == t_base_type::TYPE_I8
+           && type_name(elem_type) == "int8_t";
+  }
+
   void set_use_include_prefix(bool use_include_prefix) { use_include_prefix_ = use_include_prefix; }
 
   /**
@@ -373,6 +437,31 @@ private:
    */
   bool gen_no_skeleton_;
 
+  /**
+   * True if we should generate read-only view types next to the structs.
+   */
+  bool gen_views_;
+
+  /**
+   * True if we should generate types that allocate from a
+   * std::pmr::memory_resource, and processors that build each call in the
+   * thread's TArena.
+   */
+  bool gen_arena_;
+
+  /**
+   * True if we should generate serializedSize() for the binary and compact
+   * protocols, and processors that reserve each reply's size before
+   * writing it.
+   */
+  bool gen_serialized_size_;
+
+  /**
+   * True while generating a view type: strings become std::string_views
+   * and structs their views.
+   */
+  bool in_view_;
+
   /**
    * True if thrift has member(s)
    */
@@ -453,6 +542,12 @@ void t_cpp_generator::init_generator() {
   // Include C++xx compatibility header
   f_types_ << "#include <functional>" << '\n';
   f_types_ << "#include <memory>" << '\n';
+  if (gen_arena_) {
+    f_types_ << "#include <thrift/TArena.h>" << '\n';
+  }
+  if (gen_serialized_size_) {
+    f_types_ << "#include <thrift/protocol/TSerializedSize.h>" << '\n';
+  }
 
   // Include other Thrift includes
   const vector<t_program*>& includes = program_->get_includes();
@@ -904,6 +999,10 @@ string t_cpp_generator::render_const_value(ostream& out,
 void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
   // Forward declare struct def
   f_types_ << indent() << "class " << tstruct->get_name() << ";" << '\n' << '\n';
+  if (gen_views_) {
+    f_types_ << "#if __cplusplus >= 201703L" << '\n' << indent() << "class " << tstruct->get_name()
+             << "_view;" << '\n' << "#endif" << '\n' << '\n';
+  }
 }
 
 /**
@@ -920,6 +1019,9 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
   generate_struct_reader(out, tstruct);
   generate_struct_writer(out, tstruct);
+  if (gen_serialized_size_) {
+    generate_struct_sizer(f_types_impl_, tstruct);
+  }
   generate_struct_swap(f_types_impl_, tstruct);
   if (!gen_no_default_operators_) {
     generate_equality_operator(f_types_impl_, tstruct);
@@ -941,6 +1043,10 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
     generate_exception_what_method(f_types_impl_, tstruct);
   }
 
+  if (gen_views_) {
+    generate_struct_view(f_types_, out, tstruct);
+  }
+
   has_members_ = true;
 }
 
@@ -1068,6 +1174,79 @@ void t_cpp_generator::generate_default_constructor(ostream& out,
   scope_down(out);
 }
 
+/**
+ * The allocator-extended default and copy constructors of the arena option.
+ * Strings, containers and structs take the allocator; the rest start out as
+ * in the default and copy constructors.
+ */
+void t_cpp_generator::generate_allocator_constructors(ostream& out, t_struct* tstruct) {
+  const vector<t_field*>& members = tstruct->get_members();
+  vector<t_field*>::const_iterator m_iter;
+
+  bool uses_alloc = false;
+  bool has_nonrequired_fields = false;
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    uses_alloc = uses_alloc || is_arena_field(*m_iter);
+    has_nonrequired_fields = has_nonrequired_fields || (*m_iter)->get_req() != t_field::T_REQUIRED;
+  }
+  string alloc = uses_alloc ? "alloc" : "/* alloc */";
+
+  out << '\n';
+  indent(out) << tstruct->get_name() << "::" << tstruct->get_name()
+              << "(const allocator_type& " << alloc << ")";
+  string sep = "\n   : ";
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    t_const_value* cv = (*m_iter)->get_value();
+    string init;
+    if (t->is_base_type() || t->is_enum() || is_reference(*m_iter)) {
+      if (cv != nullptr) {
+        init = render_const_value(out, (*m_iter)->get_name(), t, cv);
+      } else if (t->is_enum()) {
+        init = "static_cast<" + type_name(t) + ">(0)";
+      } else if (!t->is_string() && !t->is_uuid() && !is_reference(*m_iter)) {
+        init = "0";
+      }
+    }
+    if (is_arena_field(*m_iter)) {
+      init += init.empty() ? "alloc" : ", alloc";
+    } else if (init.empty()) {
+      continue;
+    }
+    out << sep << (*m_iter)->get_name() << "(" << init << ")";
+    sep = ",\n     ";
+  }
+  out << " {" << '\n';
+  indent_up();
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    if (!t->is_base_type() && !t->is_enum() && !is_reference(*m_iter)
+        && (*m_iter)->get_value() != nullptr) {
+      print_const_value(out, (*m_iter)->get_name(), t, (*m_iter)->get_value());
+    }
+  }
+  scope_down(out);
+  out << '\n';
+
+  string other = members.empty() ? "/* other */" : "other";
+  indent(out) << tstruct->get_name() << "::" << tstruct->get_name() << "(const "
+              << tstruct->get_name() << "& " << other << ", const allocator_type& " << alloc
+              << ")";
+  sep = "\n   : ";
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    out << sep << (*m_iter)->get_name() << "(other." << (*m_iter)->get_name()
+        << (is_arena_field(*m_iter) ? ", alloc" : "") << ")";
+    sep = ",\n     ";
+  }
+  out << " {" << '\n';
+  if (has_nonrequired_fields) {
+    indent_up();
+    indent(out) << "__isset = other.__isset;" << '\n';
+    indent_down();
+  }
+  indent(out) << "}" << '\n';
+}
+
 void t_cpp_generator::generate_copy_constructor(ostream& out,
                                                 t_struct* tstruct,
                                                 bool is_exception) {
@@ -1293,6 +1472,15 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     // Default constructor
     std::string clsname_ctor = tstruct->get_name() + "()";
     indent(out) << clsname_ctor << (has_default_value ? "" : " noexcept") << ";" << '\n';
+
+    // Allocator-extended constructors, so std::pmr containers pass their
+    // memory resource down to the elements
+    if (gen_arena_) {
+      out << '\n' << indent() << "typedef ::std::pmr::polymorphic_allocator<char> allocator_type;"
+          << '\n' << indent() << "explicit " << tstruct->get_name()
+          << "(const allocator_type& alloc);" << '\n' << indent() << tstruct->get_name()
+          << "(const " << tstruct->get_name() << "& other, const allocator_type& alloc);" << '\n';
+    }
   }
 
   if (tstruct->annotations_.find("final") == tstruct->annotations_.end()) {
@@ -1373,6 +1561,11 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
       out << ';' << '\n';
     }
   }
+  if (write && !pointers && gen_serialized_size_) {
+    out << '\n' << indent() << "template <class Size_>" << '\n' << indent()
+        << "uint32_t serializedSize() const;" << '\n' << indent()
+        << "uint32_t serializedSize(::apache::thrift::protocol::TProtocol* oprot) const;" << '\n';
+  }
   out << '\n';
 
   if (is_user_struct && !has_custom_ostream(tstruct)) {
@@ -1434,6 +1627,9 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
 		// file in case templates are involved. Since the constructor is not templated,
 		// putting it into the (later included) .tcc file would cause ODR violations.
     generate_default_constructor(force_cpp_out, tstruct, false);
+    if (gen_arena_) {
+      generate_allocator_constructors(force_cpp_out, tstruct);
+    }
   }
 
   // Create a setter function for each field
@@ -1475,11 +1671,12 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
  * @param tstruct The struct
  */
 void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bool pointers) {
+  string name = tstruct->get_name() + (in_view_ ? "_view" : "");
   if (gen_templates_) {
     out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
-        << tstruct->get_name() << "::read(Protocol_* iprot) {" << '\n';
+        << name << "::read(Protocol_* iprot) {" << '\n';
   } else {
-    indent(out) << "uint32_t " << tstruct->get_name()
+    indent(out) << "uint32_t " << name
                 << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
   }
   indent_up();
@@ -1721,6 +1918,78 @@ void t_cpp_generator::generate_struct_result_writer(ostream& out,
   indent(out) << "}" << '\n' << '\n';
 }
 
+/**
+ * Generates serializedSize(), the bytes the struct's writer writes. It is
+ * instantiated here for both sizes, so structs generated into other files
+ * can size this one as a field.
+ *
+ * @param out Output stream
+ * @param tstruct The struct
+ * @param result True for a function result, which writes only its one set field
+ */
+void t_cpp_generator::generate_struct_sizer(ostream& out, t_struct* tstruct, bool result) {
+  string name = tstruct->get_name();
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  out << indent() << "template <class Size_>" << '\n' << indent() << "uint32_t " << name
+      << "::serializedSize() const {" << '\n';
+  indent_up();
+
+  out << indent() << "uint32_t size = 0;" << '\n';
+  if (!fields.empty()) {
+    out << indent() << "int16_t lastFieldId = 0;" << '\n';
+  }
+
+  bool first = true;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    if (result) {
+      if (first) {
+        out << '\n' << indent() << "if ";
+      } else {
+        out << " else if ";
+      }
+      out << "(this->__isset." << (*f_iter)->get_name() << ") {" << '\n';
+      indent_up();
+    } else if ((*f_iter)->get_req() == t_field::T_OPTIONAL
+               || (*f_iter)->get_type()->is_xception()) {
+      out << '\n' << indent() << "if (this->__isset." << (*f_iter)->get_name() << ") {" << '\n';
+      indent_up();
+    } else {
+      out << '\n';
+    }
+    first = false;
+
+    out << indent() << "size += Size_::sizeFieldBegin(" << (*f_iter)->get_key()
+        << ", lastFieldId);" << '\n';
+    generate_size_field(out, *f_iter, "this->", "", true);
+
+    if (result) {
+      indent_down();
+      indent(out) << "}";
+    } else if ((*f_iter)->get_req() == t_field::T_OPTIONAL
+               || (*f_iter)->get_type()->is_xception()) {
+      indent_down();
+      indent(out) << "}" << '\n';
+    }
+  }
+
+  out << '\n' << indent() << "size += Size_::sizeFieldStop();" << '\n' << indent()
+      << "return size;" << '\n';
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+
+  out << indent() << "template uint32_t " << name
+      << "::serializedSize< ::apache::thrift::protocol::TBinarySize>() const;" << '\n'
+      << indent() << "template uint32_t " << name
+      << "::serializedSize< ::apache::thrift::protocol::TCompactSize>() const;" << '\n' << '\n';
+
+  indent(out) << "uint32_t " << name
+              << "::serializedSize(::apache::thrift::protocol::TProtocol* oprot) const {" << '\n';
+  indent(out) << "  return ::apache::thrift::protocol::serializedSize(*this, oprot);" << '\n';
+  indent(out) << "}" << '\n' << '\n';
+}
+
 /**
  * Generates the swap function.
  *
@@ -1782,6 +2051,65 @@ void t_cpp_generator::generate_struct_swap(ostream& out, t_struct* tstruct) {
   out << '\n';
 }
 
+/**
+ * Generates the view of a struct, for the views option: the same fields,
+ * with strings and binaries as std::string_views into the buffer the
+ * struct was read from (see TProtocol::readStringView()), and a read()
+ * method only. Defaults of container and struct fields are left empty.
+ * Views need C++17; older builds of the generated code leave them out.
+ *
+ * @param out Stream for the declaration
+ * @param impl_out Stream for read()
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_view(ostream& out, ostream& impl_out, t_struct* tstruct) {
+  const vector<t_field*>& members = tstruct->get_members();
+  vector<t_field*>::const_iterator m_iter;
+  bool has_nonrequired_fields = false;
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    if ((*m_iter)->get_req() != t_field::T_REQUIRED)
+      has_nonrequired_fields = true;
+  }
+
+  in_view_ = true;
+  out << "#if __cplusplus >= 201703L" << '\n' << '\n';
+  out << indent() << "class " << tstruct->get_name() << "_view {" << '\n' << indent()
+      << " public:" << '\n';
+  indent_up();
+
+  for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
+    t_type* t = get_true_type((*m_iter)->get_type());
+    t_const_value* cv = (*m_iter)->get_value();
+    bool scalar = t->is_enum() || (t->is_base_type() && !t->is_uuid());
+    if (cv != nullptr && scalar && !is_reference(*m_iter)) {
+      indent(out) << type_name(t) << " " << (*m_iter)->get_name() << " = "
+                  << render_const_value(out, (*m_iter)->get_name(), t, cv) << ";" << '\n';
+    } else {
+      indent(out) << declare_field(*m_iter, true) << '\n';
+    }
+  }
+
+  if (has_nonrequired_fields) {
+    out << '\n' << indent() << "_" << tstruct->get_name() << "__isset __isset;" << '\n';
+  }
+
+  out << '\n';
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent()
+        << "uint32_t read(Protocol_* iprot);" << '\n';
+  } else {
+    out << indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot);" << '\n';
+  }
+
+  indent_down();
+  indent(out) << "};" << '\n' << '\n' << "#endif" << '\n' << '\n';
+
+  impl_out << "#if __cplusplus >= 201703L" << '\n' << '\n';
+  generate_struct_reader(impl_out, tstruct);
+  impl_out << "#endif" << '\n' << '\n';
+  in_view_ = false;
+}
+
 void t_cpp_generator::generate_struct_ostream_operator_decl(std::ostream& out, t_struct* tstruct) {
   out << "std::ostream& operator<<(std::ostream& out, const "
       << tstruct->get_name()
@@ -2071,6 +2399,9 @@ void t_cpp_generator::generate_service_helpers(t_service* tservice) {
     generate_struct_definition(out, f_service_, ts, false);
     generate_struct_reader(out, ts);
     generate_struct_writer(out, ts);
+    if (gen_serialized_size_) {
+      generate_struct_sizer(f_service_, ts);
+    }
 
     ts->set_name(tservice->get_name() + "_" + (*f_iter)->get_name() + "_pargs");
     generate_struct_declaration(f_header_, ts, false, true, false, true);
@@ -3106,6 +3437,8 @@ public:
 
   void generate_class_definition();
   void generate_dispatch_call(bool template_protocol);
+  void generate_dispatch_switch();
+  void generate_dispatch_tree(const vector<t_function*>& functions);
   void generate_process_functions();
   void generate_factory();
 
@@ -3131,15 +3464,12 @@ protected:
   string if_name_;
   string factory_class_name_;
   string finish_cob_;
-  string finish_cob_decl_;
   string ret_type_;
   string call_context_;
   string cob_arg_;
   string call_context_arg_;
-  string call_context_decl_;
   string template_header_;
   string template_suffix_;
-  string typename_str_;
   string class_suffix_;
   string extends_;
 };
@@ -3159,7 +3489,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
     if_name_ = service_name_ + "CobSvIf";
 
     finish_cob_ = "::std::function<void(bool ok)> cob, ";
-    finish_cob_decl_ = "::std::function<void(bool ok)>, ";
     cob_arg_ = "cob, ";
     ret_type_ = "void ";
   } else {
@@ -3170,7 +3499,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
     // TODO(edhall) callContext should eventually be added to TAsyncProcessor
     call_context_ = ", void* callContext";
     call_context_arg_ = ", callContext";
-    call_context_decl_ = ", void*";
   }
 
   factory_class_name_ = class_name_ + "Factory";
@@ -3178,7 +3506,6 @@ ProcessorGenerator::ProcessorGenerator(t_cpp_generator* generator,
   if (generator->gen_templates_) {
     template_header_ = "template <class Protocol_>\n";
     template_suffix_ = "<Protocol_>";
-    typename_str_ = "typename ";
     class_name_ += "T";
     factory_class_name_ += "T";
   }
@@ -3237,30 +3564,6 @@ void ProcessorGenerator::generate_class_definition() {
   f_header_ << " private:" << '\n';
   indent_up();
 
-  // Declare processMap_
-  f_header_ << indent() << "typedef  void (" << class_name_ << "::*"
-            << "ProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-            << "::apache::thrift::protocol::TProtocol*, "
-            << "::apache::thrift::protocol::TProtocol*" << call_context_decl_ << ");" << '\n';
-  if (generator_->gen_templates_) {
-    f_header_ << indent() << "typedef void (" << class_name_ << "::*"
-              << "SpecializedProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-              << "Protocol_*, Protocol_*" << call_context_decl_ << ");" << '\n' << indent()
-              << "struct ProcessFunctions {" << '\n' << indent() << "  ProcessFunction generic;"
-              << '\n' << indent() << "  SpecializedProcessFunction specialized;" << '\n' << indent()
-              << "  ProcessFunctions(ProcessFunction g, "
-              << "SpecializedProcessFunction s) :" << '\n' << indent() << "    generic(g)," << '\n'
-              << indent() << "    specialized(s) {}" << '\n' << indent()
-              << "  ProcessFunctions() : generic(nullptr), specialized(nullptr) "
-              << "{}" << '\n' << indent() << "};" << '\n' << indent()
-              << "typedef std::map<std::string, ProcessFunctions> "
-              << "ProcessMap;" << '\n';
-  } else {
-    f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
-              << "ProcessMap;" << '\n';
-  }
-  f_header_ << indent() << "ProcessMap processMap_;" << '\n';
-
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
                       << "int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, "
@@ -3304,29 +3607,8 @@ void ProcessorGenerator::generate_class_definition() {
   if (!extends_.empty()) {
     f_header_ << indent() << "  " << extends_ << "(iface)," << '\n';
   }
-  f_header_ << indent() << "  iface_(iface) {" << '\n';
-  indent_up();
-
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    f_header_ << indent() << "processMap_[\"" << (*f_iter)->get_name() << "\"] = ";
-    if (generator_->gen_templates_) {
-      f_header_ << "ProcessFunctions(" << '\n';
-      if (generator_->gen_templates_only_) {
-        indent(f_header_) << "  nullptr," << '\n';
-      } else {
-        indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ","
-                          << '\n';
-      }
-      indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ")";
-    } else {
-      f_header_ << "&" << class_name_ << "::process_" << (*f_iter)->get_name();
-    }
-    f_header_ << ";" << '\n';
-  }
-
-  indent_down();
-  f_header_ << indent() << "}" << '\n' << '\n' << indent() << "virtual ~" << class_name_ << "() {}"
-            << '\n';
+  f_header_ << indent() << "  iface_(iface) {}" << '\n' << '\n' << indent() << "virtual ~"
+            << class_name_ << "() {}" << '\n';
   indent_down();
   f_header_ << "};" << '\n' << '\n';
 
@@ -3366,53 +3648,101 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << '\n';
   indent_up();
 
-  // HOT: member function pointer map
-  f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << '\n' << indent()
-         << "pfn = processMap_.find(fname);" << '\n' << indent()
-         << "if (pfn == processMap_.end()) {" << '\n';
+  // HOT: a switch over the method names, then the unknown method
+  generate_dispatch_switch();
   if (extends_.empty()) {
-    f_out_ << indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
-           << "  iprot->readMessageEnd();" << '\n' << indent()
-           << "  iprot->getTransport()->readEnd();" << '\n' << indent()
-           << "  ::apache::thrift::TApplicationException "
+    f_out_ << indent() << "iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
+           << "iprot->readMessageEnd();" << '\n' << indent()
+           << "iprot->getTransport()->readEnd();" << '\n' << indent()
+           << "::apache::thrift::TApplicationException "
               "x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: "
               "'\"+fname+\"'\");" << '\n' << indent()
-           << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
-           << '\n' << indent() << "  x.write(oprot);" << '\n' << indent()
-           << "  oprot->writeMessageEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->writeEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->flush();" << '\n' << indent()
-           << (style_ == "Cob" ? "  return cob(true);" : "  return true;") << '\n';
+           << "oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
+           << '\n' << indent() << "x.write(oprot);" << '\n' << indent()
+           << "oprot->writeMessageEnd();" << '\n' << indent()
+           << "oprot->getTransport()->writeEnd();" << '\n' << indent()
+           << "oprot->getTransport()->flush();" << '\n' << indent()
+           << (style_ == "Cob" ? "return cob(true);" : "return true;") << '\n';
   } else {
-    f_out_ << indent() << "  return " << extends_ << "::dispatchCall("
+    f_out_ << indent() << "return " << extends_ << "::dispatchCall("
            << (style_ == "Cob" ? "cob, " : "") << "iprot, oprot, fname, seqid" << call_context_arg_
            << ");" << '\n';
   }
+
+  indent_down();
+  f_out_ << "}" << '\n' << '\n';
+}
+
+/**
+ * Finds the method by fname's length, then by the characters of fname that
+ * tell the methods of that length apart, and calls its process_ function.
+ * Each method costs a few branches and one compare, however many methods
+ * the service has. An unknown method falls out of the switch.
+ */
+void ProcessorGenerator::generate_dispatch_switch() {
+  std::map<size_t, vector<t_function*> > by_length;
+  vector<t_function*> functions = service_->get_functions();
+  vector<t_function*>::iterator f_iter;
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    by_length[(*f_iter)->get_name().size()].push_back(*f_iter);
+  }
+  if (by_length.empty()) {
+    return;
+  }
+
+  f_out_ << indent() << "switch (fname.size()) {" << '\n';
+  std::map<size_t, vector<t_function*> >::iterator l_iter;
+  for (l_iter = by_length.begin(); l_iter != by_length.end(); ++l_iter) {
+    f_out_ << indent() << "case " << l_iter->first << ":" << '\n';
+    indent_up();
+    generate_dispatch_tree(l_iter->second);
+    f_out_ << indent() << "break;" << '\n';
+    indent_down();
+  }
   f_out_ << indent() << "}" << '\n';
-  if (template_protocol) {
-    f_out_ << indent() << "(this->*(pfn->second.specialized))";
-  } else {
-    if (generator_->gen_templates_only_) {
-      // TODO: This is a null pointer, so nothing good will come from calling
-      // it.  Throw an exception instead.
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else if (generator_->gen_templates_) {
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else {
-      f_out_ << indent() << "(this->*(pfn->second))";
-    }
+}
+
+void ProcessorGenerator::generate_dispatch_tree(const vector<t_function*>& functions) {
+  if (functions.size() == 1) {
+    const string& name = functions[0]->get_name();
+    f_out_ << indent() << "if (fname == \"" << name << "\") {" << '\n';
+    indent_up();
+    // Overloading picks the Protocol_ process_ function in dispatchCallTemplated()
+    f_out_ << indent() << "process_" << name << "(" << cob_arg_ << "seqid, iprot, oprot"
+           << call_context_arg_ << ");" << '\n' << indent()
+           << (style_ == "Cob" ? "return;" : "return true;") << '\n';
+    indent_down();
+    f_out_ << indent() << "}" << '\n';
+    return;
   }
-  f_out_ << "(" << cob_arg_ << "seqid, iprot, oprot" << call_context_arg_ << ");" << '\n';
 
-  // TODO(dreiss): return pfn ret?
-  if (style_ == "Cob") {
-    f_out_ << indent() << "return;" << '\n';
-  } else {
-    f_out_ << indent() << "return true;" << '\n';
+  // The names all have the same length. Switch on the character that
+  // splits them into the most groups, the first such if there are several.
+  size_t length = functions[0]->get_name().size();
+  std::map<char, vector<t_function*> > best;
+  size_t best_pos = 0;
+  for (size_t pos = 0; pos < length; ++pos) {
+    std::map<char, vector<t_function*> > by_char;
+    vector<t_function*>::const_iterator f_iter;
+    for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+      by_char[(*f_iter)->get_name()[pos]].push_back(*f_iter);
+    }
+    if (by_char.size() > best.size()) {
+      best.swap(by_char);
+      best_pos = pos;
+    }
   }
 
-  indent_down();
-  f_out_ << "}" << '\n' << '\n';
+  f_out_ << indent() << "switch (fname[" << best_pos << "]) {" << '\n';
+  std::map<char, vector<t_function*> >::iterator c_iter;
+  for (c_iter = best.begin(); c_iter != best.end(); ++c_iter) {
+    f_out_ << indent() << "case '" << c_iter->first << "':" << '\n';
+    indent_up();
+    generate_dispatch_tree(c_iter->second);
+    f_out_ << indent() << "break;" << '\n';
+    indent_down();
+  }
+  f_out_ << indent() << "}" << '\n';
 }
 
 void ProcessorGenerator::generate_process_functions() {
@@ -3518,6 +3848,9 @@ void t_cpp_generator::generate_function_helpers(t_service* tservice, t_function*
   generate_struct_definition(out, f_service_, &result, false);
   generate_struct_reader(out, &result);
   generate_struct_result_writer(out, &result);
+  if (gen_serialized_size_) {
+    generate_struct_sizer(f_service_, &result, true);
+  }
 
   result.set_name(tservice->get_name() + "_" + tfunction->get_name() + "_presult");
   generate_struct_declaration(f_header_, &result, false, true, true, gen_cob_style_);
@@ -3526,6 +3859,25 @@ void t_cpp_generator::generate_function_helpers(t_service* tservice, t_function*
   if (gen_cob_style_) {
     generate_struct_writer(out, &result, true);
   }
+
+  // Replies read in place
+  if (gen_views_) {
+    result.set_name(tservice->get_name() + "_" + tfunction->get_name() + "_result");
+    generate_struct_view(f_header_, out, &result);
+  }
+}
+
+/**
+ * Reserves the size of a processor's reply in its output transport, with
+ * serialized_size, so a transport that buffers the frame allocates it once.
+ */
+void t_cpp_generator::generate_reply_reservation(ostream& out, t_function* tfunction) {
+  if (!gen_serialized_size_) {
+    return;
+  }
+  indent(out) << "oprot->getTransport()->reserveWrite("
+              << "::apache::thrift::protocol::serializedMessageSize(oprot, \""
+              << tfunction->get_name() << "\", seqid, result));" << '\n';
 }
 
 /**
@@ -3583,16 +3935,24 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         << "this->eventHandler_.get(), ctx, " << service_func_name << ");" << '\n' << '\n'
         << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->preRead(ctx, " << service_func_name << ");" << '\n' << indent()
-        << "}" << '\n' << '\n' << indent() << argsname << " args;" << '\n' << indent()
-        << "args.read(iprot);" << '\n' << indent() << "iprot->readMessageEnd();" << '\n' << indent()
-        << "uint32_t bytes = iprot->getTransport()->readEnd();" << '\n' << '\n' << indent()
+        << "}" << '\n' << '\n';
+    // The args and result are built in the thread's arena, reset once the
+    // reply is written
+    if (gen_arena_) {
+      out << indent() << "::apache::thrift::TArena::Scope arena;" << '\n' << indent() << argsname
+          << " args(arena.get());" << '\n';
+    } else {
+      out << indent() << argsname << " args;" << '\n';
+    }
+    out << indent() << "args.read(iprot);" << '\n' << indent() << "iprot->readMessageEnd();" << '\n'
+        << indent() << "uint32_t bytes = iprot->getTransport()->readEnd();" << '\n' << '\n' << indent()
         << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->postRead(ctx, " << service_func_name << ", bytes);" << '\n'
         << indent() << "}" << '\n' << '\n';
 
     // Declare result
     if (!tfunction->is_oneway()) {
-      out << indent() << resultname << " result;" << '\n';
+      out << indent() << resultname << (gen_arena_ ? " result(arena.get());" : " result;") << '\n';
     }
 
     // Try block for functions with exceptions
@@ -3683,7 +4043,9 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
     // Serialize the result into a struct
     out << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n' << indent()
-        << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name()
+        << "}" << '\n' << '\n';
+    generate_reply_reservation(out, tfunction);
+    out << indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name()
         << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n' << indent()
         << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();" << '\n'
         << indent() << "bytes = oprot->getTransport()->writeEnd();" << '\n' << indent()
@@ -3852,7 +4214,9 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
           << "this->eventHandler_.get(), ctx, " << service_func_name << ");" << '\n' << '\n'
           << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
           << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n'
-          << indent() << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\""
+          << indent() << "}" << '\n' << '\n';
+      generate_reply_reservation(out, tfunction);
+      out << indent() << "oprot->writeMessageBegin(\""
           << tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n'
           << indent() << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();"
           << '\n' << indent() << "uint32_t bytes = oprot->getTransport()->writeEnd();" << '\n'
@@ -3931,7 +4295,9 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
       // Serialize the result into a struct
       out << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
           << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n'
-          << indent() << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\""
+          << indent() << "}" << '\n' << '\n';
+      generate_reply_reservation(out, tfunction);
+      out << indent() << "oprot->writeMessageBegin(\""
           << tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n'
           << indent() << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();"
           << '\n' << indent() << "uint32_t bytes = oprot->getTransport()->writeEnd();" << '\n'
@@ -4036,6 +4402,14 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
     generate_deserialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_deserialize_container(out, type, name);
+  } else if (in_view_ && type->is_string()) {
+    indent(out) << "xfer += ::apache::thrift::protocol::"
+                << (type->is_binary() ? "readBinaryView" : "readStringView") << "(*iprot, " << name
+                << ");" << '\n';
+  } else if (is_arena_string(type)) {
+    indent(out) << "xfer += ::apache::thrift::protocol::"
+                << (type->is_binary() ? "readBinary" : "readString") << "(*iprot, " << name << ");"
+                << '\n';
   } else if (type->is_base_type()) {
     indent(out) << "xfer += iprot->";
     t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
@@ -4144,6 +4518,12 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
     if (!use_push) {
       indent(out) << prefix << ".resize(" << size << ");" << '\n';
     }
+    if (is_byte_list(ttype)) {
+      indent(out) << "xfer += iprot->readBytes(" << prefix << ".data(), " << size << ");" << '\n';
+      indent(out) << "xfer += iprot->readListEnd();" << '\n';
+      scope_down(out);
+      return;
+    }
   }
 
   // For loop iterates over elements
@@ -4244,6 +4624,10 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
     generate_serialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_serialize_container(out, type, name);
+  } else if (is_arena_string(type)) {
+    indent(out) << "xfer += ::apache::thrift::protocol::"
+                << (type->is_binary() ? "writeBinary" : "writeString") << "(*oprot, " << name
+                << ");" << '\n';
   } else if (type->is_base_type() || type->is_enum()) {
 
     indent(out) << "xfer += oprot->";
@@ -4335,6 +4719,13 @@ void t_cpp_generator::generate_serialize_container(ostream& out, t_type* ttype,
     indent(out) << "xfer += oprot->writeListBegin("
                 << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
                 << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+    if (is_byte_list(ttype)) {
+      indent(out) << "xfer += oprot->writeBytes(" << prefix << ".data(), "
+                  << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+      indent(out) << "xfer += oprot->writeListEnd();" << '\n';
+      scope_down(out);
+      return;
+    }
   }
 
   string iter = tmp("_iter");
@@ -4390,6 +4781,111 @@ void t_cpp_generator::generate_serialize_list_element(ostream& out, t_list* tlis
   generate_serialize_field(out, &efield, "");
 }
 
+/**
+ * Adds the bytes a field's value takes to size, as generate_serialize_field()
+ * writes it.
+ *
+ * @param in_field True for a struct's field, rather than a container's element
+ */
+void t_cpp_generator::generate_size_field(ostream& out,
+                                          t_field* tfield,
+                                          string prefix,
+                                          string suffix,
+                                          bool in_field) {
+  t_type* type = get_true_type(tfield->get_type());
+  string name = prefix + tfield->get_name() + suffix;
+
+  if (type->is_struct() || type->is_xception()) {
+    if (is_reference(tfield)) {
+      // A null reference is written as an empty struct
+      indent(out) << "size += " << name << " ? " << name
+                  << "->serializedSize<Size_>() : Size_::sizeFieldStop();" << '\n';
+    } else {
+      indent(out) << "size += " << name << ".serializedSize<Size_>();" << '\n';
+    }
+  } else if (type->is_container()) {
+    generate_size_container(out, type, name);
+  } else if (type->is_base_type()) {
+    indent(out) << "size += Size_::";
+    t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
+    switch (tbase) {
+    case t_base_type::TYPE_UUID:
+      out << "sizeUUID();";
+      break;
+    case t_base_type::TYPE_STRING:
+      out << "sizeString(static_cast<uint32_t>(" << name << ".size()));";
+      break;
+    case t_base_type::TYPE_BOOL:
+      out << "sizeBool(" << (in_field ? "true" : "false") << ");";
+      break;
+    case t_base_type::TYPE_I8:
+      out << "sizeByte();";
+      break;
+    case t_base_type::TYPE_I16:
+      out << "sizeI16(" << name << ");";
+      break;
+    case t_base_type::TYPE_I32:
+      out << "sizeI32(" << name << ");";
+      break;
+    case t_base_type::TYPE_I64:
+      out << "sizeI64(" << name << ");";
+      break;
+    case t_base_type::TYPE_DOUBLE:
+      out << "sizeDouble();";
+      break;
+    default:
+      throw "compiler error: no C++ size for base type " + t_base_type::t_base_name(tbase) + " "
+          + name;
+    }
+    out << '\n';
+  } else if (type->is_enum()) {
+    indent(out) << "size += Size_::sizeI32(static_cast<int32_t>(" << name << "));" << '\n';
+  } else {
+    throw "compiler error: no C++ size for type " + type_name(type) + " " + name;
+  }
+}
+
+void t_cpp_generator::generate_size_container(ostream& out, t_type* ttype, string prefix) {
+  scope_up(out);
+
+  if (ttype->is_map()) {
+    indent(out) << "size += Size_::sizeMapBegin(static_cast<uint32_t>(" << prefix << ".size()));"
+                << '\n';
+  } else if (ttype->is_set()) {
+    indent(out) << "size += Size_::sizeSetBegin(static_cast<uint32_t>(" << prefix << ".size()));"
+                << '\n';
+  } else if (ttype->is_list()) {
+    indent(out) << "size += Size_::sizeListBegin(static_cast<uint32_t>(" << prefix << ".size()));"
+                << '\n';
+    if (is_byte_list(ttype)) {
+      indent(out) << "size += static_cast<uint32_t>(" << prefix << ".size());" << '\n';
+      scope_down(out);
+      return;
+    }
+  }
+
+  string iter = tmp("_iter");
+  out << indent() << type_name(ttype) << "::const_iterator " << iter << ";" << '\n' << indent()
+      << "for (" << iter << " = " << prefix << ".begin(); " << iter << " != " << prefix
+      << ".end(); ++" << iter << ")" << '\n';
+  scope_up(out);
+  if (ttype->is_map()) {
+    t_field kfield(((t_map*)ttype)->get_key_type(), iter + "->first");
+    generate_size_field(out, &kfield);
+    t_field vfield(((t_map*)ttype)->get_val_type(), iter + "->second");
+    generate_size_field(out, &vfield);
+  } else if (ttype->is_set()) {
+    t_field efield(((t_set*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_size_field(out, &efield);
+  } else if (ttype->is_list()) {
+    t_field efield(((t_list*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_size_field(out, &efield);
+  }
+  scope_down(out);
+
+  scope_down(out);
+}
+
 /**
  * Makes a :: prefix for a namespace
  *
@@ -4474,6 +4970,13 @@ string t_cpp_generator::namespace_close(string ns) {
  * @return String of the type name, i.e. std::set<type>
  */
 string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
+  if (in_view_) {
+    ttype = get_true_type(ttype);
+    if (ttype->is_string()) {
+      return "std::string_view";
+    }
+  }
+
   if (ttype->is_base_type()) {
     string bname = base_type_name(((t_base_type*)ttype)->get_base());
     std::map<string, std::vector<string>>::iterator it = ttype->annotations_.find("cpp.type");
@@ -4501,14 +5004,15 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
       cname = tcontainer->get_cpp_name();
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*)ttype;
-      cname = "std::map<" + type_name(tmap->get_key_type(), in_typedef) + ", "
+      cname = container_namespace() + "map<" + type_name(tmap->get_key_type(), in_typedef) + ", "
               + type_name(tmap->get_val_type(), in_typedef) + "> ";
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*)ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      cname = container_namespace() + "set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*)ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      cname = container_namespace() + "vector<" + type_name(tlist->get_elem_type(), in_typedef)
+              + "> ";
     }
 
     if (arg) {
@@ -4536,6 +5040,10 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
     pname += "::type";
   }
 
+  if (in_view_ && (ttype->is_struct() || ttype->is_xception())) {
+    pname += "_view";
+  }
+
   if (arg) {
     if (is_complex_type(ttype)) {
       return "const " + pname + "&";
@@ -4558,7 +5066,7 @@ string t_cpp_generator::base_type_name(t_base_type::t_base tbase) {
   case t_base_type::TYPE_VOID:
     return "void";
   case t_base_type::TYPE_STRING:
-    return "std::string";
+    return gen_arena_ ? "std::pmr::string" : "std::string";
   case t_base_type::TYPE_BOOL:
     return "bool";
   case t_base_type::TYPE_I8:
@@ -4854,4 +5362,10 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    views:           Also generate read-only <struct>_view types, whose strings are\n"
+    "                     std::string_views into the buffer read from (C++17).\n"
+    "    arena:           Use std::pmr strings and containers, and build each call's args and\n"
+    "                     result in the thread's TArena, reset after the reply (C++17).\n"
+    "    serialized_size: Generate serializedSize() for the binary and compact protocols, and\n"
+    "                     reserve each reply's size in the transport before writing it.\n")
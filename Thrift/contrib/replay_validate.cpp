@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <thrift/transport/ReplayValidator.h>
+
+using namespace std;
+using apache::thrift::transport::ReplayValidator;
+
+void usage() {
+  fprintf(stderr,
+      "usage: replay_validate [options] captured.bin responses...\n"
+      "  -c                 responses are PacketLogger captures, not replay segments\n"
+      "  -k <n>             show the first <n> differences (default 10)\n"
+      "  -f <method>:<id>   leave out field <id> of <method>'s messages\n"
+      "  -b <method>:<offset>:<length>\n"
+      "                     leave out bytes of <method>'s messages\n"
+      "  <method> may be empty to apply to every method.\n"
+      "exits 0 if the responses match, 1 if not, 2 on errors\n");
+  exit(2);
+}
+
+// Splits "method:a[:b]" at its last one or two colons
+bool parseMask(const string& arg, int parts, string& method, unsigned long* values) {
+  string rest = arg;
+  for (int i = parts - 1; i >= 0; --i) {
+    size_t colon = rest.rfind(':');
+    if (colon == string::npos) {
+      return false;
+    }
+    char* end;
+    values[i] = strtoul(rest.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || colon + 1 == rest.size()) {
+      return false;
+    }
+    rest.resize(colon);
+  }
+  method = rest;
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  ReplayValidator validator;
+  ReplayValidator::Format actualFormat = ReplayValidator::REPLAY;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    string opt = argv[i];
+    string method;
+    unsigned long values[2];
+    if (opt == "-c") {
+      actualFormat = ReplayValidator::CAPTURE;
+    } else if (opt == "-k" && i + 1 < argc) {
+      validator.setMaxDiffs(strtoul(argv[++i], nullptr, 10));
+    } else if (opt == "-f" && i + 1 < argc && parseMask(argv[++i], 1, method, values)) {
+      validator.maskField(method, static_cast<int16_t>(values[0]));
+    } else if (opt == "-b" && i + 1 < argc && parseMask(argv[++i], 2, method, values)) {
+      validator.maskBytes(method, static_cast<uint32_t>(values[0]),
+                          static_cast<uint32_t>(values[1]));
+    } else {
+      usage();
+    }
+  }
+  if (argc - i < 2) {
+    usage();
+  }
+
+  if (!validator.addExpectedFile(argv[i], ReplayValidator::CAPTURE)) {
+    fprintf(stderr, "replay_validate: cannot read %s: %s\n", argv[i], strerror(errno));
+    return 2;
+  }
+  for (++i; i < argc; ++i) {
+    if (!validator.addActualFile(argv[i], actualFormat)) {
+      fprintf(stderr, "replay_validate: cannot read %s: %s\n", argv[i], strerror(errno));
+      return 2;
+    }
+  }
+
+  bool ok = validator.validate();
+  validator.print(cout);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <thrift/transport/StageProfiler.h>
+
+using namespace std;
+using apache::thrift::transport::StageProfiler;
+
+void usage() {
+  fprintf(stderr,
+      "usage: stage_breakdown [options] trace_dir\n"
+      "  -r <file>          write each request's stage latencies to <file> as CSV\n"
+      "  -o <prefix>        write .hgrm histograms to <prefix>_<method>_<stage>.hgrm\n"
+      "trace_dir holds the binary PacketLogger streams, dpdk_to_rpc.bin and on\n");
+  exit(2);
+}
+
+int main(int argc, char* argv[]) {
+  string requestLog;
+  string reportPrefix;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    string opt = argv[i];
+    if (opt == "-r" && i + 1 < argc) {
+      requestLog = argv[++i];
+    } else if (opt == "-o" && i + 1 < argc) {
+      reportPrefix = argv[++i];
+    } else {
+      usage();
+    }
+  }
+  if (argc - i != 1) {
+    usage();
+  }
+
+  StageProfiler profiler;
+  ofstream log;
+  if (!requestLog.empty()) {
+    log.open(requestLog.c_str());
+    if (!log) {
+      fprintf(stderr, "stage_breakdown: cannot write %s\n", requestLog.c_str());
+      return 1;
+    }
+    profiler.setRequestLog(&log);
+  }
+
+  if (!profiler.analyze(argv[i])) {
+    fprintf(stderr, "stage_breakdown: cannot read the traces in %s: %s\n", argv[i],
+            strerror(errno));
+    return 1;
+  }
+  profiler.print(cout);
+
+  if (!reportPrefix.empty() && !profiler.writeReports(reportPrefix)) {
+    fprintf(stderr, "stage_breakdown: cannot write %s_*.hgrm\n", reportPrefix.c_str());
+    return 1;
+  }
+  return 0;
+}
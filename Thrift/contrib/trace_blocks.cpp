@@ -0,0 +1,159 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <thrift/transport/BlockTrace.h>
+
+using namespace std;
+using apache::thrift::transport::BlockTrace;
+using apache::thrift::transport::BlockTraceReader;
+using apache::thrift::transport::BlockTraceWriter;
+using apache::thrift::transport::TTransportException;
+
+void usage() {
+  fprintf(stderr,
+      "usage: trace_blocks [options] in out\n"
+      "  -d                 decompress: in is a block trace, out a .bin trace\n"
+      "  -s <stream>        in is this PacketLogger stream (default dpdk_to_rpc):\n"
+      "                     dpdk_to_rpc, rpc_to_app, app_to_rpc or rpc_to_dpdk\n"
+      "  -l <level>         zlib level, 1 (fast, default) to 9 (small)\n"
+      "  -b <bytes>         raw bytes per block (default 1048576)\n");
+  exit(2);
+}
+
+// Record header before the data: ts, req_id, then post_type or result
+// for the app stages, then the u16 size
+size_t headerSize(const string& stream) {
+  if (stream == "dpdk_to_rpc" || stream == "rpc_to_dpdk") {
+    return 18;
+  } else if (stream == "rpc_to_app") {
+    return 22;
+  } else if (stream == "app_to_rpc") {
+    return 26;
+  }
+  usage();
+  return 0;
+}
+
+// Copies whole records from in to the writer, a quarter block at a time;
+// a partial record at the end is left out
+uint64_t compress(FILE* in, size_t header, uint32_t blockBytes, BlockTraceWriter& writer) {
+  vector<uint8_t> batch;
+  uint32_t records = 0;
+  uint64_t total = 0;
+  uint8_t rec[26 + 65535];
+  while (fread(rec, header, 1, in) == 1) {
+    uint16_t size;
+    memcpy(&size, rec + header - 2, sizeof(size));
+    if (size > 0 && fread(rec + header, size, 1, in) != 1) {
+      fprintf(stderr, "trace_blocks: partial record at the end left out\n");
+      break;
+    }
+    batch.insert(batch.end(), rec, rec + header + size);
+    records++;
+    if (batch.size() >= blockBytes / 4) {
+      writer.append(batch.data(), batch.size(), records);
+      total += records;
+      batch.clear();
+      records = 0;
+    }
+  }
+  writer.append(batch.data(), batch.size(), records);
+  return total + records;
+}
+
+int main(int argc, char* argv[]) {
+  bool decompress = false;
+  string stream = "dpdk_to_rpc";
+  int level = BlockTrace::DEFAULT_LEVEL;
+  uint32_t blockBytes = BlockTrace::BLOCK_BYTES;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    string opt = argv[i];
+    if (opt == "-d") {
+      decompress = true;
+    } else if (opt == "-s" && i + 1 < argc) {
+      stream = argv[++i];
+    } else if (opt == "-l" && i + 1 < argc) {
+      level = atoi(argv[++i]);
+    } else if (opt == "-b" && i + 1 < argc) {
+      blockBytes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else {
+      usage();
+    }
+  }
+  if (argc - i != 2 || level < 1 || level > 9 || blockBytes == 0) {
+    usage();
+  }
+  const char* inPath = argv[i];
+  const char* outPath = argv[i + 1];
+  size_t header = headerSize(stream);
+
+  try {
+    if (decompress) {
+      BlockTraceReader reader(inPath);
+      FILE* out = fopen(outPath, "wb");
+      if (!out) {
+        fprintf(stderr, "trace_blocks: cannot write %s: %s\n", outPath, strerror(errno));
+        return 1;
+      }
+      vector<uint8_t> block;
+      for (size_t b = 0; b < reader.blocks(); ++b) {
+        reader.read(b, block);
+        if (fwrite(block.data(), 1, block.size(), out) != block.size()) {
+          fprintf(stderr, "trace_blocks: cannot write %s: %s\n", outPath, strerror(errno));
+          fclose(out);
+          return 1;
+        }
+      }
+      if (fclose(out) != 0) {
+        fprintf(stderr, "trace_blocks: cannot write %s: %s\n", outPath, strerror(errno));
+        return 1;
+      }
+      printf("%llu records, %llu bytes from %llu in %llu blocks\n",
+             (unsigned long long)reader.records(), (unsigned long long)reader.rawSize(),
+             (unsigned long long)reader.fileSize(), (unsigned long long)reader.blocks());
+      return 0;
+    }
+
+    FILE* in = fopen(inPath, "rb");
+    if (!in) {
+      fprintf(stderr, "trace_blocks: cannot read %s: %s\n", inPath, strerror(errno));
+      return 1;
+    }
+    BlockTraceWriter writer(outPath, blockBytes, level);
+    uint64_t records = compress(in, header, blockBytes, writer);
+    fclose(in);
+    writer.close();
+    printf("%llu records, %llu bytes to %llu (%.1fx)\n", (unsigned long long)records,
+           (unsigned long long)writer.rawBytes(), (unsigned long long)writer.fileBytes(),
+           writer.fileBytes() ? double(writer.rawBytes()) / writer.fileBytes() : 0.0);
+  } catch (const TTransportException& e) {
+    fprintf(stderr, "trace_blocks: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <thrift/transport/PcapTrace.h>
+
+using namespace std;
+using apache::thrift::transport::PcapTrace;
+using apache::thrift::transport::TTransportException;
+
+void usage() {
+  fprintf(stderr,
+      "usage: trace_pcap export [-s ip:port] [-c ip:port] dpdk_to_rpc.bin [rpc_to_dpdk.bin] out.pcapng\n"
+      "       trace_pcap import -p port in.pcap dpdk_to_rpc.bin [rpc_to_dpdk.bin]\n"
+      "  -s <ip>:<port>     server address in the exported packets (default 10.0.0.1:9090)\n"
+      "  -c <ip>:<port>     client address in the exported packets (default 10.0.0.2:40000)\n"
+      "  -p <port>          server port; UDP sent to it are requests, from it responses\n");
+  exit(2);
+}
+
+bool parseEndpoint(const string& arg, PcapTrace::Endpoint& endpoint) {
+  size_t colon = arg.rfind(':');
+  if (colon == string::npos) {
+    return false;
+  }
+  struct in_addr addr;
+  if (inet_pton(AF_INET, arg.substr(0, colon).c_str(), &addr) != 1) {
+    return false;
+  }
+  char* end;
+  unsigned long port = strtoul(arg.c_str() + colon + 1, &end, 10);
+  if (*end != '\0' || colon + 1 == arg.size() || port > 65535) {
+    return false;
+  }
+  endpoint.ip = ntohl(addr.s_addr);
+  endpoint.port = static_cast<uint16_t>(port);
+  return true;
+}
+
+void printStats(const PcapTrace::Stats& stats) {
+  fprintf(stderr, "%llu packets, %llu requests, %llu responses, %llu skipped, %llu truncated\n",
+          (unsigned long long)stats.packets, (unsigned long long)stats.requests,
+          (unsigned long long)stats.responses, (unsigned long long)stats.skipped,
+          (unsigned long long)stats.truncated);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    usage();
+  }
+  string command = argv[1];
+  PcapTrace::ExportOptions options;
+  long port = -1;
+
+  int i = 2;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    string opt = argv[i];
+    if (command == "export" && opt == "-s" && i + 1 < argc
+        && parseEndpoint(argv[++i], options.server)) {
+      continue;
+    } else if (command == "export" && opt == "-c" && i + 1 < argc
+               && parseEndpoint(argv[++i], options.client)) {
+      continue;
+    } else if (command == "import" && opt == "-p" && i + 1 < argc) {
+      char* end;
+      port = strtol(argv[++i], &end, 10);
+      if (*end == '\0' && port > 0 && port <= 65535) {
+        continue;
+      }
+    }
+    usage();
+  }
+
+  int args = argc - i;
+  try {
+    if (command == "export" && (args == 2 || args == 3)) {
+      string responses = args == 3 ? argv[i + 1] : "";
+      printStats(PcapTrace::exportPcapng(argv[i], responses, argv[argc - 1], options));
+    } else if (command == "import" && port > 0 && (args == 2 || args == 3)) {
+      string responses = args == 3 ? argv[i + 2] : "";
+      printStats(PcapTrace::importPcap(argv[i], static_cast<uint16_t>(port), argv[i + 1],
+                                       responses));
+    } else {
+      usage();
+    }
+  } catch (TTransportException& e) {
+    fprintf(stderr, "trace_pcap: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TARENA_H_
+#define _THRIFT_TARENA_H_ 1
+
+// std::pmr is C++17; the rest of the library builds as C++11
+#if __cplusplus >= 201703L
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Memory for the structs of one request, with the cpp:arena generator
+ * option. The generated types use std::pmr strings and containers, and
+ * generated processors build each call's args and result from the calling
+ * thread's arena.
+ *
+ * Allocating bumps a pointer through blocks taken from upstream, and
+ * deallocating does nothing. reset() frees everything at once and keeps
+ * the blocks, so a thread serving requests of about the same size stops
+ * allocating after its first few. trim() gives back the blocks beyond
+ * maxRetained bytes, so one large request does not hold its memory for
+ * the life of the thread.
+ */
+class TArena : public std::pmr::memory_resource {
+public:
+  explicit TArena(size_t blockSize = 64 * 1024,
+                  std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                  size_t maxRetained = 1024 * 1024)
+    : blockSize_(blockSize),
+      maxRetained_(maxRetained),
+      upstream_(upstream),
+      block_(0),
+      used_(0),
+      allocated_(0),
+      depth_(0) {}
+
+  ~TArena() override {
+    for (const Block& b : blocks_) {
+      upstream_->deallocate(b.data, b.size);
+    }
+  }
+
+  TArena(const TArena&) = delete;
+  TArena& operator=(const TArena&) = delete;
+
+  /** Frees everything allocated since the last reset(), keeping the blocks */
+  void reset() {
+    block_ = 0;
+    used_ = 0;
+    allocated_ = 0;
+  }
+
+  /**
+   * Returns the blocks beyond the first maxRetained bytes upstream. Only
+   * call it right after reset(), as it frees blocks that may be in use.
+   */
+  void trim() {
+    size_t kept = 0;
+    size_t i = 0;
+    for (; i < blocks_.size() && kept + blocks_[i].size <= maxRetained_; ++i) {
+      kept += blocks_[i].size;
+    }
+    for (size_t j = i; j < blocks_.size(); ++j) {
+      upstream_->deallocate(blocks_[j].data, blocks_[j].size);
+    }
+    blocks_.resize(i);
+  }
+
+  /** Bytes handed out since the last reset() */
+  size_t allocated() const { return allocated_; }
+
+  /** Bytes held from upstream */
+  size_t capacity() const {
+    size_t total = 0;
+    for (const Block& b : blocks_) {
+      total += b.size;
+    }
+    return total;
+  }
+
+  /** The calling thread's arena, which generated processors allocate from */
+  static TArena& current() {
+    static thread_local TArena arena;
+    return arena;
+  }
+
+  /**
+   * Holds the calling thread's arena for one request, and resets and trims
+   * it when the outermost Scope on the thread ends. Generated processors open one
+   * around reading the args, the handler and writing the reply, so the
+   * handler must not keep any of the args or result past its return.
+   */
+  class Scope {
+  public:
+    Scope() : arena_(current()) { ++arena_.depth_; }
+    ~Scope() {
+      if (--arena_.depth_ == 0) {
+        arena_.reset();
+        arena_.trim();
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    TArena* get() const { return &arena_; }
+
+  private:
+    TArena& arena_;
+  };
+
+protected:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    for (; block_ < blocks_.size(); ++block_, used_ = 0) {
+      Block& b = blocks_[block_];
+      // Align the address, as upstream only aligns blocks to max_align_t
+      uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+      size_t start = ((base + used_ + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+      if (start <= b.size && bytes <= b.size - start) {
+        used_ = start + bytes;
+        allocated_ += bytes;
+        return b.data + start;
+      }
+    }
+
+    // Grow geometrically, so a large reply takes a few blocks, not many
+    size_t size = std::max(blockSize_, bytes + alignment);
+    if (!blocks_.empty()) {
+      size = std::max(size, blocks_.back().size * 2);
+    }
+    Block b = {static_cast<char*>(upstream_->allocate(size, alignof(std::max_align_t))), size};
+    blocks_.push_back(b);
+    block_ = blocks_.size() - 1;
+    used_ = 0;
+    return do_allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  size_t blockSize_;
+  size_t maxRetained_;
+  std::pmr::memory_resource* upstream_;
+  std::vector<Block> blocks_;
+  size_t block_;
+  size_t used_;
+  size_t allocated_;
+  int depth_;
+};
+}
+} // apache::thrift
+
+#endif
+
+#endif // #ifndef _THRIFT_TARENA_H_
@@ -41,6 +41,8 @@
 #include <vector>
 #include <exception>
 #include <typeinfo>
+#include <cstddef>
+#include <iterator>
 
 #include <thrift/TLogging.h>
 #include <thrift/TOutput.h>
@@ -50,9 +52,15 @@
 namespace apache {
 namespace thrift {
 
-class TEnumIterator
-    : public std::iterator<std::forward_iterator_tag, std::pair<int, const char*> > {
+class TEnumIterator {
 public:
+  // std::iterator is deprecated in C++17
+  typedef std::forward_iterator_tag iterator_category;
+  typedef std::pair<int, const char*> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef value_type* pointer;
+  typedef value_type& reference;
+
   TEnumIterator(int n, int* enums, const char** names)
     : ii_(0), n_(n), enums_(enums), names_(names) {}
 
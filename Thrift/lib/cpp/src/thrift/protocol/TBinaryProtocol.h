@@ -121,6 +121,12 @@ public:
 
   inline uint32_t writeUUID(const TUuid& uuid);
 
+  inline uint32_t writeBytes(const int8_t* bytes, uint32_t size);
+
+  inline uint32_t writeStringView(const char* data, uint32_t size);
+
+  inline uint32_t writeBinaryView(const char* data, uint32_t size);
+
   /**
    * Reading functions
    */
@@ -170,8 +176,20 @@ public:
 
   inline uint32_t readUUID(TUuid& uuid);
 
+  inline uint32_t readBytes(int8_t* bytes, uint32_t size);
+
+  inline uint32_t readStringView(const char*& data, uint32_t& size);
+
+  inline uint32_t readBinaryView(const char*& data, uint32_t& size);
+
+  inline uint32_t readStringInto(TStringSink& sink);
+
+  inline uint32_t readBinaryInto(TStringSink& sink);
+
   int getMinSerializedSize(TType type) override;
 
+  TWireFormat getWireFormat() override { return T_BINARY_WIRE; }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(set.size_ * getMinSerializedSize(set.elemType_));
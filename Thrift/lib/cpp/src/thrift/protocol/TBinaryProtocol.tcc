@@ -193,6 +193,24 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinary(const std::string
   return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView(const char* data,
+                                                                   uint32_t size) {
+  if (size > static_cast<uint32_t>((std::numeric_limits<int32_t>::max)()))
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  uint32_t result = writeI32((int32_t)size);
+  if (size > 0) {
+    this->trans_->write((const uint8_t*)data, size);
+  }
+  return result + size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinaryView(const char* data,
+                                                                   uint32_t size) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView(data, size);
+}
+
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeUUID(const TUuid& uuid) {
   // TODO: Consider endian swapping, see lib/delphi/src/Thrift.Utils.pas:377
@@ -200,6 +218,15 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeUUID(const TUuid& uuid)
   return 16;
 }
 
+/**
+ * An i8 is a byte on the wire, so a list<i8> is written in one go
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBytes(const int8_t* bytes, uint32_t size) {
+  this->trans_->write(reinterpret_cast<const uint8_t*>(bytes), size);
+  return size;
+}
+
 /**
  * Reading functions
  */
@@ -208,6 +235,7 @@ template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readMessageBegin(std::string& name,
                                                                     TMessageType& messageType,
                                                                     int32_t& seqid) {
+  this->releaseViews();
   uint32_t result = 0;
   int32_t sz;
   result += readI32(sz);
@@ -441,6 +469,71 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readUUID(TUuid& uuid) {
   return 16;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBytes(int8_t* bytes, uint32_t size) {
+  this->trans_->readAll(reinterpret_cast<uint8_t*>(bytes), size);
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(const char*& data,
+                                                                  uint32_t& size) {
+  int32_t sz;
+  uint32_t result = readI32(sz);
+  if (sz == 0) {
+    data = "";
+    size = 0;
+    return result;
+  }
+
+  // Lend it if the transport holds the frame, see TProtocol::readStringView()
+  if (sz > 0 && (this->string_limit_ <= 0 || sz <= this->string_limit_) && this->lendsViews()) {
+    uint32_t got = sz;
+    const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+    if (borrow_buf) {
+      data = reinterpret_cast<const char*>(borrow_buf);
+      size = static_cast<uint32_t>(sz);
+      this->trans_->consume(size);
+      return result + size;
+    }
+  }
+
+  std::string& str = this->viewCopy();
+  result += readStringBody(str, sz);
+  data = str.data();
+  size = static_cast<uint32_t>(str.size());
+  return result;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryView(const char*& data,
+                                                                  uint32_t& size) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(data, size);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringInto(TStringSink& sink) {
+  int32_t sz;
+  uint32_t result = readI32(sz);
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && sz > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  char* buf = sink.buffer(static_cast<uint32_t>(sz));
+  if (sz > 0) {
+    this->trans_->readAll(reinterpret_cast<uint8_t*>(buf), sz);
+  }
+  return result + static_cast<uint32_t>(sz);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryInto(TStringSink& sink) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readStringInto(sink);
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str, int32_t size) {
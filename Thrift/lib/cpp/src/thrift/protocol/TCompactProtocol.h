@@ -140,8 +140,16 @@ public:
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeBytes(const int8_t* bytes, uint32_t size);
+
+  uint32_t writeStringView(const char* data, uint32_t size);
+
+  uint32_t writeBinaryView(const char* data, uint32_t size);
+
   int getMinSerializedSize(TType type) override;
 
+  TWireFormat getWireFormat() override { return T_COMPACT_WIRE; }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(set.size_ * getMinSerializedSize(set.elemType_));
@@ -213,6 +221,16 @@ public:
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readBytes(int8_t* bytes, uint32_t size);
+
+  uint32_t readStringView(const char*& data, uint32_t& size);
+
+  uint32_t readBinaryView(const char*& data, uint32_t& size);
+
+  uint32_t readStringInto(TStringSink& sink);
+
+  uint32_t readBinaryInto(TStringSink& sink);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -286,6 +286,30 @@ uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
   return wsize;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeStringView(const char* data, uint32_t size) {
+  return writeBinaryView(data, size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryView(const char* data, uint32_t size) {
+  uint32_t wsize = writeVarint32(size);
+  if (size > (std::numeric_limits<uint32_t>::max)() - wsize)
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  trans_->write(reinterpret_cast<const uint8_t*>(data), size);
+  return wsize + size;
+}
+
+/**
+ * Write the elements of a list<i8>. Bytes are not varints, so they go out
+ * as they are, in one write.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBytes(const int8_t* bytes, uint32_t size) {
+  trans_->write(reinterpret_cast<const uint8_t*>(bytes), size);
+  return size;
+}
+
 //
 // Internal Writing methods
 //
@@ -420,6 +444,7 @@ uint32_t TCompactProtocolT<Transport_>::readMessageBegin(
     std::string& name,
     TMessageType& messageType,
     int32_t& seqid) {
+  this->releaseViews();
   uint32_t rsize = 0;
   int8_t protocolId;
   int8_t versionAndType;
@@ -718,6 +743,92 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
   return rsize + (uint32_t)size;
 }
 
+/**
+ * Read the elements of a list<i8> in one read.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBytes(int8_t* bytes, uint32_t size) {
+  trans_->readAll(reinterpret_cast<uint8_t*>(bytes), size);
+  return size;
+}
+
+/**
+ * Read a string or byte[] in place if the transport holds the frame, see
+ * TProtocol::readStringView().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringView(const char*& data, uint32_t& size) {
+  int32_t rsize = 0;
+  int32_t sz;
+
+  rsize += readVarint32(sz);
+  if (sz == 0) {
+    data = "";
+    size = 0;
+    return rsize;
+  }
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && sz > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  size = static_cast<uint32_t>(sz);
+  uint32_t got = size;
+  const uint8_t* borrowed = this->lendsViews() ? trans_->borrow(nullptr, &got) : nullptr;
+  if (borrowed != nullptr) {
+    data = reinterpret_cast<const char*>(borrowed);
+    trans_->consume(size);
+  } else {
+    std::string& str = this->viewCopy();
+    str.resize(size);
+    trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
+    data = str.data();
+  }
+
+  trans_->checkReadBytesAvailable(rsize + size);
+
+  return rsize + size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(const char*& data, uint32_t& size) {
+  return readStringView(data, size);
+}
+
+/**
+ * Read a string or byte[] straight from the transport into the sink's
+ * storage.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringInto(TStringSink& sink) {
+  int32_t rsize = 0;
+  int32_t sz;
+
+  rsize += readVarint32(sz);
+  if (sz < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && sz > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint32_t size = static_cast<uint32_t>(sz);
+  char* buf = sink.buffer(size);
+  if (size > 0) {
+    trans_->readAll(reinterpret_cast<uint8_t*>(buf), size);
+    trans_->checkReadBytesAvailable(rsize + size);
+  }
+
+  return rsize + size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryInto(TStringSink& sink) {
+  return readStringInto(sink);
+}
+
 /**
  * Read an i32 from the wire as a varint. The MSB of each byte is set
  * if there is another byte to follow. This can read up to 5 bytes.
@@ -60,6 +60,16 @@ enum TMessageType {
   T_ONEWAY     = 4
 };
 
+/**
+ * The wire formats a generated serializedSize() can size a struct in without
+ * writing it. Other protocols are T_UNSIZED_WIRE.
+ */
+enum TWireFormat {
+  T_UNSIZED_WIRE = 0,
+  T_BINARY_WIRE  = 1,
+  T_COMPACT_WIRE = 2
+};
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_ENUM_H_
@@ -146,6 +146,18 @@ uint32_t THeaderProtocol::writeBinary(const std::string& str) {
   return proto_->writeBinary(str);
 }
 
+uint32_t THeaderProtocol::writeBytes(const int8_t* bytes, uint32_t size) {
+  return proto_->writeBytes(bytes, size);
+}
+
+uint32_t THeaderProtocol::writeStringView(const char* data, uint32_t size) {
+  return proto_->writeStringView(data, size);
+}
+
+uint32_t THeaderProtocol::writeBinaryView(const char* data, uint32_t size) {
+  return proto_->writeBinaryView(data, size);
+}
+
 /**
  * Reading functions
  */
@@ -246,6 +258,26 @@ uint32_t THeaderProtocol::readString(std::string& str) {
 uint32_t THeaderProtocol::readBinary(std::string& binary) {
   return proto_->readBinary(binary);
 }
+
+uint32_t THeaderProtocol::readBytes(int8_t* bytes, uint32_t size) {
+  return proto_->readBytes(bytes, size);
+}
+
+uint32_t THeaderProtocol::readStringView(const char*& data, uint32_t& size) {
+  return proto_->readStringView(data, size);
+}
+
+uint32_t THeaderProtocol::readBinaryView(const char*& data, uint32_t& size) {
+  return proto_->readBinaryView(data, size);
+}
+
+uint32_t THeaderProtocol::readStringInto(TStringSink& sink) {
+  return proto_->readStringInto(sink);
+}
+
+uint32_t THeaderProtocol::readBinaryInto(TStringSink& sink) {
+  return proto_->readBinaryInto(sink);
+}
 }
 }
 } // apache::thrift::protocol
@@ -135,6 +135,12 @@ public:
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeBytes(const int8_t* bytes, uint32_t size);
+
+  uint32_t writeStringView(const char* data, uint32_t size);
+
+  uint32_t writeBinaryView(const char* data, uint32_t size);
+
   /**
    * Reading functions
    */
@@ -181,6 +187,18 @@ public:
 
   uint32_t readBinary(std::string& binary);
 
+  uint32_t readBytes(int8_t* bytes, uint32_t size);
+
+  uint32_t readStringView(const char*& data, uint32_t& size);
+
+  uint32_t readBinaryView(const char*& data, uint32_t& size);
+
+  uint32_t readStringInto(TStringSink& sink);
+
+  uint32_t readBinaryInto(TStringSink& sink);
+
+  TWireFormat getWireFormat() override { return proto_->getWireFormat(); }
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
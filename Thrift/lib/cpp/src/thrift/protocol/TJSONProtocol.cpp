@@ -955,6 +955,7 @@ uint32_t TJSONProtocol::readJSONArrayEnd() {
 uint32_t TJSONProtocol::readMessageBegin(std::string& name,
                                          TMessageType& messageType,
                                          int32_t& seqid) {
+  releaseViews();
   uint32_t result = readJSONArrayStart();
   int64_t tmpVal = 0;
   result += readJSONInteger(tmpVal);
@@ -17,7 +17,10 @@
  * under the License.
  */
 
+#include <cstring>
+
 #include <thrift/protocol/TProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
 
 namespace apache {
 namespace thrift {
@@ -28,6 +31,73 @@ uint32_t TProtocol::skip_virt(TType type) {
   return ::apache::thrift::protocol::skip(*this, type);
 }
 
+uint32_t TProtocol::readBytes_virt(int8_t* bytes, uint32_t size) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    result += readByte_virt(bytes[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::writeBytes_virt(const int8_t* bytes, uint32_t size) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    result += writeByte_virt(bytes[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::readStringView_virt(const char*& data, uint32_t& size) {
+  std::string& str = viewCopy();
+  uint32_t result = readString_virt(str);
+  data = str.data();
+  size = static_cast<uint32_t>(str.size());
+  return result;
+}
+
+uint32_t TProtocol::readBinaryView_virt(const char*& data, uint32_t& size) {
+  std::string& str = viewCopy();
+  uint32_t result = readBinary_virt(str);
+  data = str.data();
+  size = static_cast<uint32_t>(str.size());
+  return result;
+}
+
+uint32_t TProtocol::readStringInto_virt(TStringSink& sink) {
+  std::string str;
+  uint32_t result = readString_virt(str);
+  char* buf = sink.buffer(static_cast<uint32_t>(str.size()));
+  if (!str.empty()) {
+    std::memcpy(buf, str.data(), str.size());
+  }
+  return result;
+}
+
+uint32_t TProtocol::readBinaryInto_virt(TStringSink& sink) {
+  std::string str;
+  uint32_t result = readBinary_virt(str);
+  char* buf = sink.buffer(static_cast<uint32_t>(str.size()));
+  if (!str.empty()) {
+    std::memcpy(buf, str.data(), str.size());
+  }
+  return result;
+}
+
+uint32_t TProtocol::writeStringView_virt(const char* data, uint32_t size) {
+  return writeString_virt(std::string(data, size));
+}
+
+uint32_t TProtocol::writeBinaryView_virt(const char* data, uint32_t size) {
+  return writeBinary_virt(std::string(data, size));
+}
+
+bool TProtocol::holdsFrames(TTransport* trans) {
+  using transport::TFramedTransport;
+  using transport::TMemoryBuffer;
+  return dynamic_cast<TMemoryBuffer*>(trans) != nullptr
+         || dynamic_cast<TFramedTransport*>(trans) != nullptr;
+}
+
 TProtocolFactory::~TProtocolFactory() = default;
 
 }}} // apache::thrift::protocol
@@ -51,6 +51,7 @@
 #include <thrift/protocol/TMap.h>
 #include <thrift/TUuid.h>
 
+#include <deque>
 #include <memory>
 
 #ifdef HAVE_NETINET_IN_H
@@ -61,6 +62,10 @@
 #include <map>
 #include <vector>
 #include <climits>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#include <string_view>
+#endif
 
 // Use this to get around strict aliasing rules.
 // For example, uint64_t i = bitwise_cast<uint64_t>(returns_double());
@@ -207,6 +212,19 @@ namespace protocol {
 
 using apache::thrift::transport::TTransport;
 
+/**
+ * Storage that TProtocol::readStringInto() reads a string into: buffer()
+ * returns room for the string's size bytes. For string types other than
+ * std::string, such as the std::pmr::string of the cpp:arena generator
+ * option.
+ */
+class TStringSink {
+public:
+  virtual ~TStringSink() = default;
+
+  virtual char* buffer(uint32_t size) = 0;
+};
+
 /**
  * Abstract class for a thrift protocol driver. These are all the methods that
  * a protocol must implement. Essentially, there must be some way of reading
@@ -442,6 +460,7 @@ public:
 
   uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid) {
     T_VIRTUAL_CALL();
+    releaseViews();
     return readMessageBegin_virt(name, messageType, seqid);
   }
 
@@ -564,6 +583,93 @@ public:
   }
   virtual uint32_t skip_virt(TType type);
 
+  /**
+   * Bulk elements of a list<i8>, between readListBegin() and readListEnd():
+   * the same as size readByte() calls. Protocols that put bytes on the wire
+   * as they are read them with one transport read.
+   */
+  uint32_t readBytes(int8_t* bytes, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return readBytes_virt(bytes, size);
+  }
+  virtual uint32_t readBytes_virt(int8_t* bytes, uint32_t size);
+
+  /**
+   * Bulk elements of a list<i8>, between writeListBegin() and
+   * writeListEnd(): the same as size writeByte() calls.
+   */
+  uint32_t writeBytes(const int8_t* bytes, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return writeBytes_virt(bytes, size);
+  }
+  virtual uint32_t writeBytes_virt(const int8_t* bytes, uint32_t size);
+
+  /**
+   * Reads a string without copying it: data points at its bytes in the
+   * transport's buffer. That works for transports that hold a whole frame,
+   * TMemoryBuffer and TFramedTransport (so THeaderTransport), and the bytes
+   * stay valid until the transport reads its next frame. From other
+   * transports, and with protocols that do not keep a string on the wire as
+   * it is, the string is copied into storage of the protocol, kept until
+   * releaseViews() or the next readMessageBegin().
+   */
+  uint32_t readStringView(const char*& data, uint32_t& size) {
+    T_VIRTUAL_CALL();
+    return readStringView_virt(data, size);
+  }
+  virtual uint32_t readStringView_virt(const char*& data, uint32_t& size);
+
+  /** readStringView() for a binary */
+  uint32_t readBinaryView(const char*& data, uint32_t& size) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(data, size);
+  }
+  virtual uint32_t readBinaryView_virt(const char*& data, uint32_t& size);
+
+  /**
+   * Reads a string into the storage sink gives it. Protocols that keep a
+   * string on the wire as it is copy it once, straight from the transport;
+   * the others read a std::string and copy that.
+   */
+  uint32_t readStringInto(TStringSink& sink) {
+    T_VIRTUAL_CALL();
+    return readStringInto_virt(sink);
+  }
+  virtual uint32_t readStringInto_virt(TStringSink& sink);
+
+  /** readStringInto() for a binary */
+  uint32_t readBinaryInto(TStringSink& sink) {
+    T_VIRTUAL_CALL();
+    return readBinaryInto_virt(sink);
+  }
+  virtual uint32_t readBinaryInto_virt(TStringSink& sink);
+
+  /**
+   * Writes size bytes at data as a string or binary, for strings that are
+   * not a std::string.
+   */
+  uint32_t writeStringView(const char* data, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return writeStringView_virt(data, size);
+  }
+  virtual uint32_t writeStringView_virt(const char* data, uint32_t size);
+
+  uint32_t writeBinaryView(const char* data, uint32_t size) {
+    T_VIRTUAL_CALL();
+    return writeBinaryView_virt(data, size);
+  }
+  virtual uint32_t writeBinaryView_virt(const char* data, uint32_t size);
+
+  /**
+   * Frees the strings readStringView() had to copy. Every protocol's
+   * readMessageBegin() calls it.
+   */
+  void releaseViews() {
+    if (view_copies_) {
+      view_copies_->clear();
+    }
+  }
+
   inline std::shared_ptr<TTransport> getTransport() { return ptrans_; }
 
   // TODO: remove these two calls, they are for backwards
@@ -596,12 +702,35 @@ public:
     return 0;
   }
 
+  // Returns the wire format serializedSize() sizes writes to this protocol in.
+  virtual TWireFormat getWireFormat() { return T_UNSIZED_WIRE; }
+
 protected:
   TProtocol(std::shared_ptr<TTransport> ptrans)
     : ptrans_(ptrans), input_recursion_depth_(0), output_recursion_depth_(0),
-      recursion_limit_(ptrans->getConfiguration()->getRecursionLimit())
+      recursion_limit_(ptrans->getConfiguration()->getRecursionLimit()), lends_views_(-1)
   {}
 
+  /**
+   * True if readStringView() can point into the transport's buffer, which
+   * holds the whole frame.
+   */
+  bool lendsViews() {
+    if (lends_views_ < 0) {
+      lends_views_ = holdsFrames(ptrans_.get()) ? 1 : 0;
+    }
+    return lends_views_ != 0;
+  }
+
+  /** Storage for a string readStringView() cannot lend */
+  std::string& viewCopy() {
+    if (!view_copies_) {
+      view_copies_.reset(new std::deque<std::string>());
+    }
+    view_copies_->push_back(std::string());
+    return view_copies_->back();
+  }
+
   virtual void checkReadBytesAvailable(TSet& set)
   {
       ptrans_->checkReadBytesAvailable(set.size_ * getMinSerializedSize(set.elemType_));
@@ -625,6 +754,10 @@ private:
   uint32_t input_recursion_depth_;
   uint32_t output_recursion_depth_;
   uint32_t recursion_limit_;
+  int lends_views_;
+  std::unique_ptr<std::deque<std::string> > view_copies_;  // created on first use
+
+  static bool holdsFrames(TTransport* trans);
 };
 
 /**
@@ -792,6 +925,71 @@ uint32_t skip(Protocol_& prot, TType type) {
                            "invalid TType");
 }
 
+#if __cplusplus >= 201703L
+/**
+ * TProtocol::readStringView() into a std::string_view, for the view types
+ * of the cpp:views generator option.
+ */
+template <class Protocol_>
+uint32_t readStringView(Protocol_& prot, std::string_view& str) {
+  const char* data;
+  uint32_t size;
+  uint32_t result = prot.readStringView(data, size);
+  str = std::string_view(data, size);
+  return result;
+}
+
+template <class Protocol_>
+uint32_t readBinaryView(Protocol_& prot, std::string_view& str) {
+  const char* data;
+  uint32_t size;
+  uint32_t result = prot.readBinaryView(data, size);
+  str = std::string_view(data, size);
+  return result;
+}
+
+/** A std::pmr::string as a TStringSink, resized to the string read */
+class TPmrStringSink : public TStringSink {
+public:
+  explicit TPmrStringSink(std::pmr::string& str) : str_(str) {}
+
+  char* buffer(uint32_t size) override {
+    str_.resize(size);
+    return &str_[0];
+  }
+
+private:
+  std::pmr::string& str_;
+};
+
+/**
+ * The std::pmr::string of the cpp:arena generator option, read through
+ * readStringInto() and written through the views, so the bytes are copied
+ * once, into the string's own memory resource.
+ */
+template <class Protocol_>
+uint32_t readString(Protocol_& prot, std::pmr::string& str) {
+  TPmrStringSink sink(str);
+  return prot.readStringInto(sink);
+}
+
+template <class Protocol_>
+uint32_t readBinary(Protocol_& prot, std::pmr::string& str) {
+  TPmrStringSink sink(str);
+  return prot.readBinaryInto(sink);
+}
+
+template <class Protocol_>
+uint32_t writeString(Protocol_& prot, const std::pmr::string& str) {
+  return prot.writeStringView(str.data(), static_cast<uint32_t>(str.size()));
+}
+
+template <class Protocol_>
+uint32_t writeBinary(Protocol_& prot, const std::pmr::string& str) {
+  return prot.writeBinaryView(str.data(), static_cast<uint32_t>(str.size()));
+}
+#endif
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_PROTOCOL_TPROTOCOL_H_ 1
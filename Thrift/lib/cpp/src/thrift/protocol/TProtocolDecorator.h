@@ -93,6 +93,15 @@ public:
   uint32_t writeString_virt(const std::string& str) override { return protocol->writeString(str); }
   uint32_t writeBinary_virt(const std::string& str) override { return protocol->writeBinary(str); }
   uint32_t writeUUID_virt(const TUuid& uuid) override { return protocol->writeUUID(uuid); }
+  uint32_t writeBytes_virt(const int8_t* bytes, uint32_t size) override {
+    return protocol->writeBytes(bytes, size);
+  }
+  uint32_t writeStringView_virt(const char* data, uint32_t size) override {
+    return protocol->writeStringView(data, size);
+  }
+  uint32_t writeBinaryView_virt(const char* data, uint32_t size) override {
+    return protocol->writeBinaryView(data, size);
+  }
 
   uint32_t readMessageBegin_virt(std::string& name,
                                          TMessageType& messageType,
@@ -142,6 +151,23 @@ public:
   uint32_t readString_virt(std::string& str) override { return protocol->readString(str); }
   uint32_t readBinary_virt(std::string& str) override { return protocol->readBinary(str); }
   uint32_t readUUID_virt(TUuid& uuid) override { return protocol->readUUID(uuid); }
+  uint32_t readBytes_virt(int8_t* bytes, uint32_t size) override {
+    return protocol->readBytes(bytes, size);
+  }
+  uint32_t readStringView_virt(const char*& data, uint32_t& size) override {
+    return protocol->readStringView(data, size);
+  }
+  uint32_t readBinaryView_virt(const char*& data, uint32_t& size) override {
+    return protocol->readBinaryView(data, size);
+  }
+  uint32_t readStringInto_virt(TStringSink& sink) override {
+    return protocol->readStringInto(sink);
+  }
+  uint32_t readBinaryInto_virt(TStringSink& sink) override {
+    return protocol->readBinaryInto(sink);
+  }
+
+  TWireFormat getWireFormat() override { return protocol->getWireFormat(); }
 
 private:
   shared_ptr<TProtocol> protocol;
@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_
+#define _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_ 1
+
+#include <thrift/protocol/TProtocol.h>
+
+#include <string>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * The bytes TBinaryProtocol writes, without writing them, for the
+ * serializedSize() the cpp:serialized_size generator option emits. Each
+ * call sizes the write call of the same name.
+ */
+struct TBinarySize {
+  // A strict message header, which is what TBinaryProtocol writes by default
+  static uint32_t sizeMessageBegin(const std::string& name, int32_t /* seqid */) {
+    return 4 + 4 + static_cast<uint32_t>(name.size()) + 4;
+  }
+  static uint32_t sizeFieldBegin(int16_t /* fieldId */, int16_t& /* lastFieldId */) { return 3; }
+  static uint32_t sizeFieldStop() { return 1; }
+  static uint32_t sizeMapBegin(uint32_t /* size */) { return 6; }
+  static uint32_t sizeListBegin(uint32_t /* size */) { return 5; }
+  static uint32_t sizeSetBegin(uint32_t /* size */) { return 5; }
+  // In a field, which the compact protocol folds into the field header
+  static uint32_t sizeBool(bool /* inField */) { return 1; }
+  static uint32_t sizeByte() { return 1; }
+  static uint32_t sizeI16(int16_t) { return 2; }
+  static uint32_t sizeI32(int32_t) { return 4; }
+  static uint32_t sizeI64(int64_t) { return 8; }
+  static uint32_t sizeDouble() { return 8; }
+  static uint32_t sizeString(uint32_t size) { return 4 + size; }
+  static uint32_t sizeUUID() { return 16; }
+};
+
+/**
+ * The bytes TCompactProtocol writes: varints, field ids as deltas from the
+ * previous field's, and bools in their field's header.
+ */
+struct TCompactSize {
+  static uint32_t sizeMessageBegin(const std::string& name, int32_t seqid) {
+    return 2 + varint32(static_cast<uint32_t>(seqid))
+           + sizeString(static_cast<uint32_t>(name.size()));
+  }
+  static uint32_t sizeFieldBegin(int16_t fieldId, int16_t& lastFieldId) {
+    uint32_t size = (fieldId > lastFieldId && fieldId - lastFieldId <= 15)
+                        ? 1
+                        : 1 + sizeI16(fieldId);
+    lastFieldId = fieldId;
+    return size;
+  }
+  static uint32_t sizeFieldStop() { return 1; }
+  static uint32_t sizeMapBegin(uint32_t size) { return size == 0 ? 1 : varint32(size) + 1; }
+  static uint32_t sizeListBegin(uint32_t size) { return size <= 14 ? 1 : 1 + varint32(size); }
+  static uint32_t sizeSetBegin(uint32_t size) { return sizeListBegin(size); }
+  static uint32_t sizeBool(bool inField) { return inField ? 0 : 1; }
+  static uint32_t sizeByte() { return 1; }
+  static uint32_t sizeI16(int16_t i16) { return sizeI32(i16); }
+  static uint32_t sizeI32(int32_t i32) {
+    return varint32((static_cast<uint32_t>(i32) << 1) ^ static_cast<uint32_t>(i32 >> 31));
+  }
+  static uint32_t sizeI64(int64_t i64) {
+    return varint64((static_cast<uint64_t>(i64) << 1) ^ static_cast<uint64_t>(i64 >> 63));
+  }
+  static uint32_t sizeDouble() { return 8; }
+  static uint32_t sizeString(uint32_t size) { return varint32(size) + size; }
+  static uint32_t sizeUUID() { return 16; }
+
+  // A varint carries 7 of the value's significant bits per byte, so it takes
+  // (bits * 9 + 64) / 64 bytes, and at least one
+  static uint32_t varint32(uint32_t n) {
+    uint32_t bits = 32 - static_cast<uint32_t>(__builtin_clz(n | 1));
+    return (bits * 9 + 64) / 64;
+  }
+  static uint32_t varint64(uint64_t n) {
+    uint32_t bits = 64 - static_cast<uint32_t>(__builtin_clzll(n | 1));
+    return (bits * 9 + 64) / 64;
+  }
+};
+
+/**
+ * The bytes s.write(prot) writes, or 0 if prot is not one serializedSize()
+ * can size.
+ */
+template <class Struct_>
+uint32_t serializedSize(const Struct_& s, TProtocol* prot) {
+  switch (prot->getWireFormat()) {
+  case T_BINARY_WIRE:
+    return s.template serializedSize<TBinarySize>();
+  case T_COMPACT_WIRE:
+    return s.template serializedSize<TCompactSize>();
+  default:
+    return 0;
+  }
+}
+
+/**
+ * The bytes of a whole message, writeMessageBegin(name, ..., seqid),
+ * s.write(prot) and writeMessageEnd(), or 0 if prot is not one
+ * serializedSize() can size. Generated processors reserve this much in the
+ * transport before writing a reply.
+ */
+template <class Struct_>
+uint32_t serializedMessageSize(TProtocol* prot,
+                               const std::string& name,
+                               int32_t seqid,
+                               const Struct_& s) {
+  switch (prot->getWireFormat()) {
+  case T_BINARY_WIRE:
+    return TBinarySize::sizeMessageBegin(name, seqid) + s.template serializedSize<TBinarySize>();
+  case T_COMPACT_WIRE:
+    return TCompactSize::sizeMessageBegin(name, seqid) + s.template serializedSize<TCompactSize>();
+  default:
+    return 0;
+  }
+}
+}
+}
+} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_
@@ -481,6 +481,38 @@ public:
 
   uint32_t skip_virt(TType type) override { return static_cast<Protocol_*>(this)->skip(type); }
 
+  uint32_t readBytes_virt(int8_t* bytes, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->readBytes(bytes, size);
+  }
+
+  uint32_t writeBytes_virt(const int8_t* bytes, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->writeBytes(bytes, size);
+  }
+
+  uint32_t readStringView_virt(const char*& data, uint32_t& size) override {
+    return static_cast<Protocol_*>(this)->readStringView(data, size);
+  }
+
+  uint32_t readBinaryView_virt(const char*& data, uint32_t& size) override {
+    return static_cast<Protocol_*>(this)->readBinaryView(data, size);
+  }
+
+  uint32_t readStringInto_virt(TStringSink& sink) override {
+    return static_cast<Protocol_*>(this)->readStringInto(sink);
+  }
+
+  uint32_t readBinaryInto_virt(TStringSink& sink) override {
+    return static_cast<Protocol_*>(this)->readBinaryInto(sink);
+  }
+
+  uint32_t writeStringView_virt(const char* data, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->writeStringView(data, size);
+  }
+
+  uint32_t writeBinaryView_virt(const char* data, uint32_t size) override {
+    return static_cast<Protocol_*>(this)->writeBinaryView(data, size);
+  }
+
   /*
    * Provide a default skip() implementation that uses non-virtual read
    * methods.
@@ -496,6 +528,60 @@ public:
     return ::apache::thrift::protocol::skip(*prot, type);
   }
 
+  /*
+   * Provide default readBytes() and writeBytes() implementations that go
+   * a byte at a time through the non-virtual readByte() and writeByte().
+   * Protocols that write an i8 as a single byte override them.
+   */
+  uint32_t readBytes(int8_t* bytes, uint32_t size) {
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      result += static_cast<Protocol_*>(this)->readByte(bytes[i]);
+    }
+    return result;
+  }
+
+  uint32_t writeBytes(const int8_t* bytes, uint32_t size) {
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      result += static_cast<Protocol_*>(this)->writeByte(bytes[i]);
+    }
+    return result;
+  }
+
+  /*
+   * Provide a default readStringView() implementation that copies the
+   * string. Protocols that keep a string on the wire as it is lend it
+   * from the transport instead.
+   */
+  uint32_t readStringView(const char*& data, uint32_t& size) {
+    return TProtocol::readStringView_virt(data, size);
+  }
+
+  uint32_t readBinaryView(const char*& data, uint32_t& size) {
+    return TProtocol::readBinaryView_virt(data, size);
+  }
+
+  /*
+   * Provide a default readStringInto() implementation that reads a
+   * std::string and copies it into the sink.
+   */
+  uint32_t readStringInto(TStringSink& sink) { return TProtocol::readStringInto_virt(sink); }
+
+  uint32_t readBinaryInto(TStringSink& sink) { return TProtocol::readBinaryInto_virt(sink); }
+
+  /*
+   * Provide default writeStringView() and writeBinaryView() implementations
+   * that write a std::string copy.
+   */
+  uint32_t writeStringView(const char* data, uint32_t size) {
+    return TProtocol::writeStringView_virt(data, size);
+  }
+
+  uint32_t writeBinaryView(const char* data, uint32_t size) {
+    return TProtocol::writeBinaryView_virt(data, size);
+  }
+
   /*
    * Provide a default readBool() implementation for use with
    * std::vector<bool>, that behaves the same as reading into a normal bool.
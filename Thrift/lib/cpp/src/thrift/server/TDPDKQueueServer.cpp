@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string>
+
+#include <rte_eal.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+
+#include <thrift/server/TDPDKQueueServer.h>
+#include <thrift/transport/TUDPSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::DPDKTxBuffer;
+using apache::thrift::transport::TServerUDPSocket;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TUDPSocket;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+// How often an idle lcore looks at the stop flag
+const int STOP_POLL_MS = 100;
+}
+
+TDPDKQueueServer::TDPDKQueueServer(const shared_ptr<TProcessorFactory>& processorFactory,
+                                   const shared_ptr<TServerUDPSocket>& serverTransport,
+                                   const shared_ptr<TProtocolFactory>& protocolFactory,
+                                   uint16_t numQueues)
+  : TServer(processorFactory, serverTransport),
+    udpTransport_(serverTransport),
+    stop_(false),
+    txPolicy_(DPDKTxBuffer::FLUSH_MESSAGE),
+    txThreshold_(DPDKTxBuffer::DEFAULT_THRESHOLD),
+    txDeadlineUs_(DPDKTxBuffer::DEFAULT_DEADLINE_US) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+  for (uint16_t i = 0; i < (numQueues > 0 ? numQueues : 1); ++i) {
+    queues_.emplace_back(new Queue(this, i));
+  }
+}
+
+TDPDKQueueServer::TDPDKQueueServer(const shared_ptr<TProcessor>& processor,
+                                   const shared_ptr<TServerUDPSocket>& serverTransport,
+                                   const shared_ptr<TProtocolFactory>& protocolFactory,
+                                   uint16_t numQueues)
+  : TServer(processor, serverTransport),
+    udpTransport_(serverTransport),
+    stop_(false),
+    txPolicy_(DPDKTxBuffer::FLUSH_MESSAGE),
+    txThreshold_(DPDKTxBuffer::DEFAULT_THRESHOLD),
+    txDeadlineUs_(DPDKTxBuffer::DEFAULT_DEADLINE_US) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+  for (uint16_t i = 0; i < (numQueues > 0 ? numQueues : 1); ++i) {
+    queues_.emplace_back(new Queue(this, i));
+  }
+}
+
+TDPDKQueueServer::~TDPDKQueueServer() = default;
+
+void TDPDKQueueServer::serve() {
+  stop_ = false;
+  udpTransport_->setNumQueues(static_cast<uint16_t>(queues_.size()));
+  udpTransport_->listen();
+
+  // The device may support fewer queues than asked for
+  uint16_t numQueues = udpTransport_->getNumQueues();
+  if (numQueues < queues_.size()) {
+    queues_.resize(numQueues);
+  }
+  if (rte_lcore_count() < numQueues) {
+    udpTransport_->close();
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TDPDKQueueServer: fewer lcores than queues");
+  }
+
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  unsigned lcore = rte_get_next_lcore(-1, 1, 0);
+  for (uint16_t q = 1; q < numQueues; ++q) {
+    int ret = rte_eal_remote_launch(&TDPDKQueueServer::launchQueue, queues_[q].get(), lcore);
+    if (ret != 0) {
+      GlobalOutput.printf("TDPDKQueueServer: cannot launch queue %u on lcore %u", q, lcore);
+    }
+    lcore = rte_get_next_lcore(lcore, 1, 0);
+  }
+
+  serveQueue(*queues_[0]);
+
+  rte_eal_mp_wait_lcore();
+  udpTransport_->close();
+}
+
+void TDPDKQueueServer::stop() {
+  stop_ = true;
+}
+
+int TDPDKQueueServer::launchQueue(void* arg) {
+  Queue* queue = static_cast<Queue*>(arg);
+  queue->server->serveQueue(*queue);
+  return 0;
+}
+
+void TDPDKQueueServer::serveQueue(Queue& queue) {
+  shared_ptr<TUDPSocket> socket = udpTransport_->createQueueSocket(queue.id);
+  if (socket->getRecvTimeout() == 0) {
+    socket->setRecvTimeout(STOP_POLL_MS);
+  }
+  socket->setTxFlushPolicy(txPolicy_, txThreshold_, txDeadlineUs_);
+
+  // The socket is the transport: the protocol reads from the mbufs in place
+  shared_ptr<TProtocol> input = inputProtocolFactory_->getProtocol(socket);
+  shared_ptr<TProtocol> output = outputProtocolFactory_->getProtocol(socket);
+  shared_ptr<TProcessor> processor = getProcessor(input, output, socket);
+
+  void* connectionContext = nullptr;
+  if (eventHandler_) {
+    connectionContext = eventHandler_->createContext(input, output);
+  }
+
+  while (!stop_) {
+    try {
+      if (eventHandler_) {
+        eventHandler_->processContext(connectionContext, socket);
+      }
+      processor->process(input, output, connectionContext);
+      queue.requests++;
+    } catch (const TTransportException& ttx) {
+      if (ttx.getType() == TTransportException::TIMED_OUT) {
+        continue;
+      }
+      string errStr = string("TDPDKQueueServer transport error: ") + ttx.what();
+      GlobalOutput(errStr.c_str());
+      socket->readEnd();
+    } catch (const TException& tx) {
+      string errStr = string("TDPDKQueueServer process failed: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      socket->readEnd();
+    }
+  }
+
+  if (eventHandler_) {
+    eventHandler_->deleteContext(connectionContext, input, output);
+  }
+  socket->close();
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TDPDKQUEUESERVER_H_
+#define _THRIFT_SERVER_TDPDKQUEUESERVER_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <thrift/server/TServer.h>
+#include <thrift/transport/DPDKTxBuffer.h>
+#include <thrift/transport/TServerUDPSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * DPDK server with one lcore per RX/TX queue pair. Built against the DPDK
+ * TServerUDPSocket and TUDPSocket (the *_dpdk sources).
+ *
+ * The port is configured with one queue pair per lcore and RSS on the UDP
+ * 4-tuple. Every queue is polled by its own lcore, launched with
+ * rte_eal_remote_launch(), which owns everything on its path: the queue
+ * socket with its RX burst and TX batch, its protocols, a processor from
+ * the processor factory, and its per-lcore cache of the shared mbuf pool.
+ * The main lcore serves queue 0.
+ *
+ * To try it without a NIC, run on a virtual device with several queues,
+ * e.g. TServerUDPSocket::setEalArgs({"--no-pci", "--vdev=net_tap0"}) and
+ * setNumQueues(4).
+ */
+class TDPDKQueueServer : public TServer {
+public:
+  TDPDKQueueServer(
+      const std::shared_ptr<apache::thrift::TProcessorFactory>& processorFactory,
+      const std::shared_ptr<apache::thrift::transport::TServerUDPSocket>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      uint16_t numQueues);
+
+  TDPDKQueueServer(
+      const std::shared_ptr<apache::thrift::TProcessor>& processor,
+      const std::shared_ptr<apache::thrift::transport::TServerUDPSocket>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      uint16_t numQueues);
+
+  ~TDPDKQueueServer() override;
+
+  /**
+   * Initializes EAL and the port, then serves every queue on its own lcore
+   * until stop() is called.
+   */
+  void serve() override;
+
+  void stop() override;
+
+  /** TX flush policy of every queue socket, see DPDKTxBuffer */
+  void setTxFlushPolicy(
+      apache::thrift::transport::DPDKTxBuffer::FlushPolicy policy,
+      uint16_t threshold = apache::thrift::transport::DPDKTxBuffer::DEFAULT_THRESHOLD,
+      uint32_t deadlineUs = apache::thrift::transport::DPDKTxBuffer::DEFAULT_DEADLINE_US) {
+    txPolicy_ = policy;
+    txThreshold_ = threshold;
+    txDeadlineUs_ = deadlineUs;
+  }
+
+  /** Queues served; fewer than requested if the device has fewer */
+  uint16_t getNumQueues() const { return static_cast<uint16_t>(queues_.size()); }
+
+  /** Requests processed on queue i, to check how RSS spreads the load */
+  uint64_t getRequestCount(uint16_t i) const { return queues_[i]->requests.load(); }
+
+private:
+  struct Queue {
+    Queue(TDPDKQueueServer* server, uint16_t id) : server(server), id(id), requests(0) {}
+
+    TDPDKQueueServer* server;
+    uint16_t id;
+    std::atomic<uint64_t> requests;
+  };
+
+  static int launchQueue(void* arg);
+  void serveQueue(Queue& queue);
+
+  std::shared_ptr<apache::thrift::transport::TServerUDPSocket> udpTransport_;
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::atomic<bool> stop_;
+  apache::thrift::transport::DPDKTxBuffer::FlushPolicy txPolicy_;
+  uint16_t txThreshold_;
+  uint32_t txDeadlineUs_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TDPDKQUEUESERVER_H_
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <thrift/server/TDatagramServer.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TServerUDPSocket;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TUDPDatagramBatch;
+using apache::thrift::transport::TUDPFragment;
+using apache::thrift::transport::TUDPReassembler;
+using std::shared_ptr;
+using std::string;
+
+TDatagramServer::TDatagramServer(const shared_ptr<TProcessorFactory>& processorFactory,
+                                 const shared_ptr<TServerUDPSocket>& serverTransport,
+                                 const shared_ptr<TProtocolFactory>& protocolFactory,
+                                 size_t numWorkers,
+                                 const shared_ptr<ThreadFactory>& threadFactory)
+  : TServer(processorFactory, serverTransport),
+    udpTransport_(serverTransport),
+    threadFactory_(threadFactory),
+    stop_(false),
+    numWorkers_(numWorkers > 0 ? numWorkers : 1),
+    maxDatagramSize_(TUDPDatagramBatch::MAX_DATAGRAM_SIZE),
+    requests_(0) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+TDatagramServer::TDatagramServer(const shared_ptr<TProcessor>& processor,
+                                 const shared_ptr<TServerUDPSocket>& serverTransport,
+                                 const shared_ptr<TProtocolFactory>& protocolFactory,
+                                 size_t numWorkers,
+                                 const shared_ptr<ThreadFactory>& threadFactory)
+  : TServer(processor, serverTransport),
+    udpTransport_(serverTransport),
+    threadFactory_(threadFactory),
+    stop_(false),
+    numWorkers_(numWorkers > 0 ? numWorkers : 1),
+    maxDatagramSize_(TUDPDatagramBatch::MAX_DATAGRAM_SIZE),
+    requests_(0) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+/**
+ * Runs one receive loop on a thread from the thread factory.
+ */
+class TDatagramServer::Worker : public Runnable {
+public:
+  Worker(TDatagramServer& server) : server_(server) {}
+
+  void run() override { server_.receiveLoop(*server_.udpTransport_); }
+
+private:
+  TDatagramServer& server_;
+};
+
+TDatagramServer::~TDatagramServer() = default;
+
+void TDatagramServer::serve() {
+  stop_ = false;
+  udpTransport_->listen();
+
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  std::vector<shared_ptr<Thread> > workers;
+  for (size_t i = 1; i < numWorkers_; ++i) {
+    shared_ptr<Thread> thread = threadFactory_->newThread(std::make_shared<Worker>(*this));
+    thread->start();
+    workers.push_back(thread);
+  }
+
+  receiveLoop(*udpTransport_);
+
+  for (auto& thread : workers) {
+    thread->join();
+  }
+
+  udpTransport_->close();
+}
+
+void TDatagramServer::stop() {
+  stop_ = true;
+  udpTransport_->interrupt();
+}
+
+void TDatagramServer::receiveLoop(TServerUDPSocket& socket) {
+  TUDPDatagramBatch batch(socket.getBatchSize(), maxDatagramSize_);
+  const uint32_t slots = batch.capacity();
+
+  // One memory transport and protocol pair per slot, built once and reused
+  std::vector<shared_ptr<TMemoryBuffer> > inputBuffers(slots);
+  std::vector<shared_ptr<TMemoryBuffer> > outputBuffers(slots);
+  std::vector<shared_ptr<TProtocol> > inputProtocols(slots);
+  std::vector<shared_ptr<TProtocol> > outputProtocols(slots);
+  for (uint32_t i = 0; i < slots; ++i) {
+    inputBuffers[i] = std::make_shared<TMemoryBuffer>();
+    outputBuffers[i] = std::make_shared<TMemoryBuffer>();
+    inputProtocols[i] = inputProtocolFactory_->getProtocol(inputBuffers[i]);
+    outputProtocols[i] = outputProtocolFactory_->getProtocol(outputBuffers[i]);
+  }
+
+  shared_ptr<TProcessor> processor
+      = getProcessor(inputProtocols[0], outputProtocols[0], inputBuffers[0]);
+
+  void* connectionContext = nullptr;
+  if (eventHandler_) {
+    connectionContext = eventHandler_->createContext(inputProtocols[0], outputProtocols[0]);
+  }
+
+  // Requests rebuilt from fragments; only read while they are processed
+  std::vector<std::vector<uint8_t> > reassembled(slots);
+
+  while (!stop_) {
+    uint32_t count;
+    try {
+      count = socket.recvBatch(batch);
+    } catch (TTransportException& ttx) {
+      if (ttx.getType() != TTransportException::INTERRUPTED) {
+        string errStr = string("TDatagramServer recvBatch failed: ") + ttx.what();
+        GlobalOutput(errStr.c_str());
+        stop();
+      }
+      break;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      uint8_t* request = batch.data(i);
+      uint32_t requestLen = batch.length(i);
+      if (requestLen == 0) {
+        continue;
+      }
+      if (TUDPFragment::isFragment(request, requestLen)) {
+        bool complete;
+        {
+          concurrency::Guard g(reassemblyMutex_);
+          complete = reassembler_.add(request, requestLen, batch.peer(i), batch.peerLength(i),
+                                      reassembled[i]);
+        }
+        if (!complete) {
+          continue;
+        }
+        request = reassembled[i].data();
+        requestLen = static_cast<uint32_t>(reassembled[i].size());
+      }
+      inputBuffers[i]->resetBuffer(request, requestLen, TMemoryBuffer::OBSERVE);
+      outputBuffers[i]->resetBuffer();
+
+      if (eventHandler_) {
+        eventHandler_->processContext(connectionContext, inputBuffers[i]);
+      }
+
+      try {
+        processor->process(inputProtocols[i], outputProtocols[i], connectionContext);
+      } catch (const TException& tx) {
+        string errStr = string("TDatagramServer process failed: ") + tx.what();
+        GlobalOutput(errStr.c_str());
+        continue;
+      }
+      requests_++;
+
+      uint8_t* reply;
+      uint32_t replyLen;
+      outputBuffers[i]->getBuffer(&reply, &replyLen);
+      if (replyLen == 0) {
+        continue;
+      }
+      if (!fragmenter_.needsFragments(replyLen)) {
+        batch.setReply(i, reply, replyLen);
+        continue;
+      }
+      // Large replies are rare; send their fragments on their own
+      try {
+        fragmenter_.sendTo(socket.getSocketFD(), reply, replyLen, batch.peer(i),
+                           batch.peerLength(i));
+      } catch (const TException& tx) {
+        string errStr = string("TDatagramServer fragmented reply failed: ") + tx.what();
+        GlobalOutput(errStr.c_str());
+      }
+    }
+
+    try {
+      socket.sendBatch(batch);
+    } catch (TTransportException& ttx) {
+      string errStr = string("TDatagramServer sendBatch failed: ") + ttx.what();
+      GlobalOutput(errStr.c_str());
+      stop();
+      break;
+    }
+  }
+
+  if (eventHandler_) {
+    eventHandler_->deleteContext(connectionContext, inputProtocols[0], outputProtocols[0]);
+  }
+  addStats(batch.getStats());
+}
+
+void TDatagramServer::addStats(const TUDPDatagramBatch::Stats& stats) {
+  concurrency::Guard g(statsMutex_);
+  stats_.waitCalls += stats.waitCalls;
+  stats_.recvCalls += stats.recvCalls;
+  stats_.sendCalls += stats.sendCalls;
+  stats_.datagramsIn += stats.datagramsIn;
+  stats_.datagramsOut += stats.datagramsOut;
+  stats_.truncated += stats.truncated;
+}
+
+TUDPDatagramBatch::Stats TDatagramServer::getStats() const {
+  concurrency::Guard g(statsMutex_);
+  return stats_;
+}
+
+TUDPReassembler::Stats TDatagramServer::getReassemblyStats() const {
+  concurrency::Guard g(reassemblyMutex_);
+  return reassembler_.getStats();
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TDATAGRAMSERVER_H_
+#define _THRIFT_SERVER_TDATAGRAMSERVER_H_ 1
+
+#include <atomic>
+
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/server/TServer.h>
+#include <thrift/transport/TServerUDPSocket.h>
+#include <thrift/transport/TUDPDatagramBatch.h>
+#include <thrift/transport/TUDPFragment.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Server for connectionless UDP transports. Every datagram carries one
+ * complete Thrift message; it is decoded from memory, dispatched, and the
+ * reply is sent back to the address the datagram came from.
+ *
+ * Datagrams are pulled from the socket in batches of
+ * TServerUDPSocket::getBatchSize() and all replies of a batch are flushed
+ * together, so with batching enabled a busy server makes two syscalls per
+ * batch instead of two per request.
+ *
+ * Any number of workers can serve the same socket. Each owns its batch,
+ * its protocols and a processor from the processor factory, and since
+ * every datagram is answered on its own nothing is shared between them.
+ *
+ * Transport factories are not used: a datagram is already a whole frame.
+ * Requests that arrive in fragments are reassembled first, and replies
+ * longer than the fragment size are sent in fragments (see TUDPFragment).
+ */
+class TDatagramServer : public TServer {
+public:
+  TDatagramServer(
+      const std::shared_ptr<apache::thrift::TProcessorFactory>& processorFactory,
+      const std::shared_ptr<apache::thrift::transport::TServerUDPSocket>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      size_t numWorkers = 1,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  TDatagramServer(
+      const std::shared_ptr<apache::thrift::TProcessor>& processor,
+      const std::shared_ptr<apache::thrift::transport::TServerUDPSocket>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      size_t numWorkers = 1,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  ~TDatagramServer() override;
+
+  /**
+   * Binds the server socket and processes datagrams until stop() is called.
+   * The calling thread is one of the workers.
+   */
+  void serve() override;
+
+  /**
+   * Interrupts the receive loop; serve() returns once it has left it.
+   */
+  void stop() override;
+
+  /**
+   * Number of threads receiving from the socket; takes effect on serve().
+   */
+  void setNumWorkers(size_t numWorkers) { numWorkers_ = numWorkers > 0 ? numWorkers : 1; }
+  size_t getNumWorkers() const { return numWorkers_; }
+
+  /**
+   * Size of a receive slot. Longer datagrams are dropped.
+   */
+  void setMaxDatagramSize(uint32_t maxDatagramSize) { maxDatagramSize_ = maxDatagramSize; }
+  uint32_t getMaxDatagramSize() const { return maxDatagramSize_; }
+
+  /**
+   * Largest reply datagram, fragment header included. Longer replies are
+   * fragmented.
+   */
+  void setFragmentSize(uint32_t fragmentSize) { fragmenter_.setDatagramSize(fragmentSize); }
+  uint32_t getFragmentSize() const { return fragmenter_.getDatagramSize(); }
+
+  apache::thrift::transport::TUDPReassembler::Stats getReassemblyStats() const;
+
+  /**
+   * Socket call and datagram counters, accumulated when the receive loop
+   * exits.
+   */
+  apache::thrift::transport::TUDPDatagramBatch::Stats getStats() const;
+
+  /** Number of datagrams handed to the processor */
+  uint64_t getRequestCount() const { return requests_.load(); }
+
+protected:
+  /**
+   * Receive, dispatch, reply on the given socket until stopped. Run by every
+   * worker.
+   */
+  void receiveLoop(apache::thrift::transport::TServerUDPSocket& socket);
+
+  std::shared_ptr<apache::thrift::transport::TServerUDPSocket> udpTransport_;
+  std::shared_ptr<apache::thrift::concurrency::ThreadFactory> threadFactory_;
+  std::atomic<bool> stop_;
+
+private:
+  class Worker;
+
+  void addStats(const apache::thrift::transport::TUDPDatagramBatch::Stats& stats);
+
+  size_t numWorkers_;
+  uint32_t maxDatagramSize_;
+  std::atomic<uint64_t> requests_;
+
+  mutable concurrency::Mutex statsMutex_;
+  apache::thrift::transport::TUDPDatagramBatch::Stats stats_;
+
+  apache::thrift::transport::TUDPFragmenter fragmenter_;
+
+  // Fragments of one request may be picked up by different workers
+  mutable concurrency::Mutex reassemblyMutex_;
+  apache::thrift::transport::TUDPReassembler reassembler_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TDATAGRAMSERVER_H_
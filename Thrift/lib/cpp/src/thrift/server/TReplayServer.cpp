@@ -0,0 +1,238 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <thrift/server/TReplayServer.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::ReplayValidator;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}
+
+TReplayServer::TReplayServer(const shared_ptr<TProcessorFactory>& processorFactory,
+                             const shared_ptr<TProtocolFactory>& protocolFactory,
+                             const string& traceFile,
+                             size_t numWorkers,
+                             ShardBy shardBy,
+                             int maxRequests,
+                             const shared_ptr<ThreadFactory>& threadFactory)
+  : TServer(processorFactory),
+    traceFile_(traceFile),
+    numWorkers_(numWorkers > 0 ? numWorkers : 1),
+    shardBy_(shardBy),
+    maxRequests_(maxRequests),
+    threadFactory_(threadFactory),
+    stop_(false),
+    waiting_(0),
+    startNs_(0),
+    elapsedNs_(0) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+}
+
+TReplayServer::TReplayServer(const shared_ptr<TProcessor>& processor,
+                             const shared_ptr<TProtocolFactory>& protocolFactory,
+                             const string& traceFile,
+                             size_t numWorkers,
+                             ShardBy shardBy,
+                             int maxRequests,
+                             const shared_ptr<ThreadFactory>& threadFactory)
+  : TServer(processor),
+    traceFile_(traceFile),
+    numWorkers_(numWorkers > 0 ? numWorkers : 1),
+    shardBy_(shardBy),
+    maxRequests_(maxRequests),
+    threadFactory_(threadFactory),
+    stop_(false),
+    waiting_(0),
+    startNs_(0),
+    elapsedNs_(0) {
+  setInputProtocolFactory(protocolFactory);
+  setOutputProtocolFactory(protocolFactory);
+}
+
+TReplayServer::~TReplayServer() = default;
+
+/**
+ * Replays one shard on a thread from the thread factory.
+ */
+class TReplayServer::Worker : public Runnable {
+public:
+  Worker(TReplayServer& server, size_t index) : server_(server), index_(index) {}
+
+  void run() override { server_.replayLoop(index_); }
+
+private:
+  TReplayServer& server_;
+  size_t index_;
+};
+
+void TReplayServer::serve() {
+  stop_ = false;
+
+  // Shards point into the trace, so they go first
+  shards_.clear();
+  trace_.reset(new PacketReplaySocket());
+  trace_->setResponseFile(respPrefix_.empty() ? traceFile_ + ".resp" : respPrefix_);
+  trace_->loadTrace(traceFile_, maxRequests_);
+  for (size_t i = 0; i < numWorkers_; ++i) {
+    shards_.emplace_back(new PacketReplaySocket());
+    if (!shards_[i]->shareTrace(*trace_, i, numWorkers_, shardBy_)) {
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Cannot shard replay trace " + traceFile_);
+    }
+  }
+  stats_.assign(numWorkers_, WorkerStats());
+
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  waiting_ = numWorkers_;
+  startNs_ = 0;
+  std::vector<shared_ptr<Thread> > threads;
+  for (size_t i = 1; i < numWorkers_; ++i) {
+    shared_ptr<Thread> thread = threadFactory_->newThread(std::make_shared<Worker>(*this, i));
+    thread->start();
+    threads.push_back(thread);
+  }
+
+  replayLoop(0);
+
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  elapsedNs_ = 0;
+  for (auto& stats : stats_) {
+    elapsedNs_ = std::max(elapsedNs_, stats.elapsedNs);
+  }
+}
+
+void TReplayServer::stop() {
+  stop_ = true;
+}
+
+void TReplayServer::replayLoop(size_t worker) {
+  PacketReplaySocket& shard = *shards_[worker];
+  shared_ptr<TMemoryBuffer> inputBuffer = std::make_shared<TMemoryBuffer>();
+  shared_ptr<TMemoryBuffer> outputBuffer = std::make_shared<TMemoryBuffer>();
+  shared_ptr<TProtocol> inputProtocol = inputProtocolFactory_->getProtocol(inputBuffer);
+  shared_ptr<TProtocol> outputProtocol = outputProtocolFactory_->getProtocol(outputBuffer);
+  shared_ptr<TProcessor> processor = getProcessor(inputProtocol, outputProtocol, inputBuffer);
+
+  void* connectionContext = nullptr;
+  if (eventHandler_) {
+    connectionContext = eventHandler_->createContext(inputProtocol, outputProtocol);
+  }
+
+  // Everyone set up before anyone starts; the last one in starts the clock
+  if (--waiting_ == 0) {
+    startNs_ = nowNs();
+  }
+  while (startNs_.load() == 0) {
+    std::this_thread::yield();
+  }
+
+  // Counted here and stored at the end, so workers do not share lines
+  WorkerStats stats = WorkerStats();
+  const uint8_t* request;
+  uint32_t requestLen;
+  while (!stop_ && shard.nextMessage(request, requestLen)) {
+    inputBuffer->resetBuffer(const_cast<uint8_t*>(request), requestLen, TMemoryBuffer::OBSERVE);
+    outputBuffer->resetBuffer();
+
+    if (eventHandler_) {
+      eventHandler_->processContext(connectionContext, inputBuffer);
+    }
+
+    try {
+      processor->process(inputProtocol, outputProtocol, connectionContext);
+    } catch (const TException& tx) {
+      string errStr = string("TReplayServer process failed: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      stats.failed++;
+      continue;
+    }
+    stats.requests++;
+
+    uint8_t* reply;
+    uint32_t replyLen;
+    outputBuffer->getBuffer(&reply, &replyLen);
+    if (replyLen > 0) {
+      shard.write(reply, replyLen);
+    }
+  }
+  stats.elapsedNs = nowNs() - startNs_.load();
+  stats_[worker] = stats;
+
+  if (eventHandler_) {
+    eventHandler_->deleteContext(connectionContext, inputProtocol, outputProtocol);
+  }
+}
+
+uint64_t TReplayServer::getRequestCount() const {
+  uint64_t requests = 0;
+  for (auto& stats : stats_) {
+    requests += stats.requests;
+  }
+  return requests;
+}
+
+bool TReplayServer::validate(const string& expectedFile, ReplayValidator& validator) const {
+  if (!validator.addExpectedFile(expectedFile, ReplayValidator::CAPTURE)) {
+    GlobalOutput(("TReplayServer cannot open " + expectedFile).c_str());
+    return false;
+  }
+  for (auto& shard : shards_) {
+    if (!shard->addResponses(validator)) {
+      return false;
+    }
+  }
+  return validator.validate();
+}
+}
+}
+} // apache::thrift::server
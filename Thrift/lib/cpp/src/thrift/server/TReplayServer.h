@@ -0,0 +1,145 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TREPLAYSERVER_H_
+#define _THRIFT_SERVER_TREPLAYSERVER_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/server/TServer.h>
+#include <thrift/transport/PacketReplaySocket.h>
+#include <thrift/transport/ReplayValidator.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Serves a captured dpdk_to_rpc trace instead of a network, on any number
+ * of worker threads, to measure how a handler scales without a client.
+ *
+ * The trace is mapped once (see PacketReplaySocket) and split into one
+ * shard per worker, by flow or round robin. Each worker replays its shard
+ * back to back with its own processor from the processor factory, its
+ * own memory protocols and its own response files, so the workers share
+ * nothing but the read-only trace and whatever the handler shares.
+ * Requests are decoded where they lie in the mapping, as TDatagramServer
+ * decodes datagrams.
+ *
+ * serve() returns once every shard is done. The responses of all workers
+ * can then be checked against the captured rpc_to_dpdk trace together:
+ * the validator matches them by method and seqid, whatever the order.
+ * Compressed traces have to be decompressed first (trace_blocks -d).
+ */
+class TReplayServer : public TServer {
+public:
+  typedef ::PacketReplaySocket::ShardBy ShardBy;
+
+  struct WorkerStats {
+    uint64_t requests;
+    uint64_t failed;    // the processor threw
+    uint64_t elapsedNs; // from the common start to the end of its shard
+  };
+
+  TReplayServer(
+      const std::shared_ptr<apache::thrift::TProcessorFactory>& processorFactory,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      const std::string& traceFile,
+      size_t numWorkers,
+      ShardBy shardBy = ::PacketReplaySocket::SHARD_BY_FLOW,
+      int maxRequests = -1,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  TReplayServer(
+      const std::shared_ptr<apache::thrift::TProcessor>& processor,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      const std::string& traceFile,
+      size_t numWorkers,
+      ShardBy shardBy = ::PacketReplaySocket::SHARD_BY_FLOW,
+      int maxRequests = -1,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  ~TReplayServer() override;
+
+  /**
+   * Loads and shards the trace, then replays every shard on its own
+   * thread, all starting together. The calling thread replays shard 0.
+   * Throws TTransportException if the trace cannot be loaded or shared.
+   */
+  void serve() override;
+
+  /** Workers stop after the request they are processing */
+  void stop() override;
+
+  size_t getNumWorkers() const { return numWorkers_; }
+
+  /**
+   * Responses of worker i go to <prefix>.shard<i>.0, ...; by default the
+   * prefix is <trace>.resp. Takes effect on serve().
+   */
+  void setResponseFile(const std::string& prefix) { respPrefix_ = prefix; }
+
+  /** Per worker, filled in by serve() */
+  const std::vector<WorkerStats>& getWorkerStats() const { return stats_; }
+
+  /** Wall time of the last serve(), from the common start to the last worker */
+  uint64_t getElapsedNs() const { return elapsedNs_; }
+
+  uint64_t getRequestCount() const;
+
+  /**
+   * Matches the responses of every worker against a captured trace with
+   * validator, which holds the summary and differences afterwards.
+   */
+  bool validate(const std::string& expectedFile,
+                apache::thrift::transport::ReplayValidator& validator) const;
+
+private:
+  class Worker;
+
+  void replayLoop(size_t worker);
+
+  std::string traceFile_;
+  size_t numWorkers_;
+  ShardBy shardBy_;
+  int maxRequests_;
+  std::shared_ptr<apache::thrift::concurrency::ThreadFactory> threadFactory_;
+  std::string respPrefix_;
+
+  std::unique_ptr<::PacketReplaySocket> trace_;
+  std::vector<std::unique_ptr<::PacketReplaySocket> > shards_;
+  std::vector<WorkerStats> stats_;
+  std::atomic<bool> stop_;
+  std::atomic<size_t> waiting_;  // workers not yet at the start
+  std::atomic<uint64_t> startNs_;
+  uint64_t elapsedNs_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TREPLAYSERVER_H_
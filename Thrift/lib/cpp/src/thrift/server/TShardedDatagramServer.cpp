@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <thrift/server/TShardedDatagramServer.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::TServerUDPSocket;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+shared_ptr<TServerUDPSocket> newShardSocket(const string& address, int port, uint32_t batchSize) {
+  shared_ptr<TServerUDPSocket> socket(new TServerUDPSocket(address, port, batchSize));
+  socket->setReusePort(true);
+  return socket;
+}
+}
+
+TShardedDatagramServer::TShardedDatagramServer(
+    const shared_ptr<TProcessorFactory>& processorFactory,
+    const string& address,
+    int port,
+    const shared_ptr<TProtocolFactory>& protocolFactory,
+    size_t numShards,
+    uint32_t batchSize,
+    const shared_ptr<ThreadFactory>& threadFactory)
+  : TDatagramServer(processorFactory,
+                    newShardSocket(address, port, batchSize),
+                    protocolFactory,
+                    1,
+                    threadFactory),
+    pinThreads_(true) {
+  init(address, port, numShards, batchSize);
+}
+
+TShardedDatagramServer::TShardedDatagramServer(const shared_ptr<TProcessor>& processor,
+                                               const string& address,
+                                               int port,
+                                               const shared_ptr<TProtocolFactory>& protocolFactory,
+                                               size_t numShards,
+                                               uint32_t batchSize,
+                                               const shared_ptr<ThreadFactory>& threadFactory)
+  : TDatagramServer(processor,
+                    newShardSocket(address, port, batchSize),
+                    protocolFactory,
+                    1,
+                    threadFactory),
+    pinThreads_(true) {
+  init(address, port, numShards, batchSize);
+}
+
+void TShardedDatagramServer::init(const string& address,
+                                  int port,
+                                  size_t numShards,
+                                  uint32_t batchSize) {
+  // The base class socket doubles as shard 0
+  shards_.push_back(udpTransport_);
+  for (size_t i = 1; i < numShards; ++i) {
+    shards_.push_back(newShardSocket(address, port, batchSize));
+  }
+}
+
+TShardedDatagramServer::~TShardedDatagramServer() = default;
+
+/**
+ * Pins itself and serves one shard socket.
+ */
+class TShardedDatagramServer::Shard : public Runnable {
+public:
+  Shard(TShardedDatagramServer& server, size_t index) : server_(server), index_(index) {}
+
+  void run() override {
+    server_.pinCurrentThread(index_);
+    server_.receiveLoop(*server_.shards_[index_]);
+  }
+
+private:
+  TShardedDatagramServer& server_;
+  size_t index_;
+};
+
+void TShardedDatagramServer::serve() {
+  stop_ = false;
+
+  // Bind all shards before serving any, so no flow hashes to a socket that
+  // does not exist yet
+  for (auto& shard : shards_) {
+    shard->listen();
+  }
+
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  std::vector<shared_ptr<Thread> > threads;
+  for (size_t i = 1; i < shards_.size(); ++i) {
+    shared_ptr<Thread> thread = threadFactory_->newThread(std::make_shared<Shard>(*this, i));
+    thread->start();
+    threads.push_back(thread);
+  }
+
+  Shard(*this, 0).run();
+
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  for (auto& shard : shards_) {
+    shard->close();
+  }
+}
+
+void TShardedDatagramServer::stop() {
+  stop_ = true;
+  for (auto& shard : shards_) {
+    shard->interrupt();
+  }
+}
+
+void TShardedDatagramServer::pinCurrentThread(size_t shard) const {
+  if (!pinThreads_) {
+    return;
+  }
+#ifdef __linux__
+  int cpu;
+  if (!cpus_.empty()) {
+    cpu = cpus_[shard % cpus_.size()];
+  } else {
+    unsigned int online = std::thread::hardware_concurrency();
+    cpu = static_cast<int>(shard % (online > 0 ? online : 1));
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    GlobalOutput.perror("TShardedDatagramServer pthread_setaffinity_np() ", ret);
+  }
+#else
+  (void)shard;
+#endif
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,108 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TSHARDEDDATAGRAMSERVER_H_
+#define _THRIFT_SERVER_TSHARDEDDATAGRAMSERVER_H_ 1
+
+#include <string>
+#include <vector>
+
+#include <thrift/server/TDatagramServer.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Datagram server with one SO_REUSEPORT socket per shard. The kernel hashes
+ * every flow to one of the sockets, and each socket is served by a single
+ * thread pinned to its own core with its own epoll set, so shards share no
+ * socket, lock or cache line on the receive path.
+ *
+ * Use one shard per core the server may run on. Replies leave through the
+ * socket the request came in on, so clients see a single server port.
+ *
+ * With F-Stack the stack owns the event loop of each lcore; shard by running
+ * one process per lcore with TServerUDPSocket_kqueue_epoll::setReusePort().
+ */
+class TShardedDatagramServer : public TDatagramServer {
+public:
+  TShardedDatagramServer(
+      const std::shared_ptr<apache::thrift::TProcessorFactory>& processorFactory,
+      const std::string& address,
+      int port,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      size_t numShards,
+      uint32_t batchSize = apache::thrift::transport::TUDPDatagramBatch::DEFAULT_BATCH_SIZE,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  TShardedDatagramServer(
+      const std::shared_ptr<apache::thrift::TProcessor>& processor,
+      const std::string& address,
+      int port,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      size_t numShards,
+      uint32_t batchSize = apache::thrift::transport::TUDPDatagramBatch::DEFAULT_BATCH_SIZE,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadFactory>& threadFactory
+      = std::shared_ptr<apache::thrift::concurrency::ThreadFactory>(
+          new apache::thrift::concurrency::ThreadFactory(false)));
+
+  ~TShardedDatagramServer() override;
+
+  /**
+   * Binds every shard socket, then serves each one on its own thread. The
+   * calling thread serves shard 0.
+   */
+  void serve() override;
+
+  void stop() override;
+
+  size_t getNumShards() const { return shards_.size(); }
+
+  /** Socket of shard i, e.g. to tune buffers before serve() */
+  std::shared_ptr<apache::thrift::transport::TServerUDPSocket> getShard(size_t i) const {
+    return shards_[i];
+  }
+
+  /**
+   * CPUs the shard threads are pinned to, shard i on cpus[i % cpus.size()].
+   * When empty, shard i runs on CPU i modulo the number of online CPUs.
+   */
+  void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+
+  /** Leaves shard threads to the scheduler when false */
+  void setPinThreads(bool pinThreads) { pinThreads_ = pinThreads; }
+
+private:
+  class Shard;
+
+  void init(const std::string& address, int port, size_t numShards, uint32_t batchSize);
+  void pinCurrentThread(size_t shard) const;
+
+  std::vector<std::shared_ptr<apache::thrift::transport::TServerUDPSocket> > shards_;
+  std::vector<int> cpus_;
+  bool pinThreads_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TSHARDEDDATAGRAMSERVER_H_
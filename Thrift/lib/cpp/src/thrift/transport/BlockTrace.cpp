@@ -0,0 +1,348 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <thrift/transport/BlockTrace.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+const uint64_t FILE_MAGIC = 0x314B4C4243525450ULL;   // "PTRCBLK1"
+const uint64_t INDEX_MAGIC = 0x3158444943525450ULL;  // "PTRCIDX1"
+const uint32_t VERSION = 1;
+const size_t IO_BUFFER = 1 << 20;
+
+// Blocks are cut at record boundaries, a little past the block size; no
+// block is allowed to claim more than this
+const uint32_t MAX_BLOCK = 1u << 30;
+
+struct FileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct BlockHeader {
+  uint32_t rawSize;
+  uint32_t storedSize;
+  uint32_t records;
+  uint32_t codec;
+};
+
+struct Trailer {
+  uint64_t indexOffset;
+  uint64_t blocks;
+  uint64_t rawSize;
+  uint64_t magic;
+};
+
+static_assert(sizeof(FileHeader) == 16, "packed on disk");
+static_assert(sizeof(BlockHeader) == 16, "packed on disk");
+static_assert(sizeof(BlockTrace::Block) == 40, "packed on disk");
+static_assert(sizeof(Trailer) == 32, "packed on disk");
+
+std::string errorText(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+// Whole len bytes at offset, false if the file ends first
+bool preadAll(int fd, void* buf, size_t len, uint64_t offset) {
+  uint8_t* p = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t got = ::pread(fd, p, len, static_cast<off_t>(offset));
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    p += got;
+    len -= got;
+    offset += got;
+  }
+  return true;
+}
+
+} // namespace
+
+bool BlockTrace::isBlockTrace(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  FileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == FILE_MAGIC;
+  fclose(f);
+  return ok;
+}
+
+BlockTraceWriter::BlockTraceWriter(const std::string& path, uint32_t blockBytes, int level)
+  : path_(path),
+    file_(fopen(path.c_str(), "wb")),
+    blockBytes_(std::min(blockBytes ? blockBytes : 1u, MAX_BLOCK / 2)),
+    level_(level),
+    rawRecords_(0),
+    rawBytes_(0),
+    records_(0),
+    fileBytes_(0) {
+  if (!file_) {
+    throw TTransportException(TTransportException::NOT_OPEN, errorText("Cannot open", path));
+  }
+  setvbuf(file_, nullptr, _IOFBF, IO_BUFFER);
+  raw_.reserve(blockBytes_ * 2);
+  FileHeader header = {FILE_MAGIC, VERSION, 0};
+  write(&header, sizeof(header));
+}
+
+BlockTraceWriter::~BlockTraceWriter() {
+  try {
+    close();
+  } catch (const TTransportException&) {
+  }
+}
+
+void BlockTraceWriter::append(const void* data, size_t size, uint32_t records) {
+  if (!file_) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Closed " + path_);
+  }
+  if (raw_.size() + size > MAX_BLOCK) {
+    flushBlock();
+    if (size > MAX_BLOCK) {
+      throw TTransportException(TTransportException::BAD_ARGS, "Records too large for " + path_);
+    }
+  }
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  raw_.insert(raw_.end(), p, p + size);
+  rawRecords_ += records;
+  if (raw_.size() >= blockBytes_) {
+    flushBlock();
+  }
+}
+
+void BlockTraceWriter::close() {
+  if (!file_) {
+    return;
+  }
+  flushBlock();
+  Trailer trailer = {fileBytes_, blocks_.size(), rawBytes_, INDEX_MAGIC};
+  if (!blocks_.empty()) {
+    write(blocks_.data(), blocks_.size() * sizeof(BlockTrace::Block));
+  }
+  write(&trailer, sizeof(trailer));
+  FILE* f = file_;
+  file_ = nullptr;
+  if (fclose(f) != 0) {
+    throw TTransportException(TTransportException::UNKNOWN, errorText("Cannot write", path_));
+  }
+}
+
+void BlockTraceWriter::flushBlock() {
+  if (raw_.empty()) {
+    return;
+  }
+  BlockHeader header = {static_cast<uint32_t>(raw_.size()), 0, rawRecords_, BlockTrace::DEFLATE};
+  uLongf storedSize = compressBound(raw_.size());
+  stored_.resize(storedSize);
+  if (compress2(stored_.data(), &storedSize, raw_.data(), raw_.size(), level_) != Z_OK
+      || storedSize >= raw_.size()) {
+    header.codec = BlockTrace::STORED;
+    storedSize = raw_.size();
+  }
+  header.storedSize = static_cast<uint32_t>(storedSize);
+
+  BlockTrace::Block block = {fileBytes_, rawBytes_, records_, header.rawSize,
+                             header.storedSize, header.records, header.codec};
+  write(&header, sizeof(header));
+  write(header.codec == BlockTrace::STORED ? raw_.data() : stored_.data(), storedSize);
+  blocks_.push_back(block);
+  rawBytes_ += raw_.size();
+  records_ += rawRecords_;
+  raw_.clear();
+  rawRecords_ = 0;
+}
+
+void BlockTraceWriter::write(const void* data, size_t size) {
+  if (fwrite(data, 1, size, file_) != size) {
+    throw TTransportException(TTransportException::UNKNOWN, errorText("Cannot write", path_));
+  }
+  fileBytes_ += size;
+}
+
+BlockTraceReader::BlockTraceReader(const std::string& path)
+  : path_(path), fd_(::open(path.c_str(), O_RDONLY)), fileSize_(0), rawSize_(0), records_(0) {
+  struct stat st;
+  if (fd_ < 0 || fstat(fd_, &st) != 0) {
+    int err = errno;
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    errno = err;
+    throw TTransportException(TTransportException::NOT_OPEN, errorText("Cannot open", path));
+  }
+  fileSize_ = st.st_size;
+  FileHeader header;
+  if (!preadAll(fd_, &header, sizeof(header), 0) || header.magic != FILE_MAGIC
+      || header.version != VERSION) {
+    ::close(fd_);
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Not a block trace: " + path);
+  }
+  if (!readIndex()) {
+    scanBlocks();
+  }
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+BlockTraceReader::~BlockTraceReader() {
+  ::close(fd_);
+}
+
+// The index at the end, if the writer got to write it and it adds up
+bool BlockTraceReader::readIndex() {
+  Trailer trailer;
+  if (fileSize_ < sizeof(FileHeader) + sizeof(Trailer)
+      || !preadAll(fd_, &trailer, sizeof(trailer), fileSize_ - sizeof(trailer))
+      || trailer.magic != INDEX_MAGIC
+      || trailer.indexOffset < sizeof(FileHeader)
+      || trailer.indexOffset > fileSize_ - sizeof(trailer)
+      || (fileSize_ - sizeof(trailer) - trailer.indexOffset) / sizeof(BlockTrace::Block)
+             != trailer.blocks
+      || (fileSize_ - sizeof(trailer) - trailer.indexOffset) % sizeof(BlockTrace::Block) != 0) {
+    return false;
+  }
+  std::vector<BlockTrace::Block> blocks(trailer.blocks);
+  if (!blocks.empty()
+      && !preadAll(fd_, blocks.data(), blocks.size() * sizeof(BlockTrace::Block),
+                   trailer.indexOffset)) {
+    return false;
+  }
+  uint64_t raw = 0;
+  uint64_t records = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const BlockTrace::Block& b = blocks[i];
+    if (b.rawOffset != raw || b.firstRecord != records
+        || b.offset + sizeof(BlockHeader) + b.storedSize > trailer.indexOffset) {
+      return false;
+    }
+    raw += b.rawSize;
+    records += b.records;
+  }
+  if (raw != trailer.rawSize) {
+    return false;
+  }
+  blocks_.swap(blocks);
+  rawSize_ = raw;
+  records_ = records;
+  return true;
+}
+
+// Walks the block headers of a file without an index
+void BlockTraceReader::scanBlocks() {
+  uint64_t offset = sizeof(FileHeader);
+  BlockHeader header;
+  while (preadAll(fd_, &header, sizeof(header), offset)
+         && header.rawSize > 0 && header.rawSize <= MAX_BLOCK
+         && header.storedSize <= MAX_BLOCK
+         && (header.codec == BlockTrace::DEFLATE
+             || (header.codec == BlockTrace::STORED && header.storedSize == header.rawSize))
+         && offset + sizeof(header) + header.storedSize <= fileSize_) {
+    BlockTrace::Block block = {offset, rawSize_, records_, header.rawSize,
+                               header.storedSize, header.records, header.codec};
+    blocks_.push_back(block);
+    rawSize_ += header.rawSize;
+    records_ += header.records;
+    offset += sizeof(header) + header.storedSize;
+  }
+}
+
+size_t BlockTraceReader::findOffset(uint64_t offset) const {
+  if (offset >= rawSize_) {
+    return blocks_.size();
+  }
+  size_t lo = 0, hi = blocks_.size();
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (blocks_[mid].rawOffset <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+size_t BlockTraceReader::findRecord(uint64_t record) const {
+  if (record >= records_) {
+    return blocks_.size();
+  }
+  size_t lo = 0, hi = blocks_.size();
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (blocks_[mid].firstRecord <= record) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  // Past any blocks of no records that start at the same record
+  while (blocks_[lo].records == 0 && lo + 1 < blocks_.size()) {
+    ++lo;
+  }
+  return lo;
+}
+
+void BlockTraceReader::read(size_t i, uint8_t* out) const {
+  const BlockTrace::Block& b = blocks_.at(i);
+  uint64_t data = b.offset + sizeof(BlockHeader);
+  if (b.codec == BlockTrace::STORED) {
+    if (!preadAll(fd_, out, b.rawSize, data)) {
+      throw TTransportException(TTransportException::END_OF_FILE, errorText("Cannot read", path_));
+    }
+    return;
+  }
+  std::vector<uint8_t> stored(b.storedSize);
+  if (!preadAll(fd_, stored.data(), stored.size(), data)) {
+    throw TTransportException(TTransportException::END_OF_FILE, errorText("Cannot read", path_));
+  }
+  uLongf rawSize = b.rawSize;
+  if (uncompress(out, &rawSize, stored.data(), stored.size()) != Z_OK || rawSize != b.rawSize) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Corrupt block " + std::to_string(i) + " in " + path_);
+  }
+}
+
+void BlockTraceReader::read(size_t i, std::vector<uint8_t>& out) const {
+  out.resize(blocks_.at(i).rawSize);
+  read(i, out.data());
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,164 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_BLOCKTRACE_H_
+#define _THRIFT_TRANSPORT_BLOCKTRACE_H_ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <thrift/transport/TTransportException.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Packet traces stored as independently compressed blocks.
+ *
+ * A block trace holds the same bytes as the .bin trace it stands for,
+ * cut into blocks of whole records, BLOCK_BYTES or a little more each,
+ * and deflated one by one. Each block starts with its sizes and record
+ * count, and an index of the blocks ends the file, so a reader can go
+ * straight to the block holding any byte or record and several threads
+ * can decompress different blocks at once. A file whose writer never got
+ * to the index (it was killed) is still read, by walking the block
+ * headers, up to its last whole block.
+ *
+ *   header   u64 magic "PTRCBLK1", u32 version, u32 reserved
+ *   block    u32 raw size, u32 stored size, u32 records, u32 codec,
+ *            then the stored bytes
+ *   index    per block: u64 file offset, u64 raw offset, u64 first
+ *            record, u32 raw size, u32 stored size, u32 records,
+ *            u32 codec
+ *   trailer  u64 index offset, u64 blocks, u64 raw size, u64 magic
+ *            "PTRCIDX1"
+ *
+ * In host byte order, like the .bin traces. A block that does not get
+ * smaller is stored as is. Errors opening, reading or writing files, and
+ * files that are not block traces, throw TTransportException.
+ */
+class BlockTrace {
+public:
+  enum Codec {
+    STORED = 0,
+    DEFLATE = 1
+  };
+
+  enum {
+    BLOCK_BYTES = 1 << 20,  // raw bytes per block before it is cut
+    DEFAULT_LEVEL = 1       // zlib level; higher is smaller and slower
+  };
+
+  struct Block {
+    uint64_t offset;       // of its header in the file
+    uint64_t rawOffset;    // of its first byte in the raw trace
+    uint64_t firstRecord;
+    uint32_t rawSize;
+    uint32_t storedSize;
+    uint32_t records;
+    uint32_t codec;
+  };
+
+  /** Whether path starts like a block trace; false if it cannot be read */
+  static bool isBlockTrace(const std::string& path);
+};
+
+/**
+ * Writes a block trace. append() takes whole records, any number at a
+ * time, and cuts a block once BLOCK_BYTES have gathered, so a block never
+ * splits a record. close() writes the last block and the index; the
+ * destructor closes, ignoring errors.
+ */
+class BlockTraceWriter {
+public:
+  explicit BlockTraceWriter(const std::string& path,
+                            uint32_t blockBytes = BlockTrace::BLOCK_BYTES,
+                            int level = BlockTrace::DEFAULT_LEVEL);
+  ~BlockTraceWriter();
+
+  void append(const void* data, size_t size, uint32_t records);
+  void close();
+
+  uint64_t rawBytes() const { return rawBytes_; }
+  uint64_t fileBytes() const { return fileBytes_; }
+
+private:
+  BlockTraceWriter(const BlockTraceWriter&);
+  BlockTraceWriter& operator=(const BlockTraceWriter&);
+
+  void flushBlock();
+  void write(const void* data, size_t size);
+
+  std::string path_;
+  FILE* file_;
+  uint32_t blockBytes_;
+  int level_;
+  std::vector<uint8_t> raw_;
+  uint32_t rawRecords_;
+  std::vector<uint8_t> stored_;
+  std::vector<BlockTrace::Block> blocks_;
+  uint64_t rawBytes_;
+  uint64_t records_;
+  uint64_t fileBytes_;
+};
+
+/**
+ * Reads a block trace. read() uses pread and keeps no state, so any
+ * number of threads can decompress blocks of one reader at once.
+ */
+class BlockTraceReader {
+public:
+  explicit BlockTraceReader(const std::string& path);
+  ~BlockTraceReader();
+
+  size_t blocks() const { return blocks_.size(); }
+  const BlockTrace::Block& block(size_t i) const { return blocks_[i]; }
+  uint64_t rawSize() const { return rawSize_; }
+  uint64_t records() const { return records_; }
+  uint64_t fileSize() const { return fileSize_; }
+
+  /** The block holding raw byte offset, or record; blocks() if past the end */
+  size_t findOffset(uint64_t offset) const;
+  size_t findRecord(uint64_t record) const;
+
+  /** Decompresses block i to out, which has room for its rawSize bytes */
+  void read(size_t i, uint8_t* out) const;
+  void read(size_t i, std::vector<uint8_t>& out) const;
+
+private:
+  BlockTraceReader(const BlockTraceReader&);
+  BlockTraceReader& operator=(const BlockTraceReader&);
+
+  bool readIndex();
+  void scanBlocks();
+
+  std::string path_;
+  int fd_;
+  uint64_t fileSize_;
+  uint64_t rawSize_;
+  uint64_t records_;
+  std::vector<BlockTrace::Block> blocks_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_BLOCKTRACE_H_
@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DPDKChecksum.h
+#ifndef _THRIFT_TRANSPORT_DPDKCHECKSUM_H_
+#define _THRIFT_TRANSPORT_DPDKCHECKSUM_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * IPv4 and UDP checksums for the DPDK transports: in the NIC where the port
+ * offers it, in software where it does not.
+ *
+ * configure() asks the port for only the checksum offloads it reports, so
+ * rte_eth_dev_configure() does not fail on vdevs and NICs without them.
+ * One DPDKChecksum per queue then reads back what was granted:
+ *
+ *   prepareBurst()   just before tx_burst, once per burst. Frames get the
+ *                    offload flags, or their UDP (and, with no IP offload,
+ *                    IP) checksum computed here.
+ *   validateBurst()  just after rx_burst. Frames the NIC marked bad are
+ *                    dropped; frames it did not look at are checked here.
+ *
+ * The software sums run over 32 (AVX2) or 16 (SSE2) bytes at a time and
+ * fall back to 4 bytes at a time elsewhere. Frames are expected in one
+ * segment, as the transports build them and as MTU sized frames arrive;
+ * a UDP datagram spilling into a second segment is passed on unchecked.
+ *
+ * Not thread safe; use one per queue, from the lcore polling it.
+ */
+class DPDKChecksum {
+public:
+  struct Stats {
+    uint64_t rxBad;       // dropped: IP or UDP checksum wrong
+    uint64_t rxSoftware;  // verified here, the NIC did not
+    uint64_t txSoftware;  // UDP checksum computed here
+  };
+
+  DPDKChecksum() : rxOffload_(false), txIp_(false), txUdp_(false) {
+    stats_.rxBad = stats_.rxSoftware = stats_.txSoftware = 0;
+  }
+
+  /** Adds the checksum offloads info reports to conf, and nothing else */
+  static void configure(const struct rte_eth_dev_info& info, struct rte_eth_conf& conf) {
+    conf.rxmode.offloads
+        |= info.rx_offload_capa & (RTE_ETH_RX_OFFLOAD_IPV4_CKSUM | RTE_ETH_RX_OFFLOAD_UDP_CKSUM);
+    conf.txmode.offloads
+        |= info.tx_offload_capa & (RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | RTE_ETH_TX_OFFLOAD_UDP_CKSUM);
+  }
+
+  /** Takes the offloads the port was configured with */
+  void setOffloads(const struct rte_eth_conf& conf) {
+    rxOffload_ = (conf.rxmode.offloads & RTE_ETH_RX_OFFLOAD_UDP_CKSUM) != 0;
+    txIp_ = (conf.txmode.offloads & RTE_ETH_TX_OFFLOAD_IPV4_CKSUM) != 0;
+    txUdp_ = (conf.txmode.offloads & RTE_ETH_TX_OFFLOAD_UDP_CKSUM) != 0;
+  }
+
+  bool rxOffload() const { return rxOffload_; }
+  bool txOffload() const { return txUdp_; }
+  const Stats& getStats() const { return stats_; }
+
+  /**
+   * Fills in the checksums of the IPv4/UDP frames in pkts, or has the NIC
+   * do it. Expects the IP checksum set, as DPDKHeaderCache writes it, and
+   * the UDP checksum 0. Other frames, ARP for one, are left alone.
+   */
+  void prepareBurst(struct rte_mbuf** pkts, uint16_t n) {
+    for (uint16_t i = 0; i < n; ++i) {
+      struct rte_mbuf* m = pkts[i];
+      struct rte_ipv4_hdr* ip;
+      struct rte_udp_hdr* udp;
+      if (!parse(m, &ip, &udp)) {
+        continue;
+      }
+      if (txUdp_) {
+        m->l2_len = sizeof(struct rte_ether_hdr);
+        m->l3_len = ipHeaderLen(ip);
+        m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_UDP_CKSUM;
+        if (txIp_) {
+          m->ol_flags |= RTE_MBUF_F_TX_IP_CKSUM;
+          ip->hdr_checksum = 0;
+        }
+        // The NIC expects the pseudo-header sum in place
+        udp->dgram_cksum = rte_ipv4_phdr_cksum(ip, m->ol_flags);
+        continue;
+      }
+      udp->dgram_cksum = 0;
+      uint16_t sum = fold(pseudoSum(ip, udp) + sum64(udp, udpLen(udp)));
+      // 0 means no checksum; a sum of 0 is sent as its other form
+      udp->dgram_cksum = sum == 0xffff ? 0xffff : static_cast<uint16_t>(~sum);
+      stats_.txSoftware++;
+    }
+  }
+
+  /**
+   * Drops the frames of pkts whose IPv4 or UDP checksum is wrong, and
+   * moves the rest to the front. Returns how many are left.
+   */
+  uint16_t validateBurst(struct rte_mbuf** pkts, uint16_t n) {
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < n; ++i) {
+      struct rte_mbuf* m = pkts[i];
+      if (valid(m)) {
+        pkts[kept++] = m;
+      } else {
+        rte_pktmbuf_free(m);
+        stats_.rxBad++;
+      }
+    }
+    return kept;
+  }
+
+  /** One's complement sum of len bytes, not yet folded or inverted */
+  static uint64_t sum64(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t sum = 0;
+#if defined(__AVX2__)
+    // Each 32 bit lane widened into a 64 bit accumulator, so nothing carries out
+    const __m256i zero256 = _mm256_setzero_si256();
+    __m256i acc256 = zero256;
+    for (; len >= 32; p += 32, len -= 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      acc256 = _mm256_add_epi64(acc256, _mm256_unpacklo_epi32(v, zero256));
+      acc256 = _mm256_add_epi64(acc256, _mm256_unpackhi_epi32(v, zero256));
+    }
+    __m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc256),
+                                _mm256_extracti128_si256(acc256, 1));
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; len >= 16; p += 16, len -= 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+      acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; len >= 4; p += 4, len -= 4) {
+      uint32_t w;
+      memcpy(&w, p, sizeof(w));
+      sum += w;
+    }
+    if (len >= 2) {
+      uint16_t w;
+      memcpy(&w, p, sizeof(w));
+      sum += w;
+      p += 2;
+      len -= 2;
+    }
+    if (len > 0) {
+      // The odd byte is the first of a 16 bit word padded with zero
+      uint16_t w = 0;
+      memcpy(&w, p, 1);
+      sum += w;
+    }
+    return sum;
+  }
+
+  /** sum64() folded to 16 bits; 0xffff for data that checks out */
+  static uint16_t fold(uint64_t sum) {
+    sum = (sum & 0xffffffffULL) + (sum >> 32);
+    sum = (sum & 0xffffffffULL) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<uint16_t>(sum);
+  }
+
+private:
+  static uint32_t ipHeaderLen(const struct rte_ipv4_hdr* ip) {
+    return (ip->version_ihl & 0x0f) * 4u;
+  }
+
+  static uint32_t udpLen(const struct rte_udp_hdr* udp) {
+    return rte_be_to_cpu_16(udp->dgram_len);
+  }
+
+  // Addresses, protocol and UDP length, as they sit in the packet
+  static uint64_t pseudoSum(const struct rte_ipv4_hdr* ip, const struct rte_udp_hdr* udp) {
+    return static_cast<uint64_t>(ip->src_addr) + ip->dst_addr
+           + rte_cpu_to_be_16(static_cast<uint16_t>(IPPROTO_UDP)) + udp->dgram_len;
+  }
+
+  // IPv4/UDP headers of m, if it is an unfragmented UDP datagram whose
+  // headers and length fit in the first segment
+  static bool parse(struct rte_mbuf* m, struct rte_ipv4_hdr** ip, struct rte_udp_hdr** udp) {
+    if (m->data_len < sizeof(struct rte_ether_hdr) + sizeof(struct rte_ipv4_hdr)) {
+      return false;
+    }
+    struct rte_ether_hdr* eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
+    if (eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+      return false;
+    }
+    *ip = reinterpret_cast<struct rte_ipv4_hdr*>(eth + 1);
+    uint32_t l3 = ipHeaderLen(*ip);
+    if ((*ip)->next_proto_id != IPPROTO_UDP || l3 < sizeof(struct rte_ipv4_hdr)
+        || m->data_len < sizeof(struct rte_ether_hdr) + l3 + sizeof(struct rte_udp_hdr)) {
+      return false;
+    }
+    *udp = reinterpret_cast<struct rte_udp_hdr*>(reinterpret_cast<uint8_t*>(*ip) + l3);
+    return true;
+  }
+
+  bool valid(struct rte_mbuf* m) {
+    uint64_t ipFlag = m->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK;
+    uint64_t l4Flag = m->ol_flags & RTE_MBUF_F_RX_L4_CKSUM_MASK;
+    if (ipFlag == RTE_MBUF_F_RX_IP_CKSUM_BAD || l4Flag == RTE_MBUF_F_RX_L4_CKSUM_BAD) {
+      return false;
+    }
+    bool checkIp = ipFlag == RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN;
+    bool checkUdp = l4Flag == RTE_MBUF_F_RX_L4_CKSUM_UNKNOWN;
+    struct rte_ipv4_hdr* ip;
+    struct rte_udp_hdr* udp;
+    if ((!checkIp && !checkUdp) || !parse(m, &ip, &udp)) {
+      return true;
+    }
+    stats_.rxSoftware++;
+    if (checkIp && fold(sum64(ip, ipHeaderLen(ip))) != 0xffff) {
+      return false;
+    }
+    // A UDP checksum of 0 was never computed by the sender
+    uint32_t len = udpLen(udp);
+    if (!checkUdp || udp->dgram_cksum == 0 || len < sizeof(struct rte_udp_hdr)
+        || reinterpret_cast<uint8_t*>(udp) + len > rte_pktmbuf_mtod(m, uint8_t*) + m->data_len) {
+      return true;
+    }
+    return fold(pseudoSum(ip, udp) + sum64(udp, len)) == 0xffff;
+  }
+
+  bool rxOffload_;  // the NIC checks UDP; informational, the flags decide
+  bool txIp_;
+  bool txUdp_;
+  Stats stats_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_DPDKCHECKSUM_H_
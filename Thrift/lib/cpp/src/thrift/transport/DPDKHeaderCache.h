@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DPDKHeaderCache.h
+#ifndef _THRIFT_TRANSPORT_DPDKHEADERCACHE_H_
+#define _THRIFT_TRANSPORT_DPDKHEADERCACHE_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_memcpy.h>
+#include <rte_udp.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Prebuilt Ethernet/IPv4/UDP headers, one per recently seen peer.
+ *
+ * Everything but the lengths and the IP checksum is the same for every
+ * reply to a peer, so the headers are built once and copied. The peer's
+ * next hop MAC is part of the template; a different one rebuilds it. The IP
+ * checksum of the template is kept as a partial sum without the length,
+ * and finished with one add per packet. The UDP checksum covers the
+ * payload and is left to the caller.
+ *
+ * Peers map to a small direct-mapped table; a collision just rebuilds the
+ * slot. Not thread safe; keep one per lcore.
+ */
+class DPDKHeaderCache {
+public:
+  static const uint32_t HEADERS_LEN
+      = sizeof(struct rte_ether_hdr) + sizeof(struct rte_ipv4_hdr) + sizeof(struct rte_udp_hdr);
+  static const uint32_t SLOTS = 64; // power of two
+
+  DPDKHeaderCache() : srcIp_(0), hits_(0), misses_(0) {
+    memset(&srcMac_, 0, sizeof(srcMac_));
+    invalidate();
+  }
+
+  /** Addresses of this end; ip in network byte order */
+  void setSource(const struct rte_ether_addr& mac, uint32_t ip) {
+    srcMac_ = mac;
+    srcIp_ = ip;
+    invalidate();
+  }
+
+  void invalidate() {
+    for (uint32_t i = 0; i < SLOTS; ++i) {
+      slots_[i].valid = false;
+    }
+  }
+
+  /**
+   * Writes HEADERS_LEN bytes of headers for a datagram of payloadLen bytes,
+   * in a frame for dstMac. Addresses and ports are in network byte order.
+   * The UDP checksum is 0.
+   */
+  void write(uint8_t* dst,
+             const struct rte_ether_addr& dstMac,
+             uint32_t peerIp,
+             uint16_t peerPort,
+             uint16_t localPort,
+             uint16_t payloadLen) {
+    uint32_t hash = rte_be_to_cpu_32(peerIp)
+                    ^ (static_cast<uint32_t>(rte_be_to_cpu_16(peerPort)) << 3)
+                    ^ rte_be_to_cpu_16(localPort);
+    Slot& slot = slots_[hash & (SLOTS - 1)];
+    if (slot.valid && slot.peerIp == peerIp && slot.peerPort == peerPort
+        && slot.localPort == localPort
+        && rte_is_same_ether_addr(&dstMac, &((struct rte_ether_hdr*)slot.headers)->dst_addr)) {
+      hits_++;
+    } else {
+      build(slot, dstMac, peerIp, peerPort, localPort);
+      misses_++;
+    }
+    rte_memcpy(dst, slot.headers, HEADERS_LEN);
+
+    struct rte_ipv4_hdr* ip = (struct rte_ipv4_hdr*)(dst + sizeof(struct rte_ether_hdr));
+    struct rte_udp_hdr* udp = (struct rte_udp_hdr*)(ip + 1);
+    uint16_t udpLen = static_cast<uint16_t>(sizeof(struct rte_udp_hdr) + payloadLen);
+    ip->total_length = rte_cpu_to_be_16(sizeof(struct rte_ipv4_hdr) + udpLen);
+    udp->dgram_len = rte_cpu_to_be_16(udpLen);
+
+    // The one's complement sum does not care about byte order, so the
+    // stored length adds in as is
+    uint32_t sum = slot.ipSum + ip->total_length;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    ip->hdr_checksum = static_cast<uint16_t>(~sum);
+  }
+
+  uint64_t getHits() const { return hits_; }
+  uint64_t getMisses() const { return misses_; }
+
+private:
+  struct Slot {
+    bool valid;
+    uint32_t peerIp;
+    uint16_t peerPort;
+    uint16_t localPort;
+    uint16_t ipSum; // IP header sum with total_length and checksum 0
+    uint8_t headers[HEADERS_LEN];
+  };
+
+  void build(Slot& slot,
+             const struct rte_ether_addr& dstMac,
+             uint32_t peerIp,
+             uint16_t peerPort,
+             uint16_t localPort) {
+    memset(slot.headers, 0, HEADERS_LEN);
+    struct rte_ether_hdr* eth = (struct rte_ether_hdr*)slot.headers;
+    struct rte_ipv4_hdr* ip = (struct rte_ipv4_hdr*)(eth + 1);
+    struct rte_udp_hdr* udp = (struct rte_udp_hdr*)(ip + 1);
+
+    eth->src_addr = srcMac_;
+    eth->dst_addr = dstMac;
+    eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+    ip->version_ihl = (4 << 4) | (sizeof(*ip) >> 2);
+    ip->time_to_live = 64;
+    ip->next_proto_id = IPPROTO_UDP;
+    ip->src_addr = srcIp_;
+    ip->dst_addr = peerIp;
+
+    udp->src_port = localPort;
+    udp->dst_port = peerPort;
+
+    slot.ipSum = rte_raw_cksum(ip, sizeof(*ip));
+    slot.peerIp = peerIp;
+    slot.peerPort = peerPort;
+    slot.localPort = localPort;
+    slot.valid = true;
+  }
+
+  struct rte_ether_addr srcMac_;
+  uint32_t srcIp_;
+  Slot slots_[SLOTS];
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_DPDKHEADERCACHE_H_
@@ -0,0 +1,517 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DPDKNeighborTable.h
+#ifndef _THRIFT_TRANSPORT_DPDKNEIGHBORTABLE_H_
+#define _THRIFT_TRANSPORT_DPDKNEIGHBORTABLE_H_ 1
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <rte_arp.h>
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+
+#include <thrift/transport/DPDKTxBuffer.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * IPv4 to MAC table for one port, filled from ARP and shared by all of its
+ * queues.
+ *
+ * Lookups take no lock: every entry carries a sequence number that is odd
+ * while a writer changes it, and a reader that sees it move tries again.
+ * Writers (ARP input, holding packets) serialize on a spinlock; they are
+ * rare next to lookups.
+ *
+ * An entry is good for maxAge after it was last confirmed. In the last
+ * quarter of that the next resolve() asks again, so a neighbor that is
+ * still there never expires. Packets for an address that is not resolved
+ * yet are held, MAX_HELD per address, and go out once the reply arrives.
+ *
+ * Learning follows RFC 826: any ARP packet refreshes its sender if known,
+ * and adds it if the packet was for us, so a gratuitous ARP moves a known
+ * neighbor to its new MAC.
+ */
+class DPDKNeighborTable {
+public:
+  static const uint32_t SLOTS = 1024;           // power of two
+  static const uint32_t PROBES = 8;             // slots an address may use
+  static const uint32_t HELD_ADDRESSES = 16;    // unresolved addresses holding packets
+  static const uint16_t MAX_HELD = 16;          // packets held per address
+  static const uint32_t MAX_REQUESTS = 3;       // before held packets are dropped
+  static const uint32_t RETRY_MS = 250;
+  static const uint32_t DEFAULT_MAX_AGE_S = 300;
+
+  struct Stats {
+    uint64_t learned;   // entries added or moved to another MAC
+    uint64_t requests;  // ARP requests sent
+    uint64_t held;      // packets held for resolution
+    uint64_t dropped;   // held packets given up on
+    uint64_t conflicts; // ARP from another host claiming our address
+  };
+
+  DPDKNeighborTable()
+    : localIp_(0),
+      gateway_(0),
+      netmask_(0),
+      announcedIp_(0),
+      maxAgeS_(DEFAULT_MAX_AGE_S),
+      maxAgeCycles_(0),
+      retryCycles_(0) {
+    rte_spinlock_init(&lock_);
+    memset(&localMac_, 0, sizeof(localMac_));
+    memset(&stats_, 0, sizeof(stats_));
+    for (uint32_t i = 0; i < SLOTS; ++i) {
+      entries_[i].seq.store(0, std::memory_order_relaxed);
+      entries_[i].ip.store(0, std::memory_order_relaxed);
+      entries_[i].mac.store(0, std::memory_order_relaxed);
+      entries_[i].confirmed.store(0, std::memory_order_relaxed);
+      entries_[i].requested = 0;
+    }
+    for (uint32_t i = 0; i < HELD_ADDRESSES; ++i) {
+      held_[i].ip = 0;
+      held_[i].count = 0;
+    }
+  }
+
+  ~DPDKNeighborTable() {
+    for (uint32_t i = 0; i < HELD_ADDRESSES; ++i) {
+      dropHeld(held_[i]);
+    }
+  }
+
+  /**
+   * Addresses of this end; ip in network byte order. Call once EAL is up,
+   * before anything else: timeouts are converted to timer cycles here.
+   */
+  void setLocal(const struct rte_ether_addr& mac, uint32_t ip) {
+    rte_spinlock_lock(&lock_);
+    localMac_ = mac;
+    localIp_ = ip;
+    rte_spinlock_unlock(&lock_);
+    setMaxAge(maxAgeS_);
+  }
+
+  /**
+   * Addresses outside netmask are reached through gateway, both in network
+   * byte order. Without a gateway every address is on the link.
+   */
+  void setGateway(uint32_t gateway, uint32_t netmask) {
+    gateway_ = gateway;
+    netmask_ = netmask;
+  }
+
+  void setMaxAge(uint32_t seconds) {
+    maxAgeS_ = seconds;
+    maxAgeCycles_ = rte_get_timer_hz() * seconds;
+    retryCycles_ = rte_get_timer_hz() / 1000 * RETRY_MS;
+  }
+
+  /** A neighbor that is never asked for and never expires */
+  void addStatic(uint32_t ip, const struct rte_ether_addr& mac) {
+    rte_spinlock_lock(&lock_);
+    update(ip, mac, true, PERMANENT);
+    rte_spinlock_unlock(&lock_);
+  }
+
+  /** The address the frame for ip goes to */
+  uint32_t nextHop(uint32_t ip) const {
+    if (gateway_ != 0 && (ip & netmask_) != (localIp_ & netmask_)) {
+      return gateway_;
+    }
+    return ip;
+  }
+
+  /** The MAC of ip if it is known and has not expired. Lock free. */
+  bool lookup(uint32_t ip, struct rte_ether_addr* mac) const {
+    uint64_t age;
+    return find(ip, mac, &age);
+  }
+
+  /**
+   * lookup(), and if the entry is getting old, a request through tx to
+   * refresh it while it is still used.
+   */
+  bool resolve(uint32_t ip, struct rte_ether_addr* mac, struct rte_mempool* pool,
+               DPDKTxBuffer& tx) {
+    uint64_t age;
+    if (!find(ip, mac, &age)) {
+      return false;
+    }
+    if (age > maxAgeCycles_ - maxAgeCycles_ / 4) {
+      refresh(ip, *mac, pool, tx);
+    }
+    return true;
+  }
+
+  /**
+   * Keeps m, a frame for ip, until ip resolves; its destination MAC is
+   * filled in then. Asks for ip through tx unless a request is pending.
+   * m is freed if too many packets are waiting already.
+   */
+  void hold(uint32_t ip, struct rte_mbuf* m, struct rte_mempool* pool, DPDKTxBuffer& tx) {
+    uint64_t now = rte_get_timer_cycles();
+    rte_spinlock_lock(&lock_);
+    // Resolved since the caller looked
+    struct rte_ether_addr mac;
+    uint64_t age;
+    if (find(ip, &mac, &age)) {
+      rte_spinlock_unlock(&lock_);
+      rte_pktmbuf_mtod(m, struct rte_ether_hdr*)->dst_addr = mac;
+      tx.add(m);
+      return;
+    }
+
+    Held* held = findHeld(ip);
+    if (held && held->requests >= MAX_REQUESTS && now - held->requested > retryCycles_) {
+      // Nobody answered; start over with this packet
+      dropHeld(*held);
+      held = nullptr;
+    }
+    if (!held) {
+      held = findHeld(0);
+      if (held) {
+        held->ip = ip;
+        held->requests = 0;
+        held->requested = 0;
+      }
+    }
+    if (!held || held->count == MAX_HELD) {
+      stats_.dropped++;
+      rte_spinlock_unlock(&lock_);
+      rte_pktmbuf_free(m);
+      return;
+    }
+    held->pkts[held->count++] = m;
+    stats_.held++;
+
+    bool ask = held->requests == 0 || now - held->requested > retryCycles_;
+    if (ask) {
+      held->requests++;
+      held->requested = now;
+    }
+    rte_spinlock_unlock(&lock_);
+    if (ask) {
+      request(ip, broadcast(), pool, tx);
+    }
+  }
+
+  /**
+   * Handles an ARP frame: learns its sender, answers requests for the
+   * local address and sends the packets held for the sender, all through
+   * tx. m is left to the caller.
+   */
+  void input(struct rte_mbuf* m, struct rte_mempool* pool, DPDKTxBuffer& tx) {
+    if (rte_pktmbuf_data_len(m) < sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr)) {
+      return;
+    }
+    struct rte_ether_hdr* eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
+    struct rte_arp_hdr* arp = (struct rte_arp_hdr*)(eth + 1);
+    if (arp->arp_hardware != rte_cpu_to_be_16(RTE_ARP_HRD_ETHER)
+        || arp->arp_protocol != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)
+        || arp->arp_hlen != RTE_ETHER_ADDR_LEN || arp->arp_plen != sizeof(uint32_t)) {
+      return;
+    }
+    const uint32_t sip = arp->arp_data.arp_sip;
+    const uint32_t tip = arp->arp_data.arp_tip;
+    const struct rte_ether_addr sha = arp->arp_data.arp_sha;
+
+    rte_spinlock_lock(&lock_);
+    const bool forUs = localIp_ != 0 && tip == localIp_;
+    if (sip == localIp_) {
+      // Our own announcement looped back, or another host with our address
+      if (!rte_is_same_ether_addr(&sha, &localMac_)) {
+        stats_.conflicts++;
+      }
+      rte_spinlock_unlock(&lock_);
+      return;
+    }
+    // A sender of 0.0.0.0 is probing for an address (RFC 5227)
+    if (sip != 0) {
+      update(sip, sha, forUs, rte_get_timer_cycles());
+    }
+    uint16_t released = 0;
+    Held* held = sip != 0 ? findHeld(sip) : nullptr;
+    if (held) {
+      for (uint16_t i = 0; i < held->count; ++i) {
+        rte_pktmbuf_mtod(held->pkts[i], struct rte_ether_hdr*)->dst_addr = sha;
+        tx.add(held->pkts[i]);
+      }
+      released = held->count;
+      held->count = 0;
+      held->ip = 0;
+    }
+    rte_spinlock_unlock(&lock_);
+
+    if (forUs && arp->arp_opcode == rte_cpu_to_be_16(RTE_ARP_OP_REQUEST)) {
+      send(RTE_ARP_OP_REPLY, sha, sha, sip, pool, tx);
+    } else if (released > 0) {
+      tx.flush();
+    }
+  }
+
+  /**
+   * Gratuitous ARP for the local address, so neighbors learn it before we
+   * talk to them. Once per address; later calls do nothing.
+   */
+  void announce(struct rte_mempool* pool, DPDKTxBuffer& tx) {
+    rte_spinlock_lock(&lock_);
+    uint32_t ip = localIp_;
+    bool first = ip != 0 && ip != announcedIp_;
+    announcedIp_ = ip;
+    rte_spinlock_unlock(&lock_);
+    if (first) {
+      request(ip, broadcast(), pool, tx);
+    }
+  }
+
+  /** Counters; read without the lock, so only roughly current */
+  const Stats& getStats() const { return stats_; }
+
+private:
+  static const uint64_t PERMANENT = ~0ULL;
+
+  struct Entry {
+    std::atomic<uint32_t> seq;        // odd while being written
+    std::atomic<uint32_t> ip;         // 0 if free
+    std::atomic<uint64_t> mac;        // the 6 bytes of the MAC
+    std::atomic<uint64_t> confirmed;  // timer cycles, or PERMANENT
+    uint64_t requested;               // last refresh sent; under lock_
+  };
+
+  struct Held {
+    uint32_t ip;  // 0 if free
+    uint16_t count;
+    uint32_t requests;
+    uint64_t requested;
+    struct rte_mbuf* pkts[MAX_HELD];
+  };
+
+  static const struct rte_ether_addr& broadcast() {
+    static const struct rte_ether_addr mac = {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff}};
+    return mac;
+  }
+
+  static uint32_t slotOf(uint32_t ip) {
+    return (rte_be_to_cpu_32(ip) * 2654435761u) >> 22 & (SLOTS - 1);
+  }
+
+  static uint64_t pack(const struct rte_ether_addr& mac) {
+    uint64_t v = 0;
+    memcpy(&v, mac.addr_bytes, RTE_ETHER_ADDR_LEN);
+    return v;
+  }
+
+  static void unpack(uint64_t v, struct rte_ether_addr* mac) {
+    memcpy(mac->addr_bytes, &v, RTE_ETHER_ADDR_LEN);
+  }
+
+  bool find(uint32_t ip, struct rte_ether_addr* mac, uint64_t* age) const {
+    uint32_t slot = slotOf(ip);
+    for (uint32_t p = 0; p < PROBES; ++p) {
+      const Entry& e = entries_[(slot + p) & (SLOTS - 1)];
+      uint32_t seq;
+      uint32_t entryIp;
+      uint64_t packed;
+      uint64_t confirmed;
+      do {
+        seq = e.seq.load(std::memory_order_acquire);
+        entryIp = e.ip.load(std::memory_order_relaxed);
+        packed = e.mac.load(std::memory_order_relaxed);
+        confirmed = e.confirmed.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while ((seq & 1) != 0 || seq != e.seq.load(std::memory_order_relaxed));
+
+      if (entryIp == 0) {
+        return false;  // entries are replaced but never freed
+      }
+      if (entryIp == ip) {
+        *age = confirmed == PERMANENT ? 0 : rte_get_timer_cycles() - confirmed;
+        if (*age > maxAgeCycles_) {
+          return false;
+        }
+        unpack(packed, mac);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Under lock_. Sets the entry of ip, adding it if create; a full probe
+  // window gives up its oldest entry
+  void update(uint32_t ip, const struct rte_ether_addr& mac, bool create, uint64_t now) {
+    uint32_t slot = slotOf(ip);
+    Entry* target = nullptr;
+    Entry* oldest = nullptr;
+    for (uint32_t p = 0; p < PROBES; ++p) {
+      Entry& e = entries_[(slot + p) & (SLOTS - 1)];
+      uint32_t entryIp = e.ip.load(std::memory_order_relaxed);
+      if (entryIp == ip) {
+        target = &e;
+        break;
+      }
+      if (entryIp == 0) {
+        target = &e;
+        break;
+      }
+      uint64_t confirmed = e.confirmed.load(std::memory_order_relaxed);
+      if (confirmed != PERMANENT
+          && (!oldest || confirmed < oldest->confirmed.load(std::memory_order_relaxed))) {
+        oldest = &e;
+      }
+    }
+    bool known = target && target->ip.load(std::memory_order_relaxed) == ip;
+    if (!known && !create) {
+      return;
+    }
+    if (!target) {
+      target = oldest;
+      if (!target) {
+        return;  // a window of static entries
+      }
+    }
+    if (known && target->confirmed.load(std::memory_order_relaxed) == PERMANENT
+        && now != PERMANENT) {
+      return;  // ARP does not override static entries
+    }
+    uint64_t packed = pack(mac);
+    if (!known || target->mac.load(std::memory_order_relaxed) != packed) {
+      stats_.learned++;
+    }
+
+    uint32_t seq = target->seq.load(std::memory_order_relaxed);
+    target->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    target->ip.store(ip, std::memory_order_relaxed);
+    target->mac.store(packed, std::memory_order_relaxed);
+    target->confirmed.store(now, std::memory_order_relaxed);
+    target->seq.store(seq + 2, std::memory_order_release);
+    target->requested = 0;
+  }
+
+  // Asks the neighbor directly, once per retry interval
+  void refresh(uint32_t ip, const struct rte_ether_addr& mac, struct rte_mempool* pool,
+               DPDKTxBuffer& tx) {
+    uint64_t now = rte_get_timer_cycles();
+    bool ask = false;
+    rte_spinlock_lock(&lock_);
+    uint32_t slot = slotOf(ip);
+    for (uint32_t p = 0; p < PROBES; ++p) {
+      Entry& e = entries_[(slot + p) & (SLOTS - 1)];
+      if (e.ip.load(std::memory_order_relaxed) == ip) {
+        ask = now - e.requested > retryCycles_;
+        if (ask) {
+          e.requested = now;
+        }
+        break;
+      }
+    }
+    rte_spinlock_unlock(&lock_);
+    if (ask) {
+      request(ip, mac, pool, tx);
+    }
+  }
+
+  Held* findHeld(uint32_t ip) {
+    for (uint32_t i = 0; i < HELD_ADDRESSES; ++i) {
+      if (held_[i].ip == ip && (ip != 0 || held_[i].count == 0)) {
+        return &held_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void dropHeld(Held& held) {
+    for (uint16_t i = 0; i < held.count; ++i) {
+      rte_pktmbuf_free(held.pkts[i]);
+    }
+    stats_.dropped += held.count;
+    held.count = 0;
+    held.ip = 0;
+  }
+
+  void request(uint32_t ip, const struct rte_ether_addr& dst, struct rte_mempool* pool,
+               DPDKTxBuffer& tx) {
+    struct rte_ether_addr unknown;
+    memset(&unknown, 0, sizeof(unknown));
+    send(RTE_ARP_OP_REQUEST, dst, unknown, ip, pool, tx);
+    stats_.requests++;
+  }
+
+  // ARP goes out right away, along with whatever tx was holding
+  void send(uint16_t op,
+            const struct rte_ether_addr& dst,
+            const struct rte_ether_addr& tha,
+            uint32_t tip,
+            struct rte_mempool* pool,
+            DPDKTxBuffer& tx) {
+    struct rte_mbuf* m = rte_pktmbuf_alloc(pool);
+    if (!m) {
+      return;
+    }
+    char* pkt = rte_pktmbuf_append(m, sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr));
+    if (!pkt) {
+      rte_pktmbuf_free(m);
+      return;
+    }
+    struct rte_ether_hdr* eth = (struct rte_ether_hdr*)pkt;
+    struct rte_arp_hdr* arp = (struct rte_arp_hdr*)(eth + 1);
+    eth->dst_addr = dst;
+    eth->src_addr = localMac_;
+    eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+
+    arp->arp_hardware = rte_cpu_to_be_16(RTE_ARP_HRD_ETHER);
+    arp->arp_protocol = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+    arp->arp_hlen = RTE_ETHER_ADDR_LEN;
+    arp->arp_plen = sizeof(uint32_t);
+    arp->arp_opcode = rte_cpu_to_be_16(op);
+    arp->arp_data.arp_sha = localMac_;
+    arp->arp_data.arp_sip = localIp_;
+    arp->arp_data.arp_tha = tha;
+    arp->arp_data.arp_tip = tip;
+
+    tx.add(m);
+    tx.flush();
+  }
+
+  Entry entries_[SLOTS];
+  Held held_[HELD_ADDRESSES];
+  rte_spinlock_t lock_;
+  struct rte_ether_addr localMac_;
+  uint32_t localIp_;
+  uint32_t gateway_;
+  uint32_t netmask_;
+  uint32_t announcedIp_;
+  uint32_t maxAgeS_;
+  uint64_t maxAgeCycles_;
+  uint64_t retryCycles_;
+  Stats stats_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_DPDKNEIGHBORTABLE_H_
@@ -5,6 +5,9 @@
 #include <rte_ethdev.h>
 #include <rte_mempool.h>
 #include <rte_malloc.h>
+#include <memory>
+
+#include <thrift/transport/DPDKNeighborTable.h>
 
 namespace apache {
 namespace thrift {
@@ -16,12 +19,16 @@ struct DPDKResources {
     struct rte_eth_dev_info devInfo;
     struct rte_eth_conf portConf;
     void* rxQueue;
+    uint16_t nbQueues;  // RX/TX queue pairs configured on the port
     bool isInitialized;
+    std::shared_ptr<DPDKNeighborTable> neighbors;  // ARP, shared by every queue
     
     DPDKResources() 
         : portId(0)
         , mbufPool(nullptr)
-        , isInitialized(false) {
+        , nbQueues(1)
+        , isInitialized(false)
+        , neighbors(std::make_shared<DPDKNeighborTable>()) {
         memset(&devInfo, 0, sizeof(devInfo));
         memset(&portConf, 0, sizeof(portConf));
     }
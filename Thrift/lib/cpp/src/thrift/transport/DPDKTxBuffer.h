@@ -0,0 +1,193 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DPDKTxBuffer.h
+#ifndef _THRIFT_TRANSPORT_DPDKTXBUFFER_H_
+#define _THRIFT_TRANSPORT_DPDKTXBUFFER_H_ 1
+
+#include <stdint.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+
+#include <thrift/transport/DPDKChecksum.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Per-lcore TX buffer for one queue, in the spirit of rte_eth_tx_buffer:
+ * replies are queued as they are written and leave in one tx_burst.
+ *
+ * When the buffer is sent depends on the policy:
+ *
+ *   FLUSH_MESSAGE    after every message; one burst per reply (or per
+ *                    fragmented message). Lowest latency, most bursts.
+ *   FLUSH_THRESHOLD  once threshold packets are queued, or when the RX
+ *                    queue comes back empty, since there is nothing left
+ *                    to batch with.
+ *   FLUSH_DEADLINE   once the oldest queued packet has waited deadlineUs,
+ *                    or threshold packets are queued. Bounded added
+ *                    latency, even when the RX queue stays busy.
+ *   FLUSH_RX_BURST   once the RX burst being served is used up, so the
+ *                    replies to one burst leave together.
+ *
+ * A full buffer (threshold packets) is always sent. The owner reports the
+ * events through messageDone(), rxBurstDone() and rxIdle(). With a
+ * DPDKChecksum set, checksums are filled in once per burst on the way out.
+ *
+ * Not thread safe; use one per TX queue, from the lcore polling it.
+ */
+class DPDKTxBuffer {
+public:
+  enum FlushPolicy { FLUSH_MESSAGE, FLUSH_THRESHOLD, FLUSH_DEADLINE, FLUSH_RX_BURST };
+
+  static const uint16_t MAX_BURST = 64;
+  static const uint16_t DEFAULT_THRESHOLD = 32;
+  static const uint32_t DEFAULT_DEADLINE_US = 50;
+  static const int TX_RETRIES = 3;
+
+  struct Stats {
+    uint64_t packets;  // handed to the NIC
+    uint64_t dropped;  // the TX ring stayed full
+    uint64_t bursts;   // tx_burst calls that sent something
+  };
+
+  DPDKTxBuffer()
+    : portId_(0),
+      queueId_(0),
+      policy_(FLUSH_MESSAGE),
+      threshold_(DEFAULT_THRESHOLD),
+      deadlineCycles_(0),
+      oldest_(0),
+      checksum_(nullptr),
+      count_(0) {
+    stats_.packets = stats_.dropped = stats_.bursts = 0;
+  }
+
+  ~DPDKTxBuffer() { discard(); }
+
+  void setQueue(uint16_t portId, uint16_t queueId) {
+    portId_ = portId;
+    queueId_ = queueId;
+  }
+
+  /** threshold is capped at MAX_BURST; deadlineUs only matters for FLUSH_DEADLINE */
+  void setPolicy(FlushPolicy policy,
+                 uint16_t threshold = DEFAULT_THRESHOLD,
+                 uint32_t deadlineUs = DEFAULT_DEADLINE_US) {
+    policy_ = policy;
+    threshold_ = threshold == 0 ? 1 : (threshold > MAX_BURST ? MAX_BURST : threshold);
+    deadlineCycles_ = rte_get_timer_hz() / 1000000 * deadlineUs;
+  }
+
+  /** Fills in checksums before each burst; nullptr sends frames as they are */
+  void setChecksum(DPDKChecksum* checksum) { checksum_ = checksum; }
+
+  FlushPolicy getPolicy() const { return policy_; }
+  uint16_t pending() const { return count_; }
+  const Stats& getStats() const { return stats_; }
+
+  /** Queues m, which now belongs to the buffer. Returns packets dropped. */
+  uint16_t add(struct rte_mbuf* m) {
+    if (count_ == 0 && policy_ == FLUSH_DEADLINE) {
+      oldest_ = rte_get_timer_cycles();
+    }
+    pkts_[count_++] = m;
+    if (count_ >= threshold_ || expired()) {
+      return flush();
+    }
+    return 0;
+  }
+
+  /** A whole message has been queued */
+  uint16_t messageDone() { return policy_ == FLUSH_MESSAGE ? flush() : 0; }
+
+  /** The current RX burst has been served */
+  uint16_t rxBurstDone() {
+    if (policy_ == FLUSH_RX_BURST || expired()) {
+      return flush();
+    }
+    return 0;
+  }
+
+  /** An RX poll came back empty */
+  uint16_t rxIdle() {
+    if (policy_ == FLUSH_THRESHOLD || policy_ == FLUSH_RX_BURST || expired()) {
+      return flush();
+    }
+    return 0;
+  }
+
+  /** Sends everything queued. Returns packets dropped. */
+  uint16_t flush() {
+    if (count_ == 0) {
+      return 0;
+    }
+    if (checksum_) {
+      checksum_->prepareBurst(pkts_, count_);
+    }
+    uint16_t sent = 0;
+    for (int attempt = 0; attempt < TX_RETRIES && sent < count_; ++attempt) {
+      uint16_t n = rte_eth_tx_burst(portId_, queueId_, pkts_ + sent, count_ - sent);
+      if (n > 0) {
+        stats_.bursts++;
+      }
+      sent += n;
+    }
+    uint16_t dropped = count_ - sent;
+    for (uint16_t i = sent; i < count_; ++i) {
+      rte_pktmbuf_free(pkts_[i]);
+    }
+    stats_.packets += sent;
+    stats_.dropped += dropped;
+    count_ = 0;
+    return dropped;
+  }
+
+  /** Frees everything queued without sending it */
+  void discard() {
+    while (count_ > 0) {
+      rte_pktmbuf_free(pkts_[--count_]);
+    }
+  }
+
+private:
+  bool expired() const {
+    return policy_ == FLUSH_DEADLINE && count_ > 0
+           && rte_get_timer_cycles() - oldest_ >= deadlineCycles_;
+  }
+
+  uint16_t portId_;
+  uint16_t queueId_;
+  FlushPolicy policy_;
+  uint16_t threshold_;
+  uint64_t deadlineCycles_;
+  uint64_t oldest_;  // TSC when the first queued packet arrived
+  DPDKChecksum* checksum_;
+  struct rte_mbuf* pkts_[MAX_BURST];
+  uint16_t count_;
+  Stats stats_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_DPDKTXBUFFER_H_
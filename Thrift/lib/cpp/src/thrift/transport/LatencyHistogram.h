@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// LatencyHistogram.h
+#ifndef _THRIFT_TRANSPORT_LATENCYHISTOGRAM_H_
+#define _THRIFT_TRANSPORT_LATENCYHISTOGRAM_H_ 1
+
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Latency histogram with the layout of HdrHistogram: buckets double in
+ * width, each split in SUB_BUCKETS linear sub-buckets, so any value from
+ * 1 to MAX_VALUE is kept to three significant digits in a fixed 250KB.
+ * Larger values are counted as MAX_VALUE.
+ *
+ * Values are nanoseconds as recorded; print() writes the percentile
+ * distribution in the .hgrm text format HdrHistogram's plotting tools
+ * read, scaled to the unit asked for.
+ *
+ * Not thread safe; give each thread its own and add() them up.
+ */
+class LatencyHistogram {
+public:
+  enum : uint64_t { MAX_VALUE = (1ULL << 40) - 1 };  // about 18 minutes in ns
+
+  LatencyHistogram() : counts_(BUCKETS * SUB_BUCKETS / 2 + SUB_BUCKETS / 2, 0) { reset(); }
+
+  void reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    sum_ = 0;
+    sumSquares_ = 0;
+  }
+
+  void record(uint64_t value) {
+    if (value > MAX_VALUE) {
+      value = MAX_VALUE;
+    }
+    counts_[indexOf(value)]++;
+    total_++;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value);
+    sumSquares_ += static_cast<double>(value) * value;
+  }
+
+  void add(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    sumSquares_ += other.sumSquares_;
+  }
+
+  uint64_t count() const { return total_; }
+  uint64_t min() const { return total_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? sum_ / total_ : 0.0; }
+
+  double stddev() const {
+    if (!total_) {
+      return 0.0;
+    }
+    double m = mean();
+    return sqrt(std::max(0.0, sumSquares_ / total_ - m * m));
+  }
+
+  /** Largest value of the bucket the given percentile (0 to 100) falls in */
+  uint64_t percentile(double p) const {
+    if (!total_) {
+      return 0;
+    }
+    p = std::min(std::max(p, 0.0), 100.0);
+    uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(ceil(p / 100.0 * total_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= wanted) {
+        return std::min(highestEquivalent(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  /**
+   * Writes the percentile distribution, ticksPerHalf lines for each halving
+   * of the distance to 100%, in values divided by unitScale (1000 for us).
+   */
+  void print(std::ostream& out, double unitScale = 1000.0, int ticksPerHalf = 5) const {
+    char line[128];
+    out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+    if (total_) {
+      double p = 0.0;
+      for (;;) {
+        uint64_t value = percentile(p);
+        uint64_t below = countAtOrBelow(value);
+        double reached = 100.0 * below / total_;
+        if (reached >= 100.0) {
+          snprintf(line, sizeof(line), "%12.3f %14.12f %10llu\n", value / unitScale, 1.0,
+                   (unsigned long long)below);
+          out << line;
+          break;
+        }
+        snprintf(line, sizeof(line), "%12.3f %14.12f %10llu %14.2f\n", value / unitScale,
+                 p / 100.0, (unsigned long long)below, 1.0 / (1.0 - p / 100.0));
+        out << line;
+        // Halve the step each time the remaining distance halves
+        double halvings = floor(log2(100.0 / (100.0 - p)));
+        p += 100.0 / (ticksPerHalf * pow(2.0, halvings + 1));
+      }
+    }
+    snprintf(line, sizeof(line), "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n",
+             mean() / unitScale, stddev() / unitScale);
+    out << line;
+    snprintf(line, sizeof(line), "#[Max     = %12.3f, Total count    = %12llu]\n",
+             max_ / unitScale, (unsigned long long)total_);
+    out << line;
+    snprintf(line, sizeof(line), "#[Buckets = %12d, SubBuckets     = %12d]\n", (int)BUCKETS,
+             (int)SUB_BUCKETS);
+    out << line;
+  }
+
+private:
+  // 2048 sub-buckets keep 3 significant digits; 30 buckets reach 2^40
+  enum { SUB_BUCKET_BITS = 11, SUB_BUCKETS = 1 << SUB_BUCKET_BITS, BUCKETS = 30 };
+
+  // Bucket b holds [2^(b+10), 2^(b+11)) in its upper half, in steps of
+  // 2^b; bucket 0 also holds [0, 1024) in its lower half
+  static size_t indexOf(uint64_t value) {
+    int bucket = 63 - __builtin_clzll(value | (SUB_BUCKETS - 1)) - (SUB_BUCKET_BITS - 1);
+    size_t sub = static_cast<size_t>(value >> bucket);
+    return (static_cast<size_t>(bucket) << (SUB_BUCKET_BITS - 1)) + sub;
+  }
+
+  static uint64_t highestEquivalent(size_t index) {
+    size_t half = SUB_BUCKETS / 2;
+    int bucket = index < SUB_BUCKETS ? 0 : static_cast<int>(index / half) - 1;
+    uint64_t sub = index - (static_cast<size_t>(bucket) << (SUB_BUCKET_BITS - 1));
+    return ((sub + 1) << bucket) - 1;
+  }
+
+  uint64_t countAtOrBelow(uint64_t value) const {
+    if (value > MAX_VALUE) {
+      value = MAX_VALUE;
+    }
+    size_t last = indexOf(value);
+    uint64_t seen = 0;
+    for (size_t i = 0; i <= last; ++i) {
+      seen += counts_[i];
+    }
+    return seen;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_;
+  uint64_t min_;
+  uint64_t max_;
+  double sum_;
+  double sumSquares_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_LATENCYHISTOGRAM_H_
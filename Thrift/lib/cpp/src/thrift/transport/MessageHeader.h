@@ -0,0 +1,126 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// MessageHeader.h
+#ifndef _THRIFT_TRANSPORT_MESSAGEHEADER_H_
+#define _THRIFT_TRANSPORT_MESSAGEHEADER_H_ 1
+
+#include <stdint.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * The method name and seqid of a serialized Thrift message, read without
+ * a protocol or transport: binary (strict or old) or compact, framed by
+ * TFramedTransport or not. Used where only bytes are at hand, packet
+ * traces and the packets themselves.
+ */
+struct MessageHeader {
+  const char* method;  // in the message, not terminated
+  uint32_t methodLen;
+  int32_t seqid;
+  uint32_t body;       // offset of the message struct
+  bool binary;         // binary protocol
+
+  // False if data does not start with a whole message header
+  static bool parse(const uint8_t* data, uint32_t size, MessageHeader& h) {
+    const uint8_t* p = data;
+    uint32_t pos = 0;
+    h.method = nullptr;
+    h.methodLen = 0;
+    h.seqid = -1;
+    h.binary = false;
+    // TFramedTransport's length, when it covers the rest exactly
+    if (size >= 5 && readBE32(p) == size - 4 && (p[4] == 0x80 || p[4] == 0x82)) {
+      pos = 4;
+    }
+    if (pos + 1 > size) {
+      return false;
+    }
+    if (p[pos] == 0x82) {
+      // Compact: id, version and type, varint seqid, varint name length
+      uint32_t seqid, len;
+      pos += 2;
+      if (pos > size || !readVarint(p, size, pos, seqid) || !readVarint(p, size, pos, len)
+          || pos + len > size) {
+        return false;
+      }
+      h.method = reinterpret_cast<const char*>(p + pos);
+      h.methodLen = len;
+      h.seqid = static_cast<int32_t>(seqid);
+      h.body = pos + len;
+      return true;
+    }
+    if (pos + 4 > size) {
+      return false;
+    }
+    uint32_t word = readBE32(p + pos);
+    uint32_t len;
+    if ((word & 0xffff0000) == 0x80010000) {
+      // Strict binary: version and type, name, seqid
+      if (pos + 8 > size) {
+        return false;
+      }
+      len = readBE32(p + pos + 4);
+      pos += 8;
+    } else {
+      // Old binary: name, type, seqid
+      len = word;
+      pos += 4;
+    }
+    if (len > size || pos + len > size) {
+      return false;
+    }
+    h.method = reinterpret_cast<const char*>(p + pos);
+    h.methodLen = len;
+    pos += len;
+    if ((word & 0xffff0000) != 0x80010000) {
+      pos += 1;
+    }
+    if (pos + 4 > size) {
+      return false;
+    }
+    h.seqid = static_cast<int32_t>(readBE32(p + pos));
+    h.body = pos + 4;
+    h.binary = true;
+    return true;
+  }
+
+  static uint32_t readBE32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+  }
+
+  static bool readVarint(const uint8_t* p, uint32_t size, uint32_t& pos, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < size; shift += 7) {
+      uint8_t b = p[pos++];
+      value |= uint32_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_MESSAGEHEADER_H_
@@ -0,0 +1,575 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// PacketLogEngine.h
+#ifndef _THRIFT_TRANSPORT_PACKETLOGENGINE_H_
+#define _THRIFT_TRANSPORT_PACKETLOGENGINE_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <thrift/TOutput.h>
+#include <thrift/transport/BlockTrace.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Asynchronous back end of the packet loggers.
+ *
+ * Each logging thread appends to a ring of its own, one per engine it logs
+ * to: the TSC, the stream (file) the record belongs to, and the bytes to
+ * write after the timestamp, at most MAX_RECORD_BYTES. Nothing is shared
+ * between logging threads and nothing blocks; when a ring is full the
+ * record is dropped and counted.
+ *
+ * A background thread drains the rings, orders each batch by timestamp,
+ * turns the TSC into system_clock nanoseconds and has the stream's encoder
+ * append the record to a buffer, which goes out in large writes. Records
+ * of different threads are in order within a batch; one preempted between
+ * reading the TSC and publishing can land in the next.
+ *
+ * A stream goes to a plain file, or with openCompressed() to a block
+ * trace compressed on the writer thread (see BlockTrace). Streams are
+ * opened before start(), which takes CALIBRATE_MS to get a first TSC
+ * rate. stop() writes out everything logged before it and closes the
+ * files; the destructor stops.
+ */
+class PacketLogEngine {
+public:
+  static const uint32_t MAX_STREAMS = 8;
+  static const uint32_t DEFAULT_RING_BYTES = 1u << 20;  // per logging thread, power of two
+  static const size_t WRITE_BYTES = 256 * 1024;         // buffered per file before a write
+  static const uint32_t MAX_RECORD_BYTES = 0xffffff;     // header and data of one record
+  enum {
+    IDLE_WAIT_MS = 1,  // writer's nap when the rings are empty
+    CALIBRATE_MS = 10  // start() measures the TSC rate over this long
+  };
+
+  /** Appends one record to out; ns is system_clock time since the epoch */
+  typedef void (*Encoder)(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len);
+
+  struct Stats {
+    uint64_t records;  // written out
+    uint64_t dropped;  // a logging thread's ring was full
+    uint64_t writes;   // file writes
+    uint64_t rings;    // of logging threads, held by the engine
+  };
+
+  explicit PacketLogEngine(uint32_t ringBytes = DEFAULT_RING_BYTES)
+    : id_(nextId()),
+      ringBytes_(roundUp(ringBytes)),
+      running_(false),
+      stopping_(false),
+      records_(0),
+      writes_(0),
+      retiredDropped_(0),
+      tsc0_(0),
+      ns0_(0),
+      tscAnchor_(0),
+      nsAnchor_(0),
+      nsPerTick_(1.0) {
+    for (uint32_t i = 0; i < MAX_STREAMS; ++i) {
+      open_[i].store(false, std::memory_order_relaxed);
+      encoders_[i] = nullptr;
+      bufferedRecords_[i] = 0;
+    }
+  }
+
+  ~PacketLogEngine() {
+    stop();
+    // The logging threads forget these the next time they attach a ring
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (size_t i = 0; i < rings_.size(); ++i) {
+      rings_[i]->orphaned.store(true, std::memory_order_release);
+    }
+  }
+
+  /**
+   * Opens path for stream and writes preamble to it, e.g. a CSV header.
+   * Only while stopped.
+   */
+  bool open(uint8_t stream,
+            const std::string& path,
+            bool binary,
+            Encoder encoder,
+            const std::string& preamble = std::string()) {
+    if (stream >= MAX_STREAMS || running_.load()) {
+      return false;
+    }
+    files_[stream].reset(new std::ofstream(
+        path, binary ? (std::ios::out | std::ios::binary) : std::ios::out));
+    if (!files_[stream]->is_open()) {
+      files_[stream].reset();
+      return false;
+    }
+    files_[stream]->write(preamble.data(), preamble.size());
+    blocks_[stream].reset();
+    encoders_[stream] = encoder;
+    buffers_[stream].reserve(WRITE_BYTES * 2);
+    bufferedRecords_[stream] = 0;
+    open_[stream].store(true, std::memory_order_release);
+    return true;
+  }
+
+  /** Opens path for stream as a block trace. Only while stopped. */
+  bool openCompressed(uint8_t stream, const std::string& path, Encoder encoder) {
+    if (stream >= MAX_STREAMS || running_.load()) {
+      return false;
+    }
+    try {
+      blocks_[stream].reset(new BlockTraceWriter(path));
+    } catch (const TTransportException& e) {
+      GlobalOutput.printf("PacketLogEngine: %s", e.what());
+      return false;
+    }
+    files_[stream].reset();
+    encoders_[stream] = encoder;
+    buffers_[stream].reserve(WRITE_BYTES * 2);
+    bufferedRecords_[stream] = 0;
+    open_[stream].store(true, std::memory_order_release);
+    return true;
+  }
+
+  void start() {
+    if (running_.load()) {
+      return;
+    }
+    // A first TSC rate before anything is logged; the writer refines it
+    tsc0_ = ticks();
+    ns0_ = wallNs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATE_MS));
+    calibrate();
+    stopping_ = false;
+    running_.store(true);
+    writer_ = std::thread(&PacketLogEngine::run, this);
+  }
+
+  /** Writes out what was logged so far and closes the streams */
+  void stop() {
+    if (!running_.exchange(false)) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    for (uint32_t i = 0; i < MAX_STREAMS; ++i) {
+      open_[i].store(false, std::memory_order_relaxed);
+      if (files_[i]) {
+        files_[i]->close();
+        files_[i].reset();
+      }
+      if (blocks_[i]) {
+        try {
+          blocks_[i]->close();
+        } catch (const TTransportException& e) {
+          GlobalOutput.printf("PacketLogEngine: %s", e.what());
+        }
+        blocks_[i].reset();
+      }
+    }
+  }
+
+  bool isOpen(uint8_t stream) const {
+    return stream < MAX_STREAMS && open_[stream].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Hot path: queues header and data, in that order, as one record of
+   * stream. False if the stream is closed or the ring is full.
+   */
+  bool log(uint8_t stream, const void* header, uint32_t headerLen, const void* data, uint32_t dataLen) {
+    if (!isOpen(stream) || !running_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    uint64_t tsc = ticks();
+    Ring* ring = threadRing();
+    return ring->append(stream, tsc, header, headerLen, data, dataLen);
+  }
+
+  Stats getStats() const {
+    Stats stats;
+    stats.records = records_.load(std::memory_order_relaxed);
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    stats.dropped = retiredDropped_;
+    stats.rings = rings_.size();
+    for (size_t i = 0; i < rings_.size(); ++i) {
+      stats.dropped += rings_[i]->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
+  /** Encoder: nanosecond timestamp, then the record as logged */
+  static void timestampNs(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len) {
+    out.append(reinterpret_cast<const char*>(&ns), sizeof(ns));
+    out.append(reinterpret_cast<const char*>(rec), len);
+  }
+
+  /** Encoder: microsecond timestamp, then the record as logged */
+  static void timestampUs(std::string& out, uint64_t ns, const uint8_t* rec, uint32_t len) {
+    timestampNs(out, ns / 1000, rec, len);
+  }
+
+private:
+  struct RecordHeader {
+    uint64_t tsc;
+    uint32_t size;  // whole record with padding, a multiple of ALIGN
+    uint32_t meta;  // bytes | stream << 24, so bytes <= MAX_RECORD_BYTES
+  };
+
+  static const uint32_t ALIGN = sizeof(RecordHeader);
+  static const uint8_t PAD = 0xff;  // filler up to the end of the ring
+
+  // Single producer (the logging thread), single consumer (the writer)
+  struct Ring {
+    explicit Ring(uint32_t bytes)
+      : tail(0), cachedHead(0), head(0), dropped(0), retired(false), orphaned(false),
+        mask(bytes - 1), buf(new uint8_t[bytes]) {}
+
+    bool append(uint8_t stream, uint64_t tsc, const void* header, uint32_t headerLen,
+                const void* data, uint32_t dataLen) {
+      uint64_t bytes = static_cast<uint64_t>(headerLen) + dataLen;
+      uint64_t need = (sizeof(RecordHeader) + bytes + ALIGN - 1) & ~static_cast<uint64_t>(ALIGN - 1);
+      uint64_t capacity = mask + 1;
+      if (bytes > MAX_RECORD_BYTES || need > capacity / 2) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+      }
+      uint64_t t = tail.load(std::memory_order_relaxed);
+      uint64_t offset = t & mask;
+      uint64_t pad = offset + need > capacity ? capacity - offset : 0;
+      if (t + pad + need - cachedHead > capacity) {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (t + pad + need - cachedHead > capacity) {
+          dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+          return false;
+        }
+      }
+      if (pad > 0) {
+        RecordHeader* filler = reinterpret_cast<RecordHeader*>(buf.get() + offset);
+        filler->size = static_cast<uint32_t>(pad);
+        filler->meta = static_cast<uint32_t>(PAD) << 24;
+        t += pad;
+        offset = 0;
+      }
+      RecordHeader* rec = reinterpret_cast<RecordHeader*>(buf.get() + offset);
+      rec->tsc = tsc;
+      rec->size = static_cast<uint32_t>(need);
+      rec->meta = static_cast<uint32_t>(bytes) | (static_cast<uint32_t>(stream) << 24);
+      uint8_t* body = reinterpret_cast<uint8_t*>(rec + 1);
+      if (headerLen > 0) {
+        memcpy(body, header, headerLen);
+      }
+      if (dataLen > 0) {
+        memcpy(body + headerLen, data, dataLen);
+      }
+      tail.store(t + need, std::memory_order_release);
+      return true;
+    }
+
+    const RecordHeader* at(uint64_t pos) const {
+      return reinterpret_cast<const RecordHeader*>(buf.get() + (pos & mask));
+    }
+
+    // Producer's line
+    alignas(64) std::atomic<uint64_t> tail;
+    uint64_t cachedHead;
+    // Writer's line
+    alignas(64) std::atomic<uint64_t> head;
+    // Rarely written
+    alignas(64) std::atomic<uint64_t> dropped;
+    std::atomic<bool> retired;   // the logging thread has exited
+    std::atomic<bool> orphaned;  // the engine is gone
+    uint64_t mask;
+    std::unique_ptr<uint8_t[]> buf;
+  };
+
+  // The calling thread's rings, one per engine; retired when the thread
+  // exits
+  struct ThreadRing {
+    uint64_t engine;
+    std::shared_ptr<Ring> ring;
+  };
+
+  struct ThreadRings {
+    ~ThreadRings() {
+      for (size_t i = 0; i < rings.size(); ++i) {
+        rings[i].ring->retired.store(true, std::memory_order_release);
+      }
+    }
+    std::vector<ThreadRing> rings;
+  };
+
+  struct Pending {
+    uint64_t tsc;
+    const RecordHeader* rec;
+    bool operator<(const Pending& other) const { return tsc < other.tsc; }
+  };
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> ids(0);
+    return ++ids;
+  }
+
+  static uint32_t roundUp(uint32_t bytes) {
+    uint32_t size = 4096;
+    while (size < bytes && size < (1u << 30)) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  static uint64_t wallNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  Ring* threadRing() {
+    static thread_local ThreadRings local;
+    for (size_t i = 0; i < local.rings.size(); ++i) {
+      if (local.rings[i].engine == id_) {
+        return local.rings[i].ring.get();
+      }
+    }
+    return attach(local);
+  }
+
+  Ring* attach(ThreadRings& local) {
+    for (size_t i = 0; i < local.rings.size();) {
+      if (local.rings[i].ring->orphaned.load(std::memory_order_acquire)) {
+        local.rings[i] = local.rings.back();
+        local.rings.pop_back();
+      } else {
+        ++i;
+      }
+    }
+    ThreadRing entry = {id_, std::make_shared<Ring>(ringBytes_)};
+    local.rings.push_back(entry);
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    rings_.push_back(entry.ring);
+    return entry.ring.get();
+  }
+
+  // Anchors the TSC to the wall clock; the rate comes from the longest
+  // baseline so far, so it only gets better
+  void calibrate() {
+    uint64_t tsc = ticks();
+    uint64_t ns = wallNs();
+    if (tsc > tsc0_ && ns > ns0_) {
+      nsPerTick_ = static_cast<double>(ns - ns0_) / static_cast<double>(tsc - tsc0_);
+    }
+    tscAnchor_ = tsc;
+    nsAnchor_ = ns;
+  }
+
+  uint64_t toNs(uint64_t tsc) const {
+    double delta = static_cast<double>(static_cast<int64_t>(tsc - tscAnchor_)) * nsPerTick_;
+    return nsAnchor_ + static_cast<int64_t>(delta);
+  }
+
+  void run() {
+    std::chrono::steady_clock::time_point lastCalibration = std::chrono::steady_clock::now();
+
+    for (;;) {
+      bool stopping;
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping = stopping_;
+      }
+      size_t drained = drain();
+      if (std::chrono::steady_clock::now() - lastCalibration > std::chrono::seconds(1)) {
+        calibrate();
+        lastCalibration = std::chrono::steady_clock::now();
+      }
+      // Write when a file has enough for a large write, or there is
+      // nothing else to do
+      writeOut(drained == 0 || stopping);
+      if (stopping) {
+        // Everything logged before stop() is in the rings by now
+        if (drained == 0) {
+          return;
+        }
+        continue;
+      }
+      if (drained == 0) {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS), [this] { return stopping_; });
+      }
+    }
+  }
+
+  // Encodes what the rings hold, in timestamp order. Returns records.
+  size_t drain() {
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex_);
+      snapshot_ = rings_;
+    }
+    pending_.clear();
+    ends_.resize(snapshot_.size());
+    for (size_t i = 0; i < snapshot_.size(); ++i) {
+      Ring& ring = *snapshot_[i];
+      uint64_t pos = ring.head.load(std::memory_order_relaxed);
+      uint64_t tail = ring.tail.load(std::memory_order_acquire);
+      while (pos != tail) {
+        const RecordHeader* rec = ring.at(pos);
+        if ((rec->meta >> 24) != PAD) {
+          Pending p = {rec->tsc, rec};
+          pending_.push_back(p);
+        }
+        pos += rec->size;
+      }
+      ends_[i] = pos;
+    }
+
+    std::stable_sort(pending_.begin(), pending_.end());
+    for (size_t i = 0; i < pending_.size(); ++i) {
+      const RecordHeader* rec = pending_[i].rec;
+      uint8_t stream = static_cast<uint8_t>(rec->meta >> 24);
+      if (stream < MAX_STREAMS && encoders_[stream]) {
+        encoders_[stream](buffers_[stream], toNs(rec->tsc),
+                          reinterpret_cast<const uint8_t*>(rec + 1), rec->meta & 0xffffff);
+        bufferedRecords_[stream]++;
+      }
+    }
+    records_.fetch_add(pending_.size(), std::memory_order_relaxed);
+
+    bool retired = false;
+    for (size_t i = 0; i < snapshot_.size(); ++i) {
+      snapshot_[i]->head.store(ends_[i], std::memory_order_release);
+      retired = retired || snapshot_[i]->retired.load(std::memory_order_acquire);
+    }
+    if (retired) {
+      reap();
+    }
+    snapshot_.clear();
+    return pending_.size();
+  }
+
+  // Forgets the rings of exited threads once they are empty
+  void reap() {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (size_t i = 0; i < rings_.size();) {
+      Ring& ring = *rings_[i];
+      if (ring.retired.load(std::memory_order_acquire)
+          && ring.head.load(std::memory_order_relaxed) == ring.tail.load(std::memory_order_acquire)) {
+        retiredDropped_ += ring.dropped.load(std::memory_order_relaxed);
+        rings_[i] = rings_.back();
+        rings_.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void writeOut(bool all) {
+    for (uint32_t i = 0; i < MAX_STREAMS; ++i) {
+      std::string& buffer = buffers_[i];
+      if (!files_[i] && !blocks_[i]) {
+        buffer.clear();  // a stream given up on
+        continue;
+      }
+      if (buffer.empty() || (!all && buffer.size() < WRITE_BYTES)) {
+        continue;
+      }
+      if (blocks_[i]) {
+        // Whole records only, so that blocks are cut between them
+        try {
+          blocks_[i]->append(buffer.data(), buffer.size(), bufferedRecords_[i]);
+        } catch (const TTransportException& e) {
+          GlobalOutput.printf("PacketLogEngine: %s", e.what());
+          open_[i].store(false, std::memory_order_relaxed);
+          blocks_[i].reset();
+        }
+      } else {
+        files_[i]->write(buffer.data(), buffer.size());
+        files_[i]->flush();
+      }
+      buffer.clear();
+      bufferedRecords_[i] = 0;
+      writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  const uint64_t id_;
+  const uint32_t ringBytes_;
+  std::atomic<bool> running_;
+
+  // Streams; written by the writer thread once started
+  std::atomic<bool> open_[MAX_STREAMS];
+  std::unique_ptr<std::ofstream> files_[MAX_STREAMS];
+  std::unique_ptr<BlockTraceWriter> blocks_[MAX_STREAMS];
+  Encoder encoders_[MAX_STREAMS];
+  std::string buffers_[MAX_STREAMS];
+  uint32_t bufferedRecords_[MAX_STREAMS];
+
+  // Rings of the logging threads
+  mutable std::mutex ringsMutex_;
+  std::vector<std::shared_ptr<Ring> > rings_;
+  std::vector<std::shared_ptr<Ring> > snapshot_;
+  std::vector<uint64_t> ends_;
+  std::vector<Pending> pending_;
+
+  std::thread writer_;
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+  bool stopping_;
+
+  std::atomic<uint64_t> records_;
+  std::atomic<uint64_t> writes_;
+  uint64_t retiredDropped_;
+
+  // TSC to wall clock, owned by the writer thread
+  uint64_t tsc0_;
+  uint64_t ns0_;
+  uint64_t tscAnchor_;
+  uint64_t nsAnchor_;
+  double nsPerTick_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_PACKETLOGENGINE_H_
@@ -1,265 +1,783 @@
 #ifndef PACKET_REPLAY_SOCKET_H
 #define PACKET_REPLAY_SOCKET_H
 
+#include <algorithm>
 #include <vector>
+#include <string>
 #include <cstdint>
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
-
-template <typename T, std::size_t Alignment>
-struct aligned_allocator {
-    using value_type = T;
-
-    T* allocate(std::size_t n) {
-        void* ptr;
-        if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) {
-            throw std::bad_alloc();
-        }
-        return static_cast<T*>(ptr);
-    }
-
-    void deallocate(T* p, std::size_t n) {
-        std::free(p);
-    }
-
-    using pointer = T*;
-    using const_pointer = const T*;
-    using reference = T&;
-    using const_reference = const T&;
-    using size_type = std::size_t;
-    using difference_type = std::ptrdiff_t;
-
-    template <typename U>
-    struct rebind {
-        using other = aligned_allocator<U, Alignment>;
-    };
-};
-
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thrift/TOutput.h>
+#include <thrift/transport/BlockTrace.h>
+#include <thrift/transport/ReplayValidator.h>
+#include <thrift/transport/TUDPFragment.h>
+
+// Replays a dpdk_to_rpc.bin trace in place of the network and collects
+// the responses.
+//
+// Requests are handed out as [u64 timestamp][u16 size][data] records, each
+// starting on a 64 byte boundary, which is what the engine reads at
+// getRecvBufferAddr(). The first loadTrace() of a trace lays its records
+// out that way in <trace>.idx; later runs map that file and read it where
+// it lies, so the trace is never copied into memory and its size is not
+// bounded. The .idx is rebuilt when the trace's size or mtime change.
+// It also keeps the flow of each record, from its req_id, after the
+// records.
+//
+// Several sockets can replay one trace at once: shareTrace() gives a
+// socket a shard of a trace another socket has loaded, as a list of its
+// records in the same mapping, so a replay can be spread over as many
+// threads as there are sockets, each writing its own responses.
+//
+// A compressed trace (see BlockTrace) gets no .idx: a helper thread
+// decompresses it a block at a time, up to BLOCKS_AHEAD blocks ahead of
+// the replay, into buffers laid out the same way. The block before the
+// one being read is kept too, so that the record last handed out stays
+// where it is until the next advanceReadPos().
+//
+// Responses are written in the same layout to <trace>.resp.0, .1, ...,
+// each mapped RESP_SEGMENT_BYTES at a time and trimmed once full.
 class PacketReplaySocket {
 private:
-    static constexpr size_t FIXED_BUFFER_SIZE = 64 * 1024 * 1024; // 64MB
+    static constexpr size_t RECORD_HEADER = sizeof(uint64_t) + sizeof(uint16_t);
+    // Largest record, so that a response always fits where it is written
+    static constexpr size_t MAX_RECORD = (RECORD_HEADER + UINT16_MAX + 63) & ~size_t(63);
+    static constexpr size_t RESP_SEGMENT_BYTES = 64 * 1024 * 1024;
+    // Read ahead of and dropped behind the replay position
+    static constexpr size_t ADVISE_WINDOW = 8 * 1024 * 1024;
+    static constexpr uint64_t INDEX_MAGIC = 0x3230584449535250ULL; // "PRSIDX02"
+    static constexpr size_t BLOCKS_AHEAD = 2;
+    static constexpr size_t SLOTS = BLOCKS_AHEAD + 2;
+
+    // Leads the .idx file; the records follow, 64 byte aligned, then the
+    // u32 flow of each record
+    struct IndexHeader {
+        uint64_t magic;
+        uint64_t trace_size;
+        int64_t trace_mtime_sec;
+        int64_t trace_mtime_nsec;
+        uint64_t records;
+        uint64_t data_size;
+        uint8_t pad[16];
+    };
+    static_assert(sizeof(IndexHeader) == 64, "records must start 64 byte aligned");
+
+    // Record header of dpdk_to_rpc.bin as PacketLogger writes it
+    struct BasicHeader {
+        uint64_t timestamp;
+        int64_t req_id;
+        uint16_t size;
+    } __attribute__((packed));
+
+    // A response segment that is no longer written. Anonymous segments,
+    // used when the file could not be created, stay mapped at base.
+    struct RespSegment {
+        std::string path;
+        uint8_t* base;
+        size_t size;
+    };
 
-    uint8_t* raw_recv_buf_;
-    uint8_t* raw_resp_buf_;
-    uint8_t* recv_buf_;    // Fixed aligned buffer
-    uint8_t* resp_buf_;    // Fixed aligned buffer
+    // A decompressed block, laid out for replay
+    struct Slot {
+        uint8_t* buf;
+        size_t capacity;
+        size_t size;
+        uint64_t records;
+        size_t block;
+        bool ready;
+    };
 
-    size_t recv_data_size_;
-    size_t resp_data_size_;
+    uint8_t* index_{nullptr};    // mapped .idx, header included
+    size_t index_size_{0};
+    bool index_is_file_{false};
+    size_t advised_window_{0};
+
+    uint8_t* recv_buf_{nullptr}; // first record
+    size_t recv_data_size_{0};
     size_t read_pos_{0};
-    size_t write_pos_{0};
+    uint64_t records_left_{0};
     bool eof_reached_{false};
+    const uint32_t* flows_{nullptr};
+    uint64_t trace_records_{0};  // loaded, max_requests applied
+
+    // A shard of another socket's trace: where its records are, in units
+    // of 64 bytes from recv_buf_
+    bool sharded_{false};
+    std::vector<uint32_t> shard_records_;
+    size_t shard_next_{0};
+
+    // Compressed traces
+    std::unique_ptr<apache::thrift::transport::BlockTraceReader> blocks_;
+    Slot slots_[SLOTS] = {};
+    std::thread inflater_;
+    std::mutex slot_mutex_;
+    std::condition_variable slot_cv_;
+    size_t block_{0};            // being read
+    uint64_t block_records_left_{0};
+    bool stop_inflating_{false};
+    std::string inflate_error_;
+
+    std::string resp_prefix_;
+    std::vector<RespSegment> resp_done_;
+    std::string resp_path_;
+    uint8_t* resp_buf_{nullptr}; // segment being written
+    int resp_fd_{-1};
+    size_t write_pos_{0};
+    size_t resp_done_size_{0};
+
+    // Messages captured as several fragments are rebuilt here and handed
+    // out by read() over as many calls as the caller needs
+    apache::thrift::transport::TUDPReassembler reassembler_;
+    std::vector<uint8_t> message_;
+    size_t message_pos_{0};
 
 public:
-    PacketReplaySocket() {
-        raw_recv_buf_ = new uint8_t[FIXED_BUFFER_SIZE + 64];
-        raw_resp_buf_ = new uint8_t[FIXED_BUFFER_SIZE + 64];
-        recv_buf_ = allocateAligned(raw_recv_buf_);
-        resp_buf_ = allocateAligned(raw_resp_buf_);
-        recv_data_size_ = 0;
-        resp_data_size_ = 0;
-    }
+    enum ShardBy {
+        SHARD_BY_FLOW,        // every record of a flow to the same shard
+        SHARD_ROUND_ROBIN     // request by request
+    };
+
+    PacketReplaySocket() {}
 
     ~PacketReplaySocket() {
-        delete[] raw_recv_buf_;
-        delete[] raw_resp_buf_;
+        unmapTrace();
+        for (size_t i = 0; i < SLOTS; i++) {
+            free(slots_[i].buf);
+        }
+        closeRespSegment();
+        for (size_t i = 0; i < resp_done_.size(); i++) {
+            if (resp_done_[i].base) {
+                munmap(resp_done_[i].base, RESP_SEGMENT_BYTES);
+            }
+        }
     }
 
+    PacketReplaySocket(const PacketReplaySocket&) = delete;
+    PacketReplaySocket& operator=(const PacketReplaySocket&) = delete;
+
     uint8_t* getRecvBufferAddr() const { return recv_buf_ + read_pos_; }
-    uint8_t* getRespBufferAddr() const { return resp_buf_ + write_pos_; }
+    uint8_t* getRespBufferAddr() {
+        ensureRespRoom();
+        return resp_buf_ + write_pos_;
+    }
     size_t getRecvDataSize() const { return recv_data_size_; }
-    size_t getRespDataSize() const { return resp_data_size_; }
-    
+    size_t getRespDataSize() const { return resp_done_size_ + write_pos_; }
+
     uint16_t getCurrentPacketSize() const {
-        if (read_pos_ + sizeof(uint64_t) + sizeof(uint16_t) > recv_data_size_) return 0;
+        if (records_left_ == 0) return 0;
         uint16_t pkt_size = *reinterpret_cast<const uint16_t*>(recv_buf_ + read_pos_ + sizeof(uint64_t));
-        return sizeof(uint64_t) + sizeof(uint16_t) + pkt_size; // timestamp + req_id (not included, see convertToAlignedFormat) + size + hex_data
+        return RECORD_HEADER + pkt_size; // timestamp + size + data (req_id is dropped by the index)
+    }
+
+    // Capture time of the next request, in ns; 0 once the trace is done
+    uint64_t getCurrentPacketTimestamp() const {
+        if (records_left_ == 0) return 0;
+        uint64_t timestamp;
+        std::memcpy(&timestamp, recv_buf_ + read_pos_, sizeof(timestamp));
+        return timestamp;
     }
 
     void advanceReadPos() {
-        if (read_pos_ + sizeof(uint64_t) + sizeof(uint16_t) <= recv_data_size_) {
+        if (sharded_) {
+            if (records_left_ > 0 && --records_left_ > 0) {
+                read_pos_ = size_t(shard_records_[++shard_next_]) << 6;
+            }
+        } else if (records_left_ > 0) {
             uint16_t pkt_size = *reinterpret_cast<const uint16_t*>(recv_buf_ + read_pos_ + sizeof(uint64_t));
-            read_pos_ += sizeof(uint64_t) + sizeof(uint16_t) + pkt_size;
-            read_pos_ = (read_pos_ + 63) & ~63;  // 64-byte align
+            read_pos_ += RECORD_HEADER + pkt_size;
+            read_pos_ = (read_pos_ + 63) & ~size_t(63);  // 64-byte align
+            records_left_--;
+            if (!blocks_) {
+                adviseTrace();
+            } else if (--block_records_left_ == 0 && records_left_ > 0) {
+                enterBlock(block_ + 1);
+            }
         }
 
-        // Check if EOF reached
-        if (read_pos_ >= recv_data_size_) {
+        if (records_left_ == 0) {
             eof_reached_ = true;
-            //std::cout << "End of replay file reached. Set EOF flag.\n";
-        } 
+        }
     }
 
     void advanceWritePos(uint16_t data_size) {
-        size_t total_size = sizeof(uint64_t) + sizeof(uint16_t) + data_size;
-        
-        write_pos_ += total_size;
-        write_pos_ = (write_pos_ + 63) & ~63;  // 64-byte align
-        resp_data_size_ = write_pos_;
-
-        if (write_pos_ + total_size > FIXED_BUFFER_SIZE) {
-            std::cerr << "Response buffer overflow!" << std::endl;
-        }
+        write_pos_ += RECORD_HEADER + data_size;
+        write_pos_ = (write_pos_ + 63) & ~size_t(63);  // 64-byte align
+        ensureRespRoom();
     }
 
-    //void loadTrace(const std::string& filename) {
+    // Responses go to <prefix>.0, .1, ...; by default <trace>.resp
+    void setResponseFile(const std::string& prefix) { resp_prefix_ = prefix; }
+
     void loadTrace(const std::string& filename, int max_requests = -1) {
-        std::ifstream file(filename, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) {
-            std::cerr << "Failed to open trace file: " << filename << std::endl;
+        unmapTrace();
+        if (resp_prefix_.empty()) {
+            resp_prefix_ = filename + ".resp";
+        }
+        if (apache::thrift::transport::BlockTrace::isBlockTrace(filename)) {
+            loadBlocks(filename, max_requests);
             return;
         }
 
-        size_t file_size = file.tellg();
-        file.seekg(0);
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to open trace file %s", filename.c_str());
+            if (fd >= 0) ::close(fd);
+            return;
+        }
 
-        std::vector<uint8_t> raw_data(file_size);
-        file.read(reinterpret_cast<char*>(raw_data.data()), file_size);
+        std::string index_path = filename + ".idx";
+        if (!mapIndex(index_path, st)) {
+            buildIndex(fd, st, index_path);
+        }
+        ::close(fd);
+        if (!index_) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to index trace file %s", filename.c_str());
+            return;
+        }
 
-        convertToAlignedFormat(raw_data, max_requests);
+        const IndexHeader* header = reinterpret_cast<const IndexHeader*>(index_);
+        recv_buf_ = index_ + sizeof(IndexHeader);
+        recv_data_size_ = header->data_size;
+        records_left_ = header->records;
+        if (max_requests > 0 && static_cast<uint64_t>(max_requests) < records_left_) {
+            records_left_ = max_requests;
+        }
+        eof_reached_ = records_left_ == 0;
+        flows_ = reinterpret_cast<const uint32_t*>(recv_buf_ + header->data_size);
+        trace_records_ = records_left_;
 
-        //std::cout << "Loaded trace from " << filename << ": " << recv_data_size_ << " bytes" << std::endl;
-        //std::cout << "Aligned RPC data address: 0x" << std::hex
-        //          << reinterpret_cast<uintptr_t>(recv_buf_) << std::dec << std::endl;
+        madvise(index_, index_size_, MADV_SEQUENTIAL);
+        advised_window_ = SIZE_MAX;
+        adviseTrace();
     }
 
-    bool validateReplay(const std::string& expected_file) {
-        std::ifstream expected(expected_file, std::ios::binary | std::ios::ate);
-        if (!expected.is_open()) {
-            printf("JU:JU Failed to open expected file\n");
+    // Replays shard `shard` of `shards` of the trace `trace` has loaded,
+    // in place: trace must stay loaded while this socket replays. Records
+    // are dealt out by the flow in their req_id, which keeps the requests
+    // of a connection in order on one shard, or round robin, which keeps
+    // the fragments of a message together. Responses go to
+    // <trace's prefix>.shard<shard>.0, ... unless set. Compressed traces
+    // are not mapped, so cannot be shared.
+    bool shareTrace(const PacketReplaySocket& trace, size_t shard, size_t shards, ShardBy by) {
+        unmapTrace();
+        if (!trace.index_ || shard >= shards) {
+            apache::thrift::GlobalOutput("PacketReplaySocket: failed to share trace: no mapped trace to shard");
             return false;
         }
+        if (resp_prefix_.empty()) {
+            resp_prefix_ = trace.resp_prefix_ + ".shard" + std::to_string(shard);
+        }
 
-        size_t file_size = expected.tellg();
-        //printf("JU:JU Expected file size: %zu bytes\n", file_size);
-        //printf("JU:JU Response data size: %zu bytes\n", resp_data_size_);
-
-        expected.seekg(0);
-        std::vector<uint8_t> expected_data(file_size);
-        expected.read(reinterpret_cast<char*>(expected_data.data()), file_size);
-
-        size_t resp_pos = 0, exp_pos = 0;
-        int entry_count = 0;
-
-        while (resp_pos < resp_data_size_ && exp_pos < expected_data.size()) {
-            uint16_t resp_size = *reinterpret_cast<uint16_t*>(resp_buf_ + resp_pos + 8);
-            uint16_t exp_size = *reinterpret_cast<uint16_t*>(expected_data.data() + exp_pos + 16); // Fix: BasicHeader size field offset
-
-            //printf("JU:JU Entry %d - resp_size: %u, exp_size: %u\n", entry_count, resp_size, exp_size);
+        size_t pos = 0;
+        size_t owner = shards - 1;
+        bool in_message = false;
+        uint32_t message = 0;
+        for (uint64_t i = 0; i < trace.trace_records_; i++) {
+            uint16_t pkt_len;
+            std::memcpy(&pkt_len, trace.recv_buf_ + pos + sizeof(uint64_t), sizeof(pkt_len));
+            size_t to;
+            if (by == SHARD_BY_FLOW) {
+                to = trace.flows_[i] % shards;
+            } else {
+                apache::thrift::transport::TUDPFragment::Header fragment;
+                bool is_fragment = apache::thrift::transport::TUDPFragment::readHeader(
+                    trace.recv_buf_ + pos + RECORD_HEADER, pkt_len, fragment);
+                if (!is_fragment || !in_message || fragment.messageId != message) {
+                    owner = (owner + 1) % shards;
+                }
+                in_message = is_fragment;
+                message = fragment.messageId;
+                to = owner;
+            }
+            if (to == shard) {
+                shard_records_.push_back(static_cast<uint32_t>(pos >> 6));
+            }
+            pos += (RECORD_HEADER + pkt_len + 63) & ~size_t(63);
+        }
 
-            //printf("JU:JU Entry %d First 20 raw bytes:\n", entry_count);
-            //printf("  resp: ");
-            //for(int i=0; i<20; i++) printf("%02x ", resp_buf_[resp_pos + i]);
-            //printf("\n  exp:  ");
-            //for(int i=0; i<20; i++) printf("%02x ", expected_data[exp_pos + i]);
-            //printf("\n");
+        sharded_ = true;
+        recv_buf_ = trace.recv_buf_;
+        recv_data_size_ = trace.recv_data_size_;
+        records_left_ = shard_records_.size();
+        trace_records_ = records_left_;
+        read_pos_ = records_left_ > 0 ? size_t(shard_records_[0]) << 6 : 0;
+        eof_reached_ = records_left_ == 0;
+        return true;
+    }
 
-            if (resp_size != exp_size) {
-                printf("JU:JU Size mismatch at entry %d\n", entry_count);
+    // Requests left to replay
+    uint64_t getRecordsLeft() const { return records_left_; }
+
+    // Adds the responses written so far to the replayed side of validator
+    bool addResponses(apache::thrift::transport::ReplayValidator& validator) const {
+        typedef apache::thrift::transport::ReplayValidator Validator;
+        for (size_t i = 0; i < resp_done_.size(); i++) {
+            const RespSegment& segment = resp_done_[i];
+            if (segment.base) {
+                validator.addActual(segment.base, segment.size, Validator::REPLAY);
+            } else if (segment.size > 0 && !validator.addActualFile(segment.path, Validator::REPLAY)) {
+                apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to map response file %s", segment.path.c_str());
                 return false;
             }
+        }
+        if (resp_buf_) {
+            validator.addActual(resp_buf_, write_pos_, Validator::REPLAY);
+        }
+        return true;
+    }
 
-            // Compare data (can't do this because uniqueid generated during replay depends on timestamp. Thus, it is different.
-            //if (memcmp(resp_buf_ + resp_pos + 10,
-            //      expected_data.data() + exp_pos + 18, resp_size) != 0) return false;
-
-            entry_count++;
-            resp_pos += 10 + resp_size;
-            resp_pos = (resp_pos + 63) & ~63;
-            exp_pos += 18 + exp_size;
+    // Compares the responses with the captured ones byte for byte, less
+    // whatever the validator masks; the differences are left in the
+    // validator for the caller to print
+    bool validateReplay(const std::string& expected_file,
+                        apache::thrift::transport::ReplayValidator& validator) {
+        typedef apache::thrift::transport::ReplayValidator Validator;
+        if (!validator.addExpectedFile(expected_file, Validator::CAPTURE)) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to open expected file %s",
+                                                expected_file.c_str());
+            return false;
         }
+        if (!addResponses(validator)) {
+            return false;
+        }
+        return validator.validate();
+    }
 
-        //printf("JU:JU Validated %d entries successfully\n", entry_count);
-        return true;
+    bool validateReplay(const std::string& expected_file) {
+        apache::thrift::transport::ReplayValidator validator;
+        return validateReplay(expected_file, validator);
     }
 
     uint32_t read(uint8_t* buf, uint32_t max_len) {
-        if (read_pos_ + sizeof(uint64_t) + sizeof(uint16_t) > recv_data_size_) {
-            std::cout << "No more data to read.\n";
-            return 0;
+        if (message_pos_ < message_.size()) {
+            return readMessage(buf, max_len);
         }
 
-        uint16_t pkt_len = *reinterpret_cast<const uint16_t*>(recv_buf_ + read_pos_ + sizeof(uint64_t));
+        while (records_left_ > 0) {
+            uint16_t pkt_len = *reinterpret_cast<const uint16_t*>(recv_buf_ + read_pos_ + sizeof(uint64_t));
+            const uint8_t* pkt = recv_buf_ + read_pos_ + RECORD_HEADER;
+            advanceReadPos();
 
-        uint32_t copy_len = std::min(max_len, static_cast<uint32_t>(pkt_len));
-        std::memcpy(buf, recv_buf_ + read_pos_ + sizeof(uint64_t) + sizeof(uint16_t), copy_len);
+            if (!apache::thrift::transport::TUDPFragment::isFragment(pkt, pkt_len)) {
+                uint32_t copy_len = std::min(max_len, static_cast<uint32_t>(pkt_len));
+                std::memcpy(buf, pkt, copy_len);
+                return copy_len;
+            }
 
-        size_t total_size = sizeof(uint64_t) + sizeof(uint16_t) + pkt_len;
-        read_pos_ += total_size;
-        read_pos_ = (read_pos_ + 63) & ~63;
+            // The trace holds one sender, so fragments are keyed by id alone
+            if (reassembler_.add(pkt, pkt_len, nullptr, 0, message_)) {
+                message_pos_ = 0;
+                return readMessage(buf, max_len);
+            }
+        }
 
-        // Check if EOF reached
-        if (read_pos_ >= recv_data_size_) {
-            eof_reached_ = true;
-            //std::cout << "End of replay file reached. Set EOF flag.\n";
-        } 
-        
-       return copy_len;
+        std::cout << "No more data to read.\n";
+        return 0;
     }
 
-    uint32_t write(const uint8_t* buf, uint32_t len) {
-        size_t total_size = sizeof(uint64_t) + sizeof(uint16_t) + len;
+    // The next whole request where it lies, or reassembled from its
+    // fragments; it stays there until the next call. False once the trace
+    // is done.
+    bool nextMessage(const uint8_t*& data, uint32_t& size) {
+        while (records_left_ > 0) {
+            uint16_t pkt_len = *reinterpret_cast<const uint16_t*>(recv_buf_ + read_pos_ + sizeof(uint64_t));
+            const uint8_t* pkt = recv_buf_ + read_pos_ + RECORD_HEADER;
+            advanceReadPos();
+
+            if (!apache::thrift::transport::TUDPFragment::isFragment(pkt, pkt_len)) {
+                data = pkt;
+                size = pkt_len;
+                return true;
+            }
+            if (reassembler_.add(pkt, pkt_len, nullptr, 0, message_)) {
+                // Not for read() to hand out again
+                message_pos_ = message_.size();
+                data = message_.data();
+                size = static_cast<uint32_t>(message_.size());
+                return true;
+            }
+        }
+        return false;
+    }
 
-        if (write_pos_ + total_size > FIXED_BUFFER_SIZE) {
-            std::cerr << "Response buffer overflow!" << std::endl;
+    uint32_t write(const uint8_t* buf, uint32_t len) {
+        if (len > UINT16_MAX) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: response too large to record: %u bytes", len);
+            return 0;
+        }
+        ensureRespRoom();
+        if (!resp_buf_) {
             return 0;
         }
 
         uint64_t timestamp = getCurrentTimestamp();
-        *reinterpret_cast<uint64_t*>(resp_buf_ + write_pos_) = timestamp;
-        *reinterpret_cast<uint16_t*>(resp_buf_ + write_pos_ + sizeof(uint64_t)) = len;
-        std::memcpy(resp_buf_ + write_pos_ + sizeof(uint64_t) + sizeof(uint16_t), buf, len);
-
-        write_pos_ += total_size;
-        write_pos_ = (write_pos_ + 63) & ~63;
-        resp_data_size_ = write_pos_;
+        uint16_t size = static_cast<uint16_t>(len);
+        std::memcpy(resp_buf_ + write_pos_, &timestamp, sizeof(timestamp));
+        std::memcpy(resp_buf_ + write_pos_ + sizeof(uint64_t), &size, sizeof(size));
+        std::memcpy(resp_buf_ + write_pos_ + RECORD_HEADER, buf, len);
 
+        advanceWritePos(size);
         return len;
     }
 
     bool isEOF() const { return eof_reached_; }
 
 private:
-    uint8_t* allocateAligned(uint8_t* raw_buf) {
-        uintptr_t addr = reinterpret_cast<uintptr_t>(raw_buf);
-        uintptr_t aligned_addr = (addr + 63) & ~63;
-        return reinterpret_cast<uint8_t*>(aligned_addr);
+    uint32_t readMessage(uint8_t* buf, uint32_t max_len) {
+        uint32_t copy_len = std::min(max_len, static_cast<uint32_t>(message_.size() - message_pos_));
+        std::memcpy(buf, message_.data() + message_pos_, copy_len);
+        message_pos_ += copy_len;
+        return copy_len;
+    }
+
+    // Maps path if it is the index of a trace with st's size and mtime
+    bool mapIndex(const std::string& path, const struct stat& st) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        IndexHeader header;
+        struct stat index_st;
+        bool ok = fstat(fd, &index_st) == 0
+                  && ::pread(fd, &header, sizeof(header), 0) == sizeof(header)
+                  && header.magic == INDEX_MAGIC
+                  && header.trace_size == static_cast<uint64_t>(st.st_size)
+                  && header.trace_mtime_sec == st.st_mtim.tv_sec
+                  && header.trace_mtime_nsec == st.st_mtim.tv_nsec
+                  && static_cast<uint64_t>(index_st.st_size)
+                     == sizeof(header) + header.data_size + header.records * sizeof(uint32_t);
+        if (ok) {
+            void* map = mmap(nullptr, index_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = map != MAP_FAILED;
+            if (ok) {
+                index_ = static_cast<uint8_t*>(map);
+                index_size_ = index_st.st_size;
+                index_is_file_ = true;
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    // Lays the records of the trace in fd out 64 byte aligned and writes
+    // them to path. Where path cannot be written the layout is built in
+    // anonymous memory instead, and rebuilt on the next run.
+    void buildIndex(int fd, const struct stat& st, const std::string& path) {
+        size_t trace_size = st.st_size;
+        const uint8_t* trace = nullptr;
+        if (trace_size > 0) {
+            void* map = mmap(nullptr, trace_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) return;
+            trace = static_cast<const uint8_t*>(map);
+            madvise(map, trace_size, MADV_SEQUENTIAL);
+        }
+
+        // First pass sizes the index, the second fills it
+        uint64_t records = 0;
+        size_t data_size = layoutSize(trace, trace_size, records);
+        size_t index_size = sizeof(IndexHeader) + data_size + records * sizeof(uint32_t);
+
+        std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+        int out_fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        void* map = MAP_FAILED;
+        if (out_fd >= 0) {
+            if (ftruncate(out_fd, index_size) == 0) {
+                map = mmap(nullptr, index_size, PROT_READ | PROT_WRITE, MAP_SHARED, out_fd, 0);
+            }
+            if (map == MAP_FAILED) {
+                ::close(out_fd);
+                ::unlink(tmp_path.c_str());
+                out_fd = -1;
+            }
+        }
+        if (map == MAP_FAILED) {
+            map = mmap(nullptr, index_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (map == MAP_FAILED) {
+            if (trace) munmap(const_cast<uint8_t*>(trace), trace_size);
+            return;
+        }
+        uint8_t* out = static_cast<uint8_t*>(map);
+        madvise(map, index_size, MADV_SEQUENTIAL);
+
+        IndexHeader index_header;
+        std::memset(&index_header, 0, sizeof(index_header));
+        index_header.magic = INDEX_MAGIC;
+        index_header.trace_size = trace_size;
+        index_header.trace_mtime_sec = st.st_mtim.tv_sec;
+        index_header.trace_mtime_nsec = st.st_mtim.tv_nsec;
+        index_header.records = records;
+        index_header.data_size = data_size;
+        std::memcpy(out, &index_header, sizeof(index_header));
+
+        layOut(trace, records, out + sizeof(IndexHeader),
+               reinterpret_cast<uint32_t*>(out + sizeof(IndexHeader) + data_size));
+        if (trace) munmap(const_cast<uint8_t*>(trace), trace_size);
+
+        index_ = out;
+        index_size_ = index_size;
+        index_is_file_ = out_fd >= 0;
+        if (out_fd >= 0) {
+            ::close(out_fd);
+            if (::rename(tmp_path.c_str(), path.c_str()) != 0) {
+                ::unlink(tmp_path.c_str());
+            }
+        }
     }
 
-    void convertToAlignedFormat(const std::vector<uint8_t>& raw_data, int max_requests = -1) {
-        // Parse binary log format: BasicHeader + data
-        struct BasicHeader {
-            uint64_t timestamp;
-            int64_t req_id;
-            uint16_t size;
-        } __attribute__((packed));
+    // Size of the records of a trace laid out 64 byte aligned, and how
+    // many there are; a partial record at the end is left out
+    static size_t layoutSize(const uint8_t* trace, size_t trace_size, uint64_t& records) {
+        size_t data_size = 0;
+        records = 0;
+        for (size_t pos = 0; pos + sizeof(BasicHeader) <= trace_size;) {
+            const BasicHeader* header = reinterpret_cast<const BasicHeader*>(trace + pos);
+            if (pos + sizeof(BasicHeader) + header->size > trace_size) break;
+            pos += sizeof(BasicHeader) + header->size;
+            data_size += (RECORD_HEADER + header->size + 63) & ~size_t(63);
+            records++;
+        }
+        return data_size;
+    }
 
+    // Lays the records out at out as layoutSize() sized them, and their
+    // flows out at flows if given
+    static void layOut(const uint8_t* trace, uint64_t records, uint8_t* out,
+                       uint32_t* flows = nullptr) {
         size_t pos = 0;
-        size_t aligned_pos = 0;
-        int request_count = 0;
+        uint8_t* record = out;
+        for (uint64_t i = 0; i < records; i++) {
+            BasicHeader header;
+            std::memcpy(&header, trace + pos, sizeof(header));
+            std::memcpy(record, &header.timestamp, sizeof(uint64_t));
+            std::memcpy(record + sizeof(uint64_t), &header.size, sizeof(uint16_t));
+            std::memcpy(record + RECORD_HEADER, trace + pos + sizeof(BasicHeader), header.size);
+            if (flows) {
+                flows[i] = static_cast<uint32_t>(static_cast<uint64_t>(header.req_id) >> 32);
+            }
+            pos += sizeof(BasicHeader) + header.size;
+            record += (RECORD_HEADER + header.size + 63) & ~size_t(63);
+        }
+    }
+
+    void loadBlocks(const std::string& filename, int max_requests) {
+        try {
+            blocks_.reset(new apache::thrift::transport::BlockTraceReader(filename));
+        } catch (const apache::thrift::transport::TTransportException& e) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to open trace file: %s", e.what());
+            return;
+        }
+        records_left_ = blocks_->records();
+        if (max_requests > 0 && static_cast<uint64_t>(max_requests) < records_left_) {
+            records_left_ = max_requests;
+        }
+        eof_reached_ = records_left_ == 0;
+        stop_inflating_ = false;
+        inflate_error_.clear();
+        for (size_t i = 0; i < SLOTS; i++) {
+            slots_[i].ready = false;
+        }
+        block_ = 0;
+        inflater_ = std::thread(&PacketReplaySocket::inflate, this);
+        if (records_left_ > 0) {
+            enterBlock(0);
+        }
+    }
+
+    // Waits for block b, or the first block after it with records, and
+    // lets the helper have the slot two blocks back
+    void enterBlock(size_t b) {
+        std::unique_lock<std::mutex> lock(slot_mutex_);
+        for (;; b++) {
+            block_ = b;
+            slot_cv_.notify_all();
+            if (b >= blocks_->blocks()) break;
+            Slot& slot = slots_[b % SLOTS];
+            slot_cv_.wait(lock, [&] {
+                return (slot.ready && slot.block == b) || !inflate_error_.empty();
+            });
+            if (!inflate_error_.empty()) break;
+            if (slot.records > 0) {
+                recv_buf_ = slot.buf;
+                recv_data_size_ = slot.size;
+                read_pos_ = 0;
+                block_records_left_ = slot.records;
+                return;
+            }
+        }
+        if (!inflate_error_.empty()) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to decompress trace: %s", inflate_error_.c_str());
+        }
+        records_left_ = 0;
+        eof_reached_ = true;
+    }
+
+    // Helper thread: decompresses the blocks in order into their slots,
+    // no more than BLOCKS_AHEAD past the one being read
+    void inflate() {
+        std::vector<uint8_t> raw;
+        for (size_t b = 0; b < blocks_->blocks(); b++) {
+            Slot& slot = slots_[b % SLOTS];
+            {
+                std::unique_lock<std::mutex> lock(slot_mutex_);
+                slot_cv_.wait(lock, [&] { return stop_inflating_ || b <= block_ + BLOCKS_AHEAD; });
+                if (stop_inflating_) return;
+                slot.ready = false;
+            }
+            try {
+                blocks_->read(b, raw);
+            } catch (const apache::thrift::transport::TTransportException& e) {
+                std::lock_guard<std::mutex> lock(slot_mutex_);
+                inflate_error_ = e.what();
+                slot_cv_.notify_all();
+                return;
+            }
+            uint64_t records;
+            size_t size = layoutSize(raw.data(), raw.size(), records);
+            if (size > slot.capacity) {
+                free(slot.buf);
+                slot.buf = nullptr;
+                slot.capacity = 0;
+                if (posix_memalign(reinterpret_cast<void**>(&slot.buf), 64, size) != 0) {
+                    std::lock_guard<std::mutex> lock(slot_mutex_);
+                    slot.buf = nullptr;
+                    inflate_error_ = "out of memory";
+                    slot_cv_.notify_all();
+                    return;
+                }
+                slot.capacity = size;
+            }
+            layOut(raw.data(), records, slot.buf);
+
+            std::lock_guard<std::mutex> lock(slot_mutex_);
+            slot.size = size;
+            slot.records = records;
+            slot.block = b;
+            slot.ready = true;
+            slot_cv_.notify_all();
+        }
+    }
 
-        while (pos + sizeof(BasicHeader) <= raw_data.size()) {
-            if (max_requests > 0 && request_count >= max_requests) break;
-            const BasicHeader* header = reinterpret_cast<const BasicHeader*>(raw_data.data() + pos);
+    void stopInflating() {
+        if (!inflater_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(slot_mutex_);
+            stop_inflating_ = true;
+        }
+        slot_cv_.notify_all();
+        inflater_.join();
+    }
 
-            if (pos + sizeof(BasicHeader) + header->size > raw_data.size()) break;
-            if (aligned_pos + sizeof(uint64_t) + sizeof(uint16_t) + header->size > FIXED_BUFFER_SIZE) break;
+    void unmapTrace() {
+        stopInflating();
+        blocks_.reset();
+        block_records_left_ = 0;
+        if (index_) {
+            munmap(index_, index_size_);
+        }
+        index_ = nullptr;
+        index_size_ = 0;
+        recv_buf_ = nullptr;
+        recv_data_size_ = 0;
+        read_pos_ = 0;
+        records_left_ = 0;
+        eof_reached_ = false;
+        flows_ = nullptr;
+        trace_records_ = 0;
+        sharded_ = false;
+        shard_records_.clear();
+        shard_next_ = 0;
+        message_.clear();
+        message_pos_ = 0;
+    }
 
-            // Write timestamp, size, data
-            *reinterpret_cast<uint64_t*>(recv_buf_ + aligned_pos) = header->timestamp;
-            *reinterpret_cast<uint16_t*>(recv_buf_ + aligned_pos + sizeof(uint64_t)) = header->size;
-            std::memcpy(recv_buf_ + aligned_pos + sizeof(uint64_t) + sizeof(uint16_t),
-                       raw_data.data() + pos + sizeof(BasicHeader), header->size);
+    // On entering a new window, reads the next one ahead and drops the one
+    // two behind. Anonymous indexes are kept, dropping them loses the data.
+    void adviseTrace() {
+        size_t window = (sizeof(IndexHeader) + read_pos_) / ADVISE_WINDOW;
+        if (window == advised_window_) return;
+        advised_window_ = window;
 
-            pos += sizeof(BasicHeader) + header->size;
-            aligned_pos += sizeof(uint64_t) + sizeof(uint16_t) + header->size;
-            aligned_pos = (aligned_pos + 63) & ~63;  // 64-byte align
-            request_count++;
+        size_t ahead = (window + 1) * ADVISE_WINDOW;
+        if (ahead < index_size_) {
+            madvise(index_ + ahead, std::min(index_size_ - ahead, size_t(ADVISE_WINDOW)), MADV_WILLNEED);
+        }
+        if (index_is_file_ && window >= 2) {
+            madvise(index_ + (window - 2) * ADVISE_WINDOW, ADVISE_WINDOW, MADV_DONTNEED);
         }
+    }
 
-        recv_data_size_ = aligned_pos;
+    // Keeps room for a whole record at write_pos_, starting the next
+    // segment when the current one is full
+    void ensureRespRoom() {
+        if (resp_buf_ && write_pos_ + MAX_RECORD <= RESP_SEGMENT_BYTES) return;
+        closeRespSegment();
+
+        resp_path_ = (resp_prefix_.empty() ? std::string("replay.resp") : resp_prefix_)
+                     + "." + std::to_string(resp_done_.size());
+        const std::string& path = resp_path_;
+        void* map = MAP_FAILED;
+        resp_fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (resp_fd_ >= 0) {
+            if (ftruncate(resp_fd_, RESP_SEGMENT_BYTES) == 0) {
+                map = mmap(nullptr, RESP_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, resp_fd_, 0);
+            }
+            if (map == MAP_FAILED) {
+                ::close(resp_fd_);
+                ::unlink(path.c_str());
+                resp_fd_ = -1;
+            }
+        }
+        if (map == MAP_FAILED) {
+            apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to create response file %s, keeping responses in memory",
+                                path.c_str());
+            map = mmap(nullptr, RESP_SEGMENT_BYTES, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map == MAP_FAILED) {
+                apache::thrift::GlobalOutput("PacketReplaySocket: failed to map response buffer");
+                return;
+            }
+        }
+        madvise(map, RESP_SEGMENT_BYTES, MADV_SEQUENTIAL);
+        resp_buf_ = static_cast<uint8_t*>(map);
+        write_pos_ = 0;
+    }
+
+    // Trims the segment being written to what was written and sets it aside
+    void closeRespSegment() {
+        if (!resp_buf_) return;
+
+        RespSegment segment;
+        segment.path = resp_path_;
+        segment.size = write_pos_;
+        if (resp_fd_ >= 0) {
+            munmap(resp_buf_, RESP_SEGMENT_BYTES);
+            if (ftruncate(resp_fd_, write_pos_) != 0) {
+                apache::thrift::GlobalOutput.printf("PacketReplaySocket: failed to trim response file %s", segment.path.c_str());
+            }
+            ::close(resp_fd_);
+            resp_fd_ = -1;
+            segment.base = nullptr;
+        } else {
+            segment.base = resp_buf_;
+        }
+        resp_done_.push_back(segment);
+        resp_done_size_ += write_pos_;
+        resp_buf_ = nullptr;
+        write_pos_ = 0;
     }
 
     uint64_t getCurrentTimestamp() {
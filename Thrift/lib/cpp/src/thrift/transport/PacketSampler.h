@@ -0,0 +1,364 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// PacketSampler.h
+#ifndef _THRIFT_TRANSPORT_PACKETSAMPLER_H_
+#define _THRIFT_TRANSPORT_PACKETSAMPLER_H_ 1
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <thrift/TOutput.h>
+#include <thrift/transport/MessageHeader.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Decides which requests the packet loggers record, and how much of them.
+ *
+ * A request is decided once, at its first stage (sample()), and its later
+ * stages on the same thread follow that decision (follows()), which is
+ * how Thrift's servers handle a request from read to reply; a partly
+ * logged request would be useless to StageProfiler. The policy is
+ *
+ *   enabled  whether to log at all
+ *   rate     1 in rate requests, picked by a hash of the req_id so that
+ *            every process tracing the same traffic picks the same ones
+ *   tokens   at most this many requests per second, in bursts of burst
+ *   methods  only requests of these methods
+ *   capture  the whole payload, or the Thrift message header alone
+ *
+ * The checks run before anything is timestamped or copied: one load of
+ * the current policy, and with the default of everything in full a
+ * single branch. Reads that do not start a message are only logged then.
+ *
+ * setPolicy() and loadPolicy() take effect for the next request; watch()
+ * reloads a control file when it changes or on a signal, without
+ * restarting. Replaced policies are kept until the sampler is destroyed,
+ * so the hot path never waits for a reader.
+ *
+ * The control file has one setting per line, # comments:
+ *
+ *   enabled yes|no
+ *   rate <n>
+ *   tokens <per second> [<burst>]     0 for no limit
+ *   methods <name>...                 none, or *, for all
+ *   capture full|header
+ */
+class PacketSampler {
+public:
+  enum Capture { FULL, HEADER };
+
+  enum {
+    WATCH_MS = 200  // how often watch() looks at the file
+  };
+
+  struct Policy {
+    Policy() : enabled(true), rate(1), tokensPerSecond(0), burst(1), capture(FULL) {}
+    bool enabled;
+    uint32_t rate;
+    double tokensPerSecond;
+    uint32_t burst;
+    std::vector<std::string> methods;
+    Capture capture;
+  };
+
+  PacketSampler() : config_(nullptr), tat_(0), watching_(false), stopWatch_(false) {
+    setPolicy(Policy());
+  }
+
+  ~PacketSampler() { unwatch(); }
+
+  void setPolicy(const Policy& policy) {
+    std::unique_ptr<Config> c(new Config());
+    c->policy = policy;
+    c->policy.rate = policy.rate ? policy.rate : 1;
+    c->policy.burst = policy.burst ? policy.burst : 1;
+    c->threshold = UINT64_MAX / c->policy.rate;
+    c->intervalNs = policy.tokensPerSecond > 0
+                        ? static_cast<int64_t>(1e9 / policy.tokensPerSecond)
+                        : 0;
+    c->toleranceNs = c->intervalNs * (c->policy.burst - 1);
+    c->all = policy.enabled && c->policy.rate == 1 && c->intervalNs == 0
+             && policy.methods.empty() && policy.capture == FULL;
+    std::lock_guard<std::mutex> lock(configsMutex_);
+    configs_.push_back(std::move(c));
+    tat_.store(0, std::memory_order_relaxed);
+    config_.store(configs_.back().get(), std::memory_order_release);
+  }
+
+  Policy policy() const { return config_.load(std::memory_order_acquire)->policy; }
+
+  /** False, with a message in error, on a line it does not understand */
+  static bool parsePolicy(std::istream& in, Policy& policy, std::string& error) {
+    Policy p;
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream words(line);
+      std::string key, value;
+      if (!(words >> key)) {
+        continue;
+      }
+      bool ok = true;
+      if (key == "enabled") {
+        ok = static_cast<bool>(words >> value) && (value == "yes" || value == "no");
+        p.enabled = value == "yes";
+      } else if (key == "rate") {
+        ok = static_cast<bool>(words >> p.rate) && p.rate > 0;
+      } else if (key == "tokens") {
+        ok = static_cast<bool>(words >> p.tokensPerSecond) && p.tokensPerSecond >= 0;
+        if (ok && !(words >> p.burst)) {
+          p.burst = 1;
+          words.clear();
+        }
+      } else if (key == "methods") {
+        p.methods.clear();
+        while (words >> value) {
+          if (value != "*") {
+            p.methods.push_back(value);
+          }
+        }
+      } else if (key == "capture") {
+        ok = static_cast<bool>(words >> value) && (value == "full" || value == "header");
+        p.capture = value == "header" ? HEADER : FULL;
+      } else {
+        ok = false;
+      }
+      if (!ok || (words >> value)) {
+        error = "line " + std::to_string(n) + ": " + line;
+        return false;
+      }
+    }
+    policy = p;
+    return true;
+  }
+
+  /** Reads and applies a control file; keeps the policy it has if it cannot */
+  bool loadPolicy(const std::string& path, std::string& error) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+      error = "cannot read " + path;
+      return false;
+    }
+    Policy policy;
+    if (!parsePolicy(in, policy, error)) {
+      error = path + " " + error;
+      return false;
+    }
+    setPolicy(policy);
+    return true;
+  }
+
+  /**
+   * Loads path now and again whenever it changes or the process gets
+   * signum, checking every WATCH_MS. Errors go to GlobalOutput.
+   */
+  void watch(const std::string& path, int signum = SIGHUP) {
+    unwatch();
+    std::string error;
+    if (!loadPolicy(path, error)) {
+      GlobalOutput.printf("PacketSampler: %s", error.c_str());
+    }
+    signal(signum, &PacketSampler::onSignal);
+    stopWatch_ = false;
+    watching_ = true;
+    watcher_ = std::thread(&PacketSampler::runWatch, this, path);
+  }
+
+  void unwatch() {
+    if (!watching_) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(watchMutex_);
+      stopWatch_ = true;
+    }
+    watchWake_.notify_one();
+    watcher_.join();
+    watching_ = false;
+  }
+
+  /** Quick check for the loggers: is anything logged at all */
+  bool enabled() const { return config_.load(std::memory_order_acquire)->policy.enabled; }
+
+  /**
+   * First stage of request reqId, 0 if the data does not start a message,
+   * with its header if parsed: whether to log it, and bytes of its size
+   * bytes if so. Decides for the later stages on this thread; a read
+   * with reqId 0 leaves the decision for the request in progress alone.
+   */
+  bool sample(int64_t reqId, const MessageHeader* header, uint32_t size, uint32_t& bytes) {
+    const Config* c = config_.load(std::memory_order_acquire);
+    if (reqId == 0) {
+      bytes = size;
+      return c->all;
+    }
+    Decision& d = decision();
+    d.reqId = reqId;
+    if (c->all) {
+      d.sampled = true;
+      bytes = size;
+      return true;
+    }
+    d.sampled = c->policy.enabled
+                && static_cast<uint64_t>(reqId) * 0x9E3779B97F4A7C15ULL <= c->threshold
+                && methodAllowed(*c, header) && take(*c);
+    bytes = captured(*c, header, size);
+    return d.sampled;
+  }
+
+  /** A later stage of reqId: whether it was sampled, and bytes to log */
+  bool follows(int64_t reqId, const MessageHeader* header, uint32_t size, uint32_t& bytes) {
+    const Config* c = config_.load(std::memory_order_acquire);
+    if (c->all) {
+      bytes = size;
+      return true;
+    }
+    const Decision& d = decision();
+    bytes = captured(*c, header, size);
+    return c->policy.enabled && d.sampled && d.reqId == reqId;
+  }
+
+private:
+  struct Config {
+    Policy policy;
+    bool all;              // everything, in full
+    uint64_t threshold;    // of the req_id hash
+    int64_t intervalNs;    // between tokens, 0 for no limit
+    int64_t toleranceNs;   // burst allowance
+  };
+
+  struct Decision {
+    Decision() : reqId(0), sampled(false) {}
+    int64_t reqId;
+    bool sampled;
+  };
+
+  static Decision& decision() {
+    static thread_local Decision d;
+    return d;
+  }
+
+  static bool methodAllowed(const Config& c, const MessageHeader* header) {
+    const std::vector<std::string>& methods = c.policy.methods;
+    if (methods.empty()) {
+      return true;
+    }
+    if (!header) {
+      return false;
+    }
+    for (size_t i = 0; i < methods.size(); ++i) {
+      if (methods[i].size() == header->methodLen
+          && memcmp(methods[i].data(), header->method, header->methodLen) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static uint32_t captured(const Config& c, const MessageHeader* header, uint32_t size) {
+    if (c.policy.capture == FULL) {
+      return size;
+    }
+    return header && header->body <= size ? header->body : 0;
+  }
+
+  // Token bucket as a virtual scheduling clock: a request conforms if
+  // the next token is due no further than the burst allows
+  bool take(const Config& c) {
+    if (c.intervalNs == 0) {
+      return true;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+      int64_t start = tat > now ? tat : now;
+      if (start - now > c.toleranceNs) {
+        return false;
+      }
+      if (tat_.compare_exchange_weak(tat, start + c.intervalNs, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+
+  static std::atomic<bool>& signalled() {
+    static std::atomic<bool> flag(false);
+    return flag;
+  }
+
+  static void onSignal(int) { signalled().store(true); }
+
+  void runWatch(std::string path) {
+    struct stat st;
+    struct timespec mtime = {0, 0};
+    if (stat(path.c_str(), &st) == 0) {
+      mtime = st.st_mtim;
+    }
+    std::unique_lock<std::mutex> lock(watchMutex_);
+    while (!watchWake_.wait_for(lock, std::chrono::milliseconds(WATCH_MS),
+                                [this] { return stopWatch_; })) {
+      bool changed = stat(path.c_str(), &st) == 0
+                     && (st.st_mtim.tv_sec != mtime.tv_sec || st.st_mtim.tv_nsec != mtime.tv_nsec);
+      if (!signalled().exchange(false) && !changed) {
+        continue;
+      }
+      if (changed) {
+        mtime = st.st_mtim;
+      }
+      std::string error;
+      if (!loadPolicy(path, error)) {
+        GlobalOutput.printf("PacketSampler: %s", error.c_str());
+      }
+    }
+  }
+
+  std::atomic<const Config*> config_;
+  std::mutex configsMutex_;
+  std::vector<std::unique_ptr<Config> > configs_;
+  std::atomic<int64_t> tat_;  // when the bucket's next token is due
+
+  std::thread watcher_;
+  std::mutex watchMutex_;
+  std::condition_variable watchWake_;
+  bool watching_;
+  bool stopWatch_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_PACKETSAMPLER_H_
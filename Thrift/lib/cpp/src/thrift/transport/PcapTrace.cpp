@@ -0,0 +1,785 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <thrift/transport/PcapTrace.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+const size_t IO_BUFFER = 1 << 20;
+
+// PacketLogger record header: ts, req_id, size
+const size_t RECORD_HEADER = 18;
+
+const uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+const uint32_t PCAPNG_IDB = 1;
+const uint32_t PCAPNG_SPB = 3;
+const uint32_t PCAPNG_EPB = 6;
+const uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4D;
+const uint32_t PCAPNG_MAX_BLOCK = 16 << 20;
+
+const uint32_t PCAP_US = 0xA1B2C3D4;
+const uint32_t PCAP_NS = 0xA1B23C4D;
+
+enum LinkType {
+  LINK_NULL = 0,
+  LINK_ETHERNET = 1,
+  LINK_RAW = 101,
+  LINK_LINUX_SLL = 113,
+  LINK_IPV4 = 228,
+  LINK_IPV6 = 229,
+  LINK_LINUX_SLL2 = 276
+};
+
+const size_t ETH_HEADER = 14;
+const size_t IPV4_HEADER = 20;
+const size_t IPV6_HEADER = 40;
+const size_t UDP_HEADER = 8;
+
+uint16_t be16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void putBe16(uint8_t* p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v >> 8);
+  p[1] = static_cast<uint8_t>(v);
+}
+
+void putBe32(uint8_t* p, uint32_t v) {
+  putBe16(p, static_cast<uint16_t>(v >> 16));
+  putBe16(p + 2, static_cast<uint16_t>(v));
+}
+
+uint32_t swap32(uint32_t v) {
+  return __builtin_bswap32(v);
+}
+
+uint16_t swap16(uint16_t v) {
+  return static_cast<uint16_t>((v << 8) | (v >> 8));
+}
+
+std::string errorText(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+class File {
+public:
+  File(const std::string& path, const char* mode) : path_(path), f_(fopen(path.c_str(), mode)) {
+    if (!f_) {
+      throw TTransportException(TTransportException::NOT_OPEN, errorText("Cannot open", path));
+    }
+    setvbuf(f_, nullptr, _IOFBF, IO_BUFFER);
+  }
+
+  ~File() {
+    if (f_) {
+      fclose(f_);
+    }
+  }
+
+  // False at a clean end of file, throws on a partial read
+  bool read(void* buf, size_t len) {
+    size_t got = fread(buf, 1, len, f_);
+    if (got == len) {
+      return true;
+    }
+    if (ferror(f_)) {
+      throw TTransportException(TTransportException::UNKNOWN, errorText("Cannot read", path_));
+    }
+    if (got != 0) {
+      throw TTransportException(TTransportException::END_OF_FILE, "Truncated record in " + path_);
+    }
+    return false;
+  }
+
+  void readAll(void* buf, size_t len) {
+    if (!read(buf, len)) {
+      throw TTransportException(TTransportException::END_OF_FILE, "Truncated record in " + path_);
+    }
+  }
+
+  void write(const void* buf, size_t len) {
+    if (fwrite(buf, 1, len, f_) != len) {
+      throw TTransportException(TTransportException::UNKNOWN, errorText("Cannot write", path_));
+    }
+  }
+
+  void close() {
+    FILE* f = f_;
+    f_ = nullptr;
+    if (fclose(f) != 0) {
+      throw TTransportException(TTransportException::UNKNOWN, errorText("Cannot write", path_));
+    }
+  }
+
+  const std::string& path() const { return path_; }
+
+private:
+  File(const File&);
+  File& operator=(const File&);
+
+  std::string path_;
+  FILE* f_;
+};
+
+// One stream of PacketLogger records
+class TraceReader {
+public:
+  explicit TraceReader(const std::string& path) : file_(path, "rb"), ready_(false), done_(false) {}
+
+  // The next record, or null at the end
+  const std::vector<uint8_t>* peek() {
+    if (!ready_ && !done_) {
+      uint8_t header[RECORD_HEADER];
+      if (!file_.read(header, sizeof(header))) {
+        done_ = true;
+        return nullptr;
+      }
+      memcpy(&timestamp_, header, sizeof(timestamp_));
+      memcpy(&reqId_, header + 8, sizeof(reqId_));
+      uint16_t size;
+      memcpy(&size, header + 16, sizeof(size));
+      data_.resize(size);
+      file_.readAll(data_.data(), size);
+      ready_ = true;
+    }
+    return done_ ? nullptr : &data_;
+  }
+
+  void pop() { ready_ = false; }
+  uint64_t timestamp() const { return timestamp_; }
+  int64_t reqId() const { return reqId_; }
+
+private:
+  File file_;
+  bool ready_;
+  bool done_;
+  uint64_t timestamp_;
+  int64_t reqId_;
+  std::vector<uint8_t> data_;
+};
+
+class TraceWriter {
+public:
+  explicit TraceWriter(const std::string& path) : file_(path, "wb") {}
+
+  void write(uint64_t timestamp, const uint8_t* data, uint16_t size) {
+    uint8_t header[RECORD_HEADER];
+    int64_t reqId = 0;  // as PacketLogger logs the network stages
+    memcpy(header, &timestamp, sizeof(timestamp));
+    memcpy(header + 8, &reqId, sizeof(reqId));
+    memcpy(header + 16, &size, sizeof(size));
+    file_.write(header, sizeof(header));
+    file_.write(data, size);
+  }
+
+  void close() { file_.close(); }
+
+private:
+  File file_;
+};
+
+uint16_t ipChecksum(const uint8_t* p, size_t len) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    sum += be16(p + i);
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(~sum);
+}
+
+class PcapngWriter {
+public:
+  explicit PcapngWriter(const std::string& path) : file_(path, "wb") {
+    // Section header, then one Ethernet interface with ns timestamps
+    static const char app[] = "Thrift PcapTrace";
+    std::vector<uint8_t> options;
+    addOption(options, 4, app, sizeof(app) - 1);  // shb_userappl
+    addOption(options, 0, nullptr, 0);
+    std::vector<uint8_t> body(16);
+    uint32_t magic = PCAPNG_BYTE_ORDER;
+    uint16_t major = 1, minor = 0;
+    int64_t sectionLength = -1;
+    memcpy(&body[0], &magic, 4);
+    memcpy(&body[4], &major, 2);
+    memcpy(&body[6], &minor, 2);
+    memcpy(&body[8], &sectionLength, 8);
+    body.insert(body.end(), options.begin(), options.end());
+    writeBlock(PCAPNG_SHB, body);
+
+    options.clear();
+    uint8_t tsresol = 9;
+    addOption(options, 9, &tsresol, 1);  // if_tsresol, 10^-9
+    addOption(options, 0, nullptr, 0);
+    body.assign(8, 0);
+    uint16_t linkType = LINK_ETHERNET;
+    uint32_t snapLen = 0;
+    memcpy(&body[0], &linkType, 2);
+    memcpy(&body[4], &snapLen, 4);
+    body.insert(body.end(), options.begin(), options.end());
+    writeBlock(PCAPNG_IDB, body);
+  }
+
+  void writePacket(uint64_t ns, const std::vector<uint8_t>& frame, bool inbound,
+                   const std::string& comment) {
+    block_.assign(20, 0);
+    uint32_t iface = 0;
+    uint32_t high = static_cast<uint32_t>(ns >> 32);
+    uint32_t low = static_cast<uint32_t>(ns);
+    uint32_t len = static_cast<uint32_t>(frame.size());
+    memcpy(&block_[0], &iface, 4);
+    memcpy(&block_[4], &high, 4);
+    memcpy(&block_[8], &low, 4);
+    memcpy(&block_[12], &len, 4);
+    memcpy(&block_[16], &len, 4);
+    block_.insert(block_.end(), frame.begin(), frame.end());
+    block_.resize((block_.size() + 3) & ~size_t(3));
+    addOption(block_, 1, comment.data(), comment.size());  // opt_comment
+    uint32_t flags = inbound ? 1 : 2;
+    addOption(block_, 2, &flags, 4);  // epb_flags, direction
+    addOption(block_, 0, nullptr, 0);
+    writeBlock(PCAPNG_EPB, block_);
+  }
+
+  void close() { file_.close(); }
+
+private:
+  static void addOption(std::vector<uint8_t>& out, uint16_t code, const void* value,
+                        size_t len) {
+    uint16_t header[2] = {code, static_cast<uint16_t>(len)};
+    const uint8_t* h = reinterpret_cast<const uint8_t*>(header);
+    out.insert(out.end(), h, h + sizeof(header));
+    const uint8_t* v = static_cast<const uint8_t*>(value);
+    out.insert(out.end(), v, v + len);
+    out.resize((out.size() + 3) & ~size_t(3));
+  }
+
+  void writeBlock(uint32_t type, const std::vector<uint8_t>& body) {
+    uint32_t total = static_cast<uint32_t>(body.size() + 12);
+    file_.write(&type, 4);
+    file_.write(&total, 4);
+    file_.write(body.data(), body.size());
+    file_.write(&total, 4);
+  }
+
+  File file_;
+  std::vector<uint8_t> block_;
+};
+
+// Ethernet, IPv4 and UDP headers around payload
+void buildFrame(std::vector<uint8_t>& frame, const PcapTrace::Endpoint& src,
+                const PcapTrace::Endpoint& dst, const std::vector<uint8_t>& payload,
+                uint16_t ipId) {
+  frame.assign(ETH_HEADER + IPV4_HEADER + UDP_HEADER, 0);
+  uint8_t* eth = &frame[0];
+  memcpy(eth, dst.mac, 6);
+  memcpy(eth + 6, src.mac, 6);
+  putBe16(eth + 12, 0x0800);
+
+  // Lengths of payloads past what IPv4 can carry are clamped; the frame
+  // still holds all of it
+  size_t ipLen = IPV4_HEADER + UDP_HEADER + payload.size();
+  uint8_t* ip = eth + ETH_HEADER;
+  ip[0] = 0x45;
+  putBe16(ip + 2, static_cast<uint16_t>(ipLen > 0xffff ? 0xffff : ipLen));
+  putBe16(ip + 4, ipId);
+  putBe16(ip + 6, 0x4000);  // don't fragment
+  ip[8] = 64;
+  ip[9] = 17;
+  putBe32(ip + 12, src.ip);
+  putBe32(ip + 16, dst.ip);
+  putBe16(ip + 10, ipChecksum(ip, IPV4_HEADER));
+
+  uint8_t* udp = ip + IPV4_HEADER;
+  size_t udpLen = UDP_HEADER + payload.size();
+  putBe16(udp, src.port);
+  putBe16(udp + 2, dst.port);
+  putBe16(udp + 4, static_cast<uint16_t>(udpLen > 0xffff ? 0xffff : udpLen));
+  // UDP checksum left 0, optional over IPv4
+
+  frame.insert(frame.end(), payload.begin(), payload.end());
+}
+
+struct Packet {
+  uint64_t ns;
+  uint32_t linkType;
+  const uint8_t* data;
+  uint32_t capLen;
+  uint32_t origLen;
+};
+
+// Packets of a pcap or pcapng file, one at a time
+class CaptureReader {
+public:
+  explicit CaptureReader(const std::string& path)
+    : file_(path, "rb"), ng_(false), swap_(false), nsScale_(1000), linkType_(0) {
+    uint32_t magic;
+    if (!file_.read(&magic, 4)) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA, "Empty capture " + path);
+    }
+    if (magic == PCAPNG_SHB) {
+      ng_ = true;
+      readSectionHeader();
+      return;
+    }
+    if (magic == PCAP_US || magic == PCAP_NS) {
+      swap_ = false;
+    } else if (swap32(magic) == PCAP_US || swap32(magic) == PCAP_NS) {
+      swap_ = true;
+      magic = swap32(magic);
+    } else {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Not a pcap or pcapng file: " + path);
+    }
+    nsScale_ = magic == PCAP_NS ? 1 : 1000;
+    uint8_t header[20];
+    file_.readAll(header, sizeof(header));
+    linkType_ = u32(header + 16) & 0xffff;  // upper bits hold FCS information
+  }
+
+  bool next(Packet& p) { return ng_ ? nextBlock(p) : nextRecord(p); }
+
+private:
+  struct Interface {
+    uint32_t linkType;
+    bool binary;      // if_tsresol is a power of 2
+    uint32_t resol;   // its exponent
+    int64_t offset;   // if_tsoffset, seconds
+  };
+
+  uint32_t u32(const uint8_t* p) const {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap_ ? swap32(v) : v;
+  }
+
+  uint16_t u16(const uint8_t* p) const {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap_ ? swap16(v) : v;
+  }
+
+  bool nextRecord(Packet& p) {
+    uint8_t header[16];
+    if (!file_.read(header, sizeof(header))) {
+      return false;
+    }
+    uint32_t capLen = u32(header + 8);
+    if (capLen > PCAPNG_MAX_BLOCK) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Bad record length in " + file_.path());
+    }
+    buf_.resize(capLen);
+    file_.readAll(buf_.data(), capLen);
+    p.ns = static_cast<uint64_t>(u32(header)) * 1000000000ULL
+           + static_cast<uint64_t>(u32(header + 4)) * nsScale_;
+    p.linkType = linkType_;
+    p.data = buf_.data();
+    p.capLen = capLen;
+    p.origLen = u32(header + 12);
+    return true;
+  }
+
+  // Reads the rest of a section header block, the type already read
+  void readSectionHeader() {
+    uint8_t header[8];
+    file_.readAll(header, sizeof(header));
+    uint32_t magic;
+    memcpy(&magic, header + 4, 4);
+    if (magic == PCAPNG_BYTE_ORDER) {
+      swap_ = false;
+    } else if (swap32(magic) == PCAPNG_BYTE_ORDER) {
+      swap_ = true;
+    } else {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Bad pcapng byte order magic in " + file_.path());
+    }
+    uint32_t total = u32(header);
+    if (total < 28 || total > PCAPNG_MAX_BLOCK || total % 4) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Bad pcapng block in " + file_.path());
+    }
+    buf_.resize(total - 12);
+    file_.readAll(buf_.data(), buf_.size());
+    interfaces_.clear();
+  }
+
+  bool nextBlock(Packet& p) {
+    for (;;) {
+      uint8_t header[8];
+      if (!file_.read(header, 4)) {
+        return false;
+      }
+      uint32_t type;
+      memcpy(&type, header, 4);
+      if (type == PCAPNG_SHB) {
+        readSectionHeader();
+        continue;
+      }
+      file_.readAll(header + 4, 4);
+      type = u32(header);
+      uint32_t total = u32(header + 4);
+      if (total < 12 || total > PCAPNG_MAX_BLOCK || total % 4) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Bad pcapng block in " + file_.path());
+      }
+      buf_.resize(total - 8);
+      file_.readAll(buf_.data(), buf_.size());
+      size_t bodyLen = total - 12;
+      const uint8_t* body = buf_.data();
+
+      if (type == PCAPNG_IDB && bodyLen >= 8) {
+        Interface iface;
+        iface.linkType = u16(body);
+        iface.binary = false;
+        iface.resol = 6;
+        iface.offset = 0;
+        readInterfaceOptions(body + 8, bodyLen - 8, iface);
+        interfaces_.push_back(iface);
+      } else if (type == PCAPNG_EPB && bodyLen >= 20) {
+        uint32_t id = u32(body);
+        uint32_t capLen = u32(body + 12);
+        if (id >= interfaces_.size() || capLen > bodyLen - 20) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Bad enhanced packet block in " + file_.path());
+        }
+        const Interface& iface = interfaces_[id];
+        uint64_t ts = (static_cast<uint64_t>(u32(body + 4)) << 32) | u32(body + 8);
+        p.ns = toNs(ts, iface);
+        p.linkType = iface.linkType;
+        p.data = body + 20;
+        p.capLen = capLen;
+        p.origLen = u32(body + 16);
+        return true;
+      } else if (type == PCAPNG_SPB && bodyLen >= 4 && !interfaces_.empty()) {
+        // No timestamp; they are rare enough that 0 will do
+        p.origLen = u32(body);
+        p.capLen = static_cast<uint32_t>(bodyLen - 4);
+        if (p.capLen > p.origLen) {
+          p.capLen = p.origLen;
+        }
+        p.ns = 0;
+        p.linkType = interfaces_[0].linkType;
+        p.data = body + 4;
+        return true;
+      }
+    }
+  }
+
+  void readInterfaceOptions(const uint8_t* p, size_t len, Interface& iface) {
+    size_t pos = 0;
+    while (pos + 4 <= len) {
+      uint16_t code = u16(p + pos);
+      uint16_t optLen = u16(p + pos + 2);
+      pos += 4;
+      if (code == 0 || pos + optLen > len) {
+        break;
+      }
+      if (code == 9 && optLen >= 1) {  // if_tsresol
+        iface.binary = (p[pos] & 0x80) != 0;
+        iface.resol = p[pos] & 0x7f;
+      } else if (code == 14 && optLen >= 8) {  // if_tsoffset
+        uint64_t v;
+        memcpy(&v, p + pos, 8);
+        if (swap_) {
+          v = __builtin_bswap64(v);
+        }
+        iface.offset = static_cast<int64_t>(v);
+      }
+      pos += (optLen + 3) & ~3u;
+    }
+  }
+
+  static uint64_t toNs(uint64_t ts, const Interface& iface) {
+    uint64_t ns;
+    if (iface.binary) {
+      ns = static_cast<uint64_t>((static_cast<unsigned __int128>(ts) * 1000000000ULL)
+                                 >> iface.resol);
+    } else if (iface.resol <= 9) {
+      ns = ts;
+      for (uint32_t i = iface.resol; i < 9; ++i) {
+        ns *= 10;
+      }
+    } else {
+      ns = ts;
+      for (uint32_t i = 9; i < iface.resol && ns; ++i) {
+        ns /= 10;
+      }
+    }
+    return ns + static_cast<uint64_t>(iface.offset) * 1000000000ULL;
+  }
+
+  File file_;
+  bool ng_;
+  bool swap_;
+  uint64_t nsScale_;
+  uint32_t linkType_;
+  std::vector<Interface> interfaces_;
+  std::vector<uint8_t> buf_;
+};
+
+enum ParseResult { PARSE_UDP, PARSE_OTHER, PARSE_FRAGMENT, PARSE_TRUNCATED };
+
+// UDP ports and payload of an IPv4 or IPv6 packet
+ParseResult parseIp(const uint8_t* p, uint32_t len, uint16_t& srcPort, uint16_t& dstPort,
+                    const uint8_t*& payload, uint32_t& payloadLen) {
+  if (len < 1) {
+    return PARSE_TRUNCATED;
+  }
+  uint32_t l4;
+  uint32_t end = len;
+  uint8_t version = p[0] >> 4;
+  if (version == 4) {
+    if (len < IPV4_HEADER) {
+      return PARSE_TRUNCATED;
+    }
+    uint32_t ihl = (p[0] & 0x0f) * 4u;
+    uint16_t fragment = be16(p + 6);
+    if (p[9] != 17) {
+      return PARSE_OTHER;
+    }
+    if (fragment & 0x3fff) {  // more fragments, or an offset
+      return PARSE_FRAGMENT;
+    }
+    uint32_t total = be16(p + 2);
+    if (total >= ihl && total < end) {
+      end = total;  // Ethernet padding
+    }
+    l4 = ihl;
+  } else if (version == 6) {
+    if (len < IPV6_HEADER) {
+      return PARSE_TRUNCATED;
+    }
+    uint8_t next = p[6];
+    l4 = IPV6_HEADER;
+    uint32_t total = IPV6_HEADER + be16(p + 4);
+    if (total < end) {
+      end = total;
+    }
+    // Hop-by-hop, routing and destination options may precede UDP
+    while (next == 0 || next == 43 || next == 60) {
+      if (l4 + 8 > end) {
+        return PARSE_TRUNCATED;
+      }
+      next = p[l4];
+      l4 += (p[l4 + 1] + 1) * 8u;
+    }
+    if (next == 44) {
+      return PARSE_FRAGMENT;
+    }
+    if (next != 17) {
+      return PARSE_OTHER;
+    }
+  } else {
+    return PARSE_OTHER;
+  }
+  if (l4 + UDP_HEADER > end) {
+    return PARSE_TRUNCATED;
+  }
+  const uint8_t* udp = p + l4;
+  uint32_t udpLen = be16(udp + 4);
+  if (udpLen < UDP_HEADER) {
+    return PARSE_OTHER;
+  }
+  if (l4 + udpLen > end) {
+    return PARSE_TRUNCATED;
+  }
+  srcPort = be16(udp);
+  dstPort = be16(udp + 2);
+  payload = udp + UDP_HEADER;
+  payloadLen = udpLen - UDP_HEADER;
+  return PARSE_UDP;
+}
+
+// Finds the IP packet in a frame of the given link type
+ParseResult parseFrame(const Packet& pkt, uint16_t& srcPort, uint16_t& dstPort,
+                       const uint8_t*& payload, uint32_t& payloadLen) {
+  const uint8_t* p = pkt.data;
+  uint32_t len = pkt.capLen;
+  uint32_t off;
+  uint16_t etherType;
+  switch (pkt.linkType) {
+  case LINK_ETHERNET:
+    if (len < ETH_HEADER) {
+      return PARSE_TRUNCATED;
+    }
+    off = 12;
+    etherType = be16(p + off);
+    // 802.1Q and 802.1ad tags
+    while (etherType == 0x8100 || etherType == 0x88a8) {
+      off += 4;
+      if (off + 2 > len) {
+        return PARSE_TRUNCATED;
+      }
+      etherType = be16(p + off);
+    }
+    off += 2;
+    break;
+  case LINK_LINUX_SLL:
+    if (len < 16) {
+      return PARSE_TRUNCATED;
+    }
+    etherType = be16(p + 14);
+    off = 16;
+    break;
+  case LINK_LINUX_SLL2:
+    if (len < 20) {
+      return PARSE_TRUNCATED;
+    }
+    etherType = be16(p);
+    off = 20;
+    break;
+  case LINK_NULL: {
+    if (len < 4) {
+      return PARSE_TRUNCATED;
+    }
+    // Address family in the capturing host's order; 2 is AF_INET
+    // everywhere, IPv6 differs between systems, so go by the IP version
+    off = 4;
+    etherType = 0;
+    break;
+  }
+  case LINK_RAW:
+  case LINK_IPV4:
+  case LINK_IPV6:
+    off = 0;
+    etherType = 0;
+    break;
+  default:
+    return PARSE_OTHER;
+  }
+  if (etherType != 0 && etherType != 0x0800 && etherType != 0x86dd) {
+    return PARSE_OTHER;
+  }
+  if (off > len) {
+    return PARSE_TRUNCATED;
+  }
+  return parseIp(p + off, len - off, srcPort, dstPort, payload, payloadLen);
+}
+
+} // namespace
+
+PcapTrace::ExportOptions::ExportOptions() {
+  static const uint8_t clientMac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+  static const uint8_t serverMac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  memcpy(client.mac, clientMac, 6);
+  client.ip = 0x0A000002;
+  client.port = 40000;
+  memcpy(server.mac, serverMac, 6);
+  server.ip = 0x0A000001;
+  server.port = 9090;
+}
+
+PcapTrace::Stats PcapTrace::exportPcapng(const std::string& requests,
+                                         const std::string& responses,
+                                         const std::string& out,
+                                         const ExportOptions& options) {
+  Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  TraceReader in(requests);
+  std::unique_ptr<TraceReader> back(responses.empty() ? nullptr : new TraceReader(responses));
+  PcapngWriter writer(out);
+  std::vector<uint8_t> frame;
+  uint16_t ipId = 0;
+
+  // Merge the two streams by timestamp, requests first on ties
+  for (;;) {
+    const std::vector<uint8_t>* request = in.peek();
+    const std::vector<uint8_t>* response = back ? back->peek() : nullptr;
+    if (!request && !response) {
+      break;
+    }
+    bool inbound = request && (!response || in.timestamp() <= back->timestamp());
+    TraceReader& from = inbound ? in : *back;
+    const std::vector<uint8_t>& payload = inbound ? *request : *response;
+    buildFrame(frame, inbound ? options.client : options.server,
+               inbound ? options.server : options.client, payload, ipId++);
+    std::string comment = inbound ? "dpdk_to_rpc" : "rpc_to_dpdk";
+    if (from.reqId() != 0) {
+      comment += " req_id=" + std::to_string(from.reqId());
+    }
+    writer.writePacket(from.timestamp(), frame, inbound, comment);
+    from.pop();
+    stats.packets++;
+    if (inbound) {
+      stats.requests++;
+    } else {
+      stats.responses++;
+    }
+  }
+  writer.close();
+  return stats;
+}
+
+PcapTrace::Stats PcapTrace::importPcap(const std::string& in,
+                                       uint16_t port,
+                                       const std::string& requests,
+                                       const std::string& responses) {
+  Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  CaptureReader reader(in);
+  TraceWriter requestOut(requests);
+  std::unique_ptr<TraceWriter> responseOut(responses.empty() ? nullptr
+                                                             : new TraceWriter(responses));
+  Packet pkt;
+  while (reader.next(pkt)) {
+    stats.packets++;
+    uint16_t srcPort, dstPort;
+    const uint8_t* payload;
+    uint32_t payloadLen;
+    ParseResult result = parseFrame(pkt, srcPort, dstPort, payload, payloadLen);
+    if (result == PARSE_TRUNCATED) {
+      stats.truncated++;
+      continue;
+    }
+    if (result != PARSE_UDP) {
+      stats.skipped++;
+      continue;
+    }
+    if (dstPort == port) {
+      requestOut.write(pkt.ns, payload, static_cast<uint16_t>(payloadLen));
+      stats.requests++;
+    } else if (srcPort == port && responseOut) {
+      responseOut->write(pkt.ns, payload, static_cast<uint16_t>(payloadLen));
+      stats.responses++;
+    } else {
+      stats.skipped++;
+    }
+  }
+  requestOut.close();
+  if (responseOut) {
+    responseOut->close();
+  }
+  return stats;
+}
+
+}}} // apache::thrift::transport
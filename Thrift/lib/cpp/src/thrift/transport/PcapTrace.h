@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_PCAPTRACE_H_
+#define _THRIFT_TRANSPORT_PCAPTRACE_H_ 1
+
+#include <stdint.h>
+#include <string>
+
+#include <thrift/transport/TTransportException.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Converts between the packet traces PacketLogger writes and pcap.
+ *
+ * exportPcapng() writes the dpdk_to_rpc and rpc_to_dpdk streams as one
+ * pcapng file, merged by timestamp, so that Wireshark and tcpdump can
+ * read them. Each payload gets Ethernet, IPv4 and UDP headers between a
+ * made up client and server, nanosecond timestamps, the direction in
+ * epb_flags and the stage it was logged at as a comment.
+ *
+ * importPcap() goes the other way: the UDP payloads of a pcap or pcapng
+ * capture, say tcpdump on a production host, sent to the server port
+ * become a dpdk_to_rpc trace for PacketReplaySocket and the ones sent
+ * from it an rpc_to_dpdk trace for validation. Ethernet (VLAN tagged or
+ * not), Linux cooked, raw IP and loopback captures of IPv4 and IPv6 are
+ * read; IP fragments are skipped, the capture is expected to hold whole
+ * datagrams.
+ *
+ * Both stream record by record and hold one packet at a time. Errors
+ * opening, reading or writing files, and captures that are not pcap,
+ * throw TTransportException.
+ */
+class PcapTrace {
+public:
+  struct Endpoint {
+    uint8_t mac[6];
+    uint32_t ip;    // IPv4, host order
+    uint16_t port;
+  };
+
+  struct ExportOptions {
+    ExportOptions();  // client 10.0.0.2:40000, server 10.0.0.1:9090
+    Endpoint client;
+    Endpoint server;
+  };
+
+  struct Stats {
+    uint64_t packets;    // read
+    uint64_t requests;   // written, client to server
+    uint64_t responses;  // written, server to client
+    uint64_t skipped;    // not UDP to or from the port, or an IP fragment
+    uint64_t truncated;  // cut short by the capture's snap length
+  };
+
+  /**
+   * Writes the records of requests, a dpdk_to_rpc trace, and responses,
+   * an rpc_to_dpdk trace or empty for none, to out as pcapng.
+   */
+  static Stats exportPcapng(const std::string& requests,
+                            const std::string& responses,
+                            const std::string& out,
+                            const ExportOptions& options = ExportOptions());
+
+  /**
+   * Writes the UDP payloads of the capture in to requests, those sent to
+   * port, and responses, those sent from it, unless empty.
+   */
+  static Stats importPcap(const std::string& in,
+                          uint16_t port,
+                          const std::string& requests,
+                          const std::string& responses);
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_PCAPTRACE_H_
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// ReplayScheduler.h
+#ifndef _THRIFT_TRANSPORT_REPLAYSCHEDULER_H_
+#define _THRIFT_TRANSPORT_REPLAYSCHEDULER_H_ 1
+
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <thrift/transport/LatencyHistogram.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Open-loop pacing for trace replay.
+ *
+ * release() holds each request back until its recorded arrival: its
+ * trace timestamp less the first request's, divided by the speed, after
+ * the moment the first request was released. A request whose time has
+ * passed, because the previous ones took longer, is released at once and
+ * the wait counts as queueing delay, so bursts in the trace queue up the
+ * way they did in production instead of being smoothed out.
+ *
+ * complete() closes the request and records three latencies:
+ *
+ *   queueing  from the recorded arrival until release()
+ *   service   from release() until complete()
+ *   response  the two together, what a client would have seen
+ *
+ * Not thread safe; one per replay loop.
+ */
+class ReplayScheduler {
+public:
+  enum {
+    SPIN_NS = 50000  // sleep until this close to a release, then spin
+  };
+
+  explicit ReplayScheduler(double speed = 1.0)
+    : speed_(speed > 0 ? speed : 1.0),
+      started_(false),
+      traceBase_(0),
+      wallBase_(0),
+      intended_(0),
+      begin_(0) {}
+
+  /** 2 replays twice as fast as recorded, 0.5 at half speed */
+  void setSpeed(double speed) { speed_ = speed > 0 ? speed : 1.0; }
+  double getSpeed() const { return speed_; }
+
+  /** Waits until the request recorded at traceNs is due */
+  void release(uint64_t traceNs) {
+    uint64_t now = nowNs();
+    if (!started_) {
+      traceBase_ = traceNs;
+      wallBase_ = now;
+      started_ = true;
+    }
+    // Out of order timestamps are due at once
+    uint64_t offset = traceNs > traceBase_ ? traceNs - traceBase_ : 0;
+    intended_ = wallBase_ + static_cast<uint64_t>(offset / speed_);
+    begin_ = now < intended_ ? waitUntil(intended_) : now;
+  }
+
+  void complete() {
+    uint64_t end = nowNs();
+    queueing_.record(begin_ - intended_);
+    service_.record(end - begin_);
+    response_.record(end - intended_);
+  }
+
+  const LatencyHistogram& queueing() const { return queueing_; }
+  const LatencyHistogram& service() const { return service_; }
+  const LatencyHistogram& response() const { return response_; }
+
+  /**
+   * Writes the three histograms as prefix_queueing.hgrm, prefix_service.hgrm
+   * and prefix_response.hgrm, in microseconds. False if one can't be written.
+   */
+  bool writeReports(const std::string& prefix) const {
+    return writeReport(prefix + "_queueing.hgrm", queueing_)
+           && writeReport(prefix + "_service.hgrm", service_)
+           && writeReport(prefix + "_response.hgrm", response_);
+  }
+
+private:
+  static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Sleeping is too coarse for microsecond gaps; only the last SPIN_NS spin
+  static uint64_t waitUntil(uint64_t when) {
+    for (;;) {
+      uint64_t now = nowNs();
+      if (now >= when) {
+        return now;
+      }
+      if (when - now > SPIN_NS) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(when - now - SPIN_NS));
+      }
+    }
+  }
+
+  static bool writeReport(const std::string& path, const LatencyHistogram& histogram) {
+    std::ofstream out(path.c_str());
+    if (!out) {
+      return false;
+    }
+    histogram.print(out);
+    return static_cast<bool>(out);
+  }
+
+  double speed_;
+  bool started_;
+  uint64_t traceBase_;
+  uint64_t wallBase_;
+  uint64_t intended_;  // recorded arrival of the current request, on our clock
+  uint64_t begin_;     // when it was released
+  LatencyHistogram queueing_;
+  LatencyHistogram service_;
+  LatencyHistogram response_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_REPLAYSCHEDULER_H_
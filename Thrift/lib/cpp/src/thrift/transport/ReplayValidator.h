@@ -0,0 +1,650 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// ReplayValidator.h
+#ifndef _THRIFT_TRANSPORT_REPLAYVALIDATOR_H_
+#define _THRIFT_TRANSPORT_REPLAYVALIDATOR_H_ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <thrift/transport/BlockTrace.h>
+#include <thrift/transport/MessageHeader.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Checks the responses of a replay against the ones captured with the
+ * trace, byte for byte.
+ *
+ * Both sides are sequences of records: PacketLogger captures (CAPTURE,
+ * [ts][req_id][u16 size][data]) or PacketReplaySocket response segments
+ * (REPLAY, [ts][u16 size][data] on 64 byte boundaries), one or more files
+ * (block traces included) or buffers per side, in order. Each record is read as a Thrift message
+ * in the binary (strict or not) or compact protocol, optionally framed,
+ * and responses are matched to captured records by method name and seqid.
+ *
+ * Records are compared in step for as long as the two sides line up,
+ * which costs a header parse and a memcmp per record. At the first record
+ * that does not, the rest of the capture is indexed by (method, seqid)
+ * and the remaining responses are looked up in it; records that do not
+ * parse are paired with the remaining unparsed captured records in order.
+ *
+ * Fields that legitimately differ from run to run, generated ids and
+ * timestamps, are masked out of the comparison: by top level field id
+ * of the message struct (binary protocol), or by byte range from the
+ * start of the message. validate() fills in a summary and the first
+ * maxDiffs differences; print() writes both.
+ */
+class ReplayValidator {
+public:
+  enum Format {
+    CAPTURE,  // PacketLogger .bin
+    REPLAY    // PacketReplaySocket responses
+  };
+
+  enum DiffKind {
+    MISSING,     // captured, no response for it
+    UNEXPECTED,  // response matching nothing captured
+    SIZE,        // sizes differ
+    CONTENT      // same size, bytes differ outside the masks
+  };
+
+  struct Diff {
+    DiffKind kind;
+    std::string method;
+    int32_t seqid;
+    int64_t expectedIndex;  // record number on each side, -1 if none
+    int64_t actualIndex;
+    uint32_t offset;        // first differing byte
+    std::string expectedBytes;  // hex, around offset
+    std::string actualBytes;
+  };
+
+  struct Summary {
+    uint64_t expected;
+    uint64_t actual;
+    uint64_t matched;
+    uint64_t reordered;  // matched out of step
+    uint64_t identical;
+    uint64_t differing;
+    uint64_t missing;
+    uint64_t unexpected;
+    uint64_t unparsed;   // not a Thrift message; matched by order among these
+  };
+
+  explicit ReplayValidator(size_t maxDiffs = 10) : maxDiffs_(maxDiffs) { clearResults(); }
+
+  void setMaxDiffs(size_t maxDiffs) { maxDiffs_ = maxDiffs; }
+
+  /** Leaves out field fieldId of method's message struct; "" for any method */
+  void maskField(const std::string& method, int16_t fieldId) {
+    masks_[method].fields.push_back(fieldId);
+  }
+
+  /** Leaves out length bytes at offset from the start of method's messages */
+  void maskBytes(const std::string& method, uint32_t offset, uint32_t length) {
+    masks_[method].ranges.push_back(Range(offset, offset + length));
+  }
+
+  /** Appends a file to the captured (expected) or replayed side */
+  bool addExpectedFile(const std::string& path, Format format) {
+    return addFile(expected_, path, format);
+  }
+  bool addActualFile(const std::string& path, Format format) {
+    return addFile(actual_, path, format);
+  }
+
+  /** Appends records held by the caller, who keeps them until validate() */
+  void addExpected(const uint8_t* data, size_t size, Format format) {
+    expected_.push_back(Chunk(data, size, format));
+  }
+  void addActual(const uint8_t* data, size_t size, Format format) {
+    actual_.push_back(Chunk(data, size, format));
+  }
+
+  /** Matches and compares everything added; true if nothing differs */
+  bool validate() {
+    clearResults();
+    Cursor exp(expected_);
+    Cursor act(actual_);
+    Record e, a;
+    bool haveE = exp.next(e);
+    bool haveA = act.next(a);
+
+    // In step while the keys agree
+    while (haveE && haveA && sameKey(e, a)) {
+      summary_.matched++;
+      compare(e, a);
+      haveE = exp.next(e);
+      haveA = act.next(a);
+    }
+
+    if (haveE || haveA) {
+      // Out of step: sort what is left of the capture by key hash, in
+      // capture order within a hash. Unparsed records have no key and
+      // are paired with the unparsed records left, in order.
+      std::vector<Record> rest;
+      std::vector<std::pair<uint64_t, uint32_t> > index;
+      std::vector<uint32_t> unparsed;
+      for (; haveE; haveE = exp.next(e)) {
+        if (e.parsed) {
+          index.push_back(std::make_pair(keyHash(e), static_cast<uint32_t>(rest.size())));
+        } else {
+          unparsed.push_back(static_cast<uint32_t>(rest.size()));
+        }
+        rest.push_back(e);
+      }
+      std::sort(index.begin(), index.end());
+      std::vector<bool> used(rest.size(), false);
+      size_t nextUnparsed = 0;
+
+      for (; haveA; haveA = act.next(a)) {
+        const Record* match = nullptr;
+        if (!a.parsed) {
+          if (nextUnparsed < unparsed.size()) {
+            used[unparsed[nextUnparsed]] = true;
+            match = &rest[unparsed[nextUnparsed++]];
+          }
+        } else {
+          uint64_t hash = keyHash(a);
+          std::vector<std::pair<uint64_t, uint32_t> >::iterator it = std::lower_bound(
+              index.begin(), index.end(), std::make_pair(hash, static_cast<uint32_t>(0)));
+          for (; it != index.end() && it->first == hash; ++it) {
+            if (!used[it->second] && sameKey(rest[it->second], a)) {
+              used[it->second] = true;
+              match = &rest[it->second];
+              break;
+            }
+          }
+        }
+        if (!match) {
+          summary_.unexpected++;
+          addDiff(UNEXPECTED, nullptr, &a, 0);
+          continue;
+        }
+        summary_.matched++;
+        if (match->index != a.index) {
+          summary_.reordered++;
+        }
+        compare(*match, a);
+      }
+      for (size_t i = 0; i < rest.size(); ++i) {
+        if (!used[i]) {
+          summary_.missing++;
+          addDiff(MISSING, &rest[i], nullptr, 0);
+        }
+      }
+    }
+
+    summary_.expected = exp.count();
+    summary_.actual = act.count();
+    summary_.unparsed = exp.unparsed() + act.unparsed();
+    return summary_.differing == 0 && summary_.missing == 0 && summary_.unexpected == 0;
+  }
+
+  const Summary& summary() const { return summary_; }
+  const std::vector<Diff>& diffs() const { return diffs_; }
+
+  void print(std::ostream& out) const {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "Replay validation: %llu captured, %llu replayed\n"
+             "  matched     %llu (%llu out of order)\n"
+             "  identical   %llu\n"
+             "  differing   %llu\n"
+             "  missing     %llu\n"
+             "  unexpected  %llu\n"
+             "  unparsed    %llu\n",
+             (unsigned long long)summary_.expected, (unsigned long long)summary_.actual,
+             (unsigned long long)summary_.matched, (unsigned long long)summary_.reordered,
+             (unsigned long long)summary_.identical, (unsigned long long)summary_.differing,
+             (unsigned long long)summary_.missing, (unsigned long long)summary_.unexpected,
+             (unsigned long long)summary_.unparsed);
+    out << line;
+    if (diffs_.empty()) {
+      return;
+    }
+    out << "First " << diffs_.size() << " difference" << (diffs_.size() > 1 ? "s" : "") << ":\n";
+    static const char* kinds[] = {"missing", "unexpected", "size", "content"};
+    for (size_t i = 0; i < diffs_.size(); ++i) {
+      const Diff& d = diffs_[i];
+      snprintf(line, sizeof(line), "  #%zu %s %s seqid %d (captured #%lld, replayed #%lld)", i + 1,
+               kinds[d.kind], d.method.empty() ? "?" : d.method.c_str(), d.seqid,
+               (long long)d.expectedIndex, (long long)d.actualIndex);
+      out << line;
+      if (d.kind == SIZE || d.kind == CONTENT) {
+        out << " at byte " << d.offset;
+      }
+      out << "\n";
+      if (!d.expectedBytes.empty()) {
+        out << "     captured: " << d.expectedBytes << "\n";
+      }
+      if (!d.actualBytes.empty()) {
+        out << "     replayed: " << d.actualBytes << "\n";
+      }
+    }
+  }
+
+private:
+  enum {
+    CONTEXT_BYTES = 8,   // shown before a difference
+    SHOWN_BYTES = 24,
+    CAPTURE_HEADER = 18, // ts, req_id, size
+    REPLAY_HEADER = 10   // ts, size
+  };
+
+  typedef std::pair<uint32_t, uint32_t> Range;  // [first, second)
+
+  struct Masks {
+    std::vector<int16_t> fields;
+    std::vector<Range> ranges;
+  };
+
+  struct Chunk {
+    Chunk(const uint8_t* d, size_t s, Format f) : data(d), size(s), format(f) {}
+    const uint8_t* data;
+    size_t size;
+    Format format;
+  };
+
+  // binary says whether fields can be masked
+  struct Record : MessageHeader {
+    const uint8_t* data;
+    uint32_t size;
+    int64_t index;
+    bool parsed;
+  };
+
+  // A file mapped for the life of the validator; block traces are
+  // decompressed into anonymous memory instead
+  class MappedFile {
+  public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    ~MappedFile() {
+      if (data_) {
+        munmap(data_, size_);
+      }
+    }
+    bool open(const std::string& path) {
+      if (BlockTrace::isBlockTrace(path)) {
+        return inflate(path);
+      }
+      int fd = ::open(path.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        return false;
+      }
+      size_ = st.st_size;
+      if (size_ > 0) {
+        void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+          ::close(fd);
+          return false;
+        }
+        madvise(map, size_, MADV_SEQUENTIAL);
+        data_ = map;
+      }
+      ::close(fd);
+      return true;
+    }
+    const uint8_t* data() const { return static_cast<const uint8_t*>(data_); }
+    size_t size() const { return size_; }
+
+  private:
+    bool inflate(const std::string& path) {
+      try {
+        BlockTraceReader reader(path);
+        size_ = reader.rawSize();
+        if (size_ == 0) {
+          return true;
+        }
+        void* map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+          size_ = 0;
+          return false;
+        }
+        data_ = map;
+        for (size_t i = 0; i < reader.blocks(); ++i) {
+          reader.read(i, static_cast<uint8_t*>(data_) + reader.block(i).rawOffset);
+        }
+        return true;
+      } catch (const TTransportException&) {
+        return false;
+      }
+    }
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    void* data_;
+    size_t size_;
+  };
+
+  // Walks the records of one side across its chunks
+  class Cursor {
+  public:
+    explicit Cursor(const std::vector<Chunk>& chunks)
+      : chunks_(chunks), chunk_(0), pos_(0), count_(0), unparsed_(0) {}
+
+    bool next(Record& r) {
+      for (; chunk_ < chunks_.size(); ++chunk_, pos_ = 0) {
+        const Chunk& c = chunks_[chunk_];
+        uint32_t header = c.format == CAPTURE ? CAPTURE_HEADER : REPLAY_HEADER;
+        uint32_t sizeAt = c.format == CAPTURE ? 16 : 8;
+        if (pos_ + header > c.size) {
+          continue;
+        }
+        uint16_t size;
+        memcpy(&size, c.data + pos_ + sizeAt, sizeof(size));
+        if (pos_ + header + size > c.size) {
+          continue;
+        }
+        r.data = c.data + pos_ + header;
+        r.size = size;
+        r.index = static_cast<int64_t>(count_++);
+        pos_ += header + size;
+        if (c.format == REPLAY) {
+          pos_ = (pos_ + 63) & ~static_cast<size_t>(63);
+        }
+        r.parsed = MessageHeader::parse(r.data, r.size, r);
+        if (!r.parsed) {
+          unparsed_++;
+        }
+        return true;
+      }
+      return false;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t unparsed() const { return unparsed_; }
+
+  private:
+    const std::vector<Chunk>& chunks_;
+    size_t chunk_;
+    size_t pos_;
+    uint64_t count_;
+    uint64_t unparsed_;
+  };
+
+  // FNV-1a over the method name, then the seqid
+  static uint64_t keyHash(const Record& r) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t i = 0; i < r.methodLen; ++i) {
+      hash = (hash ^ static_cast<uint8_t>(r.method[i])) * 1099511628211ULL;
+    }
+    return (hash ^ static_cast<uint32_t>(r.seqid)) * 1099511628211ULL;
+  }
+
+  // Unparsed records only line up with unparsed records
+  static bool sameKey(const Record& a, const Record& b) {
+    if (!a.parsed || !b.parsed) {
+      return a.parsed == b.parsed;
+    }
+    return a.seqid == b.seqid && a.methodLen == b.methodLen
+           && memcmp(a.method, b.method, a.methodLen) == 0;
+  }
+
+  // Skips one binary protocol value of the given type; false if truncated
+  static bool skipBinary(const uint8_t* p, uint32_t size, uint32_t& pos, uint8_t type, int depth) {
+    if (depth > 64) {
+      return false;
+    }
+    uint32_t fixed = 0;
+    switch (type) {
+    case 2:  // bool
+    case 3:  // byte
+      fixed = 1;
+      break;
+    case 6:  // i16
+      fixed = 2;
+      break;
+    case 8:  // i32
+      fixed = 4;
+      break;
+    case 4:  // double
+    case 10: // i64
+      fixed = 8;
+      break;
+    case 16: // uuid
+      fixed = 16;
+      break;
+    case 11: { // string, binary
+      if (pos + 4 > size) {
+        return false;
+      }
+      uint32_t len = MessageHeader::readBE32(p + pos);
+      pos += 4;
+      if (len > size - pos) {
+        return false;
+      }
+      pos += len;
+      return true;
+    }
+    case 12: // struct
+      for (;;) {
+        if (pos + 1 > size) {
+          return false;
+        }
+        uint8_t fieldType = p[pos++];
+        if (fieldType == 0) {
+          return true;
+        }
+        pos += 2;
+        if (pos > size || !skipBinary(p, size, pos, fieldType, depth + 1)) {
+          return false;
+        }
+      }
+    case 13: { // map
+      if (pos + 6 > size) {
+        return false;
+      }
+      uint8_t keyType = p[pos], valueType = p[pos + 1];
+      uint32_t n = MessageHeader::readBE32(p + pos + 2);
+      pos += 6;
+      for (uint32_t i = 0; i < n; ++i) {
+        if (!skipBinary(p, size, pos, keyType, depth + 1)
+            || !skipBinary(p, size, pos, valueType, depth + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case 14: // set
+    case 15: { // list
+      if (pos + 5 > size) {
+        return false;
+      }
+      uint8_t elemType = p[pos];
+      uint32_t n = MessageHeader::readBE32(p + pos + 1);
+      pos += 5;
+      for (uint32_t i = 0; i < n; ++i) {
+        if (!skipBinary(p, size, pos, elemType, depth + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+    if (fixed > size - pos) {
+      return false;
+    }
+    pos += fixed;
+    return true;
+  }
+
+  // Byte ranges of r left out of the comparison, sorted
+  void maskedRanges(const Record& r, std::vector<Range>& out) const {
+    out.clear();
+    std::string method(r.method, r.methodLen);
+    const std::string* names[] = {&method, &anyMethod_};
+    for (int n = 0; n < (method.empty() ? 1 : 2); ++n) {
+      std::map<std::string, Masks>::const_iterator it = masks_.find(*names[n]);
+      if (it == masks_.end()) {
+        continue;
+      }
+      const Masks& m = it->second;
+      out.insert(out.end(), m.ranges.begin(), m.ranges.end());
+      if (m.fields.empty() || !r.binary) {
+        continue;
+      }
+      // Top level fields of the message struct
+      uint32_t pos = r.body;
+      while (pos + 1 <= r.size && r.data[pos] != 0 && pos + 3 <= r.size) {
+        uint8_t type = r.data[pos];
+        int16_t id = static_cast<int16_t>((r.data[pos + 1] << 8) | r.data[pos + 2]);
+        pos += 3;
+        uint32_t start = pos;
+        if (!skipBinary(r.data, r.size, pos, type, 0)) {
+          break;
+        }
+        if (std::find(m.fields.begin(), m.fields.end(), id) != m.fields.end()) {
+          out.push_back(Range(start, pos));
+        }
+      }
+    }
+    std::sort(out.begin(), out.end());
+  }
+
+  // Offset of the first byte differing outside the masks, or size if none
+  static uint32_t firstDifference(const uint8_t* a, const uint8_t* b, uint32_t size,
+                                  const std::vector<Range>& masks) {
+    uint32_t pos = 0;
+    for (size_t i = 0; i <= masks.size(); ++i) {
+      uint32_t end = i < masks.size() ? std::min(masks[i].first, size) : size;
+      if (end > pos && memcmp(a + pos, b + pos, end - pos) != 0) {
+        while (a[pos] == b[pos]) {
+          ++pos;
+        }
+        return pos;
+      }
+      if (i < masks.size()) {
+        pos = std::max(pos, std::min(masks[i].second, size));
+      }
+    }
+    return size;
+  }
+
+  void compare(const Record& e, const Record& a) {
+    uint32_t common = std::min(e.size, a.size);
+    uint32_t offset;
+    if (masks_.empty() || !e.parsed) {
+      offset = e.size == a.size && memcmp(e.data, a.data, e.size) == 0
+                   ? e.size
+                   : firstDifference(e.data, a.data, common, noMasks_);
+    } else {
+      maskedRanges(e, ranges_);
+      offset = firstDifference(e.data, a.data, common, ranges_);
+    }
+    if (e.size == a.size && offset == e.size) {
+      summary_.identical++;
+      return;
+    }
+    summary_.differing++;
+    addDiff(e.size != a.size ? SIZE : CONTENT, &e, &a, offset);
+  }
+
+  void addDiff(DiffKind kind, const Record* e, const Record* a, uint32_t offset) {
+    if (diffs_.size() >= maxDiffs_) {
+      return;
+    }
+    const Record* r = e ? e : a;
+    Diff d;
+    d.kind = kind;
+    d.method = r->parsed ? std::string(r->method, r->methodLen) : std::string();
+    d.seqid = r->parsed ? r->seqid : -1;
+    d.expectedIndex = e ? e->index : -1;
+    d.actualIndex = a ? a->index : -1;
+    d.offset = offset;
+    uint32_t from = offset > CONTEXT_BYTES ? offset - CONTEXT_BYTES : 0;
+    if (e) {
+      d.expectedBytes = hex(*e, from);
+    }
+    if (a) {
+      d.actualBytes = hex(*a, from);
+    }
+    diffs_.push_back(d);
+  }
+
+  static std::string hex(const Record& r, uint32_t from) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    if (from > 0) {
+      out += "+" + std::to_string(from) + ": ";
+    }
+    for (uint32_t i = from; i < r.size && i < from + SHOWN_BYTES; ++i) {
+      if (i > from) {
+        out += ' ';
+      }
+      out += digits[r.data[i] >> 4];
+      out += digits[r.data[i] & 0xf];
+    }
+    if (r.size > from + SHOWN_BYTES) {
+      out += " ...";
+    }
+    return out;
+  }
+
+  bool addFile(std::vector<Chunk>& side, const std::string& path, Format format) {
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(path)) {
+      return false;
+    }
+    files_.push_back(file);
+    side.push_back(Chunk(file->data(), file->size(), format));
+    return true;
+  }
+
+  void clearResults() {
+    memset(&summary_, 0, sizeof(summary_));
+    diffs_.clear();
+  }
+
+  size_t maxDiffs_;
+  std::map<std::string, Masks> masks_;
+  const std::string anyMethod_;
+  const std::vector<Range> noMasks_;
+  std::vector<Range> ranges_;  // scratch for compare()
+  std::vector<Chunk> expected_;
+  std::vector<Chunk> actual_;
+  std::vector<std::shared_ptr<MappedFile> > files_;
+  Summary summary_;
+  std::vector<Diff> diffs_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_REPLAYVALIDATOR_H_
@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _THRIFT_TRANSPORT_SHAREDRING_H_
+#define _THRIFT_TRANSPORT_SHAREDRING_H_ 1
+
+#include <sched.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Single producer, single consumer ring of packet slots, meant to live in
+ * shared memory between a DPDK poller and the thread running the RPCs.
+ *
+ * Each slot carries one datagram and the peer it came from or goes to, so
+ * several requests can be in flight at once. The producer and consumer
+ * indexes live on their own cache lines, each next to a cached copy of the
+ * other side's index, so neither side touches the other's line unless the
+ * ring looks full or empty.
+ *
+ * Only atomics are shared, which works across processes as well as
+ * threads. The consumer either busy-polls, or spins for a while and then
+ * sleeps on a process-shared semaphore; the producer only posts it when
+ * the consumer has said it is going to sleep.
+ *
+ * A datagram has to fit one slot, MAX_DATA bytes; push() and tryPush()
+ * refuse longer ones rather than split them.
+ */
+struct SharedRing {
+  static const uint32_t SLOTS = 256; // power of two
+  static const uint32_t SLOT_SIZE = 4096;
+  static const uint32_t MAX_DATA = SLOT_SIZE - 64;
+
+  enum WaitMode {
+    WAIT_BUSY_POLL, // never sleep; lowest latency, burns a core
+    WAIT_ADAPTIVE   // spin spinLimit times, then sleep until woken
+  };
+
+  struct alignas(64) Slot {
+    uint32_t size;
+    uint64_t peer; // opaque; the DPDK side packs the peer's IP and port
+    alignas(64) uint8_t data[MAX_DATA];
+  };
+
+  void init(WaitMode mode = WAIT_ADAPTIVE, uint32_t spins = 2048) {
+    tail.store(0, std::memory_order_relaxed);
+    cachedHead = 0;
+    head.store(0, std::memory_order_relaxed);
+    cachedTail = 0;
+    lastPeer = 0;
+    waiting.store(0, std::memory_order_relaxed);
+    setWaitMode(mode, spins);
+    sem_init(&sem, 1, 0);
+  }
+
+  void destroy() { sem_destroy(&sem); }
+
+  void setWaitMode(WaitMode mode, uint32_t spins = 2048) {
+    waitMode = mode;
+    spinLimit = spins;
+  }
+
+  // Producer side
+
+  /**
+   * Copies len bytes into the next slot.
+   *
+   * @return false if the ring is full or the datagram does not fit a slot
+   */
+  bool tryPush(const uint8_t* buf, uint32_t len, uint64_t peerTag = 0) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (len > MAX_DATA || !hasRoom(t)) {
+      return false;
+    }
+    Slot& slot = slots[t & (SLOTS - 1)];
+    memcpy(slot.data, buf, len);
+    slot.size = len;
+    slot.peer = peerTag;
+    publish(t + 1);
+    return true;
+  }
+
+  /**
+   * Waits for room, yielding the CPU.
+   *
+   * @return false, without waiting, if len does not fit a slot
+   */
+  bool push(const uint8_t* buf, uint32_t len, uint64_t peerTag = 0) {
+    if (len > MAX_DATA) {
+      return false;
+    }
+    for (uint32_t i = 0; !tryPush(buf, len, peerTag); ++i) {
+      if (i >= spinLimit) {
+        sched_yield();
+      }
+    }
+    return true;
+  }
+
+  // Consumer side
+
+  /** The oldest slot without copying it, or nullptr; release() frees it */
+  const Slot* front() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == cachedTail) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (h == cachedTail) {
+        return nullptr;
+      }
+    }
+    return &slots[h & (SLOTS - 1)];
+  }
+
+  void release() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    lastPeer = slots[h & (SLOTS - 1)].peer;
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  /**
+   * Waits for the next datagram and copies up to len bytes of it; the rest
+   * of a longer datagram is dropped, as with recvfrom().
+   */
+  uint32_t pop(uint8_t* buf, uint32_t len) {
+    const Slot* slot = waitFront();
+    uint32_t n = (std::min)(len, slot->size);
+    memcpy(buf, slot->data, n);
+    release();
+    return n;
+  }
+
+  /** Peer of the datagram released last, to tag the reply with */
+  uint64_t lastPeerTag() const { return lastPeer; }
+
+private:
+  bool hasRoom(uint32_t t) {
+    if (t - cachedHead < SLOTS) {
+      return true;
+    }
+    cachedHead = head.load(std::memory_order_acquire);
+    return t - cachedHead < SLOTS;
+  }
+
+  void publish(uint32_t t) {
+    tail.store(t, std::memory_order_seq_cst);
+    // Pairs with the consumer's store to waiting: either it sees the new
+    // tail before sleeping, or we see that it sleeps
+    if (waiting.load(std::memory_order_seq_cst) && waiting.exchange(0)) {
+      sem_post(&sem);
+    }
+  }
+
+  const Slot* waitFront() {
+    for (uint32_t i = 0;; ++i) {
+      const Slot* slot = front();
+      if (slot) {
+        return slot;
+      }
+      if (waitMode == WAIT_ADAPTIVE && i >= spinLimit) {
+        waiting.store(1, std::memory_order_seq_cst);
+        slot = front();
+        if (slot) {
+          waiting.store(0, std::memory_order_relaxed);
+          return slot;
+        }
+        while (sem_wait(&sem) == -1 && errno == EINTR) {
+        }
+        i = 0;
+      }
+    }
+  }
+
+  // Producer's cache line
+  alignas(64) std::atomic<uint32_t> tail;
+  uint32_t cachedHead;
+
+  // Consumer's cache line
+  alignas(64) std::atomic<uint32_t> head;
+  uint32_t cachedTail;
+  uint64_t lastPeer;
+
+  // Wakeup, written only around sleeping
+  alignas(64) std::atomic<uint32_t> waiting;
+  WaitMode waitMode;
+  uint32_t spinLimit;
+  sem_t sem;
+
+  Slot slots[SLOTS];
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_SHAREDRING_H_
@@ -0,0 +1,362 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// StageProfiler.h
+#ifndef _THRIFT_TRANSPORT_STAGEPROFILER_H_
+#define _THRIFT_TRANSPORT_STAGEPROFILER_H_ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <thrift/transport/LatencyHistogram.h>
+#include <thrift/transport/MessageHeader.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Where the time of a request goes, from the four PacketLogger streams.
+ *
+ * PacketLogger stamps a request at the four boundaries of the server:
+ * dpdk_to_rpc as it is read off the wire, rpc_to_app once the RPC layer
+ * has decoded the arguments, app_to_rpc when the handler has returned,
+ * rpc_to_dpdk as the reply is written. All four carry the same req_id,
+ * the connection's flow id and the seqid, and analyze() joins them into
+ *
+ *   decode  dpdk_to_rpc -> rpc_to_app, reading and decoding the call
+ *   app     rpc_to_app  -> app_to_rpc, dispatch and the handler
+ *   encode  app_to_rpc  -> rpc_to_dpdk, encoding and writing the reply
+ *   total   dpdk_to_rpc -> rpc_to_dpdk
+ *
+ * per request, optionally written as CSV, and as histograms for all
+ * requests and per method, the name taken from the dpdk_to_rpc packet.
+ *
+ * The streams are merged by timestamp, so only requests in flight are
+ * held. A stage without a record (the app stages when the server does
+ * not log them) leaves out the intervals that need it; requests never
+ * answered and records that match no request are counted. Binary traces
+ * only.
+ */
+class StageProfiler {
+public:
+  enum Point { DPDK_TO_RPC, RPC_TO_APP, APP_TO_RPC, RPC_TO_DPDK, POINTS };
+  enum Interval { DECODE, APP, ENCODE, TOTAL, INTERVALS };
+
+  struct Breakdown {
+    std::string method;
+    LatencyHistogram latency[INTERVALS];
+  };
+
+  struct Stats {
+    uint64_t requests;    // read and answered
+    uint64_t incomplete;  // answered without a stage in between, or not at all
+    uint64_t unmatched;   // records of no request in flight
+    uint64_t unlabeled;   // dpdk records with req_id 0, not starting a message
+  };
+
+  StageProfiler() : requestLog_(nullptr) {
+    overall_.method = "all";
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  /** Writes each request as a CSV line to out while analyzing */
+  void setRequestLog(std::ostream* out) {
+    requestLog_ = out;
+    if (out) {
+      *out << "flow,seqid,method,arrival_ns,decode_ns,app_ns,encode_ns,total_ns\n";
+    }
+  }
+
+  /**
+   * Reads dir/{dpdk_to_rpc,rpc_to_app,app_to_rpc,rpc_to_dpdk}.bin; false,
+   * with errno set, if one cannot be opened.
+   */
+  bool analyze(const std::string& dir) {
+    Stream streams[POINTS];
+    for (int i = 0; i < POINTS; ++i) {
+      if (!streams[i].open(dir + "/" + streamName(static_cast<Point>(i)) + ".bin",
+                           static_cast<Point>(i))) {
+        return false;
+      }
+    }
+    for (;;) {
+      int next = -1;
+      for (int i = 0; i < POINTS; ++i) {
+        if (streams[i].ready()
+            && (next < 0 || streams[i].timestamp < streams[next].timestamp)) {
+          next = i;
+        }
+      }
+      if (next < 0) {
+        break;
+      }
+      Stream& s = streams[next];
+      add(static_cast<Point>(next), s.timestamp, s.reqId, s.data.data(),
+          static_cast<uint32_t>(s.data.size()));
+      s.advance();
+    }
+    finish();
+    return true;
+  }
+
+  /** One record, in timestamp order across the streams */
+  void add(Point point, uint64_t ns, int64_t reqId, const uint8_t* data, uint32_t size) {
+    if (reqId == 0) {
+      if (point == DPDK_TO_RPC || point == RPC_TO_DPDK) {
+        stats_.unlabeled++;
+      } else {
+        stats_.unmatched++;
+      }
+      return;
+    }
+    if (point == DPDK_TO_RPC) {
+      Pending& p = pending_[reqId];
+      if (p.seen) {
+        stats_.incomplete++;  // its reply never came
+      }
+      p.seen = 1;
+      p.ts[DPDK_TO_RPC] = ns;
+      MessageHeader header;
+      p.method = MessageHeader::parse(data, size, header)
+                     ? methodIndex(header.method, header.methodLen)
+                     : methodIndex("?", 1);
+      return;
+    }
+    auto it = pending_.find(reqId);
+    if (it == pending_.end() || (it->second.seen & (1 << point))) {
+      stats_.unmatched++;
+      return;
+    }
+    Pending& p = it->second;
+    p.seen |= 1 << point;
+    p.ts[point] = ns;
+    if (point == RPC_TO_DPDK) {
+      complete(reqId, p);
+      pending_.erase(it);
+    }
+  }
+
+  /** Counts the requests still in flight as incomplete */
+  void finish() {
+    stats_.incomplete += pending_.size();
+    pending_.clear();
+  }
+
+  const Stats& stats() const { return stats_; }
+  const Breakdown& overall() const { return overall_; }
+  const std::vector<Breakdown>& methods() const { return methods_; }
+
+  static const char* intervalName(Interval i) {
+    static const char* names[] = {"decode", "app", "encode", "total"};
+    return names[i];
+  }
+
+  static const char* streamName(Point p) {
+    static const char* names[] = {"dpdk_to_rpc", "rpc_to_app", "app_to_rpc", "rpc_to_dpdk"};
+    return names[p];
+  }
+
+  /** Percentiles of each interval, overall and per method, in microseconds */
+  void print(std::ostream& out) const {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "%llu requests, %llu incomplete, %llu unmatched, %llu unlabeled\n",
+             (unsigned long long)stats_.requests, (unsigned long long)stats_.incomplete,
+             (unsigned long long)stats_.unmatched, (unsigned long long)stats_.unlabeled);
+    out << line;
+    snprintf(line, sizeof(line), "%-24s %-7s %10s %9s %9s %9s %9s %9s %9s\n", "method", "stage",
+             "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    out << line;
+    printBreakdown(out, overall_);
+    for (size_t i = 0; i < methods_.size(); ++i) {
+      printBreakdown(out, methods_[i]);
+    }
+  }
+
+  /** Writes prefix_<method>_<interval>.hgrm for all requests and each method */
+  bool writeReports(const std::string& prefix) const {
+    if (!writeBreakdown(prefix, overall_)) {
+      return false;
+    }
+    for (size_t i = 0; i < methods_.size(); ++i) {
+      if (!writeBreakdown(prefix, methods_[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Pending {
+    Pending() : seen(0), method(0) {}
+    uint64_t ts[POINTS];
+    uint8_t seen;     // bit per Point
+    uint32_t method;  // in methods_
+  };
+
+  // One PacketLogger .bin file, read a record at a time
+  struct Stream {
+    Stream() : file(nullptr), header(0), timestamp(0), reqId(0), ready_(false) {}
+    ~Stream() {
+      if (file) {
+        fclose(file);
+      }
+    }
+
+    bool open(const std::string& path, Point point) {
+      file = fopen(path.c_str(), "rb");
+      if (!file) {
+        return false;
+      }
+      // ts and req_id, then post_type or result for the app stages, then size
+      header = point == RPC_TO_APP ? 22 : point == APP_TO_RPC ? 26 : 18;
+      advance();
+      return true;
+    }
+
+    // A partial record at the end, the logger stopped mid write, ends it
+    void advance() {
+      uint8_t buf[26];
+      ready_ = fread(buf, header, 1, file) == 1;
+      if (!ready_) {
+        return;
+      }
+      uint16_t size;
+      memcpy(&timestamp, buf, 8);
+      memcpy(&reqId, buf + 8, 8);
+      memcpy(&size, buf + header - 2, 2);
+      data.resize(size);
+      ready_ = size == 0 || fread(&data[0], size, 1, file) == 1;
+    }
+
+    bool ready() const { return ready_; }
+
+    FILE* file;
+    size_t header;
+    uint64_t timestamp;
+    int64_t reqId;
+    std::vector<uint8_t> data;
+
+  private:
+    Stream(const Stream&);
+    Stream& operator=(const Stream&);
+    bool ready_;
+  };
+
+  uint32_t methodIndex(const char* name, uint32_t len) {
+    std::string method(name, len);
+    auto it = methodIds_.find(method);
+    if (it != methodIds_.end()) {
+      return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(methods_.size());
+    methods_.push_back(Breakdown());
+    methods_.back().method = method;
+    methodIds_[method] = id;
+    return id;
+  }
+
+  // Time from a to b, when both were seen; -1 otherwise
+  static int64_t between(const Pending& p, Point a, Point b) {
+    if (!(p.seen & (1 << a)) || !(p.seen & (1 << b))) {
+      return -1;
+    }
+    return p.ts[b] > p.ts[a] ? static_cast<int64_t>(p.ts[b] - p.ts[a]) : 0;
+  }
+
+  void complete(int64_t reqId, const Pending& p) {
+    int64_t ns[INTERVALS] = {between(p, DPDK_TO_RPC, RPC_TO_APP),
+                             between(p, RPC_TO_APP, APP_TO_RPC),
+                             between(p, APP_TO_RPC, RPC_TO_DPDK),
+                             between(p, DPDK_TO_RPC, RPC_TO_DPDK)};
+    stats_.requests++;
+    if (p.seen != (1 << POINTS) - 1) {
+      stats_.incomplete++;
+    }
+    Breakdown& method = methods_[p.method];
+    for (int i = 0; i < INTERVALS; ++i) {
+      if (ns[i] >= 0) {
+        overall_.latency[i].record(static_cast<uint64_t>(ns[i]));
+        method.latency[i].record(static_cast<uint64_t>(ns[i]));
+      }
+    }
+    if (requestLog_) {
+      char line[320];
+      snprintf(line, sizeof(line), "%u,%d,%s,%llu,%lld,%lld,%lld,%lld\n",
+               static_cast<uint32_t>(static_cast<uint64_t>(reqId) >> 32),
+               static_cast<int32_t>(reqId), method.method.c_str(),
+               (unsigned long long)p.ts[DPDK_TO_RPC], (long long)ns[DECODE],
+               (long long)ns[APP], (long long)ns[ENCODE], (long long)ns[TOTAL]);
+      *requestLog_ << line;
+    }
+  }
+
+  static void printBreakdown(std::ostream& out, const Breakdown& b) {
+    char line[512];
+    for (int i = 0; i < INTERVALS; ++i) {
+      const LatencyHistogram& h = b.latency[i];
+      if (h.count() == 0) {
+        continue;
+      }
+      snprintf(line, sizeof(line), "%-24.24s %-7s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+               b.method.c_str(), intervalName(static_cast<Interval>(i)),
+               (unsigned long long)h.count(), h.mean() / 1000.0, h.percentile(50) / 1000.0,
+               h.percentile(90) / 1000.0, h.percentile(99) / 1000.0,
+               h.percentile(99.9) / 1000.0, h.max() / 1000.0);
+      out << line;
+    }
+  }
+
+  static bool writeBreakdown(const std::string& prefix, const Breakdown& b) {
+    for (int i = 0; i < INTERVALS; ++i) {
+      if (b.latency[i].count() == 0) {
+        continue;
+      }
+      std::ofstream out(
+          (prefix + "_" + b.method + "_" + intervalName(static_cast<Interval>(i)) + ".hgrm")
+              .c_str());
+      if (!out) {
+        return false;
+      }
+      b.latency[i].print(out);
+      if (!out) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::ostream* requestLog_;
+  Stats stats_;
+  Breakdown overall_;
+  std::vector<Breakdown> methods_;
+  std::unordered_map<std::string, uint32_t> methodIds_;
+  std::unordered_map<int64_t, Pending> pending_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_STAGEPROFILER_H_
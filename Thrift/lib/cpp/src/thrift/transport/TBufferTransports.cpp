@@ -228,25 +228,43 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   while (new_size < len + have) {
     new_size = new_size > 0 ? new_size * 2 : 1;
   }
+  resizeWriteBuffer(new_size);
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TFramedTransport::reserveWrite(uint32_t len) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  if (len <= static_cast<uint32_t>(wBound_ - wBase_)) {
+    return;
+  }
+  // Too large is left for writeSlow() to report
+  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+    return;
+  }
+  // Exactly the frame, so the writes that follow never copy it
+  resizeWriteBuffer(len + have);
+}
+
+void TFramedTransport::resizeWriteBuffer(uint32_t newSize) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
 
   // TODO(dreiss): Consider modifying this class to use malloc/free
   // so we can use realloc here.
 
   // Allocate new buffer.
-  auto* new_buf = new uint8_t[new_size];
+  auto* new_buf = new uint8_t[newSize];
 
   // Copy the old buffer to the new one.
   memcpy(new_buf, wBuf_.get(), have);
 
   // Now point buf to the new one.
   wBuf_.reset(new_buf);
-  wBufSize_ = new_size;
+  wBufSize_ = newSize;
   wBase_ = wBuf_.get() + have;
   wBound_ = wBuf_.get() + wBufSize_;
-
-  // Copy the data into the new buffer.
-  memcpy(wBase_, buf, len);
-  wBase_ += len;
 }
 
 void TFramedTransport::flush() {
@@ -391,6 +409,19 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
   bufferSize_ = static_cast<uint32_t>(new_size);
 }
 
+void TMemoryBuffer::reserveWrite(uint32_t len) {
+  // A buffer we do not own cannot grow, and writing will say so
+  if (!owner_) {
+    return;
+  }
+  // Too large is left for writeSlow() to report
+  uint32_t avail = available_write();
+  if (static_cast<uint64_t>(bufferSize_ - avail) + len > maxBufferSize_) {
+    return;
+  }
+  ensureCanWrite(len);
+}
+
 void TMemoryBuffer::writeSlow(const uint8_t* buf, uint32_t len) {
   ensureCanWrite(len);
 
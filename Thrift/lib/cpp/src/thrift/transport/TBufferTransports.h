@@ -379,6 +379,8 @@ public:
 
   uint32_t writeEnd() override;
 
+  void reserveWrite(uint32_t len) override;
+
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
 
   std::shared_ptr<TTransport> getUnderlyingTransport() { return transport_; }
@@ -422,6 +424,11 @@ protected:
     this->write((uint8_t*)&pad, sizeof(pad));
   }
 
+  /**
+   * Moves what has been written to a new write buffer of newSize bytes.
+   */
+  void resizeWriteBuffer(uint32_t newSize);
+
   std::shared_ptr<TTransport> transport_;
 
   uint32_t rBufSize_;
@@ -672,6 +679,8 @@ public:
     return static_cast<uint32_t>(wBase_ - buffer_);
   }
 
+  void reserveWrite(uint32_t len) override;
+
   uint32_t available_read() const {
     // Remember, wBase_ is the real rBound_.
     return static_cast<uint32_t>(wBase_ - rBase_);
@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// TMbufTransport.h
+#ifndef _THRIFT_TRANSPORT_TMBUFTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TMBUFTRANSPORT_H_ 1
+
+#include <algorithm>
+#include <stdint.h>
+#include <rte_mbuf.h>
+#include <rte_memcpy.h>
+
+#include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Read-only transport over the UDP payload of one received rte_mbuf.
+ *
+ * The protocol reads straight out of the mbuf: borrow() hands out pointers
+ * into NIC memory, so TBinaryProtocol decodes strings without an
+ * intermediate copy, and fixed width fields are copied once, into the
+ * protocol's own variables. Chained mbufs are supported; borrow() only
+ * succeeds within the current segment, and read() crosses segments.
+ *
+ * The transport owns the mbuf it is given. It goes back to the pool as soon
+ * as the payload is fully consumed, at readEnd(), or when the next packet
+ * is attached, whichever comes first.
+ *
+ * Not thread safe.
+ */
+class TMbufTransport : public TVirtualTransport<TMbufTransport> {
+public:
+  TMbufTransport(std::shared_ptr<TConfiguration> config = nullptr)
+    : TVirtualTransport(config), mbuf_(nullptr), seg_(nullptr), segPos_(0), segEnd_(0), remaining_(0) {}
+
+  ~TMbufTransport() override { release(); }
+
+  /**
+   * Takes ownership of m and exposes len bytes starting offset bytes into
+   * the packet, typically the UDP payload behind the L2-L4 headers.
+   */
+  void reset(struct rte_mbuf* m, uint32_t offset, uint32_t len) {
+    release();
+    if (!m) {
+      return;
+    }
+    mbuf_ = m;
+    seg_ = m;
+    while (seg_ && offset >= seg_->data_len) {
+      offset -= seg_->data_len;
+      seg_ = seg_->next;
+    }
+    if (!seg_ || offset + len > remainingFrom(seg_)) {
+      // Header offset or length points past the packet
+      release();
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TMbufTransport: payload exceeds mbuf");
+    }
+    segPos_ = offset;
+    segEnd_ = seg_->data_len;
+    remaining_ = len;
+    if (remaining_ == 0) {
+      release();
+    }
+  }
+
+  /** Gives the mbuf back to its pool, dropping any unread payload */
+  void release() {
+    if (mbuf_) {
+      rte_pktmbuf_free(mbuf_);
+      mbuf_ = nullptr;
+    }
+    seg_ = nullptr;
+    segPos_ = segEnd_ = 0;
+    remaining_ = 0;
+  }
+
+  /** Payload bytes left to read */
+  uint32_t available() const { return remaining_; }
+
+  bool isOpen() const override { return true; }
+  bool peek() override { return remaining_ > 0; }
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    uint32_t want = std::min(len, remaining_);
+    uint32_t done = 0;
+    while (done < want) {
+      uint32_t chunk = std::min(want - done, contiguous());
+      rte_memcpy(buf + done, segData(), chunk);
+      done += chunk;
+      advance(chunk);
+    }
+    return done;
+  }
+
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    if (len > remaining_) {
+      throw TTransportException(TTransportException::END_OF_FILE,
+                                "TMbufTransport: read past end of payload");
+    }
+    return read(buf, len);
+  }
+
+  /**
+   * Points into the mbuf when *len bytes are contiguous in the current
+   * segment; *len is then set to everything the segment still holds.
+   */
+  const uint8_t* borrow(uint8_t* /* buf */, uint32_t* len) {
+    uint32_t have = contiguous();
+    if (have == 0 || *len > have) {
+      return nullptr;
+    }
+    *len = have;
+    return segData();
+  }
+
+  void consume(uint32_t len) {
+    if (len > contiguous()) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "TMbufTransport: consume past borrowed data");
+    }
+    advance(len);
+  }
+
+  uint32_t readEnd() override {
+    release();
+    return 0;
+  }
+
+private:
+  static uint32_t remainingFrom(const struct rte_mbuf* seg) {
+    uint32_t total = 0;
+    for (; seg; seg = seg->next) {
+      total += seg->data_len;
+    }
+    return total;
+  }
+
+  uint32_t contiguous() const { return std::min(remaining_, segEnd_ - segPos_); }
+  const uint8_t* segData() const { return rte_pktmbuf_mtod_offset(seg_, const uint8_t*, segPos_); }
+
+  void advance(uint32_t len) {
+    segPos_ += len;
+    remaining_ -= len;
+    if (remaining_ == 0) {
+      release();
+      return;
+    }
+    if (segPos_ == segEnd_) {
+      seg_ = seg_->next;
+      segPos_ = 0;
+      segEnd_ = seg_ ? seg_->data_len : 0;
+    }
+  }
+
+  struct rte_mbuf* mbuf_;
+  struct rte_mbuf* seg_;
+  uint32_t segPos_;
+  uint32_t segEnd_;
+  uint32_t remaining_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TMBUFTRANSPORT_H_
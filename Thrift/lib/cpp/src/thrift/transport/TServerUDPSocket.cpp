@@ -21,12 +21,16 @@
 #include <netdb.h>
 #endif
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TServerUDPSocket.h>
+#include <thrift/transport/TUDPDatagramBatch.h>
 #include <thrift/transport/TUDPSocket.h>
 #include <thrift/transport/TSocketUtils.h>
 #include <thrift/transport/SocketCommon.h>
@@ -67,9 +71,12 @@ TServerUDPSocket::TServerUDPSocket(int port)
     recvTimeout_(0),
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
+    batchSize_(1),
+    reusePort_(false),
     listening_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
-    interruptSockReader_(THRIFT_INVALID_SOCKET) {
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
 }
 
 TServerUDPSocket::TServerUDPSocket(int port, int sendTimeout, int recvTimeout)
@@ -79,9 +86,12 @@ TServerUDPSocket::TServerUDPSocket(int port, int sendTimeout, int recvTimeout)
     recvTimeout_(recvTimeout),
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
+    batchSize_(1),
+    reusePort_(false),
     listening_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
-    interruptSockReader_(THRIFT_INVALID_SOCKET) {
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
 }
 
 TServerUDPSocket::TServerUDPSocket(const string& address, int port)
@@ -92,9 +102,43 @@ TServerUDPSocket::TServerUDPSocket(const string& address, int port)
     recvTimeout_(0),
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
+    batchSize_(1),
+    reusePort_(false),
+    listening_(false),
+    interruptSockWriter_(THRIFT_INVALID_SOCKET),
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
+}
+
+TServerUDPSocket::TServerUDPSocket(int port, uint32_t batchSize)
+  : port_(port),
+    serverSocket_(THRIFT_INVALID_SOCKET),
+    sendTimeout_(0),
+    recvTimeout_(0),
+    tcpSendBuffer_(0),
+    tcpRecvBuffer_(0),
+    batchSize_(batchSize > 0 ? batchSize : 1),
+    reusePort_(false),
     listening_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
-    interruptSockReader_(THRIFT_INVALID_SOCKET) {
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
+}
+
+TServerUDPSocket::TServerUDPSocket(const string& address, int port, uint32_t batchSize)
+  : port_(port),
+    address_(address),
+    serverSocket_(THRIFT_INVALID_SOCKET),
+    sendTimeout_(0),
+    recvTimeout_(0),
+    tcpSendBuffer_(0),
+    tcpRecvBuffer_(0),
+    batchSize_(batchSize > 0 ? batchSize : 1),
+    reusePort_(false),
+    listening_(false),
+    interruptSockWriter_(THRIFT_INVALID_SOCKET),
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
 }
 
 TServerUDPSocket::TServerUDPSocket(const string& path)
@@ -105,9 +149,12 @@ TServerUDPSocket::TServerUDPSocket(const string& path)
     recvTimeout_(0),
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
+    batchSize_(1),
+    reusePort_(false),
     listening_(false),
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
-    interruptSockReader_(THRIFT_INVALID_SOCKET) {
+    interruptSockReader_(THRIFT_INVALID_SOCKET),
+    epollFd_(-1) {
 }
 
 TServerUDPSocket::~TServerUDPSocket() {
@@ -172,6 +219,24 @@ void TServerUDPSocket::_setup_sockopts() {
     }
   }
 #endif
+
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    int one = 1;
+    if (setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT,
+                   cast_sockopt(&one), sizeof(one)) == -1) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TServerUDPSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                               "Could not set SO_REUSEPORT", errno_copy);
+    }
+#else
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN,
+                             "SO_REUSEPORT is not supported on this platform");
+#endif
+  }
 }
 
 void TServerUDPSocket::_setup_unixdomain_sockopts() {
@@ -254,6 +319,35 @@ void TServerUDPSocket::listen() {
     listenCallback_(serverSocket_);
   }
 
+#ifdef __linux__
+  // recvBatch() waits on an epoll set of its own instead of rebuilding a
+  // poll() array per call; sharded servers get one event loop per socket
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd_ == -1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerUDPSocket::listen() epoll_create1() ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not create epoll set",
+                              errno_copy);
+  }
+  struct epoll_event ev;
+  std::memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = serverSocket_;
+  int ret = epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSocket_, &ev);
+  if (ret == 0 && interruptSockReader_ != THRIFT_INVALID_SOCKET) {
+    ev.data.fd = interruptSockReader_;
+    ret = epoll_ctl(epollFd_, EPOLL_CTL_ADD, interruptSockReader_, &ev);
+  }
+  if (ret == -1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerUDPSocket::listen() epoll_ctl() ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not create epoll set",
+                              errno_copy);
+  }
+#endif
+
   // The socket is now listening and ready for UDP datagrams
   listening_ = true;
 }
@@ -295,8 +389,18 @@ shared_ptr<TTransport> TServerUDPSocket::acceptImpl() {
   if (fds[0].revents & THRIFT_POLLIN) {
     struct sockaddr_storage clientAddress;
     socklen_t size = sizeof(clientAddress);
-    
-    // For UDP we don't create new sockets - we share the server socket
+    std::memset(&clientAddress, 0, sizeof(clientAddress));
+
+    // Peek at the pending datagram to learn who sent it
+    int8_t probe;
+    if (recvfrom(serverSocket_, cast_sockopt(&probe), sizeof(probe), MSG_PEEK,
+                 (struct sockaddr*)&clientAddress, &size) == -1) {
+      size = 0;
+    }
+
+    // For UDP we don't create new sockets - we share the server socket.
+    // Every read() replaces the peer address, so this transport is only safe
+    // with a single client; TDatagramServer serves many peers on one port.
     shared_ptr<TUDPSocket> client = createSocket(serverSocket_);
     // Cache the client address for sending responses
     client->setCachedAddress((struct sockaddr*)&clientAddress, size);
@@ -314,6 +418,84 @@ shared_ptr<TTransport> TServerUDPSocket::acceptImpl() {
   return nullptr;
 }
 
+uint32_t TServerUDPSocket::recvBatch(TUDPDatagramBatch& batch) {
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TServerUDPSocket not listening");
+  }
+
+  // Under load the socket rarely runs dry, so only poll once it has
+  uint32_t count = batch.recv(serverSocket_);
+  if (count > 0) {
+    return count;
+  }
+
+  const int timeout = (recvTimeout_ > 0) ? recvTimeout_ : -1;
+  bool readable = false;
+  bool interrupted = false;
+
+#ifdef __linux__
+  struct epoll_event events[2];
+  int ret = epoll_wait(epollFd_, events, 2, timeout);
+  batch.recordWait();
+  if (ret < 0) {
+    if (THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR) {
+      return 0;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerUDPSocket::recvBatch() epoll_wait() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+  }
+  for (int i = 0; i < ret; ++i) {
+    if (events[i].data.fd == interruptSockReader_) {
+      interrupted = true;
+    } else {
+      readable = true;
+    }
+  }
+#else
+  struct THRIFT_POLLFD fds[2];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = serverSocket_;
+  fds[0].events = THRIFT_POLLIN;
+  int nfds = 1;
+  if (interruptSockReader_ != THRIFT_INVALID_SOCKET) {
+    fds[1].fd = interruptSockReader_;
+    fds[1].events = THRIFT_POLLIN;
+    nfds = 2;
+  }
+
+  int ret = THRIFT_POLL(fds, nfds, timeout);
+  batch.recordWait();
+  if (ret < 0) {
+    if (THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR) {
+      return 0;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TServerUDPSocket::recvBatch() THRIFT_POLL() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+  }
+  interrupted = nfds == 2 && (fds[1].revents & THRIFT_POLLIN);
+  readable = (fds[0].revents & THRIFT_POLLIN) != 0;
+#endif
+
+  // The interrupt byte is left unread so every receiving thread sees it
+  if (interrupted) {
+    throw TTransportException(TTransportException::INTERRUPTED);
+  }
+
+  if (readable) {
+    return batch.recv(serverSocket_);
+  }
+  return 0;
+}
+
+uint32_t TServerUDPSocket::sendBatch(TUDPDatagramBatch& batch) {
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TServerUDPSocket not listening");
+  }
+  return batch.send(serverSocket_);
+}
+
 shared_ptr<TUDPSocket> TServerUDPSocket::createSocket(THRIFT_SOCKET clientSocket) {
   return std::make_shared<TUDPSocket>(clientSocket);
 }
@@ -345,6 +527,12 @@ void TServerUDPSocket::close() {
   if (interruptSockReader_ != THRIFT_INVALID_SOCKET) {
     ::THRIFT_CLOSESOCKET(interruptSockReader_);
   }
+#ifdef __linux__
+  if (epollFd_ != -1) {
+    ::close(epollFd_);
+  }
+#endif
+  epollFd_ = -1;
   serverSocket_ = THRIFT_INVALID_SOCKET;
   interruptSockWriter_ = THRIFT_INVALID_SOCKET;
   interruptSockReader_ = THRIFT_INVALID_SOCKET;
@@ -20,6 +20,7 @@ namespace thrift {
 namespace transport {
 
 class TUDPSocket;
+class TUDPDatagramBatch;
 
 /**
  * Server socket implementation of TServerTransport. Wrapper around a UDP socket
@@ -55,6 +56,24 @@ public:
    */
   TServerUDPSocket(const std::string& address, int port); 
 
+  /**
+   * Constructor for batched datagram I/O. Servers that support it pull up to
+   * batchSize datagrams per recvmmsg() and flush replies with one sendmmsg().
+   *
+   * @param port      Port number to bind to
+   * @param batchSize Max datagrams per receive call, 1 disables batching
+   */
+  TServerUDPSocket(int port, uint32_t batchSize);
+
+  /**
+   * Constructor for batched datagram I/O.
+   *
+   * @param address   Address to bind to
+   * @param port      Port number to bind to
+   * @param batchSize Max datagrams per receive call, 1 disables batching
+   */
+  TServerUDPSocket(const std::string& address, int port, uint32_t batchSize);
+
   /**
    * Constructor for Unix domain socket.
    * 
@@ -81,6 +100,34 @@ public:
   std::string getPath() const;
   bool isUnixDomainSocket() const;
 
+  uint32_t getBatchSize() const { return batchSize_; }
+  bool isBatchMode() const { return batchSize_ > 1; }
+
+  /**
+   * Sets SO_REUSEPORT before bind, so that several sockets can listen on the
+   * same port and the kernel spreads incoming flows between them. Takes
+   * effect on listen().
+   */
+  void setReusePort(bool reusePort) { reusePort_ = reusePort; }
+  bool getReusePort() const { return reusePort_; }
+
+  /**
+   * Waits until datagrams are pending on the socket, or the receive timeout
+   * expires, then pulls as many as fit in the batch with one call. Several
+   * threads may receive from the same server socket, each with its own batch.
+   *
+   * @return number of datagrams received, 0 on timeout
+   * @throws TTransportException INTERRUPTED once interrupt() has been called
+   */
+  uint32_t recvBatch(TUDPDatagramBatch& batch);
+
+  /**
+   * Sends the replies queued in the batch back to their peers.
+   *
+   * @return number of replies sent
+   */
+  uint32_t sendBatch(TUDPDatagramBatch& batch);
+
   void listen() override;
   void interrupt() override;
   void close() override;
@@ -102,11 +149,14 @@ private:
   int recvTimeout_;
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
+  uint32_t batchSize_;
+  bool reusePort_;
   bool listening_;
 
   concurrency::Mutex rwMutex_;                     // thread-safe interrupt
   THRIFT_SOCKET interruptSockWriter_;              // is notified on interrupt()
   THRIFT_SOCKET interruptSockReader_;              // is used in select/poll with serverSocket_
+  int epollFd_;                                    // watches both in recvBatch() on Linux
 
   socket_func_t listenCallback_;
 };
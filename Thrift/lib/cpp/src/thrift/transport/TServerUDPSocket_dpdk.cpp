@@ -3,6 +3,9 @@
 #include <thrift/transport/TUDPSocket.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <algorithm>
+#include <string>
+
 namespace apache {
 namespace thrift {
 namespace transport {
@@ -11,14 +14,16 @@ TServerUDPSocket::TServerUDPSocket(int port)
   : port_(port)
   , isInitialized_(false)
   , sendTimeout_(0)
-  , recvTimeout_(0) {
+  , recvTimeout_(0)
+  , numQueues_(1) {
 }
 
 TServerUDPSocket::TServerUDPSocket(int port, int sendTimeout, int recvTimeout)
   : port_(port)
   , isInitialized_(false)
   , sendTimeout_(sendTimeout)
-  , recvTimeout_(recvTimeout) {
+  , recvTimeout_(recvTimeout)
+  , numQueues_(1) {
 }
 
 TServerUDPSocket::~TServerUDPSocket() {
@@ -28,18 +33,24 @@ TServerUDPSocket::~TServerUDPSocket() {
 bool TServerUDPSocket::initDPDK() {
     dpdkResources_ = std::make_shared<DPDKResources>();
     
+    // One lcore per queue, and at least cores 0-1 as before
+    std::string lcores = "0-" + std::to_string(numQueues_ > 1 ? numQueues_ - 1 : 1);
+
     // Minimal EAL arguments
-    const char* argv[] = {
+    std::vector<const char*> argv = {
         "thrift-server",           // Program name
-        "-l", "0-1",              // Use CPU cores 0-1
+        "-l", lcores.c_str(),     // Use one CPU core per queue
         "-n", "4",                // Number of memory channels
         "--proc-type=auto",       // Process type
         "--log-level", "8",       // Debug log level
-        NULL
     };
-    int argc = sizeof(argv) / sizeof(argv[0]) - 1;  // -1 for NULL terminator
+    for (const auto& arg : ealArgs_) {
+        argv.push_back(arg.c_str());
+    }
+    argv.push_back(NULL);
+    int argc = static_cast<int>(argv.size()) - 1;  // -1 for NULL terminator
     // Initialize EAL
-    int ret = rte_eal_init(argc, (char**)argv);
+    int ret = rte_eal_init(argc, const_cast<char**>(argv.data()));
     if (ret < 0) {
         return false;
     }
@@ -81,23 +92,36 @@ bool TServerUDPSocket::setupDPDKPort() {
   // Get port info
   rte_eth_dev_info_get(dpdkResources_->portId, &dpdkResources_->devInfo);
 
+  uint16_t nbQueues = numQueues_;
+  nbQueues = std::min(nbQueues, dpdkResources_->devInfo.max_rx_queues);
+  nbQueues = std::min(nbQueues, dpdkResources_->devInfo.max_tx_queues);
+  if (nbQueues == 0) {
+    nbQueues = 1;
+  }
+  dpdkResources_->nbQueues = nbQueues;
+
   // Configure port
   memset(&dpdkResources_->portConf, 0, sizeof(dpdkResources_->portConf));
   // Set proper packet type flags
   dpdkResources_->portConf.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
   dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
-  dpdkResources_->portConf.rxmode.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM;
-  
-  // Accept all packet types
-  dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_IPV4_CKSUM;
-  dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_UDP_CKSUM;
-  
+  if (nbQueues > 1) {
+    // Hash the IP addresses and UDP ports, so a flow stays on one queue and
+    // its replies leave from the lcore that received it. Devices that
+    // cannot hash ports fall back to addresses only.
+    dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+    dpdkResources_->portConf.rx_adv_conf.rss_conf.rss_key = nullptr;
+    dpdkResources_->portConf.rx_adv_conf.rss_conf.rss_hf
+        = (RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP) & dpdkResources_->devInfo.flow_type_rss_offloads;
+  }
   dpdkResources_->portConf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
-  dpdkResources_->portConf.txmode.offloads = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | 
-                                            RTE_ETH_TX_OFFLOAD_UDP_CKSUM; 
+  // Only the checksum offloads the device has; each queue's socket does
+  // the rest in software
+  DPDKChecksum::configure(dpdkResources_->devInfo, dpdkResources_->portConf);
 
   // Configure device
-  int ret = rte_eth_dev_configure(dpdkResources_->portId, 1, 1, &dpdkResources_->portConf);
+  int ret = rte_eth_dev_configure(dpdkResources_->portId, nbQueues, nbQueues,
+                                  &dpdkResources_->portConf);
   if (ret != 0) {
     return false;
   }
@@ -109,25 +133,27 @@ bool TServerUDPSocket::setupDPDKPort() {
     return false;
   }
 
-  // Setup RX queue
-  ret = rte_eth_rx_queue_setup(dpdkResources_->portId,
-                              0,
-                              RX_RING_SIZE,
-                              rte_eth_dev_socket_id(dpdkResources_->portId),
-                              nullptr,
-                              dpdkResources_->mbufPool );
-  if (ret < 0) {
-    return false;
-  }
+  // Setup RX and TX queues. All queues share one pool; every lcore
+  // allocates from its own cache of it.
+  for (uint16_t q = 0; q < nbQueues; ++q) {
+    ret = rte_eth_rx_queue_setup(dpdkResources_->portId,
+                                q,
+                                RX_RING_SIZE,
+                                rte_eth_dev_socket_id(dpdkResources_->portId),
+                                nullptr,
+                                dpdkResources_->mbufPool );
+    if (ret < 0) {
+      return false;
+    }
 
-  // Setup TX queue
-  ret = rte_eth_tx_queue_setup(dpdkResources_->portId,
-                              0,
-                              TX_RING_SIZE,
-                              rte_eth_dev_socket_id(dpdkResources_->portId),
-                              nullptr);
-  if (ret < 0) {
-    return false;
+    ret = rte_eth_tx_queue_setup(dpdkResources_->portId,
+                                q,
+                                TX_RING_SIZE,
+                                rte_eth_dev_socket_id(dpdkResources_->portId),
+                                nullptr);
+    if (ret < 0) {
+      return false;
+    }
   }
 
   // Enable promiscuous mode
@@ -192,8 +218,17 @@ std::shared_ptr<TTransport> TServerUDPSocket::acceptImpl() {
 }
 
 std::shared_ptr<TUDPSocket> TServerUDPSocket::createSocket(uint16_t portId) {
+    return createQueueSocket(0);
+}
+
+std::shared_ptr<TUDPSocket> TServerUDPSocket::createQueueSocket(uint16_t queueId) {
+    if (!dpdkResources_ || queueId >= dpdkResources_->nbQueues) {
+        throw TTransportException(TTransportException::BAD_ARGS,
+                                 "No such queue");
+    }
+
     // Create socket with shared DPDK resources
-    auto socket = std::make_shared<TUDPSocket>(dpdkResources_);
+    auto socket = std::make_shared<TUDPSocket>(dpdkResources_, queueId);
     
     // Set socket-specific parameters
     if (sendTimeout_ > 0) {
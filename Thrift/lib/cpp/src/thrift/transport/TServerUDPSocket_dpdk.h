@@ -2,8 +2,13 @@
 #ifndef _THRIFT_TRANSPORT_TSERVERUDPSOCKET_H_
 #define _THRIFT_TRANSPORT_TSERVERUDPSOCKET_H_ 1
 
+// Lets services pick the DPDK server modes when built against this variant
+#define THRIFT_TRANSPORT_DPDK 1
+
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include <rte_eal.h>
 #include <rte_ethdev.h>
 #include <rte_mbuf.h>
@@ -45,6 +50,32 @@ public:
 
   int getPort() const { return port_; }
 
+  /**
+   * Extra EAL arguments appended to the defaults, set before listen(). A
+   * virtual device stands in for a NIC, e.g. for tests:
+   *   {"--no-pci", "--vdev=net_pcap0,rx_pcap=requests.pcap,tx_pcap=replies.pcap"}
+   *   {"--no-pci", "--vdev=net_ring0"}
+   */
+  void setEalArgs(const std::vector<std::string>& args) { ealArgs_ = args; }
+
+  /**
+   * RX/TX queue pairs to configure, set before listen(). With more than one
+   * the NIC spreads flows over the queues by RSS on the UDP 4-tuple, and
+   * EAL is given one lcore per queue. Capped at what the device supports.
+   */
+  void setNumQueues(uint16_t numQueues) { numQueues_ = numQueues > 0 ? numQueues : 1; }
+
+  /** Queues in use once listening, otherwise the number requested */
+  uint16_t getNumQueues() const {
+    return dpdkResources_ ? dpdkResources_->nbQueues : numQueues_;
+  }
+
+  /**
+   * A socket on queue queueId of the listening port. Poll it from one lcore
+   * only; see TDPDKQueueServer.
+   */
+  std::shared_ptr<TUDPSocket> createQueueSocket(uint16_t queueId);
+
   std::shared_ptr<DPDKResources> getDPDKResources() const {
         return dpdkResources_;
     }
@@ -69,6 +100,8 @@ private:
   
   concurrency::Mutex mutex_;
   port_func_t listenCallback_;
+  std::vector<std::string> ealArgs_;
+  uint16_t numQueues_;
 };
 
 }}} // apache::thrift::transport
@@ -30,17 +30,20 @@ bool TServerUDPSocket::initDPDK() {
     dpdkResources_ = std::make_shared<DPDKResources>();
     
     // Minimal EAL arguments
-    const char* argv[] = {
+    std::vector<const char*> argv = {
         "thrift-server",           // Program name
         "-l", "0-1",              // Use CPU cores 0-1
         "-n", "4",                // Number of memory channels
         "--proc-type=auto",       // Process type
         "--log-level", "8",       // Debug log level
-        NULL
     };
-    int argc = sizeof(argv) / sizeof(argv[0]) - 1;  // -1 for NULL terminator
+    for (const auto& arg : ealArgs_) {
+        argv.push_back(arg.c_str());
+    }
+    argv.push_back(NULL);
+    int argc = static_cast<int>(argv.size()) - 1;  // -1 for NULL terminator
     // Initialize EAL
-    int ret = rte_eal_init(argc, (char**)argv);
+    int ret = rte_eal_init(argc, const_cast<char**>(argv.data()));
     if (ret < 0) {
         return false;
     }
@@ -87,6 +90,7 @@ bool TServerUDPSocket::setupDPDKPort() {
   dpdkResources_->portConf.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
   dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
   dpdkResources_->portConf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
+  DPDKChecksum::configure(dpdkResources_->devInfo, dpdkResources_->portConf);
 
   // Configure device
   int ret = rte_eth_dev_configure(dpdkResources_->portId, 1, 1, &dpdkResources_->portConf);
@@ -4,6 +4,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include <rte_eal.h>
 #include <rte_ethdev.h>
 #include <rte_mbuf.h>
@@ -46,6 +48,14 @@ public:
 
   int getPort() const { return port_; }
 
+  /**
+   * Extra EAL arguments appended to the defaults, set before listen(). A
+   * virtual device stands in for a NIC, e.g. for tests:
+   *   {"--no-pci", "--vdev=net_pcap0,rx_pcap=requests.pcap,tx_pcap=replies.pcap"}
+   *   {"--no-pci", "--vdev=net_ring0"}
+   */
+  void setEalArgs(const std::vector<std::string>& args) { ealArgs_ = args; }
+
   std::shared_ptr<DPDKResources> getDPDKResources() const {
         return dpdkResources_;
     }
@@ -70,6 +80,7 @@ private:
   
   concurrency::Mutex mutex_;
   port_func_t listenCallback_;
+  std::vector<std::string> ealArgs_;
 };
 
 }}} // apache::thrift::transport
@@ -41,6 +41,7 @@ TServerUDPSocket::TServerUDPSocket(int port, bool usingKq)
     recvTimeout_(0),
     udpRecvBuffer_(MAX_UDP_PACKET),
     udpSendBuffer_(0),
+    reusePort_(false),
     retryLimit_(0),
     retryDelay_(0),
     listening_(false),
@@ -66,6 +67,7 @@ TServerUDPSocket::TServerUDPSocket(int port, int sendTimeout, int recvTimeout, b
     recvTimeout_(recvTimeout),
     udpRecvBuffer_(MAX_UDP_PACKET),
     udpSendBuffer_(0),
+    reusePort_(false),
     retryLimit_(0),
     retryDelay_(0),
     listening_(false),
@@ -93,6 +95,7 @@ TServerUDPSocket::TServerUDPSocket(const string& address, int port, bool usingKq
     recvTimeout_(0),
     udpRecvBuffer_(MAX_UDP_PACKET),
     udpSendBuffer_(0),
+    reusePort_(false),
     retryLimit_(0),
     retryDelay_(0),
     listening_(false),
@@ -145,6 +148,23 @@ void TServerUDPSocket::_setup_sockopts() {
     }
   }
 
+  // Each lcore process binds its own socket to the shared port
+  if (reusePort_) {
+    int one = 1;
+    if (-1 == ff_setsockopt(serverSocket_,
+                           SOL_SOCKET,
+                           SO_REUSEPORT,
+                           cast_sockopt(&one),
+                           sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TServerUDPSocket::_setup_sockopts() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                               "Could not set SO_REUSEPORT",
+                               errno_copy);
+    }
+  }
+
   // Set non-blocking mode
   int flags = 1;
   if (ff_ioctl(serverSocket_, FIONBIO, &flags) == -1) {
@@ -66,6 +66,13 @@ public:
   void setUDPRecvBuffer(int recvBuffer); 
   void setUDPSendBuffer(int sendBuffer);
 
+  /**
+   * Sets SO_REUSEPORT before bind. F-Stack runs one event loop per lcore
+   * process, so a sharded server starts one process per lcore (ff_init
+   * --proc-id), each listening on the same port with this option set.
+   */
+  void setReusePort(bool reusePort) { reusePort_ = reusePort; }
+
   // Callback gets called just before bind, after socket options are set
   void setBindCallback(const socket_func_t& bindCallback) { bindCallback_ = bindCallback; }
 
@@ -112,6 +119,7 @@ private:
   int recvTimeout_;
   int udpRecvBuffer_;
   int udpSendBuffer_;
+  bool reusePort_;
   bool listening_;
   int retryLimit_;
   int retryDelay_;
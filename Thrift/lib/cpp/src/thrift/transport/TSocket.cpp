@@ -525,7 +525,7 @@ uint32_t TSocket::read(uint8_t* buf, uint32_t len) {
   int got = replay_.read(buf, len);
 #ifdef ENABLE_TRACING
   if (got > 0) {
-    LOG_DPDK_TO_RPC(buf, got);
+    LOG_DPDK_TO_RPC(flowId_, buf, got);
   }
 #endif
   return got;
@@ -652,7 +652,7 @@ try_again:
   }
 #ifdef ENABLE_TRACING 
   if (got > 0) {
-    LOG_DPDK_TO_RPC(buf, got);
+    LOG_DPDK_TO_RPC(flowId_, buf, got);
   }
 #endif // ENABLE_TRACING
   return got;
@@ -662,7 +662,7 @@ try_again:
 void TSocket::write(const uint8_t* buf, uint32_t len) {
 #ifdef ENABLE_GEM5
 #ifdef ENABLE_TRACING
-  LOG_RPC_TO_DPDK(buf, len);
+  LOG_RPC_TO_DPDK(flowId_, buf, len);
 #endif
   replay_.write(buf, len);
 #else
@@ -718,7 +718,7 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   }
 #ifdef ENABLE_TRACING 
   if (b > 0) {
-    LOG_RPC_TO_DPDK(buf, b);
+    LOG_RPC_TO_DPDK(flowId_, buf, b);
   }
 #endif // ENABLE_TRACING
   return b;
@@ -381,6 +381,11 @@ public:
         num_requests_ = requests;
     }
 #endif
+#ifdef ENABLE_TRACING
+public:
+  /** Id of this connection in the packet traces, see PacketLogger */
+  uint32_t getFlowId() const { return flowId_; }
+#endif
 private:
   void unix_open();
   void local_open();
@@ -389,6 +394,9 @@ private:
     static int num_requests_;
     PacketReplaySocket replay_;
 #endif
+#ifdef ENABLE_TRACING
+  uint32_t flowId_ = PacketLogger::nextFlowId();
+#endif
 };
 }
 }
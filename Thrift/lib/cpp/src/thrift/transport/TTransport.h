@@ -178,6 +178,18 @@ public:
     return 0;
   }
 
+  /**
+   * Called before writing len bytes whose size is known up front, such as
+   * a reply sized with serializedSize(). Transports that buffer a whole
+   * message can grow their buffer once, instead of as the writes come in.
+   * It is only a hint: writing more or less than len is fine.
+   *
+   * @param len  The number of bytes about to be written
+   */
+  virtual void reserveWrite(uint32_t /* len */) {
+    // default behaviour is to do nothing
+  }
+
   /**
    * Flushes any pending data to be written. Typically used with buffered
    * transport mechanisms.
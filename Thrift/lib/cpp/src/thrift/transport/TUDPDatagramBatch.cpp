@@ -0,0 +1,240 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <thrift/thrift-config.h>
+
+#include <cstring>
+#include <sys/types.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+#include <thrift/transport/TUDPDatagramBatch.h>
+#include <thrift/transport/TTransportException.h>
+
+#ifndef SOCKOPT_CAST_T
+#ifndef _WIN32
+#define SOCKOPT_CAST_T void
+#else
+#define SOCKOPT_CAST_T char
+#endif // _WIN32
+#endif
+
+template <class T>
+inline const SOCKOPT_CAST_T* const_cast_sockopt(const T* v) {
+  return reinterpret_cast<const SOCKOPT_CAST_T*>(v);
+}
+
+template <class T>
+inline SOCKOPT_CAST_T* cast_sockopt(T* v) {
+  return reinterpret_cast<SOCKOPT_CAST_T*>(v);
+}
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TUDPDatagramBatch::TUDPDatagramBatch(uint32_t capacity, uint32_t maxDatagramSize)
+  : capacity_(capacity > 0 ? capacity : 1),
+    slotSize_(maxDatagramSize > 0 ? maxDatagramSize : MAX_DATAGRAM_SIZE),
+    count_(0),
+    buffers_(static_cast<size_t>(capacity_) * slotSize_),
+    lengths_(capacity_, 0),
+    peers_(capacity_),
+    peerLens_(capacity_, 0),
+    rxIov_(capacity_),
+    txIov_(capacity_) {
+  replies_.reserve(capacity_);
+  for (uint32_t i = 0; i < capacity_; ++i) {
+    rxIov_[i].iov_base = data(i);
+    rxIov_[i].iov_len = slotSize_;
+  }
+#ifdef __linux__
+  rxMsgs_.resize(capacity_);
+  txMsgs_.resize(capacity_);
+  std::memset(rxMsgs_.data(), 0, sizeof(struct mmsghdr) * capacity_);
+  std::memset(txMsgs_.data(), 0, sizeof(struct mmsghdr) * capacity_);
+  for (uint32_t i = 0; i < capacity_; ++i) {
+    rxMsgs_[i].msg_hdr.msg_name = &peers_[i];
+    rxMsgs_[i].msg_hdr.msg_iov = &rxIov_[i];
+    rxMsgs_[i].msg_hdr.msg_iovlen = 1;
+    txMsgs_[i].msg_hdr.msg_iov = &txIov_[i];
+    txMsgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+#endif
+  resetStats();
+}
+
+uint32_t TUDPDatagramBatch::recv(THRIFT_SOCKET fd) {
+  clear();
+
+#ifdef __linux__
+  for (uint32_t i = 0; i < capacity_; ++i) {
+    rxMsgs_[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    rxMsgs_[i].msg_hdr.msg_flags = 0;
+  }
+
+  int got;
+  do {
+    got = recvmmsg(fd, rxMsgs_.data(), capacity_, MSG_DONTWAIT, nullptr);
+    stats_.recvCalls++;
+  } while (got < 0 && THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR);
+
+  if (got < 0) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == EWOULDBLOCK) {
+      return 0;
+    }
+    GlobalOutput.perror("TUDPDatagramBatch::recv() recvmmsg() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "recvmmsg()", errno_copy);
+  }
+
+  for (int i = 0; i < got; ++i) {
+    peerLens_[i] = rxMsgs_[i].msg_hdr.msg_namelen;
+    if (rxMsgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      lengths_[i] = 0;
+      stats_.truncated++;
+    } else {
+      lengths_[i] = rxMsgs_[i].msg_len;
+    }
+  }
+  count_ = static_cast<uint32_t>(got);
+#else
+  while (count_ < capacity_) {
+    socklen_t peerLen = sizeof(struct sockaddr_storage);
+    int got = static_cast<int>(recvfrom(fd,
+                                        cast_sockopt(data(count_)),
+                                        slotSize_,
+                                        MSG_DONTWAIT,
+                                        (struct sockaddr*)&peers_[count_],
+                                        &peerLen));
+    stats_.recvCalls++;
+    if (got < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EINTR) {
+        continue;
+      }
+      if (errno_copy == THRIFT_EAGAIN || errno_copy == EWOULDBLOCK) {
+        break;
+      }
+      GlobalOutput.perror("TUDPDatagramBatch::recv() recvfrom() ", errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "recvfrom()", errno_copy);
+    }
+    peerLens_[count_] = peerLen;
+    lengths_[count_] = static_cast<uint32_t>(got);
+    count_++;
+  }
+#endif
+
+  stats_.datagramsIn += count_;
+  return count_;
+}
+
+void TUDPDatagramBatch::setReply(uint32_t i, const uint8_t* buf, uint32_t len) {
+  if (i >= count_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TUDPDatagramBatch::setReply() index out of range");
+  }
+  if (replies_.size() >= capacity_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TUDPDatagramBatch::setReply() too many replies");
+  }
+  uint32_t k = static_cast<uint32_t>(replies_.size());
+  txIov_[k].iov_base = const_cast<uint8_t*>(buf);
+  txIov_[k].iov_len = len;
+  replies_.push_back(i);
+}
+
+uint32_t TUDPDatagramBatch::send(THRIFT_SOCKET fd) {
+  uint32_t n = static_cast<uint32_t>(replies_.size());
+  if (n == 0) {
+    return 0;
+  }
+
+#ifdef __linux__
+  for (uint32_t k = 0; k < n; ++k) {
+    uint32_t i = replies_[k];
+    txMsgs_[k].msg_hdr.msg_name = &peers_[i];
+    txMsgs_[k].msg_hdr.msg_namelen = peerLens_[i];
+  }
+
+  uint32_t next = 0;
+  uint32_t sent = 0;
+  while (next < n) {
+    int ret = sendmmsg(fd, &txMsgs_[next], n - next, 0);
+    stats_.sendCalls++;
+    if (ret < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EINTR) {
+        continue;
+      }
+      // sendmmsg() only reports the error of the first unsent message
+      GlobalOutput.perror("TUDPDatagramBatch::send() sendmmsg() ", errno_copy);
+      next++;
+      continue;
+    }
+    next += static_cast<uint32_t>(ret);
+    sent += static_cast<uint32_t>(ret);
+  }
+#else
+  uint32_t sent = sendFallback(fd);
+#endif
+
+  stats_.datagramsOut += sent;
+  replies_.clear();
+  return sent;
+}
+
+uint32_t TUDPDatagramBatch::sendFallback(THRIFT_SOCKET fd) {
+  uint32_t sent = 0;
+  for (uint32_t k = 0; k < replies_.size(); ++k) {
+    uint32_t i = replies_[k];
+    int ret;
+    do {
+      ret = static_cast<int>(sendto(fd,
+                                    const_cast_sockopt(txIov_[k].iov_base),
+                                    txIov_[k].iov_len,
+                                    0,
+                                    (struct sockaddr*)&peers_[i],
+                                    peerLens_[i]));
+      stats_.sendCalls++;
+    } while (ret < 0 && THRIFT_GET_SOCKET_ERROR == THRIFT_EINTR);
+
+    if (ret < 0) {
+      GlobalOutput.perror("TUDPDatagramBatch::send() sendto() ", THRIFT_GET_SOCKET_ERROR);
+      continue;
+    }
+    sent++;
+  }
+  return sent;
+}
+
+void TUDPDatagramBatch::clear() {
+  count_ = 0;
+  replies_.clear();
+}
+
+void TUDPDatagramBatch::resetStats() {
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _THRIFT_TRANSPORT_TUDPDATAGRAMBATCH_H_
+#define _THRIFT_TRANSPORT_TUDPDATAGRAMBATCH_H_ 1
+
+#include <stdint.h>
+#include <vector>
+
+#include <thrift/transport/PlatformSocket.h>
+
+#include <sys/types.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * A set of datagrams received with one recvmmsg() call, together with the
+ * peer address of each one and the replies queued for them. Replies are
+ * flushed with a single sendmmsg() call.
+ *
+ * On platforms without recvmmsg()/sendmmsg() the batch falls back to one
+ * recvfrom()/sendto() per datagram, so callers do not need to care.
+ *
+ * A batch is not thread safe; every receiving thread should own one.
+ */
+class TUDPDatagramBatch {
+public:
+  /** Default number of datagrams pulled per receive call */
+  static const uint32_t DEFAULT_BATCH_SIZE = 32;
+
+  /** Largest payload a UDP/IPv4 datagram can carry */
+  static const uint32_t MAX_DATAGRAM_SIZE = 65507;
+
+  /** Counters used to compute syscalls per request */
+  struct Stats {
+    uint64_t waitCalls;
+    uint64_t recvCalls;
+    uint64_t sendCalls;
+    uint64_t datagramsIn;
+    uint64_t datagramsOut;
+    uint64_t truncated;
+  };
+
+  /**
+   * @param capacity        Max datagrams per receive/send call
+   * @param maxDatagramSize Size of each receive slot; longer datagrams are dropped
+   */
+  TUDPDatagramBatch(uint32_t capacity = DEFAULT_BATCH_SIZE,
+                    uint32_t maxDatagramSize = MAX_DATAGRAM_SIZE);
+
+  uint32_t capacity() const { return capacity_; }
+
+  /** Number of datagrams held since the last recv() */
+  uint32_t size() const { return count_; }
+
+  uint8_t* data(uint32_t i) { return &buffers_[static_cast<size_t>(i) * slotSize_]; }
+  uint32_t length(uint32_t i) const { return lengths_[i]; }
+
+  const struct sockaddr* peer(uint32_t i) const {
+    return reinterpret_cast<const struct sockaddr*>(&peers_[i]);
+  }
+  socklen_t peerLength(uint32_t i) const { return peerLens_[i]; }
+
+  /**
+   * Reads whatever datagrams are queued on the socket, up to capacity(),
+   * without blocking. Replies from the previous batch are discarded.
+   * Datagrams that did not fit in a slot are reported with length 0.
+   *
+   * @return number of datagrams received, 0 if none were pending
+   * @throws TTransportException on socket errors other than EAGAIN/EINTR
+   */
+  uint32_t recv(THRIFT_SOCKET fd);
+
+  /**
+   * Queues a reply to datagram i. The buffer is not copied and has to stay
+   * valid until send() returns.
+   *
+   * @throws TTransportException if i is not a received datagram or
+   *         capacity() replies are already queued
+   */
+  void setReply(uint32_t i, const uint8_t* buf, uint32_t len);
+
+  /**
+   * Sends all queued replies to their peers. A reply that the kernel rejects
+   * is logged and dropped so one bad peer cannot stall the rest of the batch.
+   *
+   * @return number of replies sent
+   */
+  uint32_t send(THRIFT_SOCKET fd);
+
+  /** Drops received datagrams and queued replies */
+  void clear();
+
+  /** Counts a poll() made by the owner while waiting for this batch */
+  void recordWait() { stats_.waitCalls++; }
+
+  const Stats& getStats() const { return stats_; }
+  void resetStats();
+
+private:
+  uint32_t sendFallback(THRIFT_SOCKET fd);
+
+  uint32_t capacity_;
+  uint32_t slotSize_;
+  uint32_t count_;
+
+  std::vector<uint8_t> buffers_;
+  std::vector<uint32_t> lengths_;
+  std::vector<struct sockaddr_storage> peers_;
+  std::vector<socklen_t> peerLens_;
+
+  /** Indexes of datagrams with a queued reply, in queue order */
+  std::vector<uint32_t> replies_;
+  std::vector<struct iovec> rxIov_;
+  std::vector<struct iovec> txIov_;
+#ifdef __linux__
+  std::vector<struct mmsghdr> rxMsgs_;
+  std::vector<struct mmsghdr> txMsgs_;
+#endif
+
+  Stats stats_;
+};
+
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TUDPDATAGRAMBATCH_H_
@@ -0,0 +1,270 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <thrift/thrift-config.h>
+
+#include <cstring>
+#include <sys/types.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+#include <thrift/transport/TUDPFragment.h>
+
+#ifndef SOCKOPT_CAST_T
+#ifndef _WIN32
+#define SOCKOPT_CAST_T void
+#else
+#define SOCKOPT_CAST_T char
+#endif // _WIN32
+#endif
+
+template <class T>
+inline const SOCKOPT_CAST_T* const_cast_sockopt(const T* v) {
+  return reinterpret_cast<const SOCKOPT_CAST_T*>(v);
+}
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+bool TUDPFragment::readHeader(const uint8_t* buf, uint32_t len, Header& header) {
+  if (!isFragment(buf, len) || buf[2] != VERSION) {
+    return false;
+  }
+  header.messageId = (static_cast<uint32_t>(buf[4]) << 24) | (static_cast<uint32_t>(buf[5]) << 16)
+                     | (static_cast<uint32_t>(buf[6]) << 8) | static_cast<uint32_t>(buf[7]);
+  header.index = static_cast<uint16_t>((buf[8] << 8) | buf[9]);
+  header.count = static_cast<uint16_t>((buf[10] << 8) | buf[11]);
+  return header.count > 0 && header.index < header.count;
+}
+
+void TUDPFragment::writeHeader(uint8_t* buf, const Header& header) {
+  buf[0] = static_cast<uint8_t>(MAGIC >> 8);
+  buf[1] = static_cast<uint8_t>(MAGIC & 0xFF);
+  buf[2] = VERSION;
+  buf[3] = 0;
+  buf[4] = static_cast<uint8_t>(header.messageId >> 24);
+  buf[5] = static_cast<uint8_t>(header.messageId >> 16);
+  buf[6] = static_cast<uint8_t>(header.messageId >> 8);
+  buf[7] = static_cast<uint8_t>(header.messageId);
+  buf[8] = static_cast<uint8_t>(header.index >> 8);
+  buf[9] = static_cast<uint8_t>(header.index);
+  buf[10] = static_cast<uint8_t>(header.count >> 8);
+  buf[11] = static_cast<uint8_t>(header.count);
+}
+
+TUDPFragmenter::TUDPFragmenter(uint32_t datagramSize) : datagramSize_(0), nextMessageId_(0) {
+  setDatagramSize(datagramSize);
+  // Start somewhere else on every run so a restarted sender does not reuse
+  // the ids of its previous incarnation while they may still be pending
+  nextMessageId_ = static_cast<uint32_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count() ^ reinterpret_cast<uintptr_t>(this));
+}
+
+void TUDPFragmenter::setDatagramSize(uint32_t datagramSize) {
+  if (datagramSize < TUDPFragment::MIN_DATAGRAM_SIZE) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TUDPFragmenter: datagram size below TUDPFragment::MIN_DATAGRAM_SIZE");
+  }
+  datagramSize_ = datagramSize;
+}
+
+uint32_t TUDPFragmenter::sendTo(THRIFT_SOCKET fd,
+                                const uint8_t* buf,
+                                uint32_t len,
+                                const struct sockaddr* peer,
+                                socklen_t peerLen) {
+  if (!needsFragments(len)) {
+    if (sendto(fd, const_cast_sockopt(buf), len, 0, peer, peer ? peerLen : 0) == -1) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TUDPFragmenter::sendTo() sendto() ", errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "sendto()", errno_copy);
+    }
+    return 1;
+  }
+
+  uint32_t sent = 0;
+  split(buf, len, [&](const uint8_t* header, const uint8_t* payload, uint32_t payloadLen) {
+#ifndef _WIN32
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<uint8_t*>(header);
+    iov[0].iov_len = TUDPFragment::HEADER_SIZE;
+    iov[1].iov_base = const_cast<uint8_t*>(payload);
+    iov[1].iov_len = payloadLen;
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<struct sockaddr*>(peer);
+    msg.msg_namelen = peer ? peerLen : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    ssize_t ret = sendmsg(fd, &msg, 0);
+#else
+    std::vector<uint8_t> datagram(header, header + TUDPFragment::HEADER_SIZE);
+    datagram.insert(datagram.end(), payload, payload + payloadLen);
+    int ret = sendto(fd, const_cast_sockopt(datagram.data()), static_cast<int>(datagram.size()), 0,
+                     peer, peer ? peerLen : 0);
+#endif
+    if (ret == -1) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TUDPFragmenter::sendTo() sendmsg() ", errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "sendmsg()", errno_copy);
+    }
+    sent++;
+  });
+  return sent;
+}
+
+TUDPReassembler::TUDPReassembler(size_t maxPending, uint32_t timeoutMs, size_t maxPendingBytes)
+  : maxPending_(maxPending > 0 ? maxPending : 1),
+    maxPendingBytes_(maxPendingBytes),
+    pendingBytes_(0),
+    timeout_(timeoutMs),
+    lastExpire_(Clock::now()) {
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+bool TUDPReassembler::add(const uint8_t* datagram,
+                          uint32_t len,
+                          const struct sockaddr* peer,
+                          socklen_t peerLen,
+                          std::vector<uint8_t>& message) {
+  stats_.fragments++;
+
+  TUDPFragment::Header header;
+  if (!TUDPFragment::readHeader(datagram, len, header)) {
+    stats_.malformed++;
+    return false;
+  }
+
+  // Sweeping on every fragment would be wasted work under load
+  Clock::time_point now = Clock::now();
+  if (now - lastExpire_ >= timeout_ / 4) {
+    expire();
+    lastExpire_ = now;
+  }
+
+  const uint8_t* payload = datagram + TUDPFragment::HEADER_SIZE;
+  const uint32_t payloadLen = len - TUDPFragment::HEADER_SIZE;
+
+  if (header.count == 1) {
+    message.assign(payload, payload + payloadLen);
+    stats_.completed++;
+    return true;
+  }
+
+  Key key(peer ? std::string(reinterpret_cast<const char*>(peer), peerLen) : std::string(),
+          header.messageId);
+  auto it = pending_.find(key);
+
+  // Every fragment but the last carries a full payload, of at least what
+  // the smallest datagram holds, so the header tells how large the message
+  // is at least before any of it is buffered
+  uint64_t fullPayload = header.index + 1 < header.count
+                             ? payloadLen
+                             : TUDPFragment::MIN_DATAGRAM_SIZE - TUDPFragment::HEADER_SIZE;
+  if (static_cast<uint64_t>(header.count - 1) * fullPayload > maxPendingBytes_) {
+    stats_.oversized++;
+    if (it != pending_.end()) {
+      erase(it);
+    }
+    return false;
+  }
+
+  if (it == pending_.end()) {
+    while (pending_.size() >= maxPending_) {
+      evictOldest();
+    }
+    Partial partial;
+    partial.started = now;
+    partial.count = header.count;
+    partial.bytes = 0;
+    it = pending_.insert(std::make_pair(key, std::move(partial))).first;
+  }
+
+  Partial& partial = it->second;
+  if (partial.count != header.count) {
+    // Same id, different message: the sender restarted or the id wrapped
+    stats_.malformed++;
+    erase(it);
+    return false;
+  }
+
+  if (payloadLen == 0 || partial.fragments.count(header.index) != 0) {
+    return false; // duplicate
+  }
+  partial.fragments[header.index].assign(payload, payload + payloadLen);
+  partial.bytes += payloadLen;
+  pendingBytes_ += payloadLen + FRAGMENT_OVERHEAD;
+
+  if (partial.fragments.size() < partial.count) {
+    // Down to this message alone if need be; it goes too if it still does
+    // not fit, as a peer that lies about the size would otherwise hold it
+    while (pendingBytes_ > maxPendingBytes_ && !pending_.empty()) {
+      evictOldest();
+    }
+    return false;
+  }
+
+  message.clear();
+  message.reserve(partial.bytes);
+  for (auto& fragment : partial.fragments) {
+    message.insert(message.end(), fragment.second.begin(), fragment.second.end());
+  }
+  erase(it);
+  stats_.completed++;
+  return true;
+}
+
+void TUDPReassembler::expire() {
+  Clock::time_point now = Clock::now();
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    auto next = std::next(it);
+    if (now - it->second.started >= timeout_) {
+      erase(it);
+      stats_.expired++;
+    }
+    it = next;
+  }
+}
+
+void TUDPReassembler::evictOldest() {
+  auto oldest = pending_.begin();
+  for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+    if (it->second.started < oldest->second.started) {
+      oldest = it;
+    }
+  }
+  if (oldest != pending_.end()) {
+    erase(oldest);
+    stats_.evicted++;
+  }
+}
+
+void TUDPReassembler::erase(std::map<Key, Partial>::iterator it) {
+  pendingBytes_ -= charged(it->second);
+  pending_.erase(it);
+}
+}
+}
+} // apache::thrift::transport
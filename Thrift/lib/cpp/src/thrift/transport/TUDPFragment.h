@@ -0,0 +1,250 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _THRIFT_TRANSPORT_TUDPFRAGMENT_H_
+#define _THRIFT_TRANSPORT_TUDPFRAGMENT_H_ 1
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TTransportException.h>
+
+#include <sys/types.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Framing for Thrift messages that do not fit in one datagram.
+ *
+ * A message longer than the datagram size is sent as a run of fragments,
+ * each starting with a 12 byte header (all fields big endian):
+ *
+ *   magic      uint16  0xF7A1
+ *   version    uint8   1
+ *   reserved   uint8   0
+ *   messageId  uint32  chosen by the sender, unique per peer
+ *   index      uint16  0 .. count-1
+ *   count      uint16  number of fragments in the message
+ *
+ * Messages that fit are sent as they are, without a header. No Thrift
+ * protocol starts a message with 0xF7, so receivers tell the two apart from
+ * the first byte and peers that never fragment stay compatible.
+ */
+class TUDPFragment {
+public:
+  static const uint16_t MAGIC = 0xF7A1;
+  static const uint8_t VERSION = 1;
+  static const uint32_t HEADER_SIZE = 12;
+  static const uint32_t MAX_FRAGMENTS = 0xFFFF;
+
+  /** Smallest datagram a fragmenter sends, so that a fragment count bounds the size */
+  static const uint32_t MIN_DATAGRAM_SIZE = 64;
+
+  /** 1500 byte Ethernet MTU less the IPv4 and UDP headers */
+  static const uint32_t DEFAULT_DATAGRAM_SIZE = 1472;
+
+  struct Header {
+    uint32_t messageId;
+    uint16_t index;
+    uint16_t count;
+  };
+
+  /** Whether the datagram starts with a fragment header */
+  static bool isFragment(const uint8_t* buf, uint32_t len) {
+    return len >= HEADER_SIZE && buf[0] == (MAGIC >> 8) && buf[1] == (MAGIC & 0xFF);
+  }
+
+  /**
+   * Decodes the header of a fragment.
+   *
+   * @return false if the datagram is not a well formed fragment
+   */
+  static bool readHeader(const uint8_t* buf, uint32_t len, Header& header);
+
+  static void writeHeader(uint8_t* buf, const Header& header);
+};
+
+/**
+ * Splits outgoing messages into fragments. Thread safe; message ids come
+ * from an atomic counter.
+ */
+class TUDPFragmenter {
+public:
+  /**
+   * @param datagramSize Largest datagram to send, fragment header included;
+   *                     at least TUDPFragment::MIN_DATAGRAM_SIZE
+   */
+  TUDPFragmenter(uint32_t datagramSize = TUDPFragment::DEFAULT_DATAGRAM_SIZE);
+
+  void setDatagramSize(uint32_t datagramSize);
+  uint32_t getDatagramSize() const { return datagramSize_; }
+
+  /** Whether a message of len bytes has to be fragmented */
+  bool needsFragments(uint32_t len) const { return len > datagramSize_; }
+
+  /**
+   * Calls send(header, payload, payloadLen) once per fragment, in order.
+   * header points at TUDPFragment::HEADER_SIZE bytes that are only valid
+   * during the call.
+   *
+   * @throws TTransportException if the message needs more than
+   *         TUDPFragment::MAX_FRAGMENTS fragments
+   */
+  template <class SendFunction>
+  void split(const uint8_t* buf, uint32_t len, SendFunction send) {
+    const uint32_t payloadSize = datagramSize_ - TUDPFragment::HEADER_SIZE;
+    const uint32_t count = (len + payloadSize - 1) / payloadSize;
+    if (count > TUDPFragment::MAX_FRAGMENTS) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "TUDPFragmenter: message too large to fragment");
+    }
+
+    TUDPFragment::Header header;
+    header.messageId = nextMessageId_++;
+    header.count = static_cast<uint16_t>(count);
+    uint8_t wire[TUDPFragment::HEADER_SIZE];
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t offset = i * payloadSize;
+      uint32_t chunk = (len - offset < payloadSize) ? len - offset : payloadSize;
+      header.index = static_cast<uint16_t>(i);
+      TUDPFragment::writeHeader(wire, header);
+      send(static_cast<const uint8_t*>(wire), buf + offset, chunk);
+    }
+  }
+
+  /**
+   * Sends buf to peer on a datagram socket, fragmented if needed, with one
+   * sendmsg() per datagram and no copy of the payload. A null peer sends
+   * to the address the socket is connected to.
+   *
+   * @return number of datagrams sent
+   */
+  uint32_t sendTo(THRIFT_SOCKET fd,
+                  const uint8_t* buf,
+                  uint32_t len,
+                  const struct sockaddr* peer,
+                  socklen_t peerLen);
+
+private:
+  uint32_t datagramSize_;
+  std::atomic<uint32_t> nextMessageId_;
+};
+
+/**
+ * Rebuilds fragmented messages on the receiving side.
+ *
+ * Partial messages are keyed by peer address and message id. The table is
+ * bounded: a message that is not complete within the timeout is dropped,
+ * and when the table is full the oldest partial message makes room. A
+ * message larger than the byte limit is dropped as soon as its header or
+ * its buffered fragments show it; every fragment held counts against the
+ * limit with its bookkeeping, and only received fragments are stored. UDP
+ * gives no delivery guarantee, so a lost fragment simply loses the message.
+ *
+ * Not thread safe.
+ */
+class TUDPReassembler {
+public:
+  struct Stats {
+    uint64_t fragments;
+    uint64_t completed;
+    uint64_t expired;
+    uint64_t evicted;
+    uint64_t malformed;
+    uint64_t oversized;
+  };
+
+  static const size_t DEFAULT_MAX_PENDING = 64;
+  static const size_t DEFAULT_MAX_PENDING_BYTES = 16 * 1024 * 1024;
+  static const uint32_t DEFAULT_TIMEOUT_MS = 1000;
+
+  /**
+   * @param maxPending      Partial messages held at most
+   * @param timeoutMs       Time allowed between the first and the last fragment
+   * @param maxPendingBytes Bytes held at most across partial messages
+   */
+  TUDPReassembler(size_t maxPending = DEFAULT_MAX_PENDING,
+                  uint32_t timeoutMs = DEFAULT_TIMEOUT_MS,
+                  size_t maxPendingBytes = DEFAULT_MAX_PENDING_BYTES);
+
+  /**
+   * Adds one fragment (header included) from peer. peer may be null when
+   * all fragments come from the same source, e.g. a trace.
+   *
+   * @return true if this completed a message, which is then in message
+   */
+  bool add(const uint8_t* datagram,
+           uint32_t len,
+           const struct sockaddr* peer,
+           socklen_t peerLen,
+           std::vector<uint8_t>& message);
+
+  /** Drops partial messages that are past the timeout */
+  void expire();
+
+  size_t pending() const { return pending_.size(); }
+
+  const Stats& getStats() const { return stats_; }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::pair<std::string, uint32_t> Key;
+
+  // Charged per fragment held on top of its payload: its map node and vector
+  static const uint32_t FRAGMENT_OVERHEAD = 64;
+
+  struct Partial {
+    Clock::time_point started;
+    uint16_t count;
+    uint32_t bytes;  // payload received
+    std::map<uint16_t, std::vector<uint8_t> > fragments;  // by index
+  };
+
+  static size_t charged(const Partial& partial) {
+    return partial.bytes + partial.fragments.size() * static_cast<size_t>(FRAGMENT_OVERHEAD);
+  }
+
+  void evictOldest();
+  void erase(std::map<Key, Partial>::iterator it);
+
+  size_t maxPending_;
+  size_t maxPendingBytes_;
+  size_t pendingBytes_;
+  std::chrono::milliseconds timeout_;
+  Clock::time_point lastExpire_;
+  std::map<Key, Partial> pending_;
+  Stats stats_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TUDPFRAGMENT_H_
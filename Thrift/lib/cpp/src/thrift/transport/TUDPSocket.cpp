@@ -1,5 +1,6 @@
 #include <thrift/thrift-config.h>
 
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #ifdef HAVE_SYS_SOCKET_H
@@ -22,6 +23,7 @@
 #include <fcntl.h>
 
 #include <thrift/concurrency/Monitor.h>
+#include <thrift/transport/TUDPDatagramBatch.h>
 #include <thrift/transport/TUDPSocket.h>
 #include <thrift/transport/TTransportException.h>
 #include <thrift/transport/PlatformSocket.h>
@@ -61,6 +63,8 @@ TUDPSocket::TUDPSocket(const string& host, int port, std::shared_ptr<TConfigurat
     recvTimeout_(0),
     maxRecvRetries_(5) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
+  peerAddrLen_ = 0;
+  messagePos_ = 0;
 }
 
 TUDPSocket::TUDPSocket(const string& path, std::shared_ptr<TConfiguration> config)
@@ -73,6 +77,8 @@ TUDPSocket::TUDPSocket(const string& path, std::shared_ptr<TConfiguration> confi
     recvTimeout_(0),
     maxRecvRetries_(5) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
+  peerAddrLen_ = 0;
+  messagePos_ = 0;
 }
 
 TUDPSocket::TUDPSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> config)
@@ -85,6 +91,7 @@ TUDPSocket::TUDPSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> con
     maxRecvRetries_(5) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
   peerAddrLen_ = 0;
+  messagePos_ = 0;
 }
 
 TUDPSocket::TUDPSocket(std::shared_ptr<TConfiguration> config)
@@ -96,6 +103,8 @@ TUDPSocket::TUDPSocket(std::shared_ptr<TConfiguration> config)
     recvTimeout_(0),
     maxRecvRetries_(5) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
+  peerAddrLen_ = 0;
+  messagePos_ = 0;
 }
 
 TUDPSocket::~TUDPSocket() {
@@ -110,6 +119,9 @@ bool TUDPSocket::peek() {
   if (!isOpen()) {
     return false;
   }
+  if (messagePos_ < message_.size()) {
+    return true;
+  }
 
   struct pollfd fds[1];
   std::memset(fds, 0, sizeof(fds));
@@ -263,6 +275,9 @@ void TUDPSocket::close() {
     ::THRIFT_CLOSESOCKET(socket_);
   }
   socket_ = THRIFT_INVALID_SOCKET;
+  message_.clear();
+  messagePos_ = 0;
+  wBuf_.clear();
 }
 
 uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
@@ -270,6 +285,49 @@ uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
     throw TTransportException(TTransportException::NOT_OPEN, "Called read on non-open socket");
   }
 
+  // Rest of a message that did not fit in the caller's buffer
+  if (messagePos_ < message_.size()) {
+    uint32_t n = std::min(len, static_cast<uint32_t>(message_.size() - messagePos_));
+    std::memcpy(buf, message_.data() + messagePos_, n);
+    messagePos_ += n;
+    return n;
+  }
+
+  for (;;) {
+    uint32_t got = recvDatagram();
+    if (got == 0) {
+      return 0;
+    }
+
+    if (!TUDPFragment::isFragment(rxBuf_.data(), got)) {
+      if (got <= len) {
+        std::memcpy(buf, rxBuf_.data(), got);
+        return got;
+      }
+      message_.assign(rxBuf_.begin(), rxBuf_.begin() + got);
+      break;
+    }
+
+    if (reassembler_.add(rxBuf_.data(),
+                         got,
+                         (struct sockaddr*)&peerAddr_,
+                         peerAddrLen_,
+                         message_)) {
+      break;
+    }
+  }
+
+  uint32_t n = std::min(len, static_cast<uint32_t>(message_.size()));
+  std::memcpy(buf, message_.data(), n);
+  messagePos_ = n;
+  return n;
+}
+
+uint32_t TUDPSocket::recvDatagram() {
+  if (rxBuf_.empty()) {
+    rxBuf_.resize(TUDPDatagramBatch::MAX_DATAGRAM_SIZE);
+  }
+
   int32_t retries = 0;
 
   // THRIFT_EAGAIN can be signaled both when a timeout has occurred and when
@@ -293,9 +351,9 @@ try_again:
 
   sockaddr_storage peer_addr;
   socklen_t peer_addr_len = sizeof(peer_addr);
-  int got = static_cast<int>(recvfrom(socket_, 
-                                     cast_sockopt(buf), 
-                                     len,
+  int got = static_cast<int>(recvfrom(socket_,
+                                     cast_sockopt(rxBuf_.data()),
+                                     rxBuf_.size(),
                                      0,
                                      (struct sockaddr*)&peer_addr,
                                      &peer_addr_len));
@@ -472,8 +530,22 @@ try_again:
 // }
 
 void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
-  // UDP is message oriented - no partial writes
-  write_partial(buf, len);
+  // UDP is message oriented: collect the message, send it on flush()
+  wBuf_.insert(wBuf_.end(), buf, buf + len);
+}
+
+void TUDPSocket::flush() {
+  if (wBuf_.empty()) {
+    return;
+  }
+  // Drop the message even if sending fails, the next one must start clean
+  try {
+    write_partial(wBuf_.data(), static_cast<uint32_t>(wBuf_.size()));
+  } catch (...) {
+    wBuf_.clear();
+    throw;
+  }
+  wBuf_.clear();
 }
 
 uint32_t TUDPSocket::write_partial(const uint8_t* buf, uint32_t len) {
@@ -481,24 +553,14 @@ uint32_t TUDPSocket::write_partial(const uint8_t* buf, uint32_t len) {
     throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
   }
 
-  uint32_t sent;
-
-  sent = static_cast<uint32_t>(sendto(socket_,
-                                      const_cast_sockopt(buf),
-                                      len,
-                                      0,
-                                      (struct sockaddr*)&peerAddr_,
-                                      peerAddrLen_));
-  
-
-  if (sent == static_cast<uint32_t>(-1)) {
-    int errno_copy = THRIFT_GET_SOCKET_ERROR;
-    GlobalOutput.perror("TUDPSocket::write_partial() send/sendto() " + getSocketInfo(), errno_copy);
-    throw TTransportException(TTransportException::UNKNOWN, "send/sendto()", errno_copy);
-  }
-
-  //fprintf(stderr, "Debug: write() operation was successful, returning sent value: %d\n", sent);
-  return sent;
+  // A connected client socket has no peer address until it has read a
+  // reply, so it relies on the address given to connect()
+  fragmenter_.sendTo(socket_,
+                     buf,
+                     len,
+                     peerAddrLen_ ? (struct sockaddr*)&peerAddr_ : nullptr,
+                     peerAddrLen_);
+  return len;
 }
 
 string TUDPSocket::getHost() const {
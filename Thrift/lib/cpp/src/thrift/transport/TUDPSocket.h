@@ -2,11 +2,13 @@
 #define _THRIFT_TRANSPORT_TUDPSOCKET_H_ 1
 
 #include <string>
+#include <vector>
 
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
 #include <thrift/transport/TServerUDPSocket.h>
 #include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TUDPFragment.h>
 
 #ifdef HAVE_ARPA_INET_H
 #include <arpa/inet.h>
@@ -24,6 +26,10 @@ namespace transport {
 
 /**
  * UDP Socket implementation of the TTransport interface.
+ *
+ * Each flush() sends one message. Messages larger than the datagram size
+ * are split into fragments (see TUDPFragment) and put back together by the
+ * receiving transport, so read() always returns bytes of whole messages.
  */
 class TUDPSocket : public TVirtualTransport<TUDPSocket> {
 public:
@@ -80,7 +86,8 @@ public:
   void close() override;
 
   /**
-   * Reads from the underlying socket.
+   * Reads from the underlying socket. A message longer than len is kept and
+   * returned by the following reads.
    * \returns the number of bytes read or 0 indicates EOF
    * \throws TTransportException of types:
    *           NOT_OPEN means the socket has been closed
@@ -89,14 +96,29 @@ public:
   virtual uint32_t read(uint8_t* buf, uint32_t len);
 
   /**
-   * Writes to the underlying socket.
+   * Appends to the message sent by the next flush().
    */
   virtual void write(const uint8_t* buf, uint32_t len);
 
   /**
-   * Writes to the underlying socket.  Does single send() and returns result.
+   * Sends buf as one message right away, fragmented if it does not fit in
+   * a datagram.
    */
-  virtual uint32_t write_partial(const uint8_t* buf, uint32_t len); 
+  virtual uint32_t write_partial(const uint8_t* buf, uint32_t len);
+
+  /**
+   * Sends everything written since the last flush() as one message.
+   */
+  void flush() override;
+
+  /**
+   * Largest datagram sent, fragment header included. Longer messages are
+   * fragmented. Defaults to TUDPFragment::DEFAULT_DATAGRAM_SIZE.
+   */
+  void setMaxDatagramSize(uint32_t size) { fragmenter_.setDatagramSize(size); }
+  uint32_t getMaxDatagramSize() const { return fragmenter_.getDatagramSize(); }
+
+  const TUDPReassembler::Stats& getReassemblyStats() const { return reassembler_.getStats(); }
 
   /**
    * Get the host that the socket is connected to
@@ -260,9 +282,26 @@ protected:
     sockaddr_in6 ipv6;
   } cachedPeerAddr_;
 
+  /** Splits outgoing messages, rebuilds incoming ones */
+  TUDPFragmenter fragmenter_;
+  TUDPReassembler reassembler_;
+
+  /** Last datagram received */
+  std::vector<uint8_t> rxBuf_;
+
+  /** Message being handed out by read(), and how much of it was */
+  std::vector<uint8_t> message_;
+  uint32_t messagePos_;
+
+  /** Bytes written since the last flush() */
+  std::vector<uint8_t> wBuf_;
+
 private:
   void local_open();
   void unix_open();
+
+  /** Receives one datagram into rxBuf_ and records its sender */
+  uint32_t recvDatagram();
 };
 
 }
@@ -23,8 +23,15 @@ TUDPSocket::TUDPSocket(std::shared_ptr<TConfiguration> config)
   , port_(0)
   , isInitialized_(false)
   , localIpAddress_(0)
+  , queueId_(0)
+  , ownsDevice_(false)
+  , replyPort_(0)
   , sendTimeout_(0)
-  , recvTimeout_(0) {
+  , recvTimeout_(0)
+  , messagePos_(0)
+  , rxHead_(0)
+  , rxCount_(0) {
+  memset(&peerAddr_, 0, sizeof(peerAddr_));
 }
 
 TUDPSocket::TUDPSocket(const std::string& host, int port, std::shared_ptr<TConfiguration> config)
@@ -33,18 +40,43 @@ TUDPSocket::TUDPSocket(const std::string& host, int port, std::shared_ptr<TConfi
   , port_(port)
   , isInitialized_(false)
   , localIpAddress_(0)
+  , dpdkResources_(std::make_shared<DPDKResources>())
+  , queueId_(0)
+  , ownsDevice_(false)
+  , replyPort_(0)
   , sendTimeout_(0)
-  , recvTimeout_(0) {
+  , recvTimeout_(0)
+  , messagePos_(0)
+  , rxHead_(0)
+  , rxCount_(0) {
+  // A client talks first; the next hop of host is resolved on the first write
+  memset(&peerAddr_, 0, sizeof(peerAddr_));
+  peerAddr_.sin_family = AF_INET;
+  peerAddr_.sin_port = htons(static_cast<uint16_t>(port));
+  inet_aton(host.c_str(), &peerAddr_.sin_addr);
 }
 
 TUDPSocket::TUDPSocket(std::shared_ptr<DPDKResources> dpdkResources,
                        std::shared_ptr<TConfiguration> config)
+    : TUDPSocket(dpdkResources, 0, config) {
+}
+
+TUDPSocket::TUDPSocket(std::shared_ptr<DPDKResources> dpdkResources,
+                       uint16_t queueId,
+                       std::shared_ptr<TConfiguration> config)
     : TVirtualTransport(config)
     , port_(0)
+    , isInitialized_(false)
     , localIpAddress_(0)
     , dpdkResources_(dpdkResources)
+    , queueId_(queueId)
+    , ownsDevice_(false)
+    , replyPort_(0)
     , sendTimeout_(0)
-    , recvTimeout_(0) {
+    , recvTimeout_(0)
+    , messagePos_(0)
+    , rxHead_(0)
+    , rxCount_(0) {
     memset(&peerAddr_, 0, sizeof(peerAddr_));
     setLocalIpAddress("192.168.1.1");
 }
@@ -74,6 +106,8 @@ bool TUDPSocket::initDPDK() {
   }
 
   isInitialized_ = true;
+  ownsDevice_ = true;
+  setupTx();
   return true;
 }
 
@@ -104,6 +138,7 @@ bool TUDPSocket::setupDPDKPort() {
   dpdkResources_->portConf.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
   dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
   dpdkResources_->portConf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
+  DPDKChecksum::configure(dpdkResources_->devInfo, dpdkResources_->portConf);
 
   // Configure device
   int ret = rte_eth_dev_configure(dpdkResources_->portId, 1, 1, &dpdkResources_->portConf);
@@ -142,26 +177,26 @@ bool TUDPSocket::setupDPDKPort() {
 }
 
 bool TUDPSocket::isOpen() const {
-  return dpdkResources_->isInitialized;
+  return dpdkResources_ && dpdkResources_->isInitialized;
 }
 
 bool TUDPSocket::peek() {
-  if (!dpdkResources_->isInitialized) {
+  if (!isOpen()) {
     return false;
   }
-
-  struct rte_mbuf* pkts_burst[1];
-  const uint16_t nb_rx = rte_eth_rx_burst(dpdkResources_->portId, 0, pkts_burst, 1);
-  
-  if (nb_rx > 0) {
-    rte_pktmbuf_free(pkts_burst[0]);
+  if (rxPacket_.available() > 0 || messagePos_ < message_.size()) {
     return true;
   }
-  
-  return false;
+
+  // Keep what arrives for read() rather than dropping it
+  return rxHead_ < rxCount_ || refillRx();
 }
 
 void TUDPSocket::open() {
+  if (!dpdkResources_) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                             "No DPDK resources");
+  }
   if (dpdkResources_->isInitialized) {
     return;
   }
@@ -173,7 +208,17 @@ void TUDPSocket::open() {
 }
 
 void TUDPSocket::close() {
-  if (!dpdkResources_->isInitialized) {
+  if (!dpdkResources_ || !dpdkResources_->isInitialized) {
+    return;
+  }
+
+  // Replies still held by the flush policy leave first; received mbufs go
+  // back before their pool is freed
+  txBuffer_.flush();
+  dropReceived();
+
+  // A queue of a server's port; the server socket stops the device
+  if (!ownsDevice_) {
     return;
   }
 
@@ -192,55 +237,116 @@ void TUDPSocket::setLocalIpAddress(const std::string& ipStr) {
         struct in_addr addr;
         inet_aton(ipStr.c_str(), &addr);
         localIpAddress_ = addr.s_addr;
+        if (dpdkResources_ && dpdkResources_->isInitialized) {
+            setupTx();
+        }
+}
+
+void TUDPSocket::setupTx() {
+  txBuffer_.setQueue(dpdkResources_->portId, queueId_);
+  // Whatever the port did not take on is done in software, per burst
+  checksum_.setOffloads(dpdkResources_->portConf);
+  txBuffer_.setChecksum(&checksum_);
+
+  struct rte_ether_addr mac;
+  rte_eth_macaddr_get(dpdkResources_->portId, &mac);
+  headers_.setSource(mac, localIpAddress_);
+
+  // Next hops are resolved by ARP; tell the link who we are first
+  dpdkResources_->neighbors->setLocal(mac, localIpAddress_);
+  dpdkResources_->neighbors->announce(dpdkResources_->mbufPool, txBuffer_);
+}
+
+void TUDPSocket::setGateway(const std::string& gateway, const std::string& netmask) {
+  struct in_addr gw;
+  struct in_addr mask;
+  if (inet_aton(gateway.c_str(), &gw) == 0 || inet_aton(netmask.c_str(), &mask) == 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                             "Invalid gateway or netmask");
+  }
+  dpdkResources_->neighbors->setGateway(gw.s_addr, mask.s_addr);
 }
 
 void TUDPSocket::handleArpPacket(struct rte_mbuf* m) {
-    struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
-    struct rte_arp_hdr* arp_hdr = (struct rte_arp_hdr*)(eth_hdr + 1);
-
-    if (rte_be_to_cpu_16(arp_hdr->arp_opcode) == RTE_ARP_OP_REQUEST &&
-        arp_hdr->arp_data.arp_tip == localIpAddress_) {
-
-        struct rte_mbuf* reply = rte_pktmbuf_alloc(dpdkResources_->mbufPool);
-        if (reply) {
-            char* pkt = rte_pktmbuf_append(reply,
-                sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr));
-
-            if (pkt) {
-                struct rte_ether_hdr* reply_eth =
-                    rte_pktmbuf_mtod(reply, struct rte_ether_hdr*);
-                struct rte_arp_hdr* reply_arp =
-                    (struct rte_arp_hdr*)(reply_eth + 1);
-
-                // Set ethernet header
-                reply_eth->dst_addr = eth_hdr->src_addr;
-                rte_eth_macaddr_get(dpdkResources_->portId, &reply_eth->src_addr);
-                reply_eth->ether_type = eth_hdr->ether_type;
-
-                // Set ARP header
-                reply_arp->arp_hardware = arp_hdr->arp_hardware;
-                reply_arp->arp_protocol = arp_hdr->arp_protocol;
-                reply_arp->arp_hlen = arp_hdr->arp_hlen;
-                reply_arp->arp_plen = arp_hdr->arp_plen;
-                reply_arp->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REPLY);
-
-                // Set ARP data
-                rte_eth_macaddr_get(dpdkResources_->portId,
-                    &reply_arp->arp_data.arp_sha);
-                reply_arp->arp_data.arp_sip = localIpAddress_;
-                reply_arp->arp_data.arp_tha = arp_hdr->arp_data.arp_sha;
-                reply_arp->arp_data.arp_tip = arp_hdr->arp_data.arp_sip;
-
-                uint16_t nb_tx = rte_eth_tx_burst(dpdkResources_->portId,
-                    0, &reply, 1);
-                if (nb_tx == 0) {
-                    rte_pktmbuf_free(reply);
-                }
-            } else {
-                rte_pktmbuf_free(reply);
-            }
-        }
+  dpdkResources_->neighbors->input(m, dpdkResources_->mbufPool, txBuffer_);
+}
+
+bool TUDPSocket::refillRx() {
+  // The replies to the burst just served are all queued by now
+  if (rxCount_ > 0) {
+    txBuffer_.rxBurstDone();
+  }
+  rxHead_ = 0;
+  rxCount_ = rte_eth_rx_burst(dpdkResources_->portId, queueId_, rxBurst_, BURST_SIZE);
+  if (rxCount_ == 0) {
+    txBuffer_.rxIdle();
+    return false;
+  }
+  rxCount_ = checksum_.validateBurst(rxBurst_, rxCount_);
+  return rxCount_ > 0;
+}
+
+struct rte_mbuf* TUDPSocket::nextPacket() {
+  if (rxHead_ == rxCount_ && !refillRx()) {
+    return nullptr;
+  }
+  return rxBurst_[rxHead_++];
+}
+
+bool TUDPSocket::acceptPacket(struct rte_mbuf* pkt, uint32_t& payloadLen) {
+    // Get packet headers
+    struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
+    uint16_t ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
+
+    // Handle ARP packets
+    if (ether_type == RTE_ETHER_TYPE_ARP) {
+        handleArpPacket(pkt);
+        return false;
+    }
+
+    // Skip non-IPv4 packets
+    if (ether_type != RTE_ETHER_TYPE_IPV4 || pkt->data_len < HEADERS_LEN) {
+        return false;
+    }
+
+    struct rte_ipv4_hdr* ip_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_ipv4_hdr*,
+                                                         sizeof(struct rte_ether_hdr));
+    struct rte_udp_hdr* udp_hdr = (struct rte_udp_hdr*)(ip_hdr + 1);
+
+    // Skip non-UDP packets
+    if (ip_hdr->next_proto_id != IPPROTO_UDP) {
+        return false;
+    }
+
+    // Validate port if set
+    if (port_ != 0 && rte_be_to_cpu_16(udp_hdr->dst_port) != port_) {
+        return false;
     }
+
+    // The UDP length, not the frame length, which may include padding
+    uint32_t dgram_len = rte_be_to_cpu_16(udp_hdr->dgram_len);
+    if (dgram_len < UDP_HDR_LEN || HEADERS_LEN + dgram_len - UDP_HDR_LEN > rte_pktmbuf_pkt_len(pkt)) {
+        return false;
+    }
+    payloadLen = dgram_len - UDP_HDR_LEN;
+
+    // Cache peer address
+    peerAddr_.sin_family = AF_INET;
+    peerAddr_.sin_port = udp_hdr->src_port;
+    peerAddr_.sin_addr.s_addr = ip_hdr->src_addr;
+    replyPort_ = udp_hdr->dst_port;
+    return true;
+}
+
+void TUDPSocket::dropReceived() {
+  rxPacket_.release();
+  while (rxHead_ < rxCount_) {
+    rte_pktmbuf_free(rxBurst_[rxHead_++]);
+  }
+  rxHead_ = rxCount_ = 0;
+  txBuffer_.discard();
+  message_.clear();
+  messagePos_ = 0;
 }
 
 uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
@@ -249,16 +355,24 @@ uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
                                 "Called read on non-open socket");
     }
 
-    uint32_t total_rx = 0;
-    struct rte_mbuf* pkt = nullptr;
-    
-    //printf("Called read()\n"); 
-    
+    // Rest of the datagram being read, straight from its mbuf
+    if (rxPacket_.available() > 0) {
+        return rxPacket_.read(buf, len);
+    }
+
+    // Rest of a reassembled message
+    if (messagePos_ < message_.size()) {
+        uint32_t n = std::min(len, static_cast<uint32_t>(message_.size() - messagePos_));
+        rte_memcpy(buf, message_.data() + messagePos_, n);
+        messagePos_ += n;
+        return n;
+    }
+
     // Poll for packets with timeout handling
     uint64_t start_time = rte_get_timer_cycles();
     uint64_t timeout_cycles = (uint64_t)recvTimeout_ * rte_get_timer_hz() / 1000;
 
-    while (total_rx == 0) {
+    while (true) {
         // Check for timeout
         if (recvTimeout_ > 0) {
             uint64_t elapsed = rte_get_timer_cycles() - start_time;
@@ -268,72 +382,87 @@ uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
             }
         }
 
-        // Use optimized single packet receive
-        uint16_t nb_rx = rte_eth_rx_burst(dpdkResources_->portId, 0, &pkt, 1);
-        if (nb_rx == 0) continue;
-        //if (nb_rx > 0 ) printf("nb_rx: %d\n", nb_rx);
-        // Get packet headers
-        struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
-        uint16_t ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
-
-        // Handle ARP packets
-        if (ether_type == RTE_ETHER_TYPE_ARP) {
-            //fprintf(stderr, "Debug: Received ARP request\n");
-            handleArpPacket(pkt);
-            rte_pktmbuf_free(pkt);
-            continue;
-        }
+        struct rte_mbuf* pkt = nextPacket();
+        if (!pkt) continue;
 
-        // Skip non-IPv4 packets
-        if (ether_type != RTE_ETHER_TYPE_IPV4) {
-            fprintf(stderr, "Debug: found non-IPv4 packets\n");
+        uint32_t payload_len = 0;
+        if (!acceptPacket(pkt, payload_len)) {
             rte_pktmbuf_free(pkt);
             continue;
         }
 
-        //struct rte_ipv4_hdr* ip_hdr = (struct rte_ipv4_hdr*)(eth_hdr + 1);
-        struct rte_ipv4_hdr* ip_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_ipv4_hdr*,
-                                                             sizeof(struct rte_ether_hdr));
-        struct rte_udp_hdr* udp_hdr = (struct rte_udp_hdr*)(ip_hdr + 1);
-
-        // Skip non-UDP packets
-        if (ip_hdr->next_proto_id != IPPROTO_UDP) {
-            fprintf(stderr, "Debug: found non-UDP packet\n");
-            rte_pktmbuf_free(pkt);
-            continue;
-        }
-
-        // Validate port if set
-        if (port_ != 0 && rte_be_to_cpu_16(udp_hdr->dst_port) != port_) {
+        uint8_t* payload = rte_pktmbuf_mtod_offset(pkt, uint8_t*, HEADERS_LEN);
+        if (TUDPFragment::isFragment(payload, payload_len)) {
+            // Fragments never exceed the MTU, so one segment holds them
+            bool complete = HEADERS_LEN + payload_len <= pkt->data_len
+                            && reassembler_.add(payload, payload_len,
+                                                (const struct sockaddr*)&peerAddr_,
+                                                sizeof(peerAddr_), message_);
             rte_pktmbuf_free(pkt);
-            continue;
+            if (!complete) {
+                continue;
+            }
+            uint32_t n = std::min(len, static_cast<uint32_t>(message_.size()));
+            rte_memcpy(buf, message_.data(), n);
+            messagePos_ = n;
+            return n;
         }
 
-        // Get and copy payload
-        uint8_t* payload = rte_pktmbuf_mtod_offset(pkt, uint8_t*, HEADERS_LEN);
-        if (!payload) {
-            printf("Error: Invalid payload\n");  // Debug`
-            rte_pktmbuf_free(pkt);
+        // No copy until the caller's; the mbuf is held until the
+        // datagram has been read
+        rxPacket_.reset(pkt, HEADERS_LEN, payload_len);
+        if (payload_len == 0) {
             continue;
         }
-        uint32_t payload_len = static_cast<uint32_t>(pkt->data_len - HEADERS_LEN);
-        uint32_t copy_len = std::min(payload_len, len); 
-        rte_memcpy(buf, payload, copy_len);
-        total_rx = copy_len;
-
-        // Cache peer address
-        peerAddr_.sin_family = AF_INET;
-        peerAddr_.sin_port = udp_hdr->src_port;
-        peerAddr_.sin_addr.s_addr = ip_hdr->src_addr;
-        
-        rte_pktmbuf_free(pkt);
-        break;
+        return rxPacket_.read(buf, len);
     }
-    return total_rx;
+}
+
+const uint8_t* TUDPSocket::borrow(uint8_t* buf, uint32_t* len) {
+  if (rxPacket_.available() > 0) {
+    return rxPacket_.borrow(buf, len);
+  }
+  uint32_t remaining = static_cast<uint32_t>(message_.size() - messagePos_);
+  if (remaining == 0 || *len > remaining) {
+    return nullptr;
+  }
+  *len = remaining;
+  return message_.data() + messagePos_;
+}
+
+void TUDPSocket::consume(uint32_t len) {
+  if (rxPacket_.available() > 0) {
+    rxPacket_.consume(len);
+    return;
+  }
+  if (len > message_.size() - messagePos_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "consume() past the end of the datagram");
+  }
+  messagePos_ += len;
+}
+
+uint32_t TUDPSocket::readEnd() {
+  // One message per datagram; whatever the protocol left unread is padding
+  rxPacket_.release();
+  return 0;
 }
 
 void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
-  write_partial(buf, len);
+  wBuf_.insert(wBuf_.end(), buf, buf + len);
+}
+
+void TUDPSocket::flush() {
+  if (wBuf_.empty()) {
+    return;
+  }
+  try {
+    write_partial(wBuf_.data(), static_cast<uint32_t>(wBuf_.size()));
+  } catch (...) {
+    wBuf_.clear();
+    throw;
+  }
+  wBuf_.clear();
 }
 
 uint32_t TUDPSocket::write_partial(const uint8_t* buf, uint32_t len) {
@@ -342,6 +471,26 @@ uint32_t TUDPSocket::write_partial(const uint8_t* buf, uint32_t len) {
                              "Called write on non-open socket");
   }
 
+  // The NIC sends what fits in one mbuf; longer messages go as fragments
+  if (fragmenter_.needsFragments(len)) {
+    fragmenter_.split(buf, len, [this](const uint8_t* header, const uint8_t* payload,
+                                       uint32_t payloadLen) {
+      sendDatagram(header, TUDPFragment::HEADER_SIZE, payload, payloadLen);
+    });
+  } else {
+    sendDatagram(nullptr, 0, buf, len);
+  }
+  if (txBuffer_.messageDone() > 0) {
+    throw TTransportException(TTransportException::UNKNOWN,
+                             "Failed to send packet");
+  }
+  return len;
+}
+
+void TUDPSocket::sendDatagram(const uint8_t* header, uint32_t headerLen,
+                              const uint8_t* buf, uint32_t len) {
+  const uint32_t payloadLen = headerLen + len;
+
   // Allocate new mbuf
   struct rte_mbuf* m = rte_pktmbuf_alloc(dpdkResources_->mbufPool);
   if (!m) {
@@ -350,72 +499,53 @@ uint32_t TUDPSocket::write_partial(const uint8_t* buf, uint32_t len) {
   }
 
   // Reserve space for headers
-  char* pkt = rte_pktmbuf_append(m, HEADERS_LEN + len);
+  char* pkt = rte_pktmbuf_append(m, HEADERS_LEN + payloadLen);
   if (!pkt) {
     rte_pktmbuf_free(m);
     throw TTransportException(TTransportException::UNKNOWN,
                              "Failed to reserve space in mbuf");
   }
 
-  // Set up headers
-  struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
-  struct rte_ipv4_hdr* ip_hdr = (struct rte_ipv4_hdr*)(eth_hdr + 1);
+  // Headers from the peer's template; a reply goes out from the port the
+  // request came in on. Until the next hop resolves, the frame waits in
+  // the neighbor table.
+  DPDKNeighborTable& neighbors = *dpdkResources_->neighbors;
+  uint32_t nextHop = neighbors.nextHop(peerAddr_.sin_addr.s_addr);
+  struct rte_ether_addr mac;
+  memset(&mac, 0, sizeof(mac));
+  bool resolved = neighbors.resolve(nextHop, &mac, dpdkResources_->mbufPool, txBuffer_);
+  headers_.write(reinterpret_cast<uint8_t*>(pkt), mac, peerAddr_.sin_addr.s_addr,
+                 peerAddr_.sin_port, port_ != 0 ? rte_cpu_to_be_16(port_) : replyPort_,
+                 static_cast<uint16_t>(payloadLen));
+  struct rte_ipv4_hdr* ip_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr*, ETHER_HDR_LEN);
   struct rte_udp_hdr* udp_hdr = (struct rte_udp_hdr*)(ip_hdr + 1);
   uint8_t* payload = (uint8_t*)(udp_hdr + 1);
 
-  // Ethernet header
-  rte_eth_macaddr_get(dpdkResources_->portId, &eth_hdr->src_addr);
-  // Destination MAC should be set based on ARP or known destination
-  // For now using broadcast
-  // memset(&eth_hdr->dst_addr, 0xff, RTE_ETHER_ADDR_LEN); 
-  // Set destination MAC directly
-  // Converting 0c:42:a1:cc:83:82 to bytes
-  eth_hdr->dst_addr.addr_bytes[0] = 0x0c;
-  eth_hdr->dst_addr.addr_bytes[1] = 0x42;
-  eth_hdr->dst_addr.addr_bytes[2] = 0xa1;
-  eth_hdr->dst_addr.addr_bytes[3] = 0xcc;
-  eth_hdr->dst_addr.addr_bytes[4] = 0x83;
-  eth_hdr->dst_addr.addr_bytes[5] = 0x82;
-
-  eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
-
-  // IP header
-  memset(ip_hdr, 0, sizeof(*ip_hdr));
-  ip_hdr->version_ihl = (4 << 4) | (sizeof(*ip_hdr) >> 2);
-  ip_hdr->type_of_service = 0;
-  ip_hdr->total_length = rte_cpu_to_be_16(sizeof(*ip_hdr) + sizeof(*udp_hdr) + len);
-  ip_hdr->packet_id = 0;
-  ip_hdr->fragment_offset = 0;
-  ip_hdr->time_to_live = 64;
-  ip_hdr->next_proto_id = IPPROTO_UDP;
-  // Source IP should be interface IP
-  ip_hdr->src_addr = localIpAddress_; //use configured Ip
-  // Destination IP from peer address
-  ip_hdr->dst_addr = peerAddr_.sin_addr.s_addr;
-  ip_hdr->hdr_checksum = 0;
-  ip_hdr->hdr_checksum = rte_ipv4_cksum(ip_hdr);
-
-  // UDP header
-  udp_hdr->src_port = rte_cpu_to_be_16(port_);
-  udp_hdr->dst_port = peerAddr_.sin_port;
-  udp_hdr->dgram_len = rte_cpu_to_be_16(sizeof(*udp_hdr) + len);
-  udp_hdr->dgram_cksum = 0;
-
-  // Copy payload
-  rte_memcpy(payload, buf, len);
-
-  // Calculate UDP checksum
-  udp_hdr->dgram_cksum = rte_ipv4_udptcp_cksum(ip_hdr, udp_hdr);
-
-  // Send packet
-  uint16_t nb_tx = rte_eth_tx_burst(dpdkResources_->portId, 0, &m, 1);
-  if (nb_tx == 0) {
-    rte_pktmbuf_free(m);
+  // Copy payload, behind the fragment header if there is one
+  if (headerLen > 0) {
+    rte_memcpy(payload, header, headerLen);
+  }
+  rte_memcpy(payload + headerLen, buf, len);
+
+  // The UDP checksum is left 0; the TX buffer fills it in per burst
+
+  if (!resolved) {
+    neighbors.hold(nextHop, m, dpdkResources_->mbufPool, txBuffer_);
+    return;
+  }
+
+  // The TX buffer decides when it leaves
+  if (txBuffer_.add(m) > 0) {
     throw TTransportException(TTransportException::UNKNOWN,
                              "Failed to send packet");
   }
+}
 
-  return len;
+void TUDPSocket::flushTx() {
+  if (txBuffer_.flush() > 0) {
+    throw TTransportException(TTransportException::UNKNOWN,
+                             "Failed to send packet");
+  }
 }
 
 // Helper function to get local IP address
@@ -4,6 +4,7 @@
 
 #include <string>
 #include <sstream> 
+#include <vector>
 #include <netinet/in.h>  
 #include <arpa/inet.h>  
 #include <rte_eal.h>
@@ -14,6 +15,11 @@
 
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
+#include <thrift/transport/TUDPFragment.h>
+#include <thrift/transport/TMbufTransport.h>
+#include <thrift/transport/DPDKChecksum.h>
+#include <thrift/transport/DPDKTxBuffer.h>
+#include <thrift/transport/DPDKHeaderCache.h>
 
 namespace apache {
 namespace thrift {
@@ -31,6 +37,11 @@ public:
   TUDPSocket(const std::string& host, int port, std::shared_ptr<TConfiguration> config = nullptr);
   TUDPSocket(std::shared_ptr<DPDKResources> dpdkResources, 
                std::shared_ptr<TConfiguration> config = nullptr);
+  // Serves one RX/TX queue pair of a port set up by TServerUDPSocket. Each
+  // queue must be used from a single lcore.
+  TUDPSocket(std::shared_ptr<DPDKResources> dpdkResources,
+             uint16_t queueId,
+             std::shared_ptr<TConfiguration> config = nullptr);
   ~TUDPSocket() override;
 
   bool isOpen() const override;
@@ -38,23 +49,65 @@ public:
   void open() override;
   void close() override;
   
+  // Packets are taken from the RX queue BURST_SIZE at a time. A datagram
+  // is read in place from its mbuf, which goes back to the pool once the
+  // payload is consumed or readEnd() is called. Use the socket as the
+  // protocol transport directly, not behind TBufferedTransport, so that
+  // borrow() lets the protocol decode straight out of the mbuf.
   uint32_t read(uint8_t* buf, uint32_t len);
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+  void consume(uint32_t len);
+  uint32_t readEnd() override;
+
+  // write() collects a message, flush() hands it to the TX buffer, which
+  // sends it according to the flush policy
   void write(const uint8_t* buf, uint32_t len);
   uint32_t write_partial(const uint8_t* buf, uint32_t len);
+  void flush() override;
+
+  // Defaults to FLUSH_MESSAGE, one burst per reply; see DPDKTxBuffer
+  void setTxFlushPolicy(DPDKTxBuffer::FlushPolicy policy,
+                        uint16_t threshold = DPDKTxBuffer::DEFAULT_THRESHOLD,
+                        uint32_t deadlineUs = DPDKTxBuffer::DEFAULT_DEADLINE_US) {
+    txBuffer_.setPolicy(policy, threshold, deadlineUs);
+  }
+  const DPDKTxBuffer::Stats& getTxStats() const { return txBuffer_.getStats(); }
+  // Checksums are offloaded where the port offers it; see DPDKChecksum
+  const DPDKChecksum::Stats& getChecksumStats() const { return checksum_.getStats(); }
+  // Sends whatever the policy is still holding back
+  void flushTx();
 
   void setRecvTimeout(int ms);
   void setSendTimeout(int ms);
+
+  // Messages longer than this go out as fragments, see TUDPFragment
+  void setMaxDatagramSize(uint32_t size) { fragmenter_.setDatagramSize(size); }
   
   std::string getHost() const { return host_; }
   int getPort() const { return port_; }
   const std::string getOrigin() const override;
   uint32_t GetLocalIPAddress(uint16_t port_id);
   void setLocalIpAddress(const std::string& ipStr);
+  uint32_t getLocalIpAddress() const { return localIpAddress_; }
+  // Peers outside netmask are reached through gateway; by default every
+  // peer is on the link. Shared by all sockets of the port.
+  void setGateway(const std::string& gateway, const std::string& netmask);
+  int getRecvTimeout() const { return recvTimeout_; }
+  std::shared_ptr<DPDKResources> getDPDKResources() const { return dpdkResources_; }
+  uint16_t getQueueId() const { return queueId_; }
 
 protected:
   bool initDPDK();
   bool setupDPDKPort();
   struct rte_mempool* createMempool();
+  void setPeerAddr(const struct sockaddr_in& addr) { peerAddr_ = addr; }
+  // Learns from ARP and answers requests for the local address, through
+  // the port's neighbor table
+  void handleArpPacket(struct rte_mbuf* m);
+  // Drops received frames with bad checksums
+  uint16_t validateRx(struct rte_mbuf** pkts, uint16_t n) {
+    return checksum_.validateBurst(pkts, n);
+  }
   
 private:
   std::string host_;
@@ -64,11 +117,39 @@ private:
   
   // DPDK specific members
   std::shared_ptr<DPDKResources> dpdkResources_;
+  uint16_t queueId_;
+  bool ownsDevice_;  // set up the port itself, rather than sharing a server's
   struct sockaddr_in peerAddr_;  // Keep this for UDP addressing
-  void handleArpPacket(struct rte_mbuf* m);
-
+  uint16_t replyPort_;  // local port the last request came in on, network order
   int sendTimeout_;
   int recvTimeout_;
+  void setupTx();
+  bool refillRx();
+  struct rte_mbuf* nextPacket();
+  bool acceptPacket(struct rte_mbuf* pkt, uint32_t& payloadLen);
+  void dropReceived();
+  void sendDatagram(const uint8_t* header, uint32_t headerLen, const uint8_t* buf, uint32_t len);
+
+  // Fragmentation; message_ holds a reassembled message that read()
+  // hands out over several calls
+  TUDPFragmenter fragmenter_;
+  TUDPReassembler reassembler_;
+  std::vector<uint8_t> message_;
+  uint32_t messagePos_;
+  std::vector<uint8_t> wBuf_;
+
+  // Received burst, handed out from rxHead_ to rxCount_, and the datagram
+  // being read
+  struct rte_mbuf* rxBurst_[BURST_SIZE];
+  uint16_t rxHead_;
+  uint16_t rxCount_;
+  TMbufTransport rxPacket_;
+
+  // Replies waiting for the flush policy, their headers per peer, and the
+  // checksums of both directions
+  DPDKChecksum checksum_;
+  DPDKTxBuffer txBuffer_;
+  DPDKHeaderCache headers_;
 };
 
 }}} // apache::thrift::transport
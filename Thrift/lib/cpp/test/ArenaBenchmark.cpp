@@ -0,0 +1,282 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Allocations of UserTimelineService::ReadUserTimeline, whose reply is a
+ * list<Post>, with the cpp:arena types for 10 to 1000 posts:
+ *
+ *   decode   the client reading the reply into a std::pmr::vector<Post>
+ *   call     the server reading the args, the handler copying the posts
+ *            into the result and writing the reply
+ *
+ * each on the heap, the memory resource the types fall back to, and in a
+ * TArena reset after every reply. The arena call is the generated
+ * processor; the heap call does the same steps as a processor generated
+ * without the arena option.
+ *
+ * Usage: ArenaBenchmark [megabytes per case]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+
+#include "thrift/TArena.h"
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "arena/gen-cpp/UserTimelineService.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift_social_network;
+
+namespace {
+
+// The default memory resource, under the types and the TArenas' blocks
+class CountingResource : public std::pmr::memory_resource {
+public:
+  uint64_t allocations = 0;
+
+protected:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+CountingResource heap;
+
+double nowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::pmr::string username(int userId) {
+  return std::pmr::string("username_" + std::to_string(userId));
+}
+
+// Posts shaped like the ones wrk2's compose-post.lua makes
+std::pmr::vector<Post> makePosts(size_t count) {
+  std::mt19937_64 rng(count);
+  std::uniform_int_distribution<int> users(0, 961);
+  std::uniform_int_distribution<int> textLength(32, 256);
+  std::uniform_int_distribution<int> few(0, 2);
+  std::pmr::vector<Post> posts(count);
+  for (size_t i = 0; i < count; ++i) {
+    Post& post = posts[i];
+    post.post_id = static_cast<int64_t>(rng() >> 1);
+    post.req_id = static_cast<int64_t>(rng() >> 1);
+    post.timestamp = 1700000000000 + static_cast<int64_t>(i);
+    post.post_type = PostType::POST;
+    post.creator.user_id = users(rng);
+    post.creator.username = username(static_cast<int>(post.creator.user_id));
+    for (int m = few(rng); m > 0; --m) {
+      UserMention mention;
+      mention.user_id = users(rng);
+      mention.username = username(static_cast<int>(mention.user_id));
+      post.text += "@" + mention.username + " ";
+      post.user_mentions.push_back(mention);
+    }
+    post.text.append(textLength(rng), 'a' + static_cast<char>(i % 26));
+    for (int u = few(rng); u > 0; --u) {
+      Url url;
+      url.expanded_url = "http://" + std::pmr::string(64, 'u');
+      url.shortened_url = "http://short-url/";
+      url.shortened_url += std::to_string(rng() % 100000000);
+      post.text += " " + url.shortened_url;
+      post.urls.push_back(url);
+    }
+    for (int m = few(rng); m > 0; --m) {
+      Media media;
+      media.media_id = static_cast<int64_t>(rng() >> 1);
+      media.media_type = "png";
+      post.media.push_back(media);
+    }
+  }
+  return posts;
+}
+
+class UserTimelineHandler : public UserTimelineServiceIf {
+public:
+  explicit UserTimelineHandler(const std::pmr::vector<Post>& posts) : posts_(posts) {}
+
+  void WriteUserTimeline(const int64_t, const int64_t, const int64_t, const int64_t,
+                         const std::pmr::map<std::pmr::string, std::pmr::string>&) override {}
+
+  // Copies into _return's memory resource, as a handler reading its posts
+  // from a cache does
+  void ReadUserTimeline(std::pmr::vector<Post>& _return, const int64_t, const int64_t,
+                        const int32_t start, const int32_t stop,
+                        const std::pmr::map<std::pmr::string, std::pmr::string>&) override {
+    _return.assign(posts_.begin() + start, posts_.begin() + stop);
+  }
+
+private:
+  const std::pmr::vector<Post>& posts_;
+};
+
+struct Result {
+  double ns;
+  double allocations;
+};
+
+// Runs step() iterations times on the bytes in message
+template <class Step>
+Result run(TMemoryBuffer& in, const std::string& message, int iterations, Step step) {
+  uint64_t allocated = 0;
+  double start = nowNs();
+  for (int i = 0; i < iterations; ++i) {
+    in.resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(message.data())),
+                   static_cast<uint32_t>(message.size()), TMemoryBuffer::OBSERVE);
+    uint64_t before = heap.allocations;
+    step();
+    allocated += heap.allocations - before;
+  }
+  Result r = {(nowNs() - start) / iterations, static_cast<double>(allocated) / iterations};
+  return r;
+}
+
+template <class Protocol>
+void benchmark(const char* protocolName, size_t count, double megabytes) {
+  std::shared_ptr<TMemoryBuffer> in(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  std::shared_ptr<Protocol> iprot(new Protocol(in));
+  std::shared_ptr<Protocol> oprot(new Protocol(out));
+
+  std::pmr::vector<Post> posts = makePosts(count);
+  std::shared_ptr<UserTimelineHandler> handler(new UserTimelineHandler(posts));
+  UserTimelineServiceProcessor processor(handler);
+
+  std::pmr::map<std::pmr::string, std::pmr::string> carrier;
+  carrier["uber-trace-id"] = "5f1a2b3c4d5e6f70:5f1a2b3c4d5e6f70:0:1";
+  UserTimelineServiceClient client(oprot);
+  client.send_ReadUserTimeline(1, 42, 0, static_cast<int32_t>(count), carrier);
+  std::string call = out->getBufferAsString();
+
+  in->resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(call.data())),
+                  static_cast<uint32_t>(call.size()), TMemoryBuffer::OBSERVE);
+  out->resetBuffer();
+  processor.process(iprot, oprot, nullptr);
+  std::string reply = out->getBufferAsString();
+
+  int iterations = static_cast<int>(megabytes * 1024 * 1024 / reply.size());
+  if (iterations < 20) {
+    iterations = 20;
+  }
+
+  std::pmr::vector<Post> heapPosts;
+  Result heapDecode = run(*in, reply, iterations, [&]() {
+    std::pmr::vector<Post> fresh;
+    UserTimelineService_ReadUserTimeline_presult presult;
+    presult.success = &fresh;
+    std::string fname;
+    TMessageType type;
+    int32_t seqid;
+    iprot->readMessageBegin(fname, type, seqid);
+    presult.read(iprot.get());
+    iprot->readMessageEnd();
+    heapPosts.swap(fresh);
+  });
+
+  TArena arena;
+  bool arenaSame = true;
+  Result arenaDecode = run(*in, reply, iterations, [&]() {
+    {
+      std::pmr::vector<Post> fresh(&arena);
+      UserTimelineService_ReadUserTimeline_presult presult;
+      presult.success = &fresh;
+      std::string fname;
+      TMessageType type;
+      int32_t seqid;
+      iprot->readMessageBegin(fname, type, seqid);
+      presult.read(iprot.get());
+      iprot->readMessageEnd();
+      arenaSame = arenaSame && fresh == posts;
+    }
+    arena.reset();
+  });
+
+  Result heapCall = run(*in, call, iterations, [&]() {
+    out->resetBuffer();
+    std::string fname;
+    TMessageType type;
+    int32_t seqid;
+    iprot->readMessageBegin(fname, type, seqid);
+    UserTimelineService_ReadUserTimeline_args args;
+    args.read(iprot.get());
+    iprot->readMessageEnd();
+    UserTimelineService_ReadUserTimeline_result result;
+    handler->ReadUserTimeline(result.success, args.req_id, args.user_id, args.start, args.stop,
+                              args.carrier);
+    result.__isset.success = true;
+    oprot->writeMessageBegin("ReadUserTimeline", T_REPLY, seqid);
+    result.write(oprot.get());
+    oprot->writeMessageEnd();
+  });
+  bool heapReplySame = out->getBufferAsString() == reply;
+
+  Result arenaCall = run(*in, call, iterations, [&]() {
+    out->resetBuffer();
+    processor.process(iprot, oprot, nullptr);
+  });
+  bool arenaReplySame = out->getBufferAsString() == reply;
+
+  if (heapPosts != posts || !arenaSame || !heapReplySame || !arenaReplySame) {
+    fprintf(stderr, "ReadUserTimeline of %zu posts read back differs\n", count);
+    exit(1);
+  }
+
+  printf("%-8s %5zu %8zu  %9.0f %9.0f %6.0f %5.0f  %9.0f %9.0f %6.0f %5.0f\n", protocolName,
+         count, reply.size(), heapDecode.ns, arenaDecode.ns, heapDecode.allocations,
+         arenaDecode.allocations, heapCall.ns, arenaCall.ns, heapCall.allocations,
+         arenaCall.allocations);
+}
+}
+
+int main(int argc, char** argv) {
+  double megabytes = argc > 1 ? atof(argv[1]) : 256;
+  std::pmr::set_default_resource(&heap);
+
+  printf("ns and allocations from the heap resource per ReadUserTimeline of <posts> posts, reply of <bytes> bytes\n");
+  printf("%-8s %5s %8s  %9s %9s %6s %5s  %9s %9s %6s %5s\n", "protocol", "posts", "bytes",
+         "decode", "arena", "allocs", "arena", "call", "arena", "allocs", "arena");
+  for (size_t count = 10; count <= 1000; count *= 10) {
+    benchmark<TBinaryProtocol>("binary", count, megabytes);
+    benchmark<TCompactProtocol>("compact", count, megabytes);
+  }
+  return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/BlockTrace.h>
+
+BOOST_AUTO_TEST_SUITE(BlockTraceTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::transport::BlockTrace;
+using apache::thrift::transport::BlockTraceReader;
+using apache::thrift::transport::BlockTraceWriter;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+
+namespace {
+
+std::string tempPath(const char* name) {
+  return "/tmp/BlockTraceTest_" + std::to_string(getpid()) + "_" + name;
+}
+
+// A dpdk_to_rpc record of a ComposeUniqueId call, as PacketLogger logs it
+std::string record(uint64_t ts, uint32_t seqid) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeMessageBegin("ComposeUniqueId", apache::thrift::protocol::T_CALL, seqid);
+  protocol.writeStructBegin("args");
+  protocol.writeFieldBegin("req_id", apache::thrift::protocol::T_I64, 1);
+  protocol.writeI64(0x5a17000000000000LL + seqid * 7919LL);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("post_type", apache::thrift::protocol::T_I32, 2);
+  protocol.writeI32(seqid % 4);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("carrier", apache::thrift::protocol::T_MAP, 3);
+  protocol.writeMapBegin(apache::thrift::protocol::T_STRING, apache::thrift::protocol::T_STRING, 1);
+  char trace[40];
+  snprintf(trace, sizeof(trace), "%016llx:%08x:0:1", 0x3c1a5b7e00000000ULL + seqid / 16, seqid);
+  protocol.writeString(std::string("uber-trace-id"));
+  protocol.writeString(std::string(trace));
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  protocol.writeMessageEnd();
+  std::string data = buffer->getBufferAsString();
+
+  int64_t reqId = (int64_t(1) << 32) | seqid;
+  uint16_t size = static_cast<uint16_t>(data.size());
+  std::string rec(18, '\0');
+  memcpy(&rec[0], &ts, 8);
+  memcpy(&rec[8], &reqId, 8);
+  memcpy(&rec[16], &size, 2);
+  return rec + data;
+}
+
+// count records in batches of up to 7, the raw trace in raw
+void writeTrace(const std::string& path, uint32_t count, uint32_t blockBytes, std::string& raw) {
+  BlockTraceWriter writer(path, blockBytes);
+  raw.clear();
+  uint64_t ts = 1700000000000000000ULL;
+  for (uint32_t i = 0; i < count;) {
+    std::string batch;
+    uint32_t n = 0;
+    for (; n < 1 + i % 7 && i < count; ++n, ++i) {
+      ts += 2000 + (i * 37) % 5000;
+      batch += record(ts, i);
+    }
+    writer.append(batch.data(), batch.size(), n);
+    raw += batch;
+  }
+  writer.close();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_round_trip_and_random_access) {
+  std::string path = tempPath("trace.blk");
+  std::string raw;
+  writeTrace(path, 50000, 64 * 1024, raw);
+  BOOST_CHECK(BlockTrace::isBlockTrace(path));
+
+  BlockTraceReader reader(path);
+  BOOST_CHECK_EQUAL(reader.records(), 50000u);
+  BOOST_CHECK_EQUAL(reader.rawSize(), raw.size());
+  BOOST_REQUIRE(reader.blocks() > 10);
+  // Thrift calls compress well
+  BOOST_CHECK_MESSAGE(reader.fileSize() * 5 <= raw.size(),
+                      raw.size() << " bytes stored in " << reader.fileSize());
+
+  std::string back;
+  std::vector<uint8_t> block;
+  for (size_t i = 0; i < reader.blocks(); ++i) {
+    const BlockTrace::Block& b = reader.block(i);
+    BOOST_CHECK_EQUAL(b.rawOffset, back.size());
+    BOOST_CHECK_EQUAL(b.codec, static_cast<uint32_t>(BlockTrace::DEFLATE));
+    reader.read(i, block);
+    BOOST_REQUIRE_EQUAL(block.size(), b.rawSize);
+    // Whole records: a block starts with the record it says it does
+    uint64_t ts;
+    memcpy(&ts, block.data(), 8);
+    uint64_t expected;
+    memcpy(&expected, raw.data() + b.rawOffset, 8);
+    BOOST_CHECK_EQUAL(ts, expected);
+    back.append(block.begin(), block.end());
+  }
+  BOOST_CHECK(back == raw);
+
+  // Straight to a record or byte, from the back
+  size_t last = reader.blocks() - 1;
+  BOOST_CHECK_EQUAL(reader.findRecord(49999), last);
+  BOOST_CHECK_EQUAL(reader.findRecord(50000), reader.blocks());
+  BOOST_CHECK_EQUAL(reader.findRecord(0), 0u);
+  size_t mid = reader.findRecord(25000);
+  BOOST_CHECK(reader.block(mid).firstRecord <= 25000u);
+  BOOST_CHECK(reader.block(mid).firstRecord + reader.block(mid).records > 25000u);
+  BOOST_CHECK_EQUAL(reader.findOffset(reader.block(mid).rawOffset), mid);
+  BOOST_CHECK_EQUAL(reader.findOffset(reader.block(mid).rawOffset - 1), mid - 1);
+  BOOST_CHECK_EQUAL(reader.findOffset(raw.size()), reader.blocks());
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_without_index) {
+  std::string path = tempPath("killed.blk");
+  std::string raw;
+  writeTrace(path, 5000, 16 * 1024, raw);
+  size_t blocks;
+  uint64_t lastOffset;
+  {
+    BlockTraceReader reader(path);
+    blocks = reader.blocks();
+    lastOffset = reader.block(blocks - 1).offset;
+  }
+
+  // As if the writer died during its last block: the index and the tail
+  // of that block are gone, the blocks before it are read
+  BOOST_REQUIRE_EQUAL(truncate(path.c_str(), lastOffset + 20), 0);
+  BlockTraceReader reader(path);
+  BOOST_REQUIRE_EQUAL(reader.blocks(), blocks - 1);
+  std::vector<uint8_t> block;
+  reader.read(blocks - 2, block);
+  const BlockTrace::Block& b = reader.block(blocks - 2);
+  BOOST_CHECK_EQUAL(b.rawOffset + b.rawSize, reader.rawSize());
+  BOOST_CHECK(memcmp(block.data(), raw.data() + b.rawOffset, b.rawSize) == 0);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_stored_and_rejected) {
+  std::string path = tempPath("random.blk");
+  std::vector<uint8_t> noise(40000);
+  uint32_t x = 12345;
+  for (size_t i = 0; i < noise.size(); ++i) {
+    x = x * 1103515245 + 12345;
+    noise[i] = static_cast<uint8_t>(x >> 24);
+  }
+  {
+    BlockTraceWriter writer(path, 8192);
+    for (size_t i = 0; i < noise.size(); i += 1000) {
+      writer.append(&noise[i], 1000, 1);
+    }
+  }
+  // What does not compress is stored as is
+  BlockTraceReader reader(path);
+  BOOST_REQUIRE_EQUAL(reader.blocks(), 5u);
+  BOOST_CHECK_EQUAL(reader.block(0).codec, static_cast<uint32_t>(BlockTrace::STORED));
+  std::vector<uint8_t> block;
+  reader.read(4, block);
+  BOOST_CHECK(memcmp(block.data(), &noise[reader.block(4).rawOffset], block.size()) == 0);
+  BOOST_CHECK_EQUAL(reader.records(), 40u);
+
+  BOOST_CHECK(!BlockTrace::isBlockTrace("/nonexistent/BlockTraceTest"));
+  BOOST_CHECK_THROW(BlockTraceReader("/nonexistent/BlockTraceTest"), TTransportException);
+  FILE* f = fopen(path.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  fwrite(&noise[0], 1, 100, f);
+  fclose(f);
+  BOOST_CHECK(!BlockTrace::isBlockTrace(path));
+  BOOST_CHECK_THROW(BlockTraceReader reader2(path), TTransportException);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
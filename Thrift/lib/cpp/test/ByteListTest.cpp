@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/MemcachedService.h"
+
+BOOST_AUTO_TEST_SUITE(ByteListTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TMultiplexedProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using thrift_memcached::MemcachedService_getRequest_presult;
+using thrift_memcached::MemcachedService_getRequest_result;
+using thrift_memcached::MemcachedService_setRequest_args;
+
+namespace {
+
+std::vector<int8_t> bytes(size_t size) {
+  std::vector<int8_t> v(size);
+  for (size_t i = 0; i < size; ++i) {
+    v[i] = static_cast<int8_t>(i * 131 + 7);
+  }
+  return v;
+}
+
+// A list<i8> the way the generated code wrote it before readBytes() and
+// writeBytes(): a virtual call per element
+void writeByByte(TProtocol& prot, const std::vector<int8_t>& list) {
+  prot.writeListBegin(apache::thrift::protocol::T_BYTE, static_cast<uint32_t>(list.size()));
+  for (int8_t b : list) {
+    prot.writeByte(b);
+  }
+  prot.writeListEnd();
+}
+
+template <class Protocol>
+void checkSameWire(size_t size) {
+  std::vector<int8_t> list = bytes(size);
+  std::shared_ptr<TMemoryBuffer> bulk(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> byByte(new TMemoryBuffer());
+  Protocol bulkProt(bulk);
+  Protocol byByteProt(byByte);
+
+  TProtocol& prot = bulkProt;
+  uint32_t written = prot.writeListBegin(apache::thrift::protocol::T_BYTE,
+                                         static_cast<uint32_t>(size));
+  written += prot.writeBytes(list.data(), static_cast<uint32_t>(size));
+  written += prot.writeListEnd();
+  writeByByte(byByteProt, list);
+  BOOST_CHECK_EQUAL(written, bulk->available_read());
+  BOOST_CHECK(bulk->getBufferAsString() == byByte->getBufferAsString());
+
+  apache::thrift::protocol::TType elemType;
+  uint32_t count;
+  uint32_t read = prot.readListBegin(elemType, count);
+  BOOST_REQUIRE_EQUAL(count, size);
+  std::vector<int8_t> back(count);
+  read += prot.readBytes(back.data(), count);
+  read += prot.readListEnd();
+  BOOST_CHECK_EQUAL(read, written);
+  BOOST_CHECK(back == list);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_binary_and_compact_wire_unchanged) {
+  for (size_t size : {0, 1, 13, 64, 1024, 65536}) {
+    checkSameWire<TBinaryProtocol>(size);
+    checkSameWire<TCompactProtocol>(size);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_default_and_decorator) {
+  // Protocols that do not override them go a byte at a time
+  checkSameWire<TJSONProtocol>(100);
+
+  // Decorators hand the whole list to the protocol they wrap
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> binary(new TBinaryProtocol(buffer));
+  TMultiplexedProtocol mux(binary, "memcached");
+  std::vector<int8_t> list = bytes(300);
+  mux.writeBytes(list.data(), 300);
+  BOOST_CHECK(buffer->getBufferAsString() == std::string(list.begin(), list.end()));
+  std::vector<int8_t> back(300);
+  BOOST_CHECK_EQUAL(mux.readBytes(back.data(), 300), 300u);
+  BOOST_CHECK(back == list);
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_byte_lists) {
+  MemcachedService_setRequest_args args;
+  args.key = bytes(40);
+  args.value = bytes(4096);
+
+  // Written as it always was
+  std::shared_ptr<TMemoryBuffer> expected(new TMemoryBuffer());
+  TBinaryProtocol expectedProt(expected);
+  expectedProt.writeStructBegin("MemcachedService_setRequest_args");
+  expectedProt.writeFieldBegin("key", apache::thrift::protocol::T_LIST, 1);
+  writeByByte(expectedProt, args.key);
+  expectedProt.writeFieldEnd();
+  expectedProt.writeFieldBegin("value", apache::thrift::protocol::T_LIST, 2);
+  writeByByte(expectedProt, args.value);
+  expectedProt.writeFieldEnd();
+  expectedProt.writeFieldStop();
+  expectedProt.writeStructEnd();
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol prot(buffer);
+  uint32_t written = args.write(&prot);
+  BOOST_CHECK_EQUAL(written, buffer->available_read());
+  BOOST_CHECK(buffer->getBufferAsString() == expected->getBufferAsString());
+
+  MemcachedService_setRequest_args back;
+  BOOST_CHECK_EQUAL(back.read(&prot), written);
+  BOOST_CHECK(back.key == args.key);
+  BOOST_CHECK(back.value == args.value);
+
+  // Through the pointers of a presult, with the compact protocol
+  std::shared_ptr<TMemoryBuffer> compactBuffer(new TMemoryBuffer());
+  TCompactProtocol compact(compactBuffer);
+  MemcachedService_getRequest_result result;
+  result.success = bytes(70000);
+  result.__isset.success = true;
+  result.write(&compact);
+  std::vector<int8_t> value;
+  MemcachedService_getRequest_presult presult;
+  presult.success = &value;
+  presult.read(&compact);
+  BOOST_CHECK(presult.__isset.success);
+  BOOST_CHECK(value == result.success);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
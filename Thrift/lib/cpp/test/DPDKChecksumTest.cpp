@@ -0,0 +1,210 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * DPDKChecksum against an RFC 1071 reference, and frames through the
+ * software TX and RX paths.
+ *
+ * DPDK is not a build dependency, so this is not part of the build. It
+ * runs without a NIC or hugepages, e.g.
+ *   g++ -O2 -std=c++11 -DBOOST_TEST_DYN_LINK -I../src DPDKChecksumTest.cpp \
+ *       $(pkg-config --cflags --libs libdpdk) -lboost_unit_test_framework
+ *   ./a.out
+ */
+
+#define BOOST_TEST_MODULE DPDKChecksumTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include "thrift/transport/DPDKChecksum.h"
+
+using apache::thrift::transport::DPDKChecksum;
+
+namespace {
+
+struct rte_mempool* pool = nullptr;
+
+struct GlobalFixture {
+  GlobalFixture() {
+    const char* args[] = {"DPDKChecksumTest", "--no-huge", "--no-pci", "-m", "64",
+                          "--log-level=error"};
+    if (rte_eal_init(sizeof(args) / sizeof(args[0]), const_cast<char**>(args)) < 0) {
+      throw std::runtime_error("rte_eal_init failed");
+    }
+    pool = rte_pktmbuf_pool_create("checksum_test", 64, 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                   SOCKET_ID_ANY);
+    if (pool == nullptr) {
+      throw std::runtime_error("rte_pktmbuf_pool_create failed");
+    }
+  }
+};
+
+// RFC 1071, section 4.1: 16 bit words added with end around carry. Words
+// are read in host order, which gives the sum in host order as well.
+uint16_t reference(const uint8_t* p, size_t len) {
+  uint32_t sum = 0;
+  for (; len > 1; p += 2, len -= 2) {
+    uint16_t w;
+    memcpy(&w, p, sizeof(w));
+    sum += w;
+  }
+  if (len > 0) {
+    uint16_t w = 0;
+    memcpy(&w, p, 1);
+    sum += w;
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(sum);
+}
+
+// An Ethernet/IPv4/UDP frame with its IP checksum set and its UDP
+// checksum 0, as DPDKHeaderCache writes them
+struct rte_mbuf* makeFrame(uint16_t payloadLen, std::mt19937& rng) {
+  struct rte_mbuf* m = rte_pktmbuf_alloc(pool);
+  BOOST_REQUIRE(m != nullptr);
+  const uint16_t ipLen = sizeof(struct rte_ipv4_hdr) + sizeof(struct rte_udp_hdr) + payloadLen;
+  char* frame = rte_pktmbuf_append(m, sizeof(struct rte_ether_hdr) + ipLen);
+  BOOST_REQUIRE(frame != nullptr);
+  memset(frame, 0, sizeof(struct rte_ether_hdr) + ipLen);
+
+  struct rte_ether_hdr* eth = reinterpret_cast<struct rte_ether_hdr*>(frame);
+  eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+  struct rte_ipv4_hdr* ip = reinterpret_cast<struct rte_ipv4_hdr*>(eth + 1);
+  ip->version_ihl = 0x45;
+  ip->total_length = rte_cpu_to_be_16(ipLen);
+  ip->time_to_live = 64;
+  ip->next_proto_id = IPPROTO_UDP;
+  ip->src_addr = htonl(0xc0a80102);
+  ip->dst_addr = htonl(0xc0a80101);
+  ip->hdr_checksum = static_cast<uint16_t>(~reference(reinterpret_cast<uint8_t*>(ip),
+                                                      sizeof(struct rte_ipv4_hdr)));
+  struct rte_udp_hdr* udp = reinterpret_cast<struct rte_udp_hdr*>(ip + 1);
+  udp->src_port = htons(40000);
+  udp->dst_port = htons(9090);
+  udp->dgram_len = rte_cpu_to_be_16(ipLen - sizeof(struct rte_ipv4_hdr));
+  uint8_t* payload = reinterpret_cast<uint8_t*>(udp + 1);
+  for (uint16_t i = 0; i < payloadLen; ++i) {
+    payload[i] = static_cast<uint8_t>(rng());
+  }
+  return m;
+}
+
+// Whether the UDP checksum of m checks out against the reference
+bool udpChecksumValid(struct rte_mbuf* m) {
+  struct rte_ipv4_hdr* ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr*,
+                                                    sizeof(struct rte_ether_hdr));
+  struct rte_udp_hdr* udp = reinterpret_cast<struct rte_udp_hdr*>(ip + 1);
+  uint16_t udpLen = rte_be_to_cpu_16(udp->dgram_len);
+  std::vector<uint8_t> pseudo(12 + udpLen);
+  memcpy(&pseudo[0], &ip->src_addr, 4);
+  memcpy(&pseudo[4], &ip->dst_addr, 4);
+  pseudo[9] = IPPROTO_UDP;
+  memcpy(&pseudo[10], &udp->dgram_len, 2);
+  memcpy(&pseudo[12], udp, udpLen);
+  return udp->dgram_cksum != 0 && reference(pseudo.data(), pseudo.size()) == 0xffff;
+}
+}
+
+BOOST_GLOBAL_FIXTURE(GlobalFixture);
+
+BOOST_AUTO_TEST_CASE(test_sum_matches_reference) {
+  // Every length up to past an MTU, from every alignment the vector loops
+  // can start at
+  std::mt19937 rng(1071);
+  std::vector<uint8_t> data(2000 + 8);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(rng());
+  }
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t len = 0; len <= 2000; ++len) {
+      const uint8_t* p = data.data() + offset;
+      uint16_t expected = reference(p, len);
+      uint16_t got = DPDKChecksum::fold(DPDKChecksum::sum64(p, len));
+      // 0 and 0xffff are the same number in one's complement
+      if (expected == 0xffff) {
+        expected = 0;
+      }
+      if (got == 0xffff) {
+        got = 0;
+      }
+      BOOST_REQUIRE_MESSAGE(got == expected, "length " << len << " offset " << offset);
+    }
+  }
+
+  // All ones, so every lane carries
+  std::vector<uint8_t> ones(2000, 0xff);
+  BOOST_CHECK_EQUAL(DPDKChecksum::fold(DPDKChecksum::sum64(ones.data(), ones.size())),
+                    reference(ones.data(), ones.size()));
+}
+
+BOOST_AUTO_TEST_CASE(test_software_tx_and_rx) {
+  std::mt19937 rng(768);
+  const uint16_t lengths[] = {0, 1, 17, 64, 511, 1400, 1472};
+  const uint16_t n = sizeof(lengths) / sizeof(lengths[0]);
+  struct rte_mbuf* pkts[n];
+  for (uint16_t i = 0; i < n; ++i) {
+    pkts[i] = makeFrame(lengths[i], rng);
+  }
+
+  // No offloads configured, so both sides run in software
+  DPDKChecksum checksum;
+  checksum.prepareBurst(pkts, n);
+  BOOST_CHECK_EQUAL(checksum.getStats().txSoftware, n);
+  for (uint16_t i = 0; i < n; ++i) {
+    BOOST_CHECK_MESSAGE(udpChecksumValid(pkts[i]), "payload " << lengths[i]);
+  }
+
+  // One bit flipped in a payload, one in an IP header: both dropped, the
+  // rest kept in order
+  struct rte_mbuf* corruptPayload = pkts[3];
+  struct rte_mbuf* corruptIp = pkts[5];
+  rte_pktmbuf_mtod_offset(corruptPayload, uint8_t*, corruptPayload->data_len - 1)[0] ^= 0x10;
+  rte_pktmbuf_mtod_offset(corruptIp, struct rte_ipv4_hdr*,
+                          sizeof(struct rte_ether_hdr))->time_to_live ^= 0x01;
+  uint16_t kept = checksum.validateBurst(pkts, n);
+  BOOST_CHECK_EQUAL(kept, n - 2);
+  BOOST_CHECK_EQUAL(checksum.getStats().rxBad, 2u);
+  BOOST_CHECK_EQUAL(checksum.getStats().rxSoftware, n);
+  for (uint16_t i = 0; i < kept; ++i) {
+    BOOST_CHECK(pkts[i] != corruptPayload && pkts[i] != corruptIp);
+  }
+
+  // A frame the NIC already checked is not summed again
+  struct rte_mbuf* checked = makeFrame(64, rng);
+  checked->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_GOOD | RTE_MBUF_F_RX_L4_CKSUM_GOOD;
+  pkts[kept] = checked;
+  BOOST_CHECK_EQUAL(checksum.validateBurst(pkts, kept + 1), kept + 1);
+  BOOST_CHECK_EQUAL(checksum.getStats().rxSoftware, 2u * n - 2);
+
+  rte_pktmbuf_free_bulk(pkts, kept + 1);
+}
@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Reply path benchmark for DPDKTxBuffer and DPDKHeaderCache, one run per
+ * flush policy.
+ *
+ * Runs on the net_null PMD, which fills every RX poll and drops whatever is
+ * sent, so it measures the TX path rather than a NIC. Every received packet
+ * is answered with one reply built from the header cache. Per policy:
+ *
+ *   Mpps           replies handed to the PMD per second
+ *   pkts/burst     average packets per tx_burst
+ *   p50/p99/p99.9  how long a reply waited in the TX buffer, in us
+ *
+ * <idle> is the fraction of polls that find the RX queue empty, which is
+ * what lets FLUSH_THRESHOLD and FLUSH_RX_BURST send a partial buffer.
+ *
+ * DPDK is not a build dependency, so this is not part of the build. E.g.
+ *   g++ -O2 -std=c++11 -I../src DPDKTxBenchmark.cpp $(pkg-config --cflags --libs libdpdk)
+ *   ./a.out --no-pci --vdev=net_null0 -- [seconds] [rxBurst] [serviceNs] [idle]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+
+#include "thrift/transport/DPDKHeaderCache.h"
+#include "thrift/transport/DPDKTxBuffer.h"
+
+using apache::thrift::transport::DPDKHeaderCache;
+using apache::thrift::transport::DPDKTxBuffer;
+
+namespace {
+
+const uint16_t PORT_ID = 0;
+const uint16_t PAYLOAD_LEN = 64;
+const uint32_t PEERS = 16;
+
+struct Config {
+  double seconds;
+  uint16_t rxBurst;
+  uint64_t serviceCycles;
+  double idle;
+};
+
+double percentile(const std::vector<uint64_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * p));
+  return sorted[i] * 1e6 / rte_get_timer_hz();
+}
+
+void run(const char* name,
+         DPDKTxBuffer::FlushPolicy policy,
+         const Config& config,
+         struct rte_mempool* pool,
+         DPDKHeaderCache& headers,
+         const struct rte_ether_addr& nextHop) {
+  DPDKTxBuffer tx;
+  tx.setQueue(PORT_ID, 0);
+  tx.setPolicy(policy);
+
+  // enqueued[i] is when the reply in slot i of the TX buffer was queued
+  uint64_t enqueued[DPDKTxBuffer::MAX_BURST];
+  std::vector<uint64_t> waits;
+  waits.reserve(1 << 22);
+  // Everything queued left together if the buffer is now empty
+  auto settle = [&](uint16_t queued) {
+    if (tx.pending() < queued) {
+      uint64_t now = rte_get_timer_cycles();
+      for (uint16_t i = 0; i < queued; ++i) {
+        waits.push_back(now - enqueued[i]);
+      }
+    }
+  };
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  struct rte_mbuf* rx[DPDKTxBuffer::MAX_BURST];
+  uint32_t nextPeer = 0;
+
+  uint64_t start = rte_get_timer_cycles();
+  uint64_t end = start + static_cast<uint64_t>(config.seconds * rte_get_timer_hz());
+  while (rte_get_timer_cycles() < end) {
+    uint16_t n = 0;
+    if (coin(rng) >= config.idle) {
+      n = rte_eth_rx_burst(PORT_ID, 0, rx, config.rxBurst);
+    }
+    uint16_t queued = tx.pending();
+    if (n == 0) {
+      tx.rxIdle();
+      settle(queued);
+      continue;
+    }
+
+    for (uint16_t i = 0; i < n; ++i) {
+      rte_pktmbuf_free(rx[i]);
+      uint64_t until = rte_get_timer_cycles() + config.serviceCycles;
+      while (rte_get_timer_cycles() < until) {
+      }
+
+      struct rte_mbuf* reply = rte_pktmbuf_alloc(pool);
+      if (!reply) {
+        continue;
+      }
+      char* pkt = rte_pktmbuf_append(reply, DPDKHeaderCache::HEADERS_LEN + PAYLOAD_LEN);
+      uint32_t peer = nextPeer++ % PEERS;
+      headers.write(reinterpret_cast<uint8_t*>(pkt), nextHop, htonl(0x0A000001 + peer),
+                    htons(static_cast<uint16_t>(40000 + peer)), htons(9090), PAYLOAD_LEN);
+
+      queued = tx.pending();
+      enqueued[queued] = rte_get_timer_cycles();
+      tx.add(reply);
+      settle(queued + 1);
+      queued = tx.pending();
+      tx.messageDone();
+      settle(queued);
+    }
+    queued = tx.pending();
+    tx.rxBurstDone();
+    settle(queued);
+  }
+  tx.flush();
+  double elapsed = static_cast<double>(rte_get_timer_cycles() - start) / rte_get_timer_hz();
+
+  std::sort(waits.begin(), waits.end());
+  const DPDKTxBuffer::Stats& stats = tx.getStats();
+  std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(8) << stats.packets / elapsed / 1e6 << " Mpps"
+            << std::setw(8) << (stats.bursts ? double(stats.packets) / stats.bursts : 0.0)
+            << " pkts/burst" << std::setprecision(1) << "  p50 " << percentile(waits, 0.5)
+            << " us, p99 " << percentile(waits, 0.99) << " us, p99.9 "
+            << percentile(waits, 0.999) << " us, " << stats.dropped << " dropped" << '\n';
+}
+}
+
+int main(int argc, char** argv) {
+  int ret = rte_eal_init(argc, argv);
+  if (ret < 0) {
+    std::cerr << "Cannot initialize EAL" << '\n';
+    return 1;
+  }
+  argc -= ret;
+  argv += ret;
+
+  Config config;
+  config.seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  config.rxBurst = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 32);
+  config.rxBurst
+      = std::min<uint16_t>(std::max<uint16_t>(config.rxBurst, 1), DPDKTxBuffer::MAX_BURST);
+  uint64_t serviceNs = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+  config.serviceCycles = rte_get_timer_hz() * serviceNs / 1000000000ULL;
+  config.idle = argc > 4 ? atof(argv[4]) : 0.1;
+
+  if (rte_eth_dev_count_avail() == 0) {
+    std::cerr << "No port; run with --vdev=net_null0" << '\n';
+    return 1;
+  }
+
+  struct rte_mempool* pool = rte_pktmbuf_pool_create("bench_pool", 16383, 256, 0,
+                                                     RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+  struct rte_eth_conf conf;
+  memset(&conf, 0, sizeof(conf));
+  int socket = rte_eth_dev_socket_id(PORT_ID);
+  if (!pool || rte_eth_dev_configure(PORT_ID, 1, 1, &conf) != 0
+      || rte_eth_rx_queue_setup(PORT_ID, 0, 1024, socket, nullptr, pool) < 0
+      || rte_eth_tx_queue_setup(PORT_ID, 0, 1024, socket, nullptr) < 0
+      || rte_eth_dev_start(PORT_ID) < 0) {
+    std::cerr << "Cannot set up port " << PORT_ID << '\n';
+    return 1;
+  }
+
+  DPDKHeaderCache headers;
+  struct rte_ether_addr mac;
+  rte_eth_macaddr_get(PORT_ID, &mac);
+  headers.setSource(mac, inet_addr("192.168.1.1"));
+
+  std::cout << config.seconds << " s per policy, RX burst " << config.rxBurst << ", "
+            << serviceNs << " ns per request, " << config.idle * 100 << "% idle polls" << '\n';
+  run("message", DPDKTxBuffer::FLUSH_MESSAGE, config, pool, headers, mac);
+  run("threshold", DPDKTxBuffer::FLUSH_THRESHOLD, config, pool, headers, mac);
+  run("deadline", DPDKTxBuffer::FLUSH_DEADLINE, config, pool, headers, mac);
+  run("rx-burst", DPDKTxBuffer::FLUSH_RX_BURST, config, pool, headers, mac);
+
+  rte_eth_dev_stop(PORT_ID);
+  rte_eth_dev_close(PORT_ID);
+  rte_eal_cleanup();
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Dispatching calls to every method of UserService and SocialGraphService,
+ * whose method names share lengths and prefixes:
+ *
+ *   lookup    std::map<std::string, ...>::find(fname) over the service's
+ *             methods, which is how generated processors used to dispatch
+ *   call      the generated processor's process(): reading the message
+ *             header, dispatching on fname, reading the empty args,
+ *             calling the Null handler and writing the reply
+ *
+ * The lookup is what each call used to spend finding its method, which
+ * grows with the names it is compared against. Generated processors now
+ * switch on the name's length and characters instead, a few branches and
+ * one compare for any method, so the lookup is no longer part of the call.
+ *
+ * Usage: DispatchBenchmark [millions of calls per method]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "gen-cpp/SocialGraphService.h"
+#include "gen-cpp/UserService.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift_social_network;
+
+namespace {
+
+double nowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ns per step() in the fastest of 30 batches, as the calls are short
+// enough for the machine's noise to swamp the difference between methods
+template <class Step>
+double best(int iterations, Step step) {
+  int batch = iterations / 30 + 1;
+  double fastest = 0;
+  for (int b = 0; b < 30; ++b) {
+    double start = nowNs();
+    for (int n = 0; n < batch; ++n) {
+      step();
+    }
+    double ns = (nowNs() - start) / batch;
+    if (b == 0 || ns < fastest) {
+      fastest = ns;
+    }
+  }
+  return fastest;
+}
+
+// A call to name with no arguments set, which the Null handlers accept
+std::string call(const std::string& name) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol prot(buffer);
+  prot.writeMessageBegin(name, T_CALL, 1);
+  prot.writeStructBegin("args");
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+  prot.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+void benchmark(const char* service, TProcessor& processor, const std::vector<std::string>& names,
+               int iterations) {
+  std::map<std::string, int> methods;
+  for (size_t i = 0; i < names.size(); ++i) {
+    methods[names[i]] = static_cast<int>(i);
+  }
+
+  std::shared_ptr<TMemoryBuffer> in(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> iprot(new TBinaryProtocol(in));
+  std::shared_ptr<TProtocol> oprot(new TBinaryProtocol(out));
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    const std::string& fname = names[i];
+    int found = 0;
+    double lookup = best(iterations, [&]() { found += methods.find(fname)->second; });
+    if (found != static_cast<int>(i) * (iterations / 30 + 1) * 30) {
+      exit(1);
+    }
+
+    std::string message = call(fname);
+    double process = best(iterations, [&]() {
+      in->resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(message.data())),
+                      static_cast<uint32_t>(message.size()), TMemoryBuffer::OBSERVE);
+      out->resetBuffer();
+      processor.process(iprot, oprot, nullptr);
+    });
+
+    // The reply is to the method called, not an unknown method exception
+    std::string replied;
+    TMessageType type;
+    int32_t seqid;
+    oprot->readMessageBegin(replied, type, seqid);
+    if (replied != fname || type != T_REPLY) {
+      fprintf(stderr, "%s.%s was not dispatched\n", service, names[i].c_str());
+      exit(1);
+    }
+
+    printf("%-18s %-26s %8.1f %8.1f\n", service, names[i].c_str(), lookup, process);
+  }
+}
+}
+
+int main(int argc, char** argv) {
+  double millions = argc > 1 ? atof(argv[1]) : 4;
+  int iterations = static_cast<int>(millions * 1000000);
+
+  printf("ns per call to <method>\n");
+  printf("%-18s %-26s %8s %8s\n", "service", "method", "lookup", "call");
+
+  UserServiceProcessor users(std::make_shared<UserServiceNull>());
+  std::vector<std::string> userMethods = {"RegisterUser", "RegisterUserWithId", "Login",
+                                          "ComposeCreatorWithUserId", "ComposeCreatorWithUsername",
+                                          "GetUserId"};
+  benchmark("UserService", users, userMethods, iterations);
+
+  SocialGraphServiceProcessor graph(std::make_shared<SocialGraphServiceNull>());
+  std::vector<std::string> graphMethods = {"GetFollowers", "GetFollowees", "Follow",
+                                           "Unfollow", "FollowWithUsername",
+                                           "UnfollowWithUsername", "InsertUser"};
+  benchmark("SocialGraphService", graph, graphMethods, iterations);
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/TApplicationException.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/Inherited.h"
+
+BOOST_AUTO_TEST_SUITE(DispatchTest)
+
+using apache::thrift::TApplicationException;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::T_CALL;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace thrift::test::debug;
+
+namespace {
+
+class Handler : public InheritedIf {
+public:
+  Handler() : oneways(0), structs(0) {}
+
+  int32_t Janky(const int32_t arg) override { return arg * 2; }
+  void voidMethod() override {}
+  int32_t primitiveMethod() override { return 7; }
+  void structMethod(CompactProtoTestStruct& _return) override {
+    structs++;
+    _return.a_i32 = 42;
+  }
+  void methodWithDefaultArgs(const int32_t) override {}
+  void onewayMethod() override { oneways++; }
+  bool declaredExceptionMethod(const bool) override { return true; }
+  int32_t identity(const int32_t arg) override { return arg; }
+
+  int oneways;
+  int structs;
+};
+
+// A client and a processor joined by two memory buffers; call() runs one
+// request sent with the client through the processor
+class Loop {
+public:
+  Loop()
+    : handler(new Handler),
+      processor(handler),
+      requests(new TMemoryBuffer),
+      replies(new TMemoryBuffer),
+      requestProtocol(new TBinaryProtocol(requests)),
+      replyProtocol(new TBinaryProtocol(replies)),
+      client(replyProtocol, requestProtocol) {}
+
+  void call() { BOOST_CHECK(processor.process(requestProtocol, replyProtocol, nullptr)); }
+
+  // Sends a call of name with no arguments, which no client would
+  void send(const std::string& name) {
+    requestProtocol->writeMessageBegin(name, T_CALL, 1);
+    requestProtocol->writeStructBegin("args");
+    requestProtocol->writeFieldStop();
+    requestProtocol->writeStructEnd();
+    requestProtocol->writeMessageEnd();
+    requests->writeEnd();
+    requests->flush();
+  }
+
+  std::shared_ptr<Handler> handler;
+  InheritedProcessor processor;
+  std::shared_ptr<TMemoryBuffer> requests;
+  std::shared_ptr<TMemoryBuffer> replies;
+  std::shared_ptr<TProtocol> requestProtocol;
+  std::shared_ptr<TProtocol> replyProtocol;
+  InheritedClient client;
+};
+
+bool unknownMethod(const TApplicationException& x) {
+  return x.getType() == TApplicationException::UNKNOWN_METHOD;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_own_and_inherited_methods) {
+  Loop loop;
+  loop.client.send_identity(5);
+  loop.call();
+  BOOST_CHECK_EQUAL(loop.client.recv_identity(), 5);
+
+  // Not Inherited's own, so through SrvProcessor
+  loop.client.send_Janky(21);
+  loop.call();
+  BOOST_CHECK_EQUAL(loop.client.recv_Janky(), 42);
+
+  loop.client.send_primitiveMethod();
+  loop.call();
+  BOOST_CHECK_EQUAL(loop.client.recv_primitiveMethod(), 7);
+
+  // Two names of the same length, told apart by their first character
+  CompactProtoTestStruct result;
+  loop.client.send_structMethod();
+  loop.call();
+  loop.client.recv_structMethod(result);
+  BOOST_CHECK_EQUAL(result.a_i32, 42);
+  loop.client.send_onewayMethod();
+  loop.call();
+  BOOST_CHECK_EQUAL(loop.handler->oneways, 1);
+  BOOST_CHECK_EQUAL(loop.replies->available_read(), 0u);
+  BOOST_CHECK_EQUAL(loop.handler->structs, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_methods) {
+  // All but the last two have the length of a method of Inherited or Srv,
+  // and differ from it in a single character
+  const char* names[] = {"identitx", "Jankx", "voidMethox", "onewayMethox", "structMethox",
+                         "xtructMethod", "primitiveMethox", "", "somethingElseEntirely"};
+  Loop loop;
+  CompactProtoTestStruct result;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    loop.send(names[i]);
+    loop.call();
+    BOOST_CHECK_EXCEPTION(loop.client.recv_structMethod(result), TApplicationException,
+                          unknownMethod);
+  }
+  BOOST_CHECK_EQUAL(loop.handler->oneways, 0);
+  BOOST_CHECK_EQUAL(loop.handler->structs, 0);
+
+  // The processor is still in step
+  loop.client.send_Janky(4);
+  loop.call();
+  BOOST_CHECK_EQUAL(loop.client.recv_Janky(), 8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Serialization cost of the memcached benchmark calls, whose keys and
+ * values are list<i8>, for values of 64 B to 64 KB:
+ *
+ *   set      setRequest args: written by the client, read by the server
+ *   get      getRequest result: written by the server, read by the client
+ *
+ * each with the generated code, which moves a byte list with one
+ * readBytes()/writeBytes(), and with a byte at a time through the virtual
+ * protocol, as the generated code did before.
+ *
+ * Usage: MemcachedBenchmark [megabytes per case]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "gen-cpp/MemcachedService.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift_memcached;
+
+namespace {
+
+const uint32_t KEY_BYTES = 16;
+
+double nowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The element loops the generated code had for a list<i8>
+uint32_t writeByteList(TProtocol* prot, const std::vector<int8_t>& list) {
+  uint32_t xfer = prot->writeListBegin(T_BYTE, static_cast<uint32_t>(list.size()));
+  for (int8_t b : list) {
+    xfer += prot->writeByte(b);
+  }
+  return xfer + prot->writeListEnd();
+}
+
+uint32_t readByteList(TProtocol* prot, std::vector<int8_t>& list) {
+  TType elemType;
+  uint32_t size;
+  uint32_t xfer = prot->readListBegin(elemType, size);
+  list.resize(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    xfer += prot->readByte(list[i]);
+  }
+  return xfer + prot->readListEnd();
+}
+
+// Reads the fields of a struct of list<i8> fields into lists[id - 1]
+uint32_t readByteLists(TProtocol* prot, std::vector<int8_t>* lists, int16_t count) {
+  std::string name;
+  TType type;
+  int16_t id;
+  uint32_t xfer = prot->readStructBegin(name);
+  for (;;) {
+    xfer += prot->readFieldBegin(name, type, id);
+    if (type == T_STOP) {
+      break;
+    }
+    int16_t index = id == 0 ? 0 : id - 1;
+    if (type == T_LIST && index < count) {
+      xfer += readByteList(prot, lists[index]);
+    } else {
+      xfer += prot->skip(type);
+    }
+    xfer += prot->readFieldEnd();
+  }
+  return xfer + prot->readStructEnd();
+}
+
+uint32_t writeSetArgsByByte(TProtocol* prot, const MemcachedService_setRequest_args& args) {
+  uint32_t xfer = prot->writeStructBegin("MemcachedService_setRequest_args");
+  xfer += prot->writeFieldBegin("key", T_LIST, 1);
+  xfer += writeByteList(prot, args.key);
+  xfer += prot->writeFieldEnd();
+  xfer += prot->writeFieldBegin("value", T_LIST, 2);
+  xfer += writeByteList(prot, args.value);
+  xfer += prot->writeFieldEnd();
+  xfer += prot->writeFieldStop();
+  return xfer + prot->writeStructEnd();
+}
+
+uint32_t writeGetResultByByte(TProtocol* prot, const MemcachedService_getRequest_result& result) {
+  uint32_t xfer = prot->writeStructBegin("MemcachedService_getRequest_result");
+  xfer += prot->writeFieldBegin("success", T_LIST, 0);
+  xfer += writeByteList(prot, result.success);
+  xfer += prot->writeFieldEnd();
+  xfer += prot->writeFieldStop();
+  return xfer + prot->writeStructEnd();
+}
+
+struct Result {
+  double writeNs;
+  double readNs;
+};
+
+// Writes and reads a call message iterations times; write(prot) writes the
+// struct, read(prot) reads it back
+template <class Write, class Read>
+Result run(TProtocol& prot, TMemoryBuffer& buffer, const char* name, int iterations, Write write,
+           Read read) {
+  Result r = {0, 0};
+  for (int i = 0; i < iterations; ++i) {
+    buffer.resetBuffer();
+    double start = nowNs();
+    prot.writeMessageBegin(name, T_CALL, i);
+    write(prot);
+    prot.writeMessageEnd();
+    double written = nowNs();
+
+    std::string fname;
+    TMessageType type;
+    int32_t seqid;
+    prot.readMessageBegin(fname, type, seqid);
+    read(prot);
+    prot.readMessageEnd();
+    double end = nowNs();
+    r.writeNs += written - start;
+    r.readNs += end - written;
+  }
+  r.writeNs /= iterations;
+  r.readNs /= iterations;
+  return r;
+}
+
+void report(const char* protocol, const char* call, uint32_t size, const Result& generated,
+            const Result& byByte) {
+  printf("%-8s %-4s %6u  %10.0f %10.0f %10.0f %10.0f  %6.1fx %6.1fx  %8.0f\n", protocol, call, size,
+         generated.writeNs, generated.readNs, byByte.writeNs, byByte.readNs,
+         byByte.writeNs / generated.writeNs, byByte.readNs / generated.readNs,
+         (size * 2.0) / (generated.writeNs + generated.readNs) * 1e3);
+}
+
+template <class Protocol>
+void benchmark(const char* protocolName, uint32_t size, double megabytes) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(size + 1024));
+  Protocol prot(buffer);
+  int iterations = static_cast<int>(megabytes * 1024 * 1024 / size);
+  if (iterations < 100) {
+    iterations = 100;
+  }
+
+  MemcachedService_setRequest_args args;
+  args.key.assign(KEY_BYTES, 'k');
+  args.value.resize(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    args.value[i] = static_cast<int8_t>(i);
+  }
+  MemcachedService_setRequest_args argsIn;
+  std::vector<int8_t> lists[2];
+
+  Result generated = run(prot, *buffer, "setRequest", iterations,
+                         [&](TProtocol& p) { args.write(&p); },
+                         [&](TProtocol& p) { argsIn.read(&p); });
+  Result byByte = run(prot, *buffer, "setRequest", iterations,
+                      [&](TProtocol& p) { writeSetArgsByByte(&p, args); },
+                      [&](TProtocol& p) { readByteLists(&p, lists, 2); });
+  if (argsIn.value != args.value || lists[1] != args.value) {
+    fprintf(stderr, "setRequest value read back differs\n");
+    exit(1);
+  }
+  report(protocolName, "set", size, generated, byByte);
+
+  MemcachedService_getRequest_result result;
+  result.success = args.value;
+  result.__isset.success = true;
+  std::vector<int8_t> value;
+  MemcachedService_getRequest_presult presult;
+  presult.success = &value;
+
+  generated = run(prot, *buffer, "getRequest", iterations,
+                  [&](TProtocol& p) { result.write(&p); },
+                  [&](TProtocol& p) { presult.read(&p); });
+  byByte = run(prot, *buffer, "getRequest", iterations,
+               [&](TProtocol& p) { writeGetResultByByte(&p, result); },
+               [&](TProtocol& p) { readByteLists(&p, lists, 1); });
+  if (value != args.value || lists[0] != args.value) {
+    fprintf(stderr, "getRequest value read back differs\n");
+    exit(1);
+  }
+  report(protocolName, "get", size, generated, byByte);
+}
+}
+
+int main(int argc, char** argv) {
+  double megabytes = argc > 1 ? atof(argv[1]) : 256;
+
+  printf("ns per message, value of <size> bytes and a %u byte key; MB/s of the generated code\n",
+         KEY_BYTES);
+  printf("%-8s %-4s %6s  %10s %10s %10s %10s  %7s %7s  %8s\n", "protocol", "call", "size",
+         "gen write", "gen read", "byte write", "byte read", "write", "read", "MB/s");
+  for (uint32_t size = 64; size <= 64 * 1024; size *= 4) {
+    benchmark<TBinaryProtocol>("binary", size, megabytes);
+    benchmark<TCompactProtocol>("compact", size, megabytes);
+  }
+  return 0;
+}
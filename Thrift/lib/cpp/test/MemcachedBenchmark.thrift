@@ -0,0 +1,29 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// The memcached benchmark service of tutorial/cpp/memcached_thrift_int8_t:
+// keys and values are list<i8>, which the generated code reads and writes
+// with readBytes()/writeBytes()
+
+namespace cpp thrift_memcached
+
+service MemcachedService{
+    list<i8> getRequest(1:list<i8> key),
+    bool setRequest(1:list<i8> key, 2:list<i8> value)
+}
@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <thrift/transport/PacketLogEngine.h>
+
+BOOST_AUTO_TEST_SUITE(PacketLogEngineTest)
+
+using apache::thrift::transport::PacketLogEngine;
+
+namespace {
+
+struct Record {
+  uint64_t ns;
+  uint32_t seq;
+  uint32_t thread;
+  std::vector<uint8_t> data;
+};
+
+std::string tempPath(const char* name) {
+  return "/tmp/PacketLogEngineTest_" + std::to_string(getpid()) + "_" + name;
+}
+
+// Records as timestampNs writes them, with a seq/thread header of 8 bytes
+std::vector<Record> readRecords(const std::string& path, size_t dataLen) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::vector<Record> records;
+  const size_t size = 16 + dataLen;
+  BOOST_REQUIRE_EQUAL(bytes.size() % size, 0u);
+  for (size_t pos = 0; pos < bytes.size(); pos += size) {
+    Record r;
+    memcpy(&r.ns, &bytes[pos], 8);
+    memcpy(&r.seq, &bytes[pos + 8], 4);
+    memcpy(&r.thread, &bytes[pos + 12], 4);
+    r.data.assign(bytes.begin() + pos + 16, bytes.begin() + pos + size);
+    records.push_back(r);
+  }
+  return records;
+}
+
+uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_records_round_trip) {
+  const std::string path = tempPath("round_trip");
+  PacketLogEngine engine;
+  BOOST_REQUIRE(engine.open(0, path, true, PacketLogEngine::timestampNs));
+  engine.start();
+  uint64_t before = nowNs();
+  std::vector<uint8_t> payload(100);
+  for (uint32_t seq = 0; seq < 5000; ++seq) {
+    uint32_t header[2] = {seq, 0};
+    payload[0] = static_cast<uint8_t>(seq);
+    BOOST_CHECK(engine.log(0, header, sizeof(header), payload.data(), payload.size()));
+    if (seq % 500 == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  engine.stop();
+  uint64_t after = nowNs();
+
+  std::vector<Record> records = readRecords(path, payload.size());
+  BOOST_REQUIRE_EQUAL(records.size(), 5000u);
+  for (uint32_t seq = 0; seq < records.size(); ++seq) {
+    BOOST_CHECK_EQUAL(records[seq].seq, seq);
+    BOOST_CHECK_EQUAL(records[seq].data[0], static_cast<uint8_t>(seq));
+    if (seq > 0) {
+      BOOST_CHECK(records[seq].ns >= records[seq - 1].ns);
+    }
+  }
+  // The TSC is converted to the wall clock, within a millisecond
+  BOOST_CHECK(records.front().ns + 1000000 >= before);
+  BOOST_CHECK(records.back().ns <= after + 1000000);
+  BOOST_CHECK_EQUAL(engine.getStats().records, 5000u);
+  BOOST_CHECK_EQUAL(engine.getStats().dropped, 0u);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_threads_each_log_in_order) {
+  const std::string path = tempPath("threads");
+  PacketLogEngine engine;
+  BOOST_REQUIRE(engine.open(1, path, true, PacketLogEngine::timestampNs));
+  engine.start();
+  const uint32_t threads = 4;
+  const uint32_t perThread = 2000;
+  std::vector<std::thread> loggers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    loggers.emplace_back([&engine, t] {
+      uint8_t data[32] = {0};
+      for (uint32_t seq = 0; seq < perThread; ++seq) {
+        uint32_t header[2] = {seq, t};
+        while (!engine.log(1, header, sizeof(header), data, sizeof(data))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (size_t t = 0; t < loggers.size(); ++t) {
+    loggers[t].join();
+  }
+  engine.stop();
+
+  std::vector<Record> records = readRecords(path, 32);
+  BOOST_REQUIRE_EQUAL(records.size(), threads * perThread);
+  std::vector<uint32_t> next(threads, 0);
+  for (size_t i = 0; i < records.size(); ++i) {
+    BOOST_REQUIRE(records[i].thread < threads);
+    BOOST_CHECK_EQUAL(records[i].seq, next[records[i].thread]++);
+  }
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_stream) {
+  const std::string path = tempPath("compressed");
+  PacketLogEngine engine;
+  BOOST_REQUIRE(engine.openCompressed(0, path, PacketLogEngine::timestampNs));
+  engine.start();
+  std::vector<uint8_t> payload(100, 7);
+  for (uint32_t seq = 0; seq < 20000; ++seq) {
+    uint32_t header[2] = {seq, 0};
+    while (!engine.log(0, header, sizeof(header), payload.data(), payload.size())) {
+      std::this_thread::yield();
+    }
+  }
+  engine.stop();
+
+  apache::thrift::transport::BlockTraceReader reader(path);
+  BOOST_CHECK_EQUAL(reader.records(), 20000u);
+  BOOST_CHECK_EQUAL(reader.rawSize(), 20000u * (16 + payload.size()));
+  BOOST_CHECK(reader.fileSize() * 5 < reader.rawSize());
+  std::vector<uint8_t> block;
+  uint32_t seq = 0;
+  for (size_t i = 0; i < reader.blocks(); ++i) {
+    reader.read(i, block);
+    BOOST_REQUIRE_EQUAL(block.size() % (16 + payload.size()), 0u);
+    for (size_t pos = 0; pos < block.size(); pos += 16 + payload.size(), ++seq) {
+      uint32_t got;
+      memcpy(&got, &block[pos + 8], sizeof(got));
+      BOOST_REQUIRE_EQUAL(got, seq);
+    }
+  }
+  BOOST_CHECK_EQUAL(seq, 20000u);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_drops_are_counted) {
+  const std::string path = tempPath("drops");
+  PacketLogEngine engine(4096);
+  BOOST_REQUIRE(engine.open(0, path, true, PacketLogEngine::timestampNs));
+  // Closed streams and records larger than half the ring are refused
+  BOOST_CHECK(!engine.log(0, nullptr, 0, nullptr, 0));
+  engine.start();
+  BOOST_CHECK(!engine.log(2, nullptr, 0, nullptr, 0));
+  std::vector<uint8_t> big(4096);
+  BOOST_CHECK(!engine.log(0, nullptr, 0, big.data(), big.size()));
+  BOOST_CHECK(engine.log(0, nullptr, 0, big.data(), 64));
+  engine.stop();
+  BOOST_CHECK_EQUAL(engine.getStats().dropped, 1u);
+  BOOST_CHECK_EQUAL(engine.getStats().records, 1u);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_record_length_fits_its_field) {
+  // A ring large enough for it, so only the 24-bit length refuses it
+  const std::string path = tempPath("long_record");
+  PacketLogEngine engine(1u << 26);
+  BOOST_REQUIRE(engine.open(0, path, true, PacketLogEngine::timestampNs));
+  engine.start();
+  std::vector<uint8_t> big(PacketLogEngine::MAX_RECORD_BYTES + 1);
+  BOOST_CHECK(!engine.log(0, nullptr, 0, big.data(), big.size()));
+  BOOST_CHECK(!engine.log(0, big.data(), 1, big.data(), PacketLogEngine::MAX_RECORD_BYTES));
+  BOOST_CHECK(engine.log(0, nullptr, 0, big.data(), 64));
+  engine.stop();
+  BOOST_CHECK_EQUAL(engine.getStats().dropped, 2u);
+  BOOST_CHECK_EQUAL(engine.getStats().records, 1u);
+  remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_one_ring_per_engine) {
+  // A thread switching between engines keeps its ring in each
+  const std::string first = tempPath("first");
+  const std::string second = tempPath("second");
+  PacketLogEngine a(4096);
+  PacketLogEngine b(4096);
+  BOOST_REQUIRE(a.open(0, first, true, PacketLogEngine::timestampNs));
+  BOOST_REQUIRE(b.open(0, second, true, PacketLogEngine::timestampNs));
+  a.start();
+  b.start();
+  std::vector<uint8_t> payload(8);
+  for (uint32_t seq = 0; seq < 100; ++seq) {
+    uint32_t header[2] = {seq, 0};
+    BOOST_CHECK(a.log(0, header, sizeof(header), payload.data(), payload.size()));
+    BOOST_CHECK(b.log(0, header, sizeof(header), payload.data(), payload.size()));
+  }
+  BOOST_CHECK_EQUAL(a.getStats().rings, 1u);
+  BOOST_CHECK_EQUAL(b.getStats().rings, 1u);
+  a.stop();
+  b.stop();
+  BOOST_CHECK_EQUAL(readRecords(first, payload.size()).size(), 100u);
+  BOOST_CHECK_EQUAL(readRecords(second, payload.size()).size(), 100u);
+  remove(first.c_str());
+  remove(second.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
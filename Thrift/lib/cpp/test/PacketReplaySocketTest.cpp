@@ -0,0 +1,300 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <thrift/transport/PacketReplaySocket.h>
+
+BOOST_AUTO_TEST_SUITE(PacketReplaySocketTest)
+
+namespace {
+
+struct __attribute__((packed)) TraceHeader {
+  uint64_t timestamp;
+  int64_t req_id;
+  uint16_t size;
+};
+
+std::string tempPath(const char* name) {
+  return "/tmp/PacketReplaySocketTest_" + std::to_string(getpid()) + "_" + name;
+}
+
+// A trace of count requests; request i is i % 300 bytes of i
+void writeTrace(const std::string& path, int count) {
+  FILE* f = fopen(path.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  for (int i = 0; i < count; i++) {
+    TraceHeader header = {static_cast<uint64_t>(i), i, static_cast<uint16_t>(i % 300)};
+    uint8_t data[300];
+    memset(data, i & 0xff, sizeof(data));
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(data, 1, header.size, f);
+  }
+  fclose(f);
+}
+
+// The same trace as a block trace, blockBytes to a block
+void compressTrace(const std::string& path, const std::string& out, uint32_t blockBytes) {
+  FILE* f = fopen(path.c_str(), "rb");
+  BOOST_REQUIRE(f != nullptr);
+  apache::thrift::transport::BlockTraceWriter writer(out, blockBytes);
+  uint8_t record[sizeof(TraceHeader) + 300];
+  TraceHeader header;
+  while (fread(&header, sizeof(header), 1, f) == 1) {
+    memcpy(record, &header, sizeof(header));
+    BOOST_REQUIRE_EQUAL(fread(record + sizeof(header), 1, header.size, f), header.size);
+    writer.append(record, sizeof(header) + header.size, 1);
+  }
+  writer.close();
+  fclose(f);
+}
+
+void removeAll(const std::string& trace) {
+  unlink(trace.c_str());
+  unlink((trace + ".idx").c_str());
+  for (int i = 0; i < 4; i++) {
+    unlink((trace + ".resp." + std::to_string(i)).c_str());
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_replay_aligned) {
+  std::string trace = tempPath("trace.bin");
+  std::string expected = tempPath("expected.bin");
+  writeTrace(trace, 1000);
+  // Echoed back, the responses are the requests
+  writeTrace(expected, 1000);
+
+  // Once building the index, once reading it back
+  for (int run = 0; run < 2; run++) {
+    PacketReplaySocket replay;
+    replay.loadTrace(trace);
+    int n = 0;
+    while (!replay.isEOF()) {
+      uint8_t* addr = replay.getRecvBufferAddr();
+      BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(addr) % 64, 0u);
+      uint64_t timestamp;
+      memcpy(&timestamp, addr, sizeof(timestamp));
+      BOOST_CHECK_EQUAL(timestamp, static_cast<uint64_t>(n));
+      BOOST_CHECK_EQUAL(replay.getCurrentPacketSize(), 10 + n % 300);
+
+      uint8_t buf[300];
+      uint32_t got = replay.read(buf, sizeof(buf));
+      BOOST_REQUIRE_EQUAL(got, static_cast<uint32_t>(n % 300));
+      for (uint32_t i = 0; i < got; i++) {
+        BOOST_REQUIRE_EQUAL(buf[i], n & 0xff);
+      }
+      BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(replay.getRespBufferAddr()) % 64, 0u);
+      replay.write(buf, got);
+      n++;
+    }
+    BOOST_CHECK_EQUAL(n, 1000);
+    BOOST_CHECK(replay.validateReplay(expected));
+  }
+
+  unlink(expected.c_str());
+  removeAll(trace);
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_compressed) {
+  std::string plain = tempPath("plain.bin");
+  std::string trace = tempPath("trace.blk");
+  std::string expected = tempPath("expected.blk");
+  writeTrace(plain, 20000);
+  // Blocks small enough that the helper runs ahead and wraps its slots
+  compressTrace(plain, trace, 16 * 1024);
+  compressTrace(plain, expected, 1 << 20);
+
+  PacketReplaySocket replay;
+  replay.loadTrace(trace);
+  int n = 0;
+  const uint8_t* last = nullptr;
+  while (!replay.isEOF()) {
+    uint8_t* addr = replay.getRecvBufferAddr();
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(addr) % 64, 0u);
+    BOOST_CHECK_EQUAL(replay.getCurrentPacketTimestamp(), static_cast<uint64_t>(n));
+    BOOST_CHECK_EQUAL(replay.getCurrentPacketSize(), 10 + n % 300);
+    if (last) {
+      // The record handed out before is still there
+      uint16_t size;
+      memcpy(&size, last + 8, sizeof(size));
+      BOOST_CHECK_EQUAL(size, (n - 1) % 300);
+    }
+    last = addr;
+
+    uint8_t buf[300];
+    uint32_t got = replay.read(buf, sizeof(buf));
+    BOOST_REQUIRE_EQUAL(got, static_cast<uint32_t>(n % 300));
+    for (uint32_t i = 0; i < got; i++) {
+      BOOST_REQUIRE_EQUAL(buf[i], n & 0xff);
+    }
+    replay.write(buf, got);
+    n++;
+  }
+  BOOST_CHECK_EQUAL(n, 20000);
+  BOOST_CHECK(replay.validateReplay(expected));
+
+  // Stopped early, and again from the start
+  replay.loadTrace(trace, 5000);
+  n = 0;
+  for (; !replay.isEOF(); n++) {
+    replay.advanceReadPos();
+  }
+  BOOST_CHECK_EQUAL(n, 5000);
+  replay.loadTrace(trace);
+  BOOST_CHECK_EQUAL(replay.getCurrentPacketTimestamp(), 0u);
+
+  unlink(plain.c_str());
+  unlink(expected.c_str());
+  removeAll(trace);
+}
+
+BOOST_AUTO_TEST_CASE(test_max_requests_and_stale_index) {
+  std::string trace = tempPath("stale.bin");
+  writeTrace(trace, 100);
+  {
+    PacketReplaySocket replay;
+    replay.loadTrace(trace, 40);
+    int n = 0;
+    for (; !replay.isEOF(); n++) {
+      replay.advanceReadPos();
+    }
+    BOOST_CHECK_EQUAL(n, 40);
+  }
+
+  // A rewritten trace must not be served from the old index
+  writeTrace(trace, 150);
+  struct timeval times[2] = {{1, 0}, {1, 0}};
+  utimes(trace.c_str(), times);
+  {
+    PacketReplaySocket replay;
+    replay.loadTrace(trace);
+    int n = 0;
+    for (; !replay.isEOF(); n++) {
+      replay.advanceReadPos();
+    }
+    BOOST_CHECK_EQUAL(n, 150);
+  }
+
+  removeAll(trace);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_trace) {
+  // Requests of three flows, then a message in three fragments
+  std::string trace = tempPath("shared.bin");
+  FILE* f = fopen(trace.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  for (int i = 0; i < 300; i++) {
+    uint8_t data[8];
+    memset(data, i & 0xff, sizeof(data));
+    TraceHeader header = {static_cast<uint64_t>(i), (int64_t(1 + i % 3) << 32) | i, sizeof(data)};
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(data, 1, sizeof(data), f);
+  }
+  for (uint16_t i = 0; i < 3; i++) {
+    uint8_t data[apache::thrift::transport::TUDPFragment::HEADER_SIZE + 4];
+    apache::thrift::transport::TUDPFragment::Header fragment = {77, i, 3};
+    apache::thrift::transport::TUDPFragment::writeHeader(data, fragment);
+    memset(data + apache::thrift::transport::TUDPFragment::HEADER_SIZE, 'a' + i, 4);
+    TraceHeader header = {static_cast<uint64_t>(300 + i), int64_t(1) << 32, sizeof(data)};
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(data, 1, sizeof(data), f);
+  }
+  fclose(f);
+
+  PacketReplaySocket replay;
+  replay.loadTrace(trace);
+
+  // By flow, each shard sees its flow in order
+  for (size_t shard = 0; shard < 3; shard++) {
+    PacketReplaySocket part;
+    BOOST_REQUIRE(part.shareTrace(replay, shard, 3, PacketReplaySocket::SHARD_BY_FLOW));
+    uint64_t last = 0;
+    int n = 0;
+    for (; !part.isEOF(); n++) {
+      BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(part.getRecvBufferAddr()) % 64, 0u);
+      uint64_t ts = part.getCurrentPacketTimestamp();
+      if (ts < 300) {
+        BOOST_CHECK_EQUAL((1 + ts % 3) % 3, shard);
+      }
+      BOOST_CHECK(n == 0 || ts > last);
+      last = ts;
+      part.advanceReadPos();
+    }
+    BOOST_CHECK_EQUAL(n, shard == 1 ? 103 : 100);
+  }
+
+  // Round robin hands out every request once and the fragments together
+  std::vector<int> seen(300, 0);
+  int messages = 0;
+  for (size_t shard = 0; shard < 4; shard++) {
+    PacketReplaySocket part;
+    BOOST_REQUIRE(part.shareTrace(replay, shard, 4, PacketReplaySocket::SHARD_ROUND_ROBIN));
+    const uint8_t* data;
+    uint32_t size;
+    while (part.nextMessage(data, size)) {
+      if (size == 12) {
+        BOOST_CHECK(memcmp(data, "aaaabbbbcccc", 12) == 0);
+        messages++;
+      } else {
+        BOOST_REQUIRE_EQUAL(size, 8u);
+        seen[data[0]]++;
+      }
+    }
+    BOOST_CHECK(part.isEOF());
+  }
+  BOOST_CHECK_EQUAL(messages, 1);
+  for (int i = 0; i < 256; i++) {
+    BOOST_CHECK_EQUAL(seen[i], i < 300 - 256 ? 2 : 1);
+  }
+
+  // Nothing to share from a socket without a trace
+  PacketReplaySocket empty;
+  PacketReplaySocket part;
+  BOOST_CHECK(!part.shareTrace(empty, 0, 1, PacketReplaySocket::SHARD_BY_FLOW));
+  removeAll(trace);
+}
+
+BOOST_AUTO_TEST_CASE(test_response_rotation) {
+  std::string prefix = tempPath("resp");
+  PacketReplaySocket replay;
+  replay.setResponseFile(prefix);
+  static uint8_t buf[65535];
+  // More than one 64MB segment's worth
+  for (int i = 0; i < 1100; i++) {
+    BOOST_REQUIRE_EQUAL(replay.write(buf, sizeof(buf)), sizeof(buf));
+  }
+  BOOST_CHECK_EQUAL(replay.getRespDataSize(), 1100u * 65600u);
+
+  struct stat st;
+  BOOST_CHECK_EQUAL(stat((prefix + ".0").c_str(), &st), 0);
+  BOOST_CHECK_EQUAL(stat((prefix + ".1").c_str(), &st), 0);
+  for (int i = 0; i < 4; i++) {
+    unlink((prefix + "." + std::to_string(i)).c_str());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
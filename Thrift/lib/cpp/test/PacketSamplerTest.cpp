@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/PacketSampler.h>
+
+BOOST_AUTO_TEST_SUITE(PacketSamplerTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::T_CALL;
+using apache::thrift::transport::MessageHeader;
+using apache::thrift::transport::PacketSampler;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+std::string call(const std::string& method, int32_t seqid) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeMessageBegin(method, T_CALL, seqid);
+  protocol.writeStructBegin("args");
+  protocol.writeFieldBegin("req_id", apache::thrift::protocol::T_I64, 1);
+  protocol.writeI64(seqid);
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  protocol.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+// Runs a request of method through sample() and its later stages
+bool request(PacketSampler& sampler, const std::string& method, int32_t seqid,
+             uint32_t& bytes) {
+  std::string data = call(method, seqid);
+  MessageHeader header;
+  BOOST_REQUIRE(MessageHeader::parse(reinterpret_cast<const uint8_t*>(data.data()),
+                                     static_cast<uint32_t>(data.size()), header));
+  int64_t reqId = (int64_t(1) << 32) | static_cast<uint32_t>(seqid);
+  bool sampled = sampler.sample(reqId, &header, static_cast<uint32_t>(data.size()), bytes);
+  uint32_t later;
+  BOOST_CHECK_EQUAL(sampler.follows(reqId, nullptr, 10, later), sampled);
+  return sampled;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_default_logs_everything) {
+  PacketSampler sampler;
+  uint32_t bytes;
+  std::string data = call("ComposeUniqueId", 1);
+  for (int32_t i = 0; i < 100; ++i) {
+    BOOST_CHECK(request(sampler, "ComposeUniqueId", i, bytes));
+    BOOST_CHECK_EQUAL(bytes, data.size());
+  }
+  // Reads that start no message too, and any later stage
+  BOOST_CHECK(sampler.sample(0, nullptr, 4, bytes));
+  BOOST_CHECK(sampler.follows(12345, nullptr, 7, bytes));
+  BOOST_CHECK_EQUAL(bytes, 7u);
+}
+
+BOOST_AUTO_TEST_CASE(test_rate_and_methods) {
+  PacketSampler sampler;
+  PacketSampler::Policy policy;
+  policy.rate = 10;
+  policy.methods.push_back("ComposeUniqueId");
+  policy.capture = PacketSampler::HEADER;
+  sampler.setPolicy(policy);
+
+  uint32_t bytes;
+  int sampled = 0;
+  for (int32_t i = 0; i < 10000; ++i) {
+    if (request(sampler, "ComposeUniqueId", i, bytes)) {
+      sampled++;
+      // Version, name length, name and seqid
+      BOOST_CHECK_EQUAL(bytes, 8u + 15u + 4u);
+      // Not some other request on this thread
+      BOOST_CHECK(!sampler.follows((int64_t(1) << 32) | (i + 1), nullptr, 10, bytes));
+    }
+    BOOST_CHECK(!request(sampler, "ReadPost", i, bytes));
+  }
+  BOOST_CHECK(sampled > 900 && sampled < 1100);
+  BOOST_CHECK(!sampler.sample(0, nullptr, 4, bytes));
+
+  // The same requests again, as another process would pick them
+  int again = 0;
+  for (int32_t i = 0; i < 10000; ++i) {
+    again += request(sampler, "ComposeUniqueId", i, bytes) ? 1 : 0;
+  }
+  BOOST_CHECK_EQUAL(again, sampled);
+
+  policy.enabled = false;
+  sampler.setPolicy(policy);
+  BOOST_CHECK(!sampler.enabled());
+  BOOST_CHECK(!request(sampler, "ComposeUniqueId", 0, bytes));
+}
+
+BOOST_AUTO_TEST_CASE(test_token_bucket) {
+  PacketSampler sampler;
+  PacketSampler::Policy policy;
+  policy.tokensPerSecond = 10;
+  policy.burst = 5;
+  sampler.setPolicy(policy);
+
+  uint32_t bytes;
+  int sampled = 0;
+  for (int32_t i = 0; i < 1000; ++i) {
+    sampled += request(sampler, "ComposeUniqueId", i, bytes) ? 1 : 0;
+  }
+  BOOST_CHECK_EQUAL(sampled, 5);
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  sampled = 0;
+  for (int32_t i = 0; i < 1000; ++i) {
+    sampled += request(sampler, "ComposeUniqueId", i, bytes) ? 1 : 0;
+  }
+  BOOST_CHECK(sampled >= 2 && sampled <= 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_read_request) {
+  PacketSampler sampler;
+  PacketSampler::Policy policy;
+  policy.rate = 2;
+  sampler.setPolicy(policy);
+
+  // A framed request read in three parts: the frame length, the message
+  // start and a continuation; only the second has a req_id
+  std::string data = call("ComposeUniqueId", 0);
+  MessageHeader header;
+  BOOST_REQUIRE(MessageHeader::parse(reinterpret_cast<const uint8_t*>(data.data()),
+                                     static_cast<uint32_t>(data.size()), header));
+  uint32_t bytes;
+  int sampled = 0;
+  for (int32_t i = 0; i < 100; ++i) {
+    int64_t reqId = (int64_t(1) << 32) | static_cast<uint32_t>(i);
+    BOOST_CHECK(!sampler.sample(0, nullptr, 4, bytes));
+    bool first = sampler.sample(reqId, &header, static_cast<uint32_t>(data.size()), bytes);
+    BOOST_CHECK(!sampler.sample(0, nullptr, 16, bytes));
+    // The later stages still follow the decision
+    BOOST_CHECK_EQUAL(sampler.follows(reqId, nullptr, 10, bytes), first);
+    BOOST_CHECK_EQUAL(sampler.follows(reqId, &header, static_cast<uint32_t>(data.size()), bytes),
+                      first);
+    sampled += first ? 1 : 0;
+  }
+  BOOST_CHECK(sampled > 0 && sampled < 100);
+}
+
+BOOST_AUTO_TEST_CASE(test_control_file) {
+  std::istringstream good(
+      "# sample one in a hundred ComposeUniqueId calls, headers only\n"
+      "rate 100\n"
+      "tokens 1000 50\n"
+      "methods ComposeUniqueId  # and nothing else\n"
+      "capture header\n");
+  PacketSampler::Policy policy;
+  std::string error;
+  BOOST_REQUIRE(PacketSampler::parsePolicy(good, policy, error));
+  BOOST_CHECK(policy.enabled);
+  BOOST_CHECK_EQUAL(policy.rate, 100u);
+  BOOST_CHECK_EQUAL(policy.tokensPerSecond, 1000.0);
+  BOOST_CHECK_EQUAL(policy.burst, 50u);
+  BOOST_REQUIRE_EQUAL(policy.methods.size(), 1u);
+  BOOST_CHECK_EQUAL(policy.methods[0], "ComposeUniqueId");
+  BOOST_CHECK_EQUAL(policy.capture, PacketSampler::HEADER);
+
+  std::istringstream bad("rate 10\ncapture most\n");
+  BOOST_CHECK(!PacketSampler::parsePolicy(bad, policy, error));
+  BOOST_CHECK_EQUAL(error, "line 2: capture most");
+
+  // Picked up when the file changes
+  std::string path = "/tmp/PacketSamplerTest_" + std::to_string(getpid());
+  FILE* f = fopen(path.c_str(), "w");
+  BOOST_REQUIRE(f != nullptr);
+  fputs("enabled no\n", f);
+  fclose(f);
+  PacketSampler sampler;
+  sampler.watch(path);
+  BOOST_CHECK(!sampler.enabled());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  f = fopen(path.c_str(), "w");
+  BOOST_REQUIRE(f != nullptr);
+  fputs("enabled yes\nrate 2\n", f);
+  fclose(f);
+  for (int i = 0; i < 50 && !sampler.enabled(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(PacketSampler::WATCH_MS / 4));
+  }
+  BOOST_CHECK(sampler.enabled());
+  BOOST_CHECK_EQUAL(sampler.policy().rate, 2u);
+  sampler.unwatch();
+  unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,267 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <thrift/transport/PcapTrace.h>
+
+BOOST_AUTO_TEST_SUITE(PcapTraceTest)
+
+using apache::thrift::transport::PcapTrace;
+using apache::thrift::transport::TTransportException;
+
+namespace {
+
+struct __attribute__((packed)) TraceHeader {
+  uint64_t timestamp;
+  int64_t req_id;
+  uint16_t size;
+};
+
+struct Record {
+  uint64_t timestamp;
+  std::string data;
+};
+
+std::string tempPath(const char* name) {
+  return "/tmp/PcapTraceTest_" + std::to_string(getpid()) + "_" + name;
+}
+
+void writeTrace(const std::string& path, const std::vector<Record>& records) {
+  FILE* f = fopen(path.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  for (size_t i = 0; i < records.size(); i++) {
+    TraceHeader header = {records[i].timestamp, static_cast<int64_t>(i + 1),
+                          static_cast<uint16_t>(records[i].data.size())};
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(records[i].data.data(), 1, header.size, f);
+  }
+  fclose(f);
+}
+
+std::vector<Record> readTrace(const std::string& path) {
+  std::vector<Record> records;
+  FILE* f = fopen(path.c_str(), "rb");
+  BOOST_REQUIRE(f != nullptr);
+  TraceHeader header;
+  while (fread(&header, sizeof(header), 1, f) == 1) {
+    Record record;
+    record.timestamp = header.timestamp;
+    record.data.resize(header.size);
+    BOOST_REQUIRE_EQUAL(fread(&record.data[0], 1, header.size, f), header.size);
+    records.push_back(record);
+  }
+  fclose(f);
+  return records;
+}
+
+void append(std::vector<uint8_t>& out, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+void appendBe16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+// An IPv4 packet with a UDP header, fragment bits as given
+std::vector<uint8_t> ipv4Udp(uint16_t src, uint16_t dst, const std::string& payload,
+                             uint16_t fragment = 0x4000) {
+  std::vector<uint8_t> p;
+  p.push_back(0x45);
+  p.push_back(0);
+  appendBe16(p, static_cast<uint16_t>(28 + payload.size()));
+  appendBe16(p, 0);
+  appendBe16(p, fragment);
+  p.push_back(64);
+  p.push_back(17);
+  appendBe16(p, 0);
+  const uint8_t addrs[8] = {10, 0, 0, 2, 10, 0, 0, 1};
+  append(p, addrs, sizeof(addrs));
+  appendBe16(p, src);
+  appendBe16(p, dst);
+  appendBe16(p, static_cast<uint16_t>(8 + payload.size()));
+  appendBe16(p, 0);
+  append(p, payload.data(), payload.size());
+  return p;
+}
+
+// An IPv6 packet with a UDP header behind a destination options header
+std::vector<uint8_t> ipv6Udp(uint16_t src, uint16_t dst, const std::string& payload) {
+  std::vector<uint8_t> p;
+  p.push_back(0x60);
+  p.push_back(0);
+  appendBe16(p, 0);
+  appendBe16(p, static_cast<uint16_t>(16 + payload.size()));
+  p.push_back(60);
+  p.push_back(64);
+  p.resize(p.size() + 32, 0);
+  p.push_back(17);
+  p.push_back(0);
+  p.resize(p.size() + 6, 0);
+  appendBe16(p, src);
+  appendBe16(p, dst);
+  appendBe16(p, static_cast<uint16_t>(8 + payload.size()));
+  appendBe16(p, 0);
+  append(p, payload.data(), payload.size());
+  return p;
+}
+
+// An Ethernet frame, VLAN tagged if vlan is not 0
+std::vector<uint8_t> ethernet(uint16_t type, const std::vector<uint8_t>& ip, uint16_t vlan = 0) {
+  std::vector<uint8_t> f(12, 0x02);
+  if (vlan) {
+    appendBe16(f, 0x8100);
+    appendBe16(f, vlan);
+  }
+  appendBe16(f, type);
+  append(f, ip.data(), ip.size());
+  return f;
+}
+
+// A classic pcap record, ts in microseconds
+void pcapRecord(std::vector<uint8_t>& out, uint32_t sec, uint32_t usec,
+                const std::vector<uint8_t>& frame, uint32_t capLen) {
+  uint32_t header[4] = {sec, usec, capLen, static_cast<uint32_t>(frame.size())};
+  append(out, header, sizeof(header));
+  append(out, frame.data(), capLen);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_export_import_round_trip) {
+  std::string requests = tempPath("requests.bin");
+  std::string responses = tempPath("responses.bin");
+  std::string pcapng = tempPath("trace.pcapng");
+  std::string requestsBack = tempPath("requests_back.bin");
+  std::string responsesBack = tempPath("responses_back.bin");
+
+  std::vector<Record> in;
+  std::vector<Record> out;
+  for (int i = 0; i < 50; i++) {
+    Record request = {1700000000000000000ULL + i * 1000ULL, std::string(i * 20, char(i))};
+    Record response = {request.timestamp + 500, std::string(7 + i, char(100 + i))};
+    in.push_back(request);
+    out.push_back(response);
+  }
+  writeTrace(requests, in);
+  writeTrace(responses, out);
+
+  PcapTrace::Stats exported = PcapTrace::exportPcapng(requests, responses, pcapng);
+  BOOST_CHECK_EQUAL(exported.packets, 100u);
+  BOOST_CHECK_EQUAL(exported.requests, 50u);
+  BOOST_CHECK_EQUAL(exported.responses, 50u);
+
+  PcapTrace::Stats imported = PcapTrace::importPcap(pcapng, 9090, requestsBack, responsesBack);
+  BOOST_CHECK_EQUAL(imported.packets, 100u);
+  BOOST_CHECK_EQUAL(imported.requests, 50u);
+  BOOST_CHECK_EQUAL(imported.responses, 50u);
+  BOOST_CHECK_EQUAL(imported.skipped, 0u);
+
+  std::vector<Record> inBack = readTrace(requestsBack);
+  std::vector<Record> outBack = readTrace(responsesBack);
+  BOOST_REQUIRE_EQUAL(inBack.size(), in.size());
+  BOOST_REQUIRE_EQUAL(outBack.size(), out.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    BOOST_CHECK_EQUAL(inBack[i].timestamp, in[i].timestamp);
+    BOOST_CHECK(inBack[i].data == in[i].data);
+    BOOST_CHECK_EQUAL(outBack[i].timestamp, out[i].timestamp);
+    BOOST_CHECK(outBack[i].data == out[i].data);
+  }
+
+  // Other ports are not ours
+  PcapTrace::Stats other = PcapTrace::importPcap(pcapng, 9091, requestsBack, "");
+  BOOST_CHECK_EQUAL(other.requests, 0u);
+  BOOST_CHECK_EQUAL(other.skipped, 100u);
+
+  unlink(requests.c_str());
+  unlink(responses.c_str());
+  unlink(pcapng.c_str());
+  unlink(requestsBack.c_str());
+  unlink(responsesBack.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_import_pcap) {
+  std::string pcap = tempPath("capture.pcap");
+  std::string requests = tempPath("requests.bin");
+  std::string responses = tempPath("responses.bin");
+
+  std::vector<uint8_t> file;
+  uint32_t global[6] = {0xA1B2C3D4, 0x00040002, 0, 0, 65535, 1};
+  append(file, global, sizeof(global));
+
+  std::vector<uint8_t> request = ethernet(0x0800, ipv4Udp(40000, 9090, "request"), 42);
+  // Trailing Ethernet padding is not payload
+  request.resize(request.size() + 6, 0);
+  pcapRecord(file, 10, 1, request, static_cast<uint32_t>(request.size()));
+  std::vector<uint8_t> response = ethernet(0x86dd, ipv6Udp(9090, 40000, "response"));
+  pcapRecord(file, 10, 2, response, static_cast<uint32_t>(response.size()));
+  std::vector<uint8_t> fragment = ethernet(0x0800, ipv4Udp(40000, 9090, "fragment", 0x2000));
+  pcapRecord(file, 10, 3, fragment, static_cast<uint32_t>(fragment.size()));
+  std::vector<uint8_t> arp = ethernet(0x0806, std::vector<uint8_t>(28, 0));
+  pcapRecord(file, 10, 4, arp, static_cast<uint32_t>(arp.size()));
+  std::vector<uint8_t> cut = ethernet(0x0800, ipv4Udp(40000, 9090, "snapped"));
+  pcapRecord(file, 10, 5, cut, 40);
+
+  FILE* f = fopen(pcap.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  fwrite(file.data(), 1, file.size(), f);
+  fclose(f);
+
+  PcapTrace::Stats stats = PcapTrace::importPcap(pcap, 9090, requests, responses);
+  BOOST_CHECK_EQUAL(stats.packets, 5u);
+  BOOST_CHECK_EQUAL(stats.requests, 1u);
+  BOOST_CHECK_EQUAL(stats.responses, 1u);
+  BOOST_CHECK_EQUAL(stats.skipped, 2u);
+  BOOST_CHECK_EQUAL(stats.truncated, 1u);
+
+  std::vector<Record> in = readTrace(requests);
+  std::vector<Record> out = readTrace(responses);
+  BOOST_REQUIRE_EQUAL(in.size(), 1u);
+  BOOST_REQUIRE_EQUAL(out.size(), 1u);
+  BOOST_CHECK_EQUAL(in[0].timestamp, 10000001000ULL);
+  BOOST_CHECK_EQUAL(in[0].data, "request");
+  BOOST_CHECK_EQUAL(out[0].timestamp, 10000002000ULL);
+  BOOST_CHECK_EQUAL(out[0].data, "response");
+
+  unlink(pcap.c_str());
+  unlink(requests.c_str());
+  unlink(responses.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_import_not_pcap) {
+  std::string path = tempPath("not.pcap");
+  FILE* f = fopen(path.c_str(), "wb");
+  BOOST_REQUIRE(f != nullptr);
+  fputs("timestamp,req_id,size,data_hex\n", f);
+  fclose(f);
+  std::string requests = tempPath("requests.bin");
+  BOOST_CHECK_THROW(PcapTrace::importPcap(path, 9090, requests, ""), TTransportException);
+  BOOST_CHECK_THROW(PcapTrace::importPcap(tempPath("missing.pcap"), 9090, requests, ""),
+                    TTransportException);
+  unlink(path.c_str());
+  unlink(requests.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,250 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Reading the list<Post> reply of PostStorageService::ReadPosts, as the
+ * home and user timeline services do, for 10 to 1000 posts:
+ *
+ *   owned    PostStorageService_ReadPosts_presult: a std::string per text,
+ *            username and url
+ *   view     PostStorageService_ReadPosts_result_view (cpp:views): the
+ *            strings point into the reply buffer
+ *
+ * each from a TMemoryBuffer over the reply, as TReplayServer and the
+ * framed transports hand it to the protocol, with the heap allocations
+ * counted per reply.
+ *
+ * Usage: PostViewBenchmark [megabytes per case]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "gen-cpp/PostStorageService.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift_social_network;
+
+namespace {
+uint64_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+double nowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Posts shaped like the ones wrk2's compose-post.lua makes
+std::vector<Post> makePosts(size_t count) {
+  std::mt19937_64 rng(count);
+  std::uniform_int_distribution<int> users(0, 961);
+  std::uniform_int_distribution<int> textLength(32, 256);
+  std::uniform_int_distribution<int> few(0, 2);
+  std::vector<Post> posts(count);
+  for (size_t i = 0; i < count; ++i) {
+    Post& post = posts[i];
+    post.post_id = static_cast<int64_t>(rng() >> 1);
+    post.req_id = static_cast<int64_t>(rng() >> 1);
+    post.timestamp = 1700000000000 + static_cast<int64_t>(i);
+    post.post_type = PostType::POST;
+    post.creator.user_id = users(rng);
+    post.creator.username = "username_" + std::to_string(post.creator.user_id);
+    for (int m = few(rng); m > 0; --m) {
+      UserMention mention;
+      mention.user_id = users(rng);
+      mention.username = "username_" + std::to_string(mention.user_id);
+      post.text += "@" + mention.username + " ";
+      post.user_mentions.push_back(mention);
+    }
+    post.text += std::string(textLength(rng), 'a' + static_cast<char>(i % 26));
+    for (int u = few(rng); u > 0; --u) {
+      Url url;
+      url.expanded_url = "http://" + std::string(64, 'u');
+      url.shortened_url = "http://short-url/" + std::to_string(rng() % 100000000);
+      post.text += " " + url.shortened_url;
+      post.urls.push_back(url);
+    }
+    for (int m = few(rng); m > 0; --m) {
+      Media media;
+      media.media_id = static_cast<int64_t>(rng() >> 1);
+      media.media_type = "png";
+      post.media.push_back(media);
+    }
+  }
+  return posts;
+}
+
+bool same(const Post& post, const Post_view& view) {
+  if (post.post_id != view.post_id || post.text != view.text
+      || post.creator.username != view.creator.username
+      || post.user_mentions.size() != view.user_mentions.size()
+      || post.urls.size() != view.urls.size() || post.media.size() != view.media.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < post.user_mentions.size(); ++i) {
+    if (post.user_mentions[i].username != view.user_mentions[i].username) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < post.urls.size(); ++i) {
+    if (post.urls[i].shortened_url != view.urls[i].shortened_url
+        || post.urls[i].expanded_url != view.urls[i].expanded_url) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < post.media.size(); ++i) {
+    if (post.media[i].media_type != view.media[i].media_type) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Result {
+  double ns;
+  double allocations;
+};
+
+// Reads the reply in reply iterations times with read(prot)
+template <class Read>
+Result run(TProtocol& prot, TMemoryBuffer& buffer, const std::string& reply, int iterations,
+           Read read) {
+  uint64_t allocated = 0;
+  double start = nowNs();
+  for (int i = 0; i < iterations; ++i) {
+    buffer.resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(reply.data())),
+                       static_cast<uint32_t>(reply.size()), TMemoryBuffer::OBSERVE);
+    uint64_t before = allocations;
+    std::string fname;
+    TMessageType type;
+    int32_t seqid;
+    prot.readMessageBegin(fname, type, seqid);
+    read(prot);
+    prot.readMessageEnd();
+    allocated += allocations - before;
+  }
+  Result r = {(nowNs() - start) / iterations, static_cast<double>(allocated) / iterations};
+  return r;
+}
+
+template <class Protocol>
+void benchmark(const char* protocolName, size_t count, double megabytes) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol prot(buffer);
+
+  PostStorageService_ReadPosts_result result;
+  result.success = makePosts(count);
+  result.__isset.success = true;
+  prot.writeMessageBegin("ReadPosts", T_REPLY, 1);
+  result.write(&prot);
+  prot.writeMessageEnd();
+  std::string reply = buffer->getBufferAsString();
+
+  int iterations = static_cast<int>(megabytes * 1024 * 1024 / reply.size());
+  if (iterations < 20) {
+    iterations = 20;
+  }
+
+  std::vector<Post> posts;
+  Result owned = run(prot, *buffer, reply, iterations, [&](TProtocol& p) {
+    std::vector<Post> fresh;
+    PostStorageService_ReadPosts_presult presult;
+    presult.success = &fresh;
+    presult.read(&p);
+    posts.swap(fresh);
+  });
+  Result view = run(prot, *buffer, reply, iterations, [&](TProtocol& p) {
+    PostStorageService_ReadPosts_result_view fresh;
+    fresh.read(&p);
+  });
+
+  // The last views, while the reply they point into is still there
+  buffer->resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(reply.data())),
+                      static_cast<uint32_t>(reply.size()), TMemoryBuffer::OBSERVE);
+  std::string fname;
+  TMessageType type;
+  int32_t seqid;
+  prot.readMessageBegin(fname, type, seqid);
+  PostStorageService_ReadPosts_result_view views;
+  views.read(&prot);
+  prot.readMessageEnd();
+  if (posts.size() != count || views.success.size() != count) {
+    fprintf(stderr, "ReadPosts read back %zu and %zu posts of %zu\n", posts.size(),
+            views.success.size(), count);
+    exit(1);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (posts[i] != result.success[i] || !same(result.success[i], views.success[i])) {
+      fprintf(stderr, "ReadPosts post %zu read back differs\n", i);
+      exit(1);
+    }
+  }
+
+  printf("%-8s %5zu %8zu  %10.0f %10.0f  %6.2fx  %8.0f %8.0f\n", protocolName, count,
+         reply.size(), owned.ns, view.ns, owned.ns / view.ns, owned.allocations,
+         view.allocations);
+}
+}
+
+int main(int argc, char** argv) {
+  double megabytes = argc > 1 ? atof(argv[1]) : 256;
+
+  printf("ns and heap allocations per ReadPosts reply of <posts> posts and <bytes> bytes\n");
+  printf("%-8s %5s %8s  %10s %10s  %7s  %8s %8s\n", "protocol", "posts", "bytes", "owned ns",
+         "view ns", "speedup", "owned", "view");
+  for (size_t count = 10; count <= 1000; count *= 10) {
+    benchmark<TBinaryProtocol>("binary", count, megabytes);
+    benchmark<TCompactProtocol>("compact", count, megabytes);
+  }
+  return 0;
+}
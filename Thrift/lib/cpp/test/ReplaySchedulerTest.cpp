@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <thrift/transport/LatencyHistogram.h>
+#include <thrift/transport/ReplayScheduler.h>
+
+BOOST_AUTO_TEST_SUITE(ReplaySchedulerTest)
+
+using apache::thrift::transport::LatencyHistogram;
+using apache::thrift::transport::ReplayScheduler;
+
+namespace {
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                              - since)
+      .count();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_histogram_percentiles) {
+  LatencyHistogram histogram;
+  for (uint64_t v = 1; v <= 100000; ++v) {
+    histogram.record(v * 1000);
+  }
+  BOOST_CHECK_EQUAL(histogram.count(), 100000u);
+  BOOST_CHECK_EQUAL(histogram.min(), 1000u);
+  BOOST_CHECK_EQUAL(histogram.max(), 100000000u);
+  // Three significant digits
+  BOOST_CHECK_CLOSE(static_cast<double>(histogram.percentile(50)), 50000000.0, 0.1);
+  BOOST_CHECK_CLOSE(static_cast<double>(histogram.percentile(99)), 99000000.0, 0.1);
+  BOOST_CHECK_CLOSE(static_cast<double>(histogram.percentile(99.9)), 99900000.0, 0.1);
+  BOOST_CHECK_EQUAL(histogram.percentile(100), 100000000u);
+  BOOST_CHECK_CLOSE(histogram.mean(), 50000500.0, 0.001);
+
+  // Small values are exact, larger than MAX_VALUE are clamped
+  LatencyHistogram exact;
+  exact.record(0);
+  exact.record(1023);
+  exact.record(LatencyHistogram::MAX_VALUE + 1);
+  BOOST_CHECK_EQUAL(exact.percentile(0), 0u);
+  BOOST_CHECK_EQUAL(exact.percentile(60), 1023u);
+  BOOST_CHECK_EQUAL(exact.max(), LatencyHistogram::MAX_VALUE);
+
+  LatencyHistogram merged;
+  merged.add(histogram);
+  merged.add(exact);
+  BOOST_CHECK_EQUAL(merged.count(), 100003u);
+  BOOST_CHECK_EQUAL(merged.min(), 0u);
+
+  std::ostringstream out;
+  histogram.print(out);
+  BOOST_CHECK(out.str().find("Value     Percentile TotalCount") != std::string::npos);
+  BOOST_CHECK(out.str().find("Total count    =       100000") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_open_loop_pacing) {
+  // Requests recorded 2ms apart, replayed at twice the speed
+  ReplayScheduler scheduler(2.0);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < 5; ++i) {
+    scheduler.release(1000000000ULL + i * 2000000ULL);
+    BOOST_CHECK_GE(elapsedNs(start), i * 1000000ULL);
+    scheduler.complete();
+  }
+  BOOST_CHECK_EQUAL(scheduler.response().count(), 5u);
+
+  // A request taking longer than the gap delays the next one, which
+  // shows up as queueing, not service
+  ReplayScheduler slow(1.0);
+  slow.release(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  slow.complete();
+  slow.release(1000000);
+  slow.complete();
+  BOOST_CHECK_GE(slow.queueing().max(), 3000000u);
+  BOOST_CHECK_LT(slow.service().min(), 3000000u);
+  BOOST_CHECK_GE(slow.response().max(), slow.queueing().max());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/ReplayValidator.h>
+
+BOOST_AUTO_TEST_SUITE(ReplayValidatorTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::T_I64;
+using apache::thrift::protocol::T_REPLY;
+using apache::thrift::protocol::T_STRING;
+using apache::thrift::transport::ReplayValidator;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+// A reply struct of two fields: 0 an id, 1 a note
+std::string reply(const std::string& method, int32_t seqid, int64_t id, const std::string& note) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeMessageBegin(method, T_REPLY, seqid);
+  protocol.writeStructBegin("result");
+  protocol.writeFieldBegin("success", T_I64, 0);
+  protocol.writeI64(id);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("note", T_STRING, 1);
+  protocol.writeString(note);
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  protocol.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+void append(std::vector<uint8_t>& out, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// PacketLogger record: ts, req_id, u16 size, data
+void capture(std::vector<uint8_t>& out, const std::string& message) {
+  uint64_t ts = 1;
+  int64_t reqId = 0;
+  uint16_t size = static_cast<uint16_t>(message.size());
+  append(out, &ts, sizeof(ts));
+  append(out, &reqId, sizeof(reqId));
+  append(out, &size, sizeof(size));
+  append(out, message.data(), message.size());
+}
+
+// PacketReplaySocket record: ts, u16 size, data, padded to 64 bytes
+void replayed(std::vector<uint8_t>& out, const std::string& message) {
+  uint64_t ts = 2;
+  uint16_t size = static_cast<uint16_t>(message.size());
+  append(out, &ts, sizeof(ts));
+  append(out, &size, sizeof(size));
+  append(out, message.data(), message.size());
+  out.resize((out.size() + 63) & ~size_t(63));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_masked_fields_match) {
+  std::vector<uint8_t> expected, actual;
+  for (int32_t i = 0; i < 100; ++i) {
+    capture(expected, reply("ComposeUniqueId", i, 1000 + i, "ok"));
+    replayed(actual, reply("ComposeUniqueId", i, 5000 + i, "ok"));
+  }
+
+  ReplayValidator strict;
+  strict.addExpected(expected.data(), expected.size(), ReplayValidator::CAPTURE);
+  strict.addActual(actual.data(), actual.size(), ReplayValidator::REPLAY);
+  BOOST_CHECK(!strict.validate());
+  BOOST_CHECK_EQUAL(strict.summary().differing, 100u);
+  BOOST_CHECK_EQUAL(strict.diffs().size(), 10u);
+  BOOST_CHECK_EQUAL(strict.diffs()[0].kind, ReplayValidator::CONTENT);
+  BOOST_CHECK_EQUAL(strict.diffs()[0].method, "ComposeUniqueId");
+
+  ReplayValidator masked;
+  masked.maskField("ComposeUniqueId", 0);
+  masked.addExpected(expected.data(), expected.size(), ReplayValidator::CAPTURE);
+  masked.addActual(actual.data(), actual.size(), ReplayValidator::REPLAY);
+  BOOST_CHECK(masked.validate());
+  BOOST_CHECK_EQUAL(masked.summary().expected, 100u);
+  BOOST_CHECK_EQUAL(masked.summary().identical, 100u);
+  BOOST_CHECK_EQUAL(masked.summary().reordered, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_reordered_missing_and_differing) {
+  std::vector<uint8_t> expected, actual;
+  for (int32_t i = 0; i < 10; ++i) {
+    capture(expected, reply("get", i, i, "ok"));
+  }
+  // 0..4 in step, then 9..6 backwards, 5 lost, 7 with another note,
+  // and one nobody asked for
+  for (int32_t i = 0; i < 5; ++i) {
+    replayed(actual, reply("get", i, i, "ok"));
+  }
+  for (int32_t i = 9; i > 5; --i) {
+    replayed(actual, reply("get", i, i, i == 7 ? "no" : "ok"));
+  }
+  replayed(actual, reply("put", 3, 3, "ok"));
+
+  ReplayValidator validator(5);
+  validator.addExpected(expected.data(), expected.size(), ReplayValidator::CAPTURE);
+  validator.addActual(actual.data(), actual.size(), ReplayValidator::REPLAY);
+  BOOST_CHECK(!validator.validate());
+  const ReplayValidator::Summary& s = validator.summary();
+  BOOST_CHECK_EQUAL(s.expected, 10u);
+  BOOST_CHECK_EQUAL(s.actual, 10u);
+  BOOST_CHECK_EQUAL(s.matched, 9u);
+  BOOST_CHECK_EQUAL(s.identical, 8u);
+  BOOST_CHECK_EQUAL(s.differing, 1u);
+  BOOST_CHECK_EQUAL(s.missing, 1u);
+  BOOST_CHECK_EQUAL(s.unexpected, 1u);
+  BOOST_CHECK_EQUAL(s.unparsed, 0u);
+
+  const std::vector<ReplayValidator::Diff>& diffs = validator.diffs();
+  BOOST_REQUIRE_EQUAL(diffs.size(), 3u);
+  BOOST_CHECK_EQUAL(diffs[0].kind, ReplayValidator::CONTENT);
+  BOOST_CHECK_EQUAL(diffs[0].seqid, 7);
+  std::string seven = reply("get", 7, 7, "ok");
+  BOOST_CHECK_EQUAL(diffs[0].offset, seven.size() - 3);  // "ok" vs "no", then the stop
+  BOOST_CHECK_EQUAL(diffs[1].kind, ReplayValidator::UNEXPECTED);
+  BOOST_CHECK_EQUAL(diffs[1].method, "put");
+  BOOST_CHECK_EQUAL(diffs[2].kind, ReplayValidator::MISSING);
+  BOOST_CHECK_EQUAL(diffs[2].seqid, 5);
+
+  std::ostringstream out;
+  validator.print(out);
+  BOOST_CHECK(out.str().find("#1 content get seqid 7") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_byte_masks_and_sizes) {
+  std::vector<uint8_t> expected, actual;
+  std::string a = reply("get", 1, 1, "abc");
+  std::string b = reply("get", 1, 1, "abd");
+  capture(expected, a);
+  replayed(actual, b);
+  capture(expected, reply("get", 2, 2, "short"));
+  replayed(actual, reply("get", 2, 2, "longer"));
+
+  ReplayValidator validator;
+  validator.maskBytes("", static_cast<uint32_t>(a.size() - 2), 1);
+  validator.addExpected(expected.data(), expected.size(), ReplayValidator::CAPTURE);
+  validator.addActual(actual.data(), actual.size(), ReplayValidator::REPLAY);
+  BOOST_CHECK(!validator.validate());
+  BOOST_CHECK_EQUAL(validator.summary().identical, 1u);
+  BOOST_REQUIRE_EQUAL(validator.diffs().size(), 1u);
+  BOOST_CHECK_EQUAL(validator.diffs()[0].kind, ReplayValidator::SIZE);
+  BOOST_CHECK_EQUAL(validator.diffs()[0].seqid, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_unparsed_after_dropped_reply) {
+  // A reply lost before an unparsed record puts the sides out of step;
+  // the unparsed records still pair up with each other
+  std::vector<uint8_t> expected, actual;
+  std::string raw("not a thrift message");
+  capture(expected, reply("get", 1, 1, "ok"));
+  capture(expected, reply("get", 2, 2, "ok"));
+  capture(expected, raw);
+  capture(expected, reply("get", 3, 3, "ok"));
+  replayed(actual, reply("get", 1, 1, "ok"));
+  replayed(actual, raw);
+  replayed(actual, reply("get", 3, 3, "ok"));
+
+  ReplayValidator validator;
+  validator.addExpected(expected.data(), expected.size(), ReplayValidator::CAPTURE);
+  validator.addActual(actual.data(), actual.size(), ReplayValidator::REPLAY);
+  BOOST_CHECK(!validator.validate());
+  const ReplayValidator::Summary& s = validator.summary();
+  BOOST_CHECK_EQUAL(s.matched, 3u);
+  BOOST_CHECK_EQUAL(s.identical, 3u);
+  BOOST_CHECK_EQUAL(s.missing, 1u);
+  BOOST_CHECK_EQUAL(s.unexpected, 0u);
+  BOOST_CHECK_EQUAL(s.unparsed, 2u);
+  BOOST_REQUIRE_EQUAL(validator.diffs().size(), 1u);
+  BOOST_CHECK_EQUAL(validator.diffs()[0].kind, ReplayValidator::MISSING);
+  BOOST_CHECK_EQUAL(validator.diffs()[0].seqid, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
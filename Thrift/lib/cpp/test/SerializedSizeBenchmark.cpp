@@ -0,0 +1,221 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Writing the list<Post> reply of PostStorageService::ReadPosts for 10 to
+ * 1000 posts, as a generated processor does, into a TFramedTransport:
+ *
+ *   grown     the frame buffer doubles as the writes come in
+ *   reserved  reserveWrite(serializedMessageSize()) first, which
+ *             processors generated with cpp:serialized_size do, so the
+ *             frame buffer is allocated once at its final size
+ *
+ * each with a new TFramedTransport per reply, as on a new connection or
+ * once a transport gives its buffer back, and the time serializedSize()
+ * takes on its own.
+ *
+ * Usage: SerializedSizeBenchmark [megabytes per case]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/protocol/TSerializedSize.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "gen-cpp/PostStorageService.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift_social_network;
+
+namespace {
+uint64_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+double nowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Posts shaped like the ones wrk2's compose-post.lua makes
+std::vector<Post> makePosts(size_t count) {
+  std::mt19937_64 rng(count);
+  std::uniform_int_distribution<int> users(0, 961);
+  std::uniform_int_distribution<int> textLength(32, 256);
+  std::uniform_int_distribution<int> few(0, 2);
+  std::vector<Post> posts(count);
+  for (size_t i = 0; i < count; ++i) {
+    Post& post = posts[i];
+    post.post_id = static_cast<int64_t>(rng() >> 1);
+    post.req_id = static_cast<int64_t>(rng() >> 1);
+    post.timestamp = 1700000000000 + static_cast<int64_t>(i);
+    post.post_type = PostType::POST;
+    post.creator.user_id = users(rng);
+    post.creator.username = "username_" + std::to_string(post.creator.user_id);
+    for (int m = few(rng); m > 0; --m) {
+      UserMention mention;
+      mention.user_id = users(rng);
+      mention.username = "username_" + std::to_string(mention.user_id);
+      post.text += "@" + mention.username + " ";
+      post.user_mentions.push_back(mention);
+    }
+    post.text += std::string(textLength(rng), 'a' + static_cast<char>(i % 26));
+    for (int u = few(rng); u > 0; --u) {
+      Url url;
+      url.expanded_url = "http://" + std::string(64, 'u');
+      url.shortened_url = "http://short-url/" + std::to_string(rng() % 100000000);
+      post.text += " " + url.shortened_url;
+      post.urls.push_back(url);
+    }
+    for (int m = few(rng); m > 0; --m) {
+      Media media;
+      media.media_id = static_cast<int64_t>(rng() >> 1);
+      media.media_type = "png";
+      post.media.push_back(media);
+    }
+  }
+  return posts;
+}
+
+struct Result {
+  double ns;
+  double allocations;
+};
+
+// Writes the reply iterations times into sink, through a new framed
+// transport each time
+template <class Protocol>
+Result run(const std::shared_ptr<TMemoryBuffer>& sink,
+           const PostStorageService_ReadPosts_result& result, int iterations, bool reserve) {
+  uint64_t allocated = 0;
+  double start = nowNs();
+  for (int i = 0; i < iterations; ++i) {
+    sink->resetBuffer();
+    uint64_t before = allocations;
+    std::shared_ptr<TFramedTransport> framed(new TFramedTransport(sink));
+    Protocol prot(framed);
+    if (reserve) {
+      framed->reserveWrite(serializedMessageSize(&prot, "ReadPosts", 1, result));
+    }
+    prot.writeMessageBegin("ReadPosts", T_REPLY, 1);
+    result.write(&prot);
+    prot.writeMessageEnd();
+    framed->writeEnd();
+    framed->flush();
+    allocated += allocations - before;
+  }
+  Result r = {(nowNs() - start) / iterations, static_cast<double>(allocated) / iterations};
+  return r;
+}
+
+template <class Protocol>
+void benchmark(const char* protocolName, size_t count, double megabytes) {
+  PostStorageService_ReadPosts_result result;
+  result.success = makePosts(count);
+  result.__isset.success = true;
+
+  // The sink is grown once here, so only the frame buffer allocates below
+  std::shared_ptr<TMemoryBuffer> sink(new TMemoryBuffer());
+  Protocol prot(sink);
+  uint32_t size = serializedMessageSize(&prot, "ReadPosts", 1, result);
+  uint32_t written = prot.writeMessageBegin("ReadPosts", T_REPLY, 1);
+  written += result.write(&prot);
+  written += prot.writeMessageEnd();
+  std::string reply = sink->getBufferAsString();
+  if (size != written || written != reply.size()) {
+    fprintf(stderr, "ReadPosts of %zu posts sized %u, wrote %u\n", count, size, written);
+    exit(1);
+  }
+
+  int iterations = static_cast<int>(megabytes * 1024 * 1024 / reply.size());
+  if (iterations < 20) {
+    iterations = 20;
+  }
+
+  Result grown = run<Protocol>(sink, result, iterations, false);
+  std::string grownFrame = sink->getBufferAsString();
+  Result reserved = run<Protocol>(sink, result, iterations, true);
+  std::string reservedFrame = sink->getBufferAsString();
+  if (grownFrame != reservedFrame || reservedFrame.size() != reply.size() + 4
+      || reservedFrame.compare(4, std::string::npos, reply) != 0) {
+    fprintf(stderr, "ReadPosts of %zu posts framed differently\n", count);
+    exit(1);
+  }
+
+  uint64_t total = 0;
+  double start = nowNs();
+  for (int i = 0; i < iterations; ++i) {
+    total += serializedMessageSize(&prot, "ReadPosts", 1, result);
+  }
+  double sizing = (nowNs() - start) / iterations;
+  if (total != static_cast<uint64_t>(size) * iterations) {
+    fprintf(stderr, "ReadPosts of %zu posts sized differently\n", count);
+    exit(1);
+  }
+
+  printf("%-8s %5zu %8zu  %9.0f %9.0f  %6.2fx  %8.0f  %6.0f %6.0f\n", protocolName, count,
+         reply.size(), grown.ns, reserved.ns, grown.ns / reserved.ns, sizing, grown.allocations,
+         reserved.allocations);
+}
+}
+
+int main(int argc, char** argv) {
+  double megabytes = argc > 1 ? atof(argv[1]) : 256;
+
+  printf("ns and heap allocations per framed ReadPosts reply of <posts> posts and <bytes> bytes\n");
+  printf("%-8s %5s %8s  %9s %9s  %7s  %8s  %6s %6s\n", "protocol", "posts", "bytes", "grown",
+         "reserved", "speedup", "sizing", "grown", "rsrvd");
+  for (size_t count = 10; count <= 1000; count *= 10) {
+    benchmark<TBinaryProtocol>("binary", count, megabytes);
+    benchmark<TCompactProtocol>("compact", count, megabytes);
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "sized/gen-cpp/DebugProtoTest_types.h"
+
+// This copy of DebugProtoTest_types leaves out DebugProtoTest_extras.cpp,
+// which goes with the one in libtestgencpp
+namespace thrift {
+namespace test {
+namespace debug {
+
+bool Empty::operator<(Empty const& other) const {
+  (void)other;
+  return false;
+}
+}
+}
+}
+
+BOOST_AUTO_TEST_SUITE(SerializedSizeTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace thrift::test::debug;
+
+namespace {
+
+// serializedSize() must be what write() writes
+template <class Protocol, class Struct_>
+void checkSize(const Struct_& s) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol prot(buffer);
+  uint32_t size = s.serializedSize(&prot);
+  BOOST_CHECK_EQUAL(s.write(&prot), size);
+  BOOST_CHECK_EQUAL(buffer->available_read(), size);
+}
+
+template <class Struct_>
+void checkSize(const Struct_& s) {
+  checkSize<TBinaryProtocol>(s);
+  checkSize<TCompactProtocol>(s);
+}
+
+OneOfEach oneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.integer32 = -70000;
+  ooe.double_precision = 3.14159;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string(300, '\x01');
+  ooe.i64_list.push_back(-1);
+  ooe.i64_list.push_back(0x7fffffffffffffffLL);
+  return ooe;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_primitives_and_containers) {
+  CompactProtoTestStruct s;
+  s.a_byte = -128;
+  s.a_i16 = -32768;
+  s.a_i32 = 1000000000;
+  s.a_i64 = 0xffffffffffLL;
+  s.a_string = "my string";
+  s.a_binary = std::string(200, '\0');
+  s.true_field = true;
+  for (int i = 0; i < 20; ++i) {
+    s.i32_list.push_back(i * -100000);
+    s.boolean_list.push_back(i % 3 == 0);
+    s.string_list.push_back(std::string(i * 10, 's'));
+    s.byte_list.push_back(static_cast<int8_t>(i));
+  }
+  s.i64_set.insert(-1);
+  s.i64_set.insert(0x7fffffffffffffffLL);
+  s.boolean_set.insert(true);
+  s.string_byte_map[""] = 0;
+  s.string_byte_map["second"] = 2;
+  s.boolean_byte_map[false] = 1;
+  s.byte_boolean_map[1] = true;
+  s.byte_map_map[0];
+  s.byte_map_map[2][1] = 1;
+  s.byte_list_map[1].push_back(1);
+  s.field500 = 500;
+  s.field20000 = -20000;
+  checkSize(s);
+
+  // Empty containers, and field ids far apart
+  checkSize(CompactProtoTestStruct());
+  checkSize(SingleMapTestStruct());
+  BigFieldIdStruct big;
+  big.field1 = "one";
+  big.field2 = "forty five";
+  checkSize(big);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested) {
+  RandomStuff stuff;
+  stuff.myintlist.push_back(-1);
+  stuff.maps[1];
+  stuff.maps[-300];
+  stuff.bigint = -0x7fffffffffffLL;
+  checkSize(stuff);
+
+  // The compact protocol has no uuid, which OneOfEach holds
+  HolyMoley hm;
+  hm.big.push_back(oneOfEach());
+  hm.big.push_back(OneOfEach());
+  std::vector<std::string> strings(3, "then a one, two");
+  hm.contain.insert(strings);
+  hm.contain.insert(std::vector<std::string>());
+  Bonk bonk;
+  bonk.type = 1;
+  bonk.message = "Wait.";
+  hm.bonks["nothing"];
+  hm.bonks["something"].push_back(bonk);
+  checkSize<TBinaryProtocol>(hm);
+
+  Nesting n;
+  n.my_ooe = oneOfEach();
+  n.my_bonk = bonk;
+  checkSize<TBinaryProtocol>(n);
+}
+
+BOOST_AUTO_TEST_CASE(test_union_and_exception) {
+  TestUnion u;
+  checkSize(u);
+  std::vector<RandomStuff> list(3);
+  u.__set_struct_list(list);
+  checkSize(u);
+  u.__set_struct_field(oneOfEach());
+  checkSize<TBinaryProtocol>(u);
+
+  ExceptionWithAMap x;
+  x.blah = "blah";
+  x.map_field["key"] = "value";
+  checkSize(x);
+}
+
+BOOST_AUTO_TEST_CASE(test_unsized_protocol) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol json(buffer);
+  BOOST_CHECK_EQUAL(oneOfEach().serializedSize(&json), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserved_frame) {
+  HolyMoley hm;
+  for (int i = 0; i < 50; ++i) {
+    hm.big.push_back(oneOfEach());
+  }
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+  TBinaryProtocol binary(framed);
+  framed->reserveWrite(hm.serializedSize(&binary));
+  uint32_t size = hm.write(&binary);
+  framed->flush();
+
+  // The frame's size, then the struct
+  BOOST_CHECK_EQUAL(buffer->available_read(), size + 4);
+  TBinaryProtocol reader(std::shared_ptr<TFramedTransport>(new TFramedTransport(buffer)));
+  HolyMoley read;
+  read.read(&reader);
+  BOOST_CHECK(read == hm);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
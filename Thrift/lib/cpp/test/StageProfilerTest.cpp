@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/StageProfiler.h>
+
+BOOST_AUTO_TEST_SUITE(StageProfilerTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::T_CALL;
+using apache::thrift::protocol::T_REPLY;
+using apache::thrift::transport::StageProfiler;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+std::string message(const std::string& method, int32_t seqid, bool reply) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeMessageBegin(method, reply ? T_REPLY : T_CALL, seqid);
+  protocol.writeStructBegin("args");
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  protocol.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+int64_t requestId(uint32_t flow, int32_t seqid) {
+  return static_cast<int64_t>((static_cast<uint64_t>(flow) << 32) | static_cast<uint32_t>(seqid));
+}
+
+// A PacketLogger record; extra is post_type or result for the app stages
+void record(FILE* f, uint64_t ts, int64_t reqId, size_t extra, const std::string& data) {
+  uint16_t size = static_cast<uint16_t>(data.size());
+  char zero[8] = {0};
+  fwrite(&ts, 8, 1, f);
+  fwrite(&reqId, 8, 1, f);
+  fwrite(zero, extra, 1, f);
+  fwrite(&size, 2, 1, f);
+  fwrite(data.data(), 1, data.size(), f);
+}
+
+struct TraceDir {
+  TraceDir() : path("/tmp/StageProfilerTest_" + std::to_string(getpid())) {
+    mkdir(path.c_str(), 0755);
+    const char* names[] = {"dpdk_to_rpc", "rpc_to_app", "app_to_rpc", "rpc_to_dpdk"};
+    for (int i = 0; i < 4; ++i) {
+      files[i] = fopen((path + "/" + names[i] + ".bin").c_str(), "wb");
+      BOOST_REQUIRE(files[i] != nullptr);
+    }
+  }
+
+  ~TraceDir() {
+    const char* names[] = {"dpdk_to_rpc", "rpc_to_app", "app_to_rpc", "rpc_to_dpdk"};
+    for (int i = 0; i < 4; ++i) {
+      unlink((path + "/" + names[i] + ".bin").c_str());
+    }
+    rmdir(path.c_str());
+  }
+
+  void close() {
+    for (int i = 0; i < 4; ++i) {
+      fclose(files[i]);
+    }
+  }
+
+  // A request at t taking decode, app and encode ns
+  void request(uint32_t flow, int32_t seqid, const std::string& method, uint64_t t,
+               uint64_t decode, uint64_t app, uint64_t encode) {
+    int64_t id = requestId(flow, seqid);
+    record(files[0], t, id, 0, message(method, seqid, false));
+    record(files[1], t + decode, id, 4, "args");
+    record(files[2], t + decode + app, id, 8, "result");
+    record(files[3], t + decode + app + encode, id, 0, message(method, seqid, true));
+  }
+
+  std::string path;
+  FILE* files[4];
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_breakdown_per_method) {
+  TraceDir dir;
+  // Overlapping requests on two flows reusing seqids
+  for (int i = 0; i < 100; ++i) {
+    uint64_t t = 1000000 + i * 10000;
+    dir.request(1, i, "ComposeUniqueId", t, 2000, 5000, 3000);
+    dir.request(2, i, "ReadPost", t + 100, 1000, 20000, 4000);
+  }
+  dir.close();
+
+  StageProfiler profiler;
+  std::ostringstream log;
+  profiler.setRequestLog(&log);
+  BOOST_REQUIRE(profiler.analyze(dir.path));
+
+  const StageProfiler::Stats& stats = profiler.stats();
+  BOOST_CHECK_EQUAL(stats.requests, 200u);
+  BOOST_CHECK_EQUAL(stats.incomplete, 0u);
+  BOOST_CHECK_EQUAL(stats.unmatched, 0u);
+  BOOST_CHECK_EQUAL(stats.unlabeled, 0u);
+
+  BOOST_REQUIRE_EQUAL(profiler.methods().size(), 2u);
+  const StageProfiler::Breakdown& compose = profiler.methods()[0];
+  const StageProfiler::Breakdown& read = profiler.methods()[1];
+  BOOST_CHECK_EQUAL(compose.method, "ComposeUniqueId");
+  BOOST_CHECK_EQUAL(read.method, "ReadPost");
+  BOOST_CHECK_EQUAL(compose.latency[StageProfiler::DECODE].percentile(50), 2000u);
+  BOOST_CHECK_EQUAL(compose.latency[StageProfiler::APP].percentile(50), 5000u);
+  BOOST_CHECK_EQUAL(compose.latency[StageProfiler::ENCODE].percentile(50), 3000u);
+  BOOST_CHECK_EQUAL(compose.latency[StageProfiler::TOTAL].percentile(50), 10000u);
+  BOOST_CHECK_EQUAL(read.latency[StageProfiler::APP].count(), 100u);
+  BOOST_CHECK_EQUAL(profiler.overall().latency[StageProfiler::TOTAL].count(), 200u);
+  BOOST_CHECK_EQUAL(profiler.overall().latency[StageProfiler::TOTAL].max(), 25000u);
+
+  std::string csv = log.str();
+  BOOST_CHECK(csv.find("1,0,ComposeUniqueId,1000000,2000,5000,3000,10000\n") != std::string::npos);
+  BOOST_CHECK(csv.find("2,99,ReadPost,1990100,1000,20000,4000,25000\n") != std::string::npos);
+
+  std::ostringstream out;
+  profiler.print(out);
+  BOOST_CHECK(out.str().find("200 requests") == 0);
+  BOOST_CHECK(out.str().find("ReadPost") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_and_unmatched) {
+  StageProfiler profiler;
+  std::string call = message("ComposeUniqueId", 7, false);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(call.data());
+  uint32_t size = static_cast<uint32_t>(call.size());
+
+  // Answered without the app stages: only the total
+  profiler.add(StageProfiler::DPDK_TO_RPC, 100, requestId(1, 7), data, size);
+  profiler.add(StageProfiler::RPC_TO_DPDK, 900, requestId(1, 7), data, size);
+  // Never answered
+  profiler.add(StageProfiler::DPDK_TO_RPC, 1000, requestId(1, 8), data, size);
+  // A reply to nothing and a framing read
+  profiler.add(StageProfiler::RPC_TO_DPDK, 1100, requestId(3, 1), data, size);
+  profiler.add(StageProfiler::DPDK_TO_RPC, 1200, 0, data, 4);
+  profiler.finish();
+
+  const StageProfiler::Stats& stats = profiler.stats();
+  BOOST_CHECK_EQUAL(stats.requests, 1u);
+  BOOST_CHECK_EQUAL(stats.incomplete, 2u);
+  BOOST_CHECK_EQUAL(stats.unmatched, 1u);
+  BOOST_CHECK_EQUAL(stats.unlabeled, 1u);
+  BOOST_CHECK_EQUAL(profiler.overall().latency[StageProfiler::TOTAL].percentile(50), 800u);
+  BOOST_CHECK_EQUAL(profiler.overall().latency[StageProfiler::DECODE].count(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_trace) {
+  StageProfiler profiler;
+  BOOST_CHECK(!profiler.analyze("/nonexistent/StageProfilerTest"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
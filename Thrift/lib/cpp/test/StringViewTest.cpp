@@ -0,0 +1,257 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE(StringViewTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TMultiplexedProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::TStringSink;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+std::vector<std::string> strings() {
+  std::vector<std::string> v;
+  v.push_back("hello");
+  v.push_back("");
+  v.push_back(std::string(3000, 'x'));
+  v.push_back(std::string("bin\0ary", 7));
+  for (int i = 0; i < 50; ++i) {
+    v.push_back("post text " + std::to_string(i) + std::string(i * 7, 'a' + i % 26));
+  }
+  return v;
+}
+
+// A list<binary>, then a string to check the next read starts in the right place
+void writeStrings(TProtocol& prot, const std::vector<std::string>& v) {
+  prot.writeListBegin(apache::thrift::protocol::T_STRING, static_cast<uint32_t>(v.size()));
+  for (size_t i = 0; i < v.size(); ++i) {
+    prot.writeBinary(v[i]);
+  }
+  prot.writeListEnd();
+  prot.writeString("end");
+}
+
+// Reads them all before looking at any, which must still be there.
+// Returns the bytes read.
+uint32_t checkViews(TProtocol& prot, const std::vector<std::string>& v,
+                    const uint8_t* lentFrom = nullptr, uint32_t lentSize = 0) {
+  std::vector<const char*> data(v.size());
+  std::vector<uint32_t> sizes(v.size());
+  apache::thrift::protocol::TType elemType;
+  uint32_t count;
+  uint32_t xfer = prot.readListBegin(elemType, count);
+  BOOST_REQUIRE_EQUAL(count, v.size());
+  for (size_t i = 0; i < v.size(); ++i) {
+    xfer += prot.readBinaryView(data[i], sizes[i]);
+  }
+  xfer += prot.readListEnd();
+  std::string trailer;
+  xfer += prot.readString(trailer);
+  BOOST_CHECK_EQUAL(trailer, "end");
+  for (size_t i = 0; i < v.size(); ++i) {
+    BOOST_CHECK_EQUAL(std::string(data[i], sizes[i]), v[i]);
+    if (lentFrom != nullptr && sizes[i] > 0) {
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(data[i]);
+      BOOST_CHECK(p >= lentFrom && p + sizes[i] <= lentFrom + lentSize);
+    }
+  }
+  return xfer;
+}
+
+class VectorSink : public TStringSink {
+public:
+  char* buffer(uint32_t size) override {
+    bytes.assign(size + 1, '\0');
+    return &bytes[0];
+  }
+
+  std::string str() const { return std::string(bytes.data(), bytes.size() - 1); }
+
+  std::vector<char> bytes;
+};
+
+// readStringInto() for each, as the cpp:arena std::pmr::strings are read
+void checkSink(TProtocol& prot, const std::vector<std::string>& v) {
+  apache::thrift::protocol::TType elemType;
+  uint32_t count;
+  prot.readListBegin(elemType, count);
+  BOOST_REQUIRE_EQUAL(count, v.size());
+  for (size_t i = 0; i < v.size(); ++i) {
+    VectorSink sink;
+    prot.readBinaryInto(sink);
+    BOOST_CHECK_EQUAL(sink.str(), v[i]);
+  }
+  prot.readListEnd();
+  VectorSink trailer;
+  prot.readStringInto(trailer);
+  BOOST_CHECK_EQUAL(trailer.str(), "end");
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_lent_from_memory_buffer) {
+  std::vector<std::string> v = strings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  uint8_t* buf;
+  uint32_t size;
+
+  TBinaryProtocol binary(buffer);
+  writeStrings(binary, v);
+  buffer->getBuffer(&buf, &size);
+  BOOST_CHECK_EQUAL(checkViews(binary, v, buf, size), size);
+
+  buffer->resetBuffer();
+  TCompactProtocol compact(buffer);
+  writeStrings(compact, v);
+  buffer->getBuffer(&buf, &size);
+  BOOST_CHECK_EQUAL(checkViews(compact, v, buf, size), size);
+}
+
+BOOST_AUTO_TEST_CASE(test_lent_from_frame) {
+  std::vector<std::string> v = strings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+  TBinaryProtocol binary(framed);
+  writeStrings(binary, v);
+  framed->flush();
+
+  // The frame is read into the transport's buffer before the first string
+  checkViews(binary, v);
+}
+
+BOOST_AUTO_TEST_CASE(test_copied_from_stream) {
+  // A buffered transport refills its buffer under the views, so they are copies
+  std::vector<std::string> v = strings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(buffer, 512));
+  TBinaryProtocol binary(buffered);
+  writeStrings(binary, v);
+  buffered->flush();
+  checkViews(binary, v);
+
+  buffer->resetBuffer();
+  TCompactProtocol compact(buffered);
+  writeStrings(compact, v);
+  buffered->flush();
+  checkViews(compact, v);
+  compact.releaseViews();
+}
+
+BOOST_AUTO_TEST_CASE(test_copied_by_default_protocols) {
+  // Protocols that escape strings copy through readBinary()
+  std::vector<std::string> v = strings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol json(buffer);
+  writeStrings(json, v);
+  checkViews(json, v);
+
+  // Decorators pass the call through
+  buffer->resetBuffer();
+  std::shared_ptr<TBinaryProtocol> binary(new TBinaryProtocol(buffer));
+  TMultiplexedProtocol multiplexed(binary, "PostStorageService");
+  writeStrings(multiplexed, v);
+  uint8_t* buf;
+  uint32_t size;
+  buffer->getBuffer(&buf, &size);
+  checkViews(multiplexed, v, buf, size);
+}
+
+BOOST_AUTO_TEST_CASE(test_read_into_sink) {
+  std::vector<std::string> v = strings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(buffer, 512));
+  TBinaryProtocol binary(buffered);
+  writeStrings(binary, v);
+  buffered->flush();
+  checkSink(binary, v);
+
+  buffer->resetBuffer();
+  TCompactProtocol compact(buffered);
+  writeStrings(compact, v);
+  buffered->flush();
+  checkSink(compact, v);
+
+  buffer->resetBuffer();
+  TJSONProtocol json(buffer);
+  writeStrings(json, v);
+  checkSink(json, v);
+}
+
+BOOST_AUTO_TEST_CASE(test_string_and_binary_apart) {
+  // JSON escapes a string and base64-encodes a binary
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol json(buffer);
+  std::string text("a \"quoted\" \\ string\n");
+  std::string binary("\x00\x01\xff", 3);
+  json.writeString(text);
+  json.writeBinary(binary);
+  const char* data;
+  uint32_t size;
+  json.readStringView(data, size);
+  BOOST_CHECK_EQUAL(std::string(data, size), text);
+  json.readBinaryView(data, size);
+  BOOST_CHECK_EQUAL(std::string(data, size), binary);
+
+  buffer->resetBuffer();
+  json.writeStringView(text.data(), static_cast<uint32_t>(text.size()));
+  json.writeBinaryView(binary.data(), static_cast<uint32_t>(binary.size()));
+  std::string str;
+  json.readString(str);
+  BOOST_CHECK_EQUAL(str, text);
+  json.readBinary(str);
+  BOOST_CHECK_EQUAL(str, binary);
+}
+
+BOOST_AUTO_TEST_CASE(test_string_limit) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol binary(buffer);
+  binary.setStringSizeLimit(100);
+  binary.writeString(std::string(101, 'x'));
+  const char* data;
+  uint32_t size;
+  BOOST_CHECK_THROW(binary.readStringView(data, size), TProtocolException);
+  binary.writeString(std::string(101, 'x'));
+  VectorSink sink;
+  BOOST_CHECK_THROW(binary.readStringInto(sink), TProtocolException);
+
+  buffer->resetBuffer();
+  TCompactProtocol compact(buffer, 100, 0);
+  compact.writeString(std::string(101, 'x'));
+  BOOST_CHECK_THROW(compact.readStringView(data, size), TProtocolException);
+  compact.writeString(std::string(101, 'x'));
+  BOOST_CHECK_THROW(compact.readStringInto(sink), TProtocolException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,100 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include "thrift/TArena.h"
+
+BOOST_AUTO_TEST_SUITE(TArenaTest)
+
+using apache::thrift::TArena;
+
+namespace {
+
+// Hands out blocks from the heap, counting the bytes it holds
+class CountingResource : public std::pmr::memory_resource {
+public:
+  CountingResource() : held(0) {}
+
+  size_t held;
+
+protected:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    held += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    held -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_over_aligned_allocations) {
+  CountingResource upstream;
+  TArena arena(1024, &upstream);
+  for (size_t alignment = 1; alignment <= 4096; alignment *= 2) {
+    BOOST_CHECK(arena.allocate(1, 1));
+    void* p = arena.allocate(8, alignment);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(p) % alignment, 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_trim_keeps_max_retained) {
+  CountingResource upstream;
+  {
+    TArena arena(1024, &upstream, 4096);
+    BOOST_CHECK(arena.allocate(100, 8));
+    BOOST_CHECK(arena.allocate(64 * 1024, 8));
+    BOOST_CHECK_GT(upstream.held, 64u * 1024);
+
+    arena.reset();
+    arena.trim();
+    BOOST_CHECK_EQUAL(upstream.held, 1024u);
+    BOOST_CHECK_EQUAL(arena.capacity(), 1024u);
+
+    // The kept block is still used
+    BOOST_CHECK(arena.allocate(100, 8));
+    BOOST_CHECK_EQUAL(upstream.held, 1024u);
+  }
+  BOOST_CHECK_EQUAL(upstream.held, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_outermost_scope_trims) {
+  TArena& arena = TArena::current();
+  {
+    TArena::Scope outer;
+    {
+      TArena::Scope inner;
+      BOOST_CHECK(inner.get()->allocate(8 * 1024 * 1024, 8));
+    }
+    BOOST_CHECK_GE(arena.capacity(), 8u * 1024 * 1024);
+  }
+  BOOST_CHECK_EQUAL(arena.allocated(), 0u);
+  BOOST_CHECK_LE(arena.capacity(), 1024u * 1024);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -383,6 +383,21 @@ BOOST_AUTO_TEST_CASE(test_maximum_buffer_size)
   BOOST_CHECK_THROW(buf.write(&small_buff[0], 1), TTransportException);
 }
 
+BOOST_AUTO_TEST_CASE(test_reserve_write_is_a_hint)
+{
+  TMemoryBuffer buf;
+  buf.setMaxBufferSize(8192);
+  std::vector<uint8_t> small_buff(1);
+
+  // Past the maximum it is ignored; the write is what fails
+  BOOST_CHECK_NO_THROW(buf.reserveWrite(8193));
+  BOOST_CHECK_NO_THROW(buf.reserveWrite(std::numeric_limits<uint32_t>::max()));
+  buf.reserveWrite(4096);
+  BOOST_CHECK_GE(buf.getBufferSize(), 4096u);
+  buf.write(&small_buff[0], 1);
+  BOOST_CHECK_NO_THROW(buf.reserveWrite(8192));
+}
+
 BOOST_AUTO_TEST_CASE(test_buffer_overflow)
 {
   TMemoryBuffer buf;
@@ -0,0 +1,209 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <thrift/TProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TReplayServer.h>
+#include <thrift/transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE(TReplayServerTest)
+
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TType;
+using apache::thrift::server::TReplayServer;
+using apache::thrift::transport::ReplayValidator;
+using apache::thrift::transport::TMemoryBuffer;
+
+namespace {
+
+const int FLOWS = 4;
+const int CALLS = 4000;
+
+std::string tempPath(const char* name) {
+  return "/tmp/TReplayServerTest_" + std::to_string(getpid()) + "_" + name;
+}
+
+// Doubles field 1 of a call: Double(1: i64 x) returns x * 2
+class DoubleProcessor : public TProcessor {
+public:
+  bool process(std::shared_ptr<TProtocol> in, std::shared_ptr<TProtocol> out, void*) override {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    std::string ignored;
+    in->readStructBegin(ignored);
+    int64_t x = 0;
+    for (;;) {
+      TType fieldType;
+      int16_t id;
+      in->readFieldBegin(ignored, fieldType, id);
+      if (fieldType == apache::thrift::protocol::T_STOP) {
+        break;
+      }
+      if (id == 1 && fieldType == apache::thrift::protocol::T_I64) {
+        in->readI64(x);
+      } else {
+        in->skip(fieldType);
+      }
+      in->readFieldEnd();
+    }
+    in->readStructEnd();
+    in->readMessageEnd();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      threads_.insert(std::this_thread::get_id());
+    }
+    writeReply(*out, seqid, x * 2);
+    return true;
+  }
+
+  static void writeReply(TProtocol& out, int32_t seqid, int64_t result) {
+    out.writeMessageBegin("Double", apache::thrift::protocol::T_REPLY, seqid);
+    out.writeStructBegin("result");
+    out.writeFieldBegin("success", apache::thrift::protocol::T_I64, 0);
+    out.writeI64(result);
+    out.writeFieldEnd();
+    out.writeFieldStop();
+    out.writeStructEnd();
+    out.writeMessageEnd();
+  }
+
+  size_t threads() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_.size();
+  }
+
+private:
+  std::mutex mutex_;
+  std::set<std::thread::id> threads_;
+};
+
+void writeRecord(FILE* f, uint64_t ts, int64_t reqId, const std::string& data) {
+  uint16_t size = static_cast<uint16_t>(data.size());
+  fwrite(&ts, sizeof(ts), 1, f);
+  fwrite(&reqId, sizeof(reqId), 1, f);
+  fwrite(&size, sizeof(size), 1, f);
+  fwrite(data.data(), 1, data.size(), f);
+}
+
+// CALLS calls interleaved over FLOWS connections, as PacketLogger captures
+// them, and the replies they got
+void writeTraces(const std::string& calls, const std::string& replies) {
+  FILE* in = fopen(calls.c_str(), "wb");
+  FILE* out = fopen(replies.c_str(), "wb");
+  BOOST_REQUIRE(in != nullptr && out != nullptr);
+  for (int i = 0; i < CALLS; i++) {
+    int64_t reqId = (static_cast<int64_t>(1 + i % FLOWS) << 32) | i;
+    std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TBinaryProtocol protocol(buffer);
+    protocol.writeMessageBegin("Double", apache::thrift::protocol::T_CALL, i);
+    protocol.writeStructBegin("args");
+    protocol.writeFieldBegin("x", apache::thrift::protocol::T_I64, 1);
+    protocol.writeI64(1000 + i);
+    protocol.writeFieldEnd();
+    protocol.writeFieldStop();
+    protocol.writeStructEnd();
+    protocol.writeMessageEnd();
+    writeRecord(in, 2 * i, reqId, buffer->getBufferAsString());
+
+    buffer->resetBuffer();
+    DoubleProcessor::writeReply(protocol, i, 2 * (1000 + i));
+    writeRecord(out, 2 * i + 1, reqId, buffer->getBufferAsString());
+  }
+  fclose(in);
+  fclose(out);
+}
+
+void removeAll(const std::string& trace, int shards) {
+  unlink(trace.c_str());
+  unlink((trace + ".idx").c_str());
+  for (int i = 0; i < shards; i++) {
+    unlink((trace + ".resp.shard" + std::to_string(i) + ".0").c_str());
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_replay_by_flow) {
+  std::string trace = tempPath("calls.bin");
+  std::string expected = tempPath("replies.bin");
+  writeTraces(trace, expected);
+
+  std::shared_ptr<DoubleProcessor> processor(new DoubleProcessor);
+  TReplayServer server(processor, std::make_shared<TBinaryProtocolFactory>(), trace, FLOWS);
+  server.serve();
+
+  BOOST_CHECK_EQUAL(server.getRequestCount(), static_cast<uint64_t>(CALLS));
+  BOOST_CHECK_EQUAL(processor->threads(), static_cast<size_t>(FLOWS));
+  // One flow per worker
+  for (size_t i = 0; i < server.getWorkerStats().size(); i++) {
+    BOOST_CHECK_EQUAL(server.getWorkerStats()[i].requests, static_cast<uint64_t>(CALLS / FLOWS));
+    BOOST_CHECK_EQUAL(server.getWorkerStats()[i].failed, 0u);
+  }
+  BOOST_CHECK(server.getElapsedNs() > 0);
+
+  // Merged from every worker, in whatever order they finished
+  ReplayValidator validator;
+  BOOST_CHECK(server.validate(expected, validator));
+  BOOST_CHECK_EQUAL(validator.summary().identical, static_cast<uint64_t>(CALLS));
+
+  unlink(expected.c_str());
+  removeAll(trace, FLOWS);
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_round_robin) {
+  std::string trace = tempPath("rr.bin");
+  std::string expected = tempPath("rr_replies.bin");
+  writeTraces(trace, expected);
+
+  // More workers than flows, and fewer requests than the trace has
+  std::shared_ptr<DoubleProcessor> processor(new DoubleProcessor);
+  TReplayServer server(processor, std::make_shared<TBinaryProtocolFactory>(), trace, 6,
+                       PacketReplaySocket::SHARD_ROUND_ROBIN, 600);
+  server.serve();
+  BOOST_CHECK_EQUAL(server.getRequestCount(), 600u);
+  for (size_t i = 0; i < server.getWorkerStats().size(); i++) {
+    BOOST_CHECK_EQUAL(server.getWorkerStats()[i].requests, 100u);
+  }
+
+  // The calls left out are missing, the rest match
+  ReplayValidator validator(0);
+  BOOST_CHECK(!server.validate(expected, validator));
+  BOOST_CHECK_EQUAL(validator.summary().identical, 600u);
+  BOOST_CHECK_EQUAL(validator.summary().missing, static_cast<uint64_t>(CALLS - 600));
+
+  unlink(expected.c_str());
+  removeAll(trace, 6);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
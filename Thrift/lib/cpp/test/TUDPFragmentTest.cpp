@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <thrift/transport/TServerUDPSocket.h>
+#include <thrift/transport/TUDPFragment.h>
+#include <thrift/transport/TUDPSocket.h>
+
+BOOST_AUTO_TEST_SUITE(TUDPFragmentTest)
+
+using apache::thrift::transport::TServerUDPSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TUDPFragment;
+using apache::thrift::transport::TUDPFragmenter;
+using apache::thrift::transport::TUDPReassembler;
+using apache::thrift::transport::TUDPSocket;
+
+namespace {
+
+std::vector<uint8_t> makeMessage(size_t len) {
+  std::vector<uint8_t> message(len);
+  for (size_t i = 0; i < len; ++i) {
+    message[i] = static_cast<uint8_t>(i * 7);
+  }
+  return message;
+}
+
+std::vector<std::vector<uint8_t> > fragment(TUDPFragmenter& fragmenter,
+                                            const std::vector<uint8_t>& message) {
+  std::vector<std::vector<uint8_t> > datagrams;
+  fragmenter.split(message.data(), static_cast<uint32_t>(message.size()),
+                   [&](const uint8_t* header, const uint8_t* payload, uint32_t len) {
+                     std::vector<uint8_t> datagram(header, header + TUDPFragment::HEADER_SIZE);
+                     datagram.insert(datagram.end(), payload, payload + len);
+                     datagrams.push_back(datagram);
+                   });
+  return datagrams;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_header_round_trip) {
+  TUDPFragment::Header in;
+  in.messageId = 0xDEADBEEF;
+  in.index = 3;
+  in.count = 9;
+  uint8_t wire[TUDPFragment::HEADER_SIZE];
+  TUDPFragment::writeHeader(wire, in);
+
+  TUDPFragment::Header out;
+  BOOST_CHECK(TUDPFragment::isFragment(wire, sizeof(wire)));
+  BOOST_CHECK(TUDPFragment::readHeader(wire, sizeof(wire), out));
+  BOOST_CHECK_EQUAL(out.messageId, in.messageId);
+  BOOST_CHECK_EQUAL(out.index, in.index);
+  BOOST_CHECK_EQUAL(out.count, in.count);
+
+  // Strict binary and compact messages are never mistaken for fragments
+  const uint8_t binary[TUDPFragment::HEADER_SIZE] = {0x80, 0x01, 0x00, 0x01};
+  const uint8_t compact[TUDPFragment::HEADER_SIZE] = {0x82, 0x21};
+  BOOST_CHECK(!TUDPFragment::isFragment(binary, sizeof(binary)));
+  BOOST_CHECK(!TUDPFragment::isFragment(compact, sizeof(compact)));
+}
+
+BOOST_AUTO_TEST_CASE(test_reassemble_out_of_order) {
+  TUDPFragmenter fragmenter(100);
+  std::vector<uint8_t> message = makeMessage(1000);
+  std::vector<std::vector<uint8_t> > datagrams = fragment(fragmenter, message);
+  BOOST_CHECK_EQUAL(datagrams.size(), 12u); // 88 payload bytes per fragment
+
+  TUDPReassembler reassembler;
+  std::vector<uint8_t> out;
+  for (size_t i = datagrams.size(); i-- > 1;) {
+    BOOST_CHECK(!reassembler.add(datagrams[i].data(), static_cast<uint32_t>(datagrams[i].size()),
+                                 nullptr, 0, out));
+  }
+  // A duplicate does not count twice
+  BOOST_CHECK(!reassembler.add(datagrams[5].data(), static_cast<uint32_t>(datagrams[5].size()),
+                               nullptr, 0, out));
+  BOOST_CHECK(reassembler.add(datagrams[0].data(), static_cast<uint32_t>(datagrams[0].size()),
+                              nullptr, 0, out));
+  BOOST_CHECK(out == message);
+  BOOST_CHECK_EQUAL(reassembler.pending(), 0u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().completed, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_table_is_bounded) {
+  TUDPFragmenter fragmenter(100);
+  TUDPReassembler reassembler(2, 50);
+  std::vector<uint8_t> out;
+
+  // Three incomplete messages in a table of two: the oldest is evicted
+  for (int m = 0; m < 3; ++m) {
+    std::vector<std::vector<uint8_t> > datagrams = fragment(fragmenter, makeMessage(300));
+    BOOST_CHECK(!reassembler.add(datagrams[0].data(), static_cast<uint32_t>(datagrams[0].size()),
+                                 nullptr, 0, out));
+  }
+  BOOST_CHECK_EQUAL(reassembler.pending(), 2u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().evicted, 1u);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  reassembler.expire();
+  BOOST_CHECK_EQUAL(reassembler.pending(), 0u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().expired, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(test_message_size_is_bounded) {
+  TUDPReassembler reassembler(4, 1000, 4096);
+  std::vector<uint8_t> out;
+
+  // A message that fits the byte limit goes through
+  TUDPFragmenter fragmenter(1024);
+  std::vector<std::vector<uint8_t> > datagrams = fragment(fragmenter, makeMessage(4000));
+  for (size_t i = 0; i + 1 < datagrams.size(); ++i) {
+    BOOST_CHECK(!reassembler.add(datagrams[i].data(), static_cast<uint32_t>(datagrams[i].size()),
+                                 nullptr, 0, out));
+  }
+  BOOST_CHECK(reassembler.add(datagrams.back().data(),
+                              static_cast<uint32_t>(datagrams.back().size()), nullptr, 0, out));
+
+  // A first fragment whose header declares more than the limit is not kept
+  TUDPFragment::Header header;
+  header.messageId = 1;
+  header.index = 0;
+  header.count = TUDPFragment::MAX_FRAGMENTS;
+  std::vector<uint8_t> datagram(TUDPFragment::HEADER_SIZE + 1000);
+  TUDPFragment::writeHeader(datagram.data(), header);
+  BOOST_CHECK(!reassembler.add(datagram.data(), static_cast<uint32_t>(datagram.size()), nullptr,
+                               0, out));
+  BOOST_CHECK_EQUAL(reassembler.pending(), 0u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().oversized, 1u);
+
+  // The last fragment carries no size promise; a lone partial message is
+  // dropped once what it buffered passes the limit
+  header.messageId = 2;
+  header.index = 1;
+  header.count = 2;
+  datagram.assign(TUDPFragment::HEADER_SIZE + 5000, 0);
+  TUDPFragment::writeHeader(datagram.data(), header);
+  BOOST_CHECK(!reassembler.add(datagram.data(), static_cast<uint32_t>(datagram.size()), nullptr,
+                               0, out));
+  BOOST_CHECK_EQUAL(reassembler.pending(), 0u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().evicted, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_small_fragments_are_bounded) {
+  TUDPReassembler reassembler(1000, 1000, 4096);
+  std::vector<uint8_t> out;
+  TUDPFragment::Header header;
+  std::vector<uint8_t> datagram(TUDPFragment::HEADER_SIZE + 1);
+
+  // A last fragment of one byte still says the message is at least as
+  // large as its count of smallest datagrams
+  header.messageId = 1;
+  header.index = TUDPFragment::MAX_FRAGMENTS - 1;
+  header.count = TUDPFragment::MAX_FRAGMENTS;
+  TUDPFragment::writeHeader(datagram.data(), header);
+  BOOST_CHECK(!reassembler.add(datagram.data(), static_cast<uint32_t>(datagram.size()), nullptr,
+                               0, out));
+  BOOST_CHECK_EQUAL(reassembler.pending(), 0u);
+  BOOST_CHECK_EQUAL(reassembler.getStats().oversized, 1u);
+
+  // Many one byte fragments of different messages: what each costs to hold
+  // counts against the limit, not just its byte of payload
+  for (uint32_t id = 2; id < 1000; ++id) {
+    header.messageId = id;
+    header.index = 1;
+    header.count = 2;
+    TUDPFragment::writeHeader(datagram.data(), header);
+    BOOST_CHECK(!reassembler.add(datagram.data(), static_cast<uint32_t>(datagram.size()), nullptr,
+                                 0, out));
+  }
+  BOOST_CHECK(reassembler.pending() < 4096u / 64u);
+  BOOST_CHECK(reassembler.getStats().evicted > 900u);
+}
+
+BOOST_AUTO_TEST_CASE(test_socket_large_messages) {
+  const int port = 19191;
+  TServerUDPSocket server(port);
+  server.listen();
+
+  TUDPSocket client("127.0.0.1", port);
+  client.setRecvTimeout(1000);
+  client.open();
+
+  // Larger than one datagram, delivered to the caller in small reads
+  std::vector<uint8_t> request = makeMessage(20000);
+  client.write(request.data(), static_cast<uint32_t>(request.size()));
+  client.flush();
+
+  std::shared_ptr<TTransport> accepted = server.accept();
+  std::vector<uint8_t> received(request.size());
+  uint32_t have = 0;
+  while (have < received.size()) {
+    uint32_t got = accepted->read(received.data() + have, 512);
+    BOOST_REQUIRE(got > 0);
+    have += got;
+  }
+  BOOST_CHECK(received == request);
+
+  std::vector<uint8_t> reply = makeMessage(5000);
+  accepted->write(reply.data(), static_cast<uint32_t>(reply.size()));
+  accepted->flush();
+
+  std::vector<uint8_t> replied(reply.size());
+  uint32_t got = client.read(replied.data(), static_cast<uint32_t>(replied.size()));
+  BOOST_CHECK_EQUAL(got, reply.size());
+  BOOST_CHECK(replied == reply);
+
+  client.close();
+  server.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,336 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Loopback benchmark for the UDP server paths.
+ *
+ *   legacy   TServerUDPSocket::accept() + TUDPSocket, one recvfrom/sendto per request
+ *   batch    TDatagramServer with recvmmsg/sendmmsg batches of <batch> datagrams
+ *   shards   TShardedDatagramServer, one SO_REUSEPORT socket and pinned thread
+ *            per shard, for 1 to <shards> shards
+ *
+ * Usage: UDPBenchmark [seconds] [clients] [window] [batch] [shards]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "thrift/TProcessor.h"
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/server/TDatagramServer.h"
+#include "thrift/server/TShardedDatagramServer.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "thrift/transport/TServerUDPSocket.h"
+#include "thrift/transport/TTransportException.h"
+#include "thrift/transport/TUDPSocket.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+
+namespace {
+
+const int kPort = 19090;
+
+/**
+ * Answers every call with its own seqid, roughly the shape of
+ * UniqueIdService::ComposeUniqueId.
+ */
+class EchoProcessor : public TProcessor {
+public:
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol> out,
+               void* connectionContext) override {
+    (void)connectionContext;
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    out->writeMessageBegin(name, T_REPLY, seqid);
+    out->writeStructBegin("result");
+    out->writeFieldBegin("success", T_I64, 0);
+    out->writeI64(seqid);
+    out->writeFieldEnd();
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+};
+
+/**
+ * Counts socket calls made by the legacy per-request path.
+ */
+std::atomic<uint64_t> legacyWaitCalls(0);
+std::atomic<uint64_t> legacyRecvCalls(0);
+std::atomic<uint64_t> legacySendCalls(0);
+
+class CountingUDPSocket : public TUDPSocket {
+public:
+  CountingUDPSocket(THRIFT_SOCKET socket) : TUDPSocket(socket) {}
+
+  bool peek() override {
+    legacyWaitCalls++;
+    return TUDPSocket::peek();
+  }
+
+  uint32_t read(uint8_t* buf, uint32_t len) override {
+    legacyRecvCalls++;
+    return TUDPSocket::read(buf, len);
+  }
+
+  uint32_t write_partial(const uint8_t* buf, uint32_t len) override {
+    legacySendCalls++;
+    return TUDPSocket::write_partial(buf, len);
+  }
+};
+
+class CountingServerUDPSocket : public TServerUDPSocket {
+public:
+  CountingServerUDPSocket(int port) : TServerUDPSocket(port) {}
+
+protected:
+  std::shared_ptr<TUDPSocket> createSocket(THRIFT_SOCKET client) override {
+    legacyWaitCalls++; // the poll() in acceptImpl()
+    return std::make_shared<CountingUDPSocket>(client);
+  }
+};
+
+std::string makeRequest(int32_t seqid) {
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  prot.writeMessageBegin("ComposeUniqueId", T_CALL, seqid);
+  prot.writeStructBegin("args");
+  prot.writeFieldBegin("req_id", T_I64, 1);
+  prot.writeI64(seqid);
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("post_type", T_I32, 2);
+  prot.writeI32(0);
+  prot.writeFieldEnd();
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+  prot.writeMessageEnd();
+  return buf->getBufferAsString();
+}
+
+/**
+ * Keeps <window> requests in flight on its own socket until told to stop.
+ */
+void runClient(int window, std::atomic<bool>& done, std::atomic<uint64_t>& completed) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    std::cerr << "client socket setup failed" << '\n';
+    return;
+  }
+  struct timeval tv = {0, 200 * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  // The load generator batches too, so the server is what gets measured
+  const std::string request = makeRequest(1);
+  std::vector<uint8_t> replies(static_cast<size_t>(window) * 512);
+  std::vector<struct iovec> txIov(window);
+  std::vector<struct iovec> rxIov(window);
+  std::vector<struct mmsghdr> txMsgs(window);
+  std::vector<struct mmsghdr> rxMsgs(window);
+  std::memset(txMsgs.data(), 0, sizeof(struct mmsghdr) * window);
+  std::memset(rxMsgs.data(), 0, sizeof(struct mmsghdr) * window);
+  for (int i = 0; i < window; ++i) {
+    txIov[i].iov_base = const_cast<char*>(request.data());
+    txIov[i].iov_len = request.size();
+    txMsgs[i].msg_hdr.msg_iov = &txIov[i];
+    txMsgs[i].msg_hdr.msg_iovlen = 1;
+    rxIov[i].iov_base = &replies[static_cast<size_t>(i) * 512];
+    rxIov[i].iov_len = 512;
+    rxMsgs[i].msg_hdr.msg_iov = &rxIov[i];
+    rxMsgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  while (!done) {
+    if (sendmmsg(fd, txMsgs.data(), window, 0) < 0) {
+      continue;
+    }
+    int outstanding = window;
+    while (outstanding > 0) {
+      int got = recvmmsg(fd, rxMsgs.data(), outstanding, MSG_WAITFORONE, nullptr);
+      if (got <= 0) {
+        break; // lost datagrams are simply not counted
+      }
+      completed += got;
+      outstanding -= got;
+    }
+  }
+  ::close(fd);
+}
+
+uint64_t runLoad(int seconds, int clients, int window) {
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> completed(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < clients; ++i) {
+    threads.emplace_back(runClient, window, std::ref(done), std::ref(completed));
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  done = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  return completed.load();
+}
+
+void report(const std::string& mode,
+            int seconds,
+            uint64_t completed,
+            uint64_t requests,
+            uint64_t waitCalls,
+            uint64_t recvCalls,
+            uint64_t sendCalls) {
+  uint64_t calls = waitCalls + recvCalls + sendCalls;
+  double perReq = requests ? static_cast<double>(calls) / requests : 0.0;
+  std::cout << mode << ": " << completed / seconds << " req/s, " << waitCalls << " poll, "
+            << recvCalls << " recv, " << sendCalls << " send, " << perReq << " syscalls/req"
+            << '\n';
+}
+
+void benchLegacy(int seconds, int clients, int window) {
+  legacyWaitCalls = 0;
+  legacyRecvCalls = 0;
+  legacySendCalls = 0;
+  std::shared_ptr<CountingServerUDPSocket> server(new CountingServerUDPSocket(kPort));
+  server->setRecvTimeout(100);
+  server->listen();
+
+  // Same loop as TServerFramework + TConnectedClient: accept, then process
+  // while peek() reports pending data
+  std::atomic<uint64_t> requests(0);
+  std::thread serverThread([&]() {
+    EchoProcessor processor;
+    for (;;) {
+      std::shared_ptr<TTransport> client;
+      try {
+        client = server->accept();
+      } catch (TTransportException&) {
+        break;
+      }
+      std::shared_ptr<TTransport> buffered(new TBufferedTransport(client));
+      std::shared_ptr<TProtocol> prot(new TBinaryProtocol(buffered));
+      try {
+        while (buffered->peek()) {
+          processor.process(prot, prot, nullptr);
+          requests++;
+        }
+      } catch (TTransportException&) {
+        // recv timeout: the load is gone, go back to accept()
+      }
+    }
+  });
+
+  uint64_t completed = runLoad(seconds, clients, window);
+  server->interrupt();
+  serverThread.join();
+  server->close();
+  report("legacy", seconds, completed, requests, legacyWaitCalls, legacyRecvCalls,
+         legacySendCalls);
+}
+
+void benchBatch(int seconds, int clients, int window, uint32_t batchSize) {
+  std::shared_ptr<TServerUDPSocket> socket(new TServerUDPSocket(kPort, batchSize));
+  std::shared_ptr<TProcessor> processor(new EchoProcessor());
+  std::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  TDatagramServer server(processor, socket, protocolFactory);
+
+  std::thread serverThread([&]() { server.serve(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  uint64_t completed = runLoad(seconds, clients, window);
+  server.stop();
+  serverThread.join();
+
+  TUDPDatagramBatch::Stats stats = server.getStats();
+  report("batch=" + std::to_string(batchSize), seconds, completed, server.getRequestCount(),
+         stats.waitCalls, stats.recvCalls, stats.sendCalls);
+}
+
+void benchSharded(int seconds, int clients, int window, uint32_t batchSize, size_t shards) {
+  std::shared_ptr<TProcessor> processor(new EchoProcessor());
+  std::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  TShardedDatagramServer server(processor, "127.0.0.1", kPort, protocolFactory, shards, batchSize);
+
+  std::thread serverThread([&]() { server.serve(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  uint64_t completed = runLoad(seconds, clients, window);
+  server.stop();
+  serverThread.join();
+
+  TUDPDatagramBatch::Stats stats = server.getStats();
+  report("shards=" + std::to_string(shards), seconds, completed, server.getRequestCount(),
+         stats.waitCalls, stats.recvCalls, stats.sendCalls);
+}
+}
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? std::atoi(argv[1]) : 2;
+  int clients = argc > 2 ? std::atoi(argv[2]) : 4;
+  int window = argc > 3 ? std::atoi(argv[3]) : 16;
+  uint32_t batchSize = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 32;
+  int maxShards = argc > 5 ? std::atoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency());
+  if (seconds <= 0) {
+    seconds = 1;
+  }
+
+  std::cout << clients << " clients, " << window << " requests in flight each" << '\n';
+  benchLegacy(seconds, clients, window);
+  benchBatch(seconds, clients, window, 1);
+  benchBatch(seconds, clients, window, batchSize);
+
+  // Each client socket is its own flow, so keep at least one per shard
+  for (int shards = 1; shards <= maxShards; ++shards) {
+    benchSharded(seconds, std::max(clients, shards), window, batchSize, shards);
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TUDPDatagramBatch.h>
+
+BOOST_AUTO_TEST_SUITE(UDPDatagramBatchTest)
+
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TUDPDatagramBatch;
+
+namespace {
+
+struct DatagramPair {
+  DatagramPair() { BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0); }
+  ~DatagramPair() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+  int fds[2];
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_reply_round_trip) {
+  DatagramPair pair;
+  TUDPDatagramBatch batch(4, 256);
+  BOOST_REQUIRE_EQUAL(send(pair.fds[1], "ping", 4, 0), 4);
+  BOOST_REQUIRE_EQUAL(batch.recv(pair.fds[0]), 1u);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<char*>(batch.data(0)), batch.length(0)), "ping");
+
+  const uint8_t reply[] = {'p', 'o', 'n', 'g'};
+  batch.setReply(0, reply, sizeof(reply));
+  BOOST_CHECK_EQUAL(batch.send(pair.fds[0]), 1u);
+  char buf[16];
+  BOOST_CHECK_EQUAL(recv(pair.fds[1], buf, sizeof(buf), 0), 4);
+  BOOST_CHECK_EQUAL(std::string(buf, 4), "pong");
+}
+
+BOOST_AUTO_TEST_CASE(test_replies_are_bounded) {
+  DatagramPair pair;
+  TUDPDatagramBatch batch(1, 256);
+  BOOST_REQUIRE_EQUAL(send(pair.fds[1], "ping", 4, 0), 4);
+  BOOST_REQUIRE_EQUAL(batch.recv(pair.fds[0]), 1u);
+
+  const uint8_t reply[] = {'p', 'o', 'n', 'g'};
+  BOOST_CHECK_THROW(batch.setReply(1, reply, sizeof(reply)), TTransportException);
+  batch.setReply(0, reply, sizeof(reply));
+  // A second reply to the same slot would not fit in the send vectors
+  BOOST_CHECK_THROW(batch.setReply(0, reply, sizeof(reply)), TTransportException);
+  BOOST_CHECK_EQUAL(batch.send(pair.fds[0]), 1u);
+
+  // The queue is empty again once sent
+  batch.setReply(0, reply, sizeof(reply));
+  BOOST_CHECK_EQUAL(batch.send(pair.fds[0]), 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
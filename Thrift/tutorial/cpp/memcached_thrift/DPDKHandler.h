@@ -21,6 +21,11 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include <thrift/transport/DPDKChecksum.h>
+#include <thrift/transport/DPDKHeaderCache.h>
+#include <thrift/transport/DPDKNeighborTable.h>
+#include <thrift/transport/DPDKTxBuffer.h>
+
 #include "shared_buffer.h"
 #include "PacketLogger.h"
 
@@ -30,6 +35,7 @@ public:
     static const uint16_t TX_RING_SIZE = 4096;
     static const uint16_t NUM_MBUFS = 16382;
     static const uint16_t MBUF_CACHE_SIZE = 512;
+    static const uint16_t BURST_SIZE = 32;
     
     static DPDKHandler& getInstance() {
         static DPDKHandler instance;
@@ -47,9 +53,20 @@ public:
         packetCallback_ = cb;
     }
 
-    // Send data
+    // Queue a reply; it leaves according to the TX flush policy
     bool sendData(const uint8_t* data, uint32_t len);
 
+    // Defaults to FLUSH_MESSAGE, one burst per reply
+    using TxBuffer = apache::thrift::transport::DPDKTxBuffer;
+    void setTxFlushPolicy(TxBuffer::FlushPolicy policy,
+                          uint16_t threshold = TxBuffer::DEFAULT_THRESHOLD,
+                          uint32_t deadlineUs = TxBuffer::DEFAULT_DEADLINE_US) {
+        txBuffer_.setPolicy(policy, threshold, deadlineUs);
+    }
+    const TxBuffer::Stats& getTxStats() const { return txBuffer_.getStats(); }
+    using Checksum = apache::thrift::transport::DPDKChecksum;
+    const Checksum::Stats& getChecksumStats() const { return checksum_.getStats(); }
+
     // Start polling in separate thread
     void startPolling();
 
@@ -59,6 +76,10 @@ public:
     // Set IP Address
     void setLocalIpAddress(const std::string& ipStr);
 
+    // Peers outside netmask are reached through gateway; by default every
+    // peer is on the link
+    void setGateway(const std::string& gateway, const std::string& netmask);
+
 private:
     DPDKHandler() = default;
     ~DPDKHandler() { cleanup(); }
@@ -82,4 +103,16 @@ private:
     struct rte_mempool* mbufPool_{nullptr};
     struct rte_eth_dev_info devInfo_{};
     struct rte_eth_conf portConf_{};
+
+    // Last RX burst, handed to the RPC side from rxHead_ to rxCount_
+    struct rte_mbuf* rxBurst_[BURST_SIZE];
+    uint16_t rxHead_{0};
+    uint16_t rxCount_{0};
+
+    // Replies waiting for the flush policy, their checksums, their headers
+    // per peer, and the MACs they go to
+    Checksum checksum_;
+    TxBuffer txBuffer_;
+    apache::thrift::transport::DPDKHeaderCache headers_;
+    apache::thrift::transport::DPDKNeighborTable neighbors_;
 };
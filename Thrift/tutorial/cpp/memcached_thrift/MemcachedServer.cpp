@@ -6,6 +6,9 @@
 #include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TServerUDPSocket.h>
+#ifdef THRIFT_TRANSPORT_DPDK
+#include <thrift/server/TDPDKQueueServer.h>
+#endif
 #include <thrift/transport/TBufferTransports.h>
 #include "gen-cpp/MemcachedService.h"
 // #include <libmemcached/memcached.h>
@@ -223,6 +226,24 @@ int main(int argc, char **argv) {
     int port = 9090;
     ::std::shared_ptr<MemcachedServiceHandler> handler(new MemcachedServiceHandler());
     ::std::shared_ptr<TProcessor> processor(new MemcachedServiceProcessor(handler));
+#ifdef THRIFT_TRANSPORT_DPDK
+    // --dpdk-queues N: RSS over N queue pairs, one lcore and processor each
+    for (int i = 1; i + 1 < argc; i++) {
+        if (::std::string(argv[i]) == "--dpdk-queues") {
+            uint16_t numQueues = static_cast<uint16_t>(::std::stoi(argv[i + 1]));
+            TDPDKQueueServer server(
+                ::std::make_shared<MemcachedServiceProcessorFactory>(
+                    ::std::make_shared<MemcachedServiceIfSingletonFactory>(handler)),
+                ::std::make_shared<TServerUDPSocket>(port),
+                ::std::make_shared<TBinaryProtocolFactory>(),
+                numQueues);
+            std::cout << "Starting the DPDK server on port " << port << " with " << numQueues
+                      << " queues..." << std::endl;
+            server.serve();
+            return 0;
+        }
+    }
+#endif
     //::std::shared_ptr<TServerTransport> serverTransport(new TServerUDPSocket("192.168.1.1", port, true)); // usingKq = true
     //::std::shared_ptr<TServerTransport> serverTransport(new TServerUDPSocket("localhost", port));
     //::std::shared_ptr<TServerTransport> serverTransport(new TServerUDPSocket(port));
@@ -1,81 +1,71 @@
 // PacketLogger.h
 #pragma once
-#include <fstream>
 #include <vector>
 #include <string>
-#include <chrono>
 #include <cstdint>
 
+#include <thrift/transport/PacketLogEngine.h>
+
+// Records go through PacketLogEngine: the log calls only copy into a
+// per-thread ring, and a background thread writes the files. The format is
+// unchanged: [timestamp us (8 bytes)][length (2 bytes)][data], or the
+// EnhancedHeader and the data.
 class PacketLogger {
 public:
+    typedef apache::thrift::transport::PacketLogEngine Engine;
+
     static PacketLogger& getInstance() {
         static PacketLogger instance;
         return instance;
     }
 
     void initializeLogFiles(const std::string& baseDir) {
-        dpdk_to_rpc_.open(baseDir + "/dpdk_to_rpc.log", std::ios::out | std::ios::binary);
-        rpc_to_logic_.open(baseDir + "/rpc_to_logic.log", std::ios::out | std::ios::binary);
-        logic_to_rpc_.open(baseDir + "/logic_to_rpc.log", std::ios::out | std::ios::binary);
-        rpc_to_dpdk_.open(baseDir + "/rpc_to_dpdk.log", std::ios::out | std::ios::binary);
+        engine_.stop();
+        engine_.open(DPDK_TO_RPC, baseDir + "/dpdk_to_rpc.log", true, Engine::timestampUs);
+        engine_.open(RPC_TO_LOGIC, baseDir + "/rpc_to_logic.log", true, Engine::timestampUs);
+        engine_.open(LOGIC_TO_RPC, baseDir + "/logic_to_rpc.log", true, Engine::timestampUs);
+        engine_.open(RPC_TO_DPDK, baseDir + "/rpc_to_dpdk.log", true, Engine::timestampUs);
+        engine_.start();
     }
 
     void logDPDKToRPC(const uint8_t* data, uint16_t len) {
-        writePacket(dpdk_to_rpc_, reinterpret_cast<const int8_t*>(data), len);
+        writePacket(DPDK_TO_RPC, data, len);
     }
 
     void logRPCToLogic(const uint8_t* data, uint16_t len) {
-        writePacket(rpc_to_logic_, reinterpret_cast<const int8_t*>(data), len);
+        writePacket(RPC_TO_LOGIC, data, len);
     }
 
     void logRPCToLogic(const std::vector<int8_t>& data, uint16_t keyLen, 
                        uint16_t valueLen, bool isGet) {
-        if (!rpc_to_logic_.is_open()) return;
-        
-        EnhancedHeader header;
-        header.timestamp = getCurrentTimestamp();
-        header.keyLength = keyLen;
-        header.valueLength = valueLen;
-        header.requestType = isGet ? 1 : 0;
-        
-        rpc_to_logic_.write(reinterpret_cast<const char*>(&header), sizeof(header));
-        rpc_to_logic_.write(reinterpret_cast<const char*>(data.data()), data.size());
-        rpc_to_logic_.flush();
+        writeEnhanced(RPC_TO_LOGIC, data, keyLen, valueLen, isGet);
     }
 
     void logLogicToRPC(const uint8_t* data, uint16_t len) {
-        writePacket(logic_to_rpc_, reinterpret_cast<const int8_t*>(data), len);
+        writePacket(LOGIC_TO_RPC, data, len);
     }
 
     void logLogicToRPC(const std::vector<int8_t>& data, uint16_t keyLen, 
                        uint16_t valueLen, bool isGet) {
-        if (!logic_to_rpc_.is_open()) return;
-        
-        EnhancedHeader header;
-        header.timestamp = getCurrentTimestamp();
-        header.keyLength = keyLen;
-        header.valueLength = valueLen;
-        header.requestType = isGet ? 1 : 0;
-        
-        logic_to_rpc_.write(reinterpret_cast<const char*>(&header), sizeof(header));
-        logic_to_rpc_.write(reinterpret_cast<const char*>(data.data()), data.size());
-        logic_to_rpc_.flush();
+        writeEnhanced(LOGIC_TO_RPC, data, keyLen, valueLen, isGet);
     }
 
     void logRPCToDPDK(const uint8_t* data, uint16_t len) {
-        writePacket(rpc_to_dpdk_, reinterpret_cast<const int8_t*>(data), len);
+        writePacket(RPC_TO_DPDK, data, len);
     }
 
+    // Records written and dropped because a thread's ring was full
+    Engine::Stats getStats() const { return engine_.getStats(); }
+
     ~PacketLogger() {
-        dpdk_to_rpc_.close();
-        rpc_to_logic_.close();
-        logic_to_rpc_.close();
-        rpc_to_dpdk_.close();
+        engine_.stop();
     }
 
 private:
     PacketLogger() {} // Private constructor for singleton
 
+    enum Stream { DPDK_TO_RPC, RPC_TO_LOGIC, LOGIC_TO_RPC, RPC_TO_DPDK };
+
     struct EnhancedHeader {
         uint64_t timestamp;
         uint16_t keyLength;
@@ -83,28 +73,22 @@ private:
         uint8_t requestType;  // SET = 0, GET = 1
     };
 
-    uint64_t getCurrentTimestamp() {
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        auto now_ms = std::chrono::duration_cast<std::chrono::microseconds>(
-            now.time_since_epoch()).count() % 1000000;
-        return static_cast<uint64_t>(now_c) * 1000000 + now_ms;
+    void writePacket(Stream stream, const uint8_t* data, uint16_t len) {
+        engine_.log(stream, &len, sizeof(len), data, len);
     }
-    
-    void writePacket(std::ofstream& file, const int8_t* data, uint16_t len) {
-        if (!file.is_open()) return;
-        
-        uint64_t timestamp = getCurrentTimestamp();
-        uint16_t length = len;
-        
-        file.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
-        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
-        file.write(reinterpret_cast<const char*>(data), len);
-        file.flush();
+
+    // The header goes out as the struct sits in memory, padding and all;
+    // the engine puts the timestamp in front
+    void writeEnhanced(Stream stream, const std::vector<int8_t>& data, uint16_t keyLen,
+                       uint16_t valueLen, bool isGet) {
+        EnhancedHeader header = {};
+        header.keyLength = keyLen;
+        header.valueLength = valueLen;
+        header.requestType = isGet ? 1 : 0;
+        const uint8_t* fields = reinterpret_cast<const uint8_t*>(&header) + sizeof(header.timestamp);
+        engine_.log(stream, fields, sizeof(header) - sizeof(header.timestamp),
+                    data.data(), data.size());
     }
 
-    std::ofstream dpdk_to_rpc_;
-    std::ofstream rpc_to_logic_;
-    std::ofstream logic_to_rpc_;
-    std::ofstream rpc_to_dpdk_;
-};
\ No newline at end of file
+    Engine engine_;
+};
@@ -3298,37 +3298,18 @@ namespace thrift {
     
     uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
         // Wait for data from DPDK
-        sem_wait(&shared_mem_->rx_buffer.sem);
-        pthread_mutex_lock(&shared_mem_->rx_buffer.mutex);
-
-        if (!shared_mem_->rx_buffer.has_data) {
-            pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
-            return 0;
-        }
-
-        // Copy data from shared memory
-        uint32_t copy_len = std::min(len, (uint32_t)shared_mem_->rx_buffer.size);
-        memcpy(buf, shared_mem_->rx_buffer.data, copy_len);
-
-        // Reset buffer state
-        shared_mem_->rx_buffer.has_data = false;
-        shared_mem_->rx_buffer.size = 0;
-
-        pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
+        uint32_t copy_len = shared_mem_->rx_ring.pop(buf, len);
         return copy_len;
     }
 
     void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
-        pthread_mutex_lock(&shared_mem_->tx_buffer.mutex);
-
-        // Copy to shared memory
-        memcpy(shared_mem_->tx_buffer.data, buf, len);
-        shared_mem_->tx_buffer.size = len;
-        shared_mem_->tx_buffer.has_data = true;
-
-        // Signal DPDK
-        sem_post(&shared_mem_->tx_buffer.sem);
-        pthread_mutex_unlock(&shared_mem_->tx_buffer.mutex);
+        // Copy to shared memory, back to the peer of the request
+        if (!shared_mem_->tx_ring.push(buf, len, shared_mem_->rx_ring.lastPeerTag())) {
+            // The DPDK side sends a slot as one packet, so it cannot be split
+            throw TTransportException(TTransportException::BAD_ARGS,
+                                      "Reply of " + std::to_string(len)
+                                      + " bytes does not fit a SharedRing slot");
+        }
     }
 
 //  void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
@@ -3421,17 +3421,7 @@ namespace thrift {
       // Shared Memory Implementation
       if (execution_mode == "dpdk") {
         // Wait for data from DPDK
-        sem_wait(&shared_mem_->rx_buffer.sem);
-        pthread_mutex_lock(&shared_mem_->rx_buffer.mutex);
-
-        if (!shared_mem_->rx_buffer.has_data) {
-            pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
-            return 0;
-        }
-
-        // Copy data from shared memory
-        uint32_t copy_len = std::min(len, (uint32_t)shared_mem_->rx_buffer.size);
-        memcpy(buf, shared_mem_->rx_buffer.data, copy_len);
+        uint32_t copy_len = shared_mem_->rx_ring.pop(buf, len);
 
         if (copy_len > 0) {
           logger_.logDPDKToRPC(buf, copy_len);
@@ -3444,11 +3434,6 @@ namespace thrift {
         // }
         // std::cout << "\nBuffer as int32: " << *(reinterpret_cast<int32_t*>(buf)) << std::endl;
 
-        // Reset buffer state
-        shared_mem_->rx_buffer.has_data = false;
-        shared_mem_->rx_buffer.size = 0;
-
-        pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
         return copy_len;
       } else {
         // file implementation
@@ -3459,18 +3444,15 @@ namespace thrift {
     void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
       // shared memory implementation
       if (execution_mode == "dpdk") {
-        pthread_mutex_lock(&shared_mem_->tx_buffer.mutex);
-
-        // Copy to shared memory
-        memcpy(shared_mem_->tx_buffer.data, buf, len);
-        shared_mem_->tx_buffer.size = len;
-        shared_mem_->tx_buffer.has_data = true;
+        // Copy to shared memory, back to the peer of the request
+        if (!shared_mem_->tx_ring.push(buf, len, shared_mem_->rx_ring.lastPeerTag())) {
+            // The DPDK side sends a slot as one packet, so it cannot be split
+            throw TTransportException(TTransportException::BAD_ARGS,
+                                      "Reply of " + std::to_string(len)
+                                      + " bytes does not fit a SharedRing slot");
+        }
 
         logger_.logRPCToDPDK(buf, len);
-
-        // Signal DPDK
-        sem_post(&shared_mem_->tx_buffer.sem);
-        pthread_mutex_unlock(&shared_mem_->tx_buffer.mutex);
       } else {
         // file implementation
         replay_.write(buf, len);
@@ -3727,15 +3709,9 @@ namespace thrift {
     // Set proper packet type flags
     dpdkResources_->portConf.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
     dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
-    dpdkResources_->portConf.rxmode.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM;
-    
-    // Accept all packet types
-    dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_IPV4_CKSUM;
-    dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_UDP_CKSUM;
-    
     dpdkResources_->portConf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
-    dpdkResources_->portConf.txmode.offloads = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | 
-                                              RTE_ETH_TX_OFFLOAD_UDP_CKSUM;
+    // Only the checksum offloads the device has; vdevs often have none
+    ::apache::thrift::transport::DPDKChecksum::configure(dpdkResources_->devInfo, dpdkResources_->portConf);
 
     // Configure device
     int ret = rte_eth_dev_configure(dpdkResources_->portId, 1, 1, &dpdkResources_->portConf);
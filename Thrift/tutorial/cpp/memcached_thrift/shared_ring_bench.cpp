@@ -0,0 +1,263 @@
+// shared_ring_bench.cpp
+//
+// Per-packet cost of the shared memory path between the DPDK poller and the
+// RPC thread, without DPDK: two processes, as with dpdk-rpc_sharedmem, play
+// the poller and the RPC side over an anonymous shared mapping.
+//
+//   legacy    the old single-slot buffer: mutex, has_data flag and one
+//             semaphore per direction
+//   busy      SharedRing, RPC side busy-polls
+//   adaptive  SharedRing, RPC side spins, then sleeps on the semaphore
+//
+// ping-pong: one request in flight; the poller times request -> reply,
+// as a client would see it through this hop. Percentiles in ns.
+// stream:    the poller pushes as fast as the RPC side keeps up and drains
+// replies as they come; packets per second through both directions.
+//
+//   g++ -O2 -std=c++11 -pthread shared_ring_bench.cpp -o shared_ring_bench
+//   ./shared_ring_bench [packets] [payload]
+//
+// Pin it for stable numbers, e.g. taskset -c 2,3. With a single CPU the
+// poller yields instead of spinning and busy-poll is skipped, since a
+// consumer that never sleeps only makes sense on a core of its own.
+
+#include "shared_buffer.h"
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+bool singleCpu = false;
+
+// The poller spins as DPDK would, unless it would starve the other side
+void idle() {
+   if (singleCpu) {
+      sched_yield();
+   }
+}
+
+uint64_t nowNs() {
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           Clock::now().time_since_epoch()).count();
+}
+
+// The single-slot buffer the ring replaced, kept here for comparison
+struct LegacyBuffer {
+   uint8_t data[2048];
+   size_t size;
+   bool has_data;
+   sem_t sem;
+   pthread_mutex_t mutex;
+
+   void init() {
+      pthread_mutexattr_t attr;
+      pthread_mutexattr_init(&attr);
+      pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+      pthread_mutex_init(&mutex, &attr);
+      pthread_mutexattr_destroy(&attr);
+      sem_init(&sem, 1, 0);
+      has_data = false;
+      size = 0;
+   }
+
+   // As DPDKHandler did it: drop the packet if the last one is still there
+   bool tryPush(const uint8_t* buf, uint32_t len) {
+      pthread_mutex_lock(&mutex);
+      if (has_data) {
+         pthread_mutex_unlock(&mutex);
+         return false;
+      }
+      memcpy(data, buf, len);
+      size = len;
+      has_data = true;
+      sem_post(&sem);
+      pthread_mutex_unlock(&mutex);
+      return true;
+   }
+
+   // As TUDPSocket::read did it
+   uint32_t pop(uint8_t* buf, uint32_t len) {
+      sem_wait(&sem);
+      pthread_mutex_lock(&mutex);
+      uint32_t n = std::min(len, (uint32_t)size);
+      memcpy(buf, data, n);
+      has_data = false;
+      size = 0;
+      pthread_mutex_unlock(&mutex);
+      return n;
+   }
+
+   // As DPDKHandler polled for replies
+   bool tryPop(uint8_t* buf, uint32_t len) {
+      if (sem_trywait(&sem) != 0) {
+         return false;
+      }
+      pthread_mutex_lock(&mutex);
+      memcpy(buf, data, std::min(len, (uint32_t)size));
+      has_data = false;
+      pthread_mutex_unlock(&mutex);
+      return true;
+   }
+};
+
+struct Legacy {
+   LegacyBuffer rx;
+   LegacyBuffer tx;
+
+   void init(SharedRing::WaitMode) {
+      rx.init();
+      tx.init();
+   }
+   bool request(const uint8_t* buf, uint32_t len) { return rx.tryPush(buf, len); }
+   bool reply(uint8_t* buf, uint32_t len) { return tx.tryPop(buf, len); }
+   // RPC side: the reply is written back into the tx slot as write() did
+   void serve(uint8_t* buf, uint32_t len) {
+      uint32_t n = rx.pop(buf, len);
+      while (!tx.tryPush(buf, n)) {
+         idle();
+      }
+   }
+};
+
+struct Ring {
+   SharedRing rx;
+   SharedRing tx;
+
+   void init(SharedRing::WaitMode mode) {
+      rx.init(mode);
+      tx.init(mode);
+   }
+   bool request(const uint8_t* buf, uint32_t len) { return rx.tryPush(buf, len, 1); }
+   bool reply(uint8_t* buf, uint32_t len) {
+      const SharedRing::Slot* slot = tx.front();
+      if (!slot) {
+         return false;
+      }
+      memcpy(buf, slot->data, std::min(len, slot->size));
+      tx.release();
+      return true;
+   }
+   void serve(uint8_t* buf, uint32_t len) {
+      uint32_t n = rx.pop(buf, len);
+      tx.push(buf, n, rx.lastPeerTag());
+   }
+};
+
+template <typename Channel>
+Channel* mapChannel(SharedRing::WaitMode mode) {
+   void* addr = mmap(NULL, sizeof(Channel), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (addr == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+   }
+   Channel* channel = new (addr) Channel;
+   channel->init(mode);
+   return channel;
+}
+
+// Forks the RPC side, which answers every request it reads
+template <typename Channel>
+pid_t startServer(Channel* channel, uint64_t packets, uint32_t payload) {
+   pid_t pid = fork();
+   if (pid == 0) {
+      std::vector<uint8_t> buf(payload);
+      for (uint64_t i = 0; i < packets; ++i) {
+         channel->serve(buf.data(), payload);
+      }
+      _exit(0);
+   }
+   return pid;
+}
+
+double percentile(const std::vector<uint64_t>& sorted, double p) {
+   size_t i = std::min(sorted.size() - 1, (size_t)(sorted.size() * p));
+   return (double)sorted[i];
+}
+
+template <typename Channel>
+void pingPong(const char* name, SharedRing::WaitMode mode, uint64_t packets, uint32_t payload) {
+   Channel* channel = mapChannel<Channel>(mode);
+   pid_t pid = startServer(channel, packets, payload);
+
+   std::vector<uint8_t> req(payload, 0x5a), rep(payload);
+   std::vector<uint64_t> rtt;
+   rtt.reserve(packets);
+   for (uint64_t i = 0; i < packets; ++i) {
+      uint64_t start = nowNs();
+      while (!channel->request(req.data(), payload)) {
+         idle();
+      }
+      while (!channel->reply(rep.data(), payload)) {
+         idle();
+      }
+      rtt.push_back(nowNs() - start);
+   }
+   waitpid(pid, nullptr, 0);
+
+   std::sort(rtt.begin(), rtt.end());
+   printf("%-9s ping-pong  p50 %7.0f  p99 %7.0f  p99.9 %7.0f  max %8.0f ns\n", name,
+          percentile(rtt, 0.5), percentile(rtt, 0.99), percentile(rtt, 0.999),
+          (double)rtt.back());
+   munmap(channel, sizeof(Channel));
+}
+
+template <typename Channel>
+void stream(const char* name, SharedRing::WaitMode mode, uint64_t packets, uint32_t payload) {
+   Channel* channel = mapChannel<Channel>(mode);
+   pid_t pid = startServer(channel, packets, payload);
+
+   std::vector<uint8_t> req(payload, 0x5a), rep(payload);
+   uint64_t sent = 0, received = 0;
+   uint64_t start = nowNs();
+   while (received < packets) {
+      bool progress = false;
+      if (sent < packets && channel->request(req.data(), payload)) {
+         sent++;
+         progress = true;
+      }
+      while (channel->reply(rep.data(), payload)) {
+         received++;
+         progress = true;
+      }
+      if (!progress) {
+         idle();
+      }
+   }
+   double seconds = (nowNs() - start) / 1e9;
+   waitpid(pid, nullptr, 0);
+
+   printf("%-9s stream     %7.2f Mpkt/s\n", name, packets / seconds / 1e6);
+   munmap(channel, sizeof(Channel));
+}
+
+}
+
+int main(int argc, char** argv) {
+   uint64_t packets = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+   uint32_t payload = argc > 2 ? (uint32_t)atoi(argv[2]) : 64;
+   payload = std::max(1u, std::min(payload, (uint32_t)sizeof(LegacyBuffer::data)));
+
+   singleCpu = sysconf(_SC_NPROCESSORS_ONLN) < 2;
+
+   printf("%llu packets of %u bytes%s\n", (unsigned long long)packets, payload,
+          singleCpu ? ", one CPU" : "");
+   pingPong<Legacy>("legacy", SharedRing::WAIT_ADAPTIVE, packets, payload);
+   if (!singleCpu) {
+      pingPong<Ring>("busy", SharedRing::WAIT_BUSY_POLL, packets, payload);
+   }
+   pingPong<Ring>("adaptive", SharedRing::WAIT_ADAPTIVE, packets, payload);
+   stream<Legacy>("legacy", SharedRing::WAIT_ADAPTIVE, packets, payload);
+   if (!singleCpu) {
+      stream<Ring>("busy", SharedRing::WAIT_BUSY_POLL, packets, payload);
+   }
+   stream<Ring>("adaptive", SharedRing::WAIT_ADAPTIVE, packets, payload);
+   return 0;
+}
@@ -3390,17 +3390,7 @@ namespace thrift {
     // Shared Memory Implementation
     uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
         // Wait for data from DPDK
-        sem_wait(&shared_mem_->rx_buffer.sem);
-        pthread_mutex_lock(&shared_mem_->rx_buffer.mutex);
-
-        if (!shared_mem_->rx_buffer.has_data) {
-            pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
-            return 0;
-        }
-
-        // Copy data from shared memory
-        uint32_t copy_len = std::min(len, (uint32_t)shared_mem_->rx_buffer.size);
-        memcpy(buf, shared_mem_->rx_buffer.data, copy_len);
+        uint32_t copy_len = shared_mem_->rx_ring.pop(buf, len);
 
         if (copy_len > 0) {
           logger_.logDPDKToRPC(buf, copy_len);
@@ -3413,27 +3403,19 @@ namespace thrift {
         // }
         // std::cout << "\nBuffer as int32: " << *(reinterpret_cast<int32_t*>(buf)) << std::endl;
 
-        // Reset buffer state
-        shared_mem_->rx_buffer.has_data = false;
-        shared_mem_->rx_buffer.size = 0;
-
-        pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
         return copy_len;
     }
 
     void TUDPSocket::write(const uint8_t* buf, uint32_t len) {
-        pthread_mutex_lock(&shared_mem_->tx_buffer.mutex);
-
-        // Copy to shared memory
-        memcpy(shared_mem_->tx_buffer.data, buf, len);
-        shared_mem_->tx_buffer.size = len;
-        shared_mem_->tx_buffer.has_data = true;
+        // Copy to shared memory, back to the peer of the request
+        if (!shared_mem_->tx_ring.push(buf, len, shared_mem_->rx_ring.lastPeerTag())) {
+            // The DPDK side sends a slot as one packet, so it cannot be split
+            throw TTransportException(TTransportException::BAD_ARGS,
+                                      "Reply of " + std::to_string(len)
+                                      + " bytes does not fit a SharedRing slot");
+        }
 
         logger_.logRPCToDPDK(buf, len);
-
-        // Signal DPDK
-        sem_post(&shared_mem_->tx_buffer.sem);
-        pthread_mutex_unlock(&shared_mem_->tx_buffer.mutex);
     }
 
     // uint32_t TUDPSocket::read(uint8_t* buf, uint32_t len) {
@@ -3560,15 +3560,9 @@ namespace thrift {
     // Set proper packet type flags
     dpdkResources_->portConf.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
     dpdkResources_->portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
-    dpdkResources_->portConf.rxmode.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM;
-    
-    // Accept all packet types
-    dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_IPV4_CKSUM;
-    dpdkResources_->portConf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_UDP_CKSUM;
-    
     dpdkResources_->portConf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
-    dpdkResources_->portConf.txmode.offloads = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | 
-                                              RTE_ETH_TX_OFFLOAD_UDP_CKSUM;
+    // Only the checksum offloads the device has; vdevs often have none
+    ::apache::thrift::transport::DPDKChecksum::configure(dpdkResources_->devInfo, dpdkResources_->portConf);
 
     // Configure device
     int ret = rte_eth_dev_configure(dpdkResources_->portId, 1, 1, &dpdkResources_->portConf);
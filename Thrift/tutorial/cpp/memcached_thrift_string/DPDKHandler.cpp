@@ -38,6 +38,9 @@ bool DPDKHandler::init(uint16_t port_id) {
         fprintf(stderr, "Failed to setup port: %s\n", rte_strerror(rte_errno));
         return false;
     }
+    txBuffer_.setQueue(portId_, 0);
+    checksum_.setOffloads(portConf_);
+    txBuffer_.setChecksum(&checksum_);
     
     return true;
 }
@@ -69,15 +72,9 @@ bool DPDKHandler::setupDPDKPort() {
   // Set proper packet type flags
   portConf_.rxmode.max_lro_pkt_size = RTE_ETHER_MAX_LEN;
   portConf_.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
-  portConf_.rxmode.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM;
-
-  // Accept all packet types
-  portConf_.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_IPV4_CKSUM;
-  portConf_.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_UDP_CKSUM;
-
   portConf_.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
-  portConf_.txmode.offloads = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM |
-                                            RTE_ETH_TX_OFFLOAD_UDP_CKSUM;
+  // Checksum offloads only where the device has them; software otherwise
+  Checksum::configure(devInfo_, portConf_);
 
   // Configure device
   int ret = rte_eth_dev_configure(portId_, 1, 1, &portConf_);
@@ -140,6 +137,21 @@ void DPDKHandler::setLocalIpAddress(const std::string& ipStr) {
         struct in_addr addr;
         inet_aton(ipStr.c_str(), &addr);
         localIpAddress_ = addr.s_addr;
+
+        struct rte_ether_addr mac;
+        rte_eth_macaddr_get(portId_, &mac);
+        headers_.setSource(mac, localIpAddress_);
+        // Next hops are resolved by ARP; tell the link who we are first
+        neighbors_.setLocal(mac, localIpAddress_);
+        neighbors_.announce(mbufPool_, txBuffer_);
+}
+
+void DPDKHandler::setGateway(const std::string& gateway, const std::string& netmask) {
+        struct in_addr gw;
+        struct in_addr mask;
+        inet_aton(gateway.c_str(), &gw);
+        inet_aton(netmask.c_str(), &mask);
+        neighbors_.setGateway(gw.s_addr, mask.s_addr);
 }
 
 void DPDKHandler::startPolling() {
@@ -156,62 +168,42 @@ void DPDKHandler::stopPolling() {
 }
 
 void DPDKHandler::handleArpPacket(struct rte_mbuf* m) {
-    struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
-    struct rte_arp_hdr* arp_hdr = (struct rte_arp_hdr*)(eth_hdr + 1);
-
-    if (rte_be_to_cpu_16(arp_hdr->arp_opcode) == RTE_ARP_OP_REQUEST &&
-        arp_hdr->arp_data.arp_tip == localIpAddress_) {
-
-        struct rte_mbuf* reply = rte_pktmbuf_alloc(mbufPool_);
-        if (reply) {
-           char* pkt = rte_pktmbuf_append(reply,
-                sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr));
-
-            if (pkt) {
-                struct rte_ether_hdr* reply_eth =
-                    rte_pktmbuf_mtod(reply, struct rte_ether_hdr*);
-                struct rte_arp_hdr* reply_arp =
-                    (struct rte_arp_hdr*)(reply_eth + 1);
-
-                // Set ethernet header
-                reply_eth->dst_addr = eth_hdr->src_addr;
-                rte_eth_macaddr_get(portId_, &reply_eth->src_addr);
-                reply_eth->ether_type = eth_hdr->ether_type;
-
-                // Set ARP header
-                reply_arp->arp_hardware = arp_hdr->arp_hardware;
-                reply_arp->arp_protocol = arp_hdr->arp_protocol;
-                reply_arp->arp_hlen = arp_hdr->arp_hlen;
-                reply_arp->arp_plen = arp_hdr->arp_plen;
-                reply_arp->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REPLY);
-
-                // Set ARP data
-                rte_eth_macaddr_get(portId_,
-                    &reply_arp->arp_data.arp_sha);
-                reply_arp->arp_data.arp_sip = localIpAddress_;
-                reply_arp->arp_data.arp_tha = arp_hdr->arp_data.arp_sha;
-                reply_arp->arp_data.arp_tip = arp_hdr->arp_data.arp_sip;
-
-                uint16_t nb_tx = rte_eth_tx_burst(portId_,
-                    0, &reply, 1);
-                if (nb_tx == 0) {
-                    rte_pktmbuf_free(reply);
-                }
-            } else {
-                rte_pktmbuf_free(reply);
-            }
-        }
-    }
+    neighbors_.input(m, mbufPool_, txBuffer_);
+}
+
+// Peers travel through the rings as one word: IPv4 address and UDP port,
+// both in network byte order
+static uint64_t packPeer(uint32_t ip, uint16_t port) {
+    return (static_cast<uint64_t>(ip) << 16) | port;
+}
+
+static void unpackPeer(uint64_t peer, struct sockaddr_in& addr) {
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = static_cast<uint32_t>(peer >> 16);
+    addr.sin_port = static_cast<uint16_t>(peer & 0xFFFF);
 }
 
 void DPDKHandler::pollLoop() {
     auto& logger = PacketLogger::getInstance();
     while (running_) {
-        struct rte_mbuf* pkts[1];
-        const uint16_t nb_rx = rte_eth_rx_burst(portId_, 0, pkts, 1);
-        
-        for (uint16_t i = 0; i < nb_rx; i++) {
-            struct rte_mbuf* pkt = pkts[i];
+        // Refill once the previous burst has been handed over; the replies
+        // to it are queued by then
+        if (rxHead_ == rxCount_) {
+            if (rxCount_ > 0) {
+                txBuffer_.rxBurstDone();
+            }
+            rxHead_ = 0;
+            rxCount_ = rte_eth_rx_burst(portId_, 0, rxBurst_, BURST_SIZE);
+            if (rxCount_ == 0) {
+                txBuffer_.rxIdle();
+            }
+            rxCount_ = checksum_.validateBurst(rxBurst_, rxCount_);
+        }
+
+        // Hand the burst to the RPC side; whatever does not fit in the ring
+        // waits here until it has room
+        while (rxHead_ < rxCount_) {
+            struct rte_mbuf* pkt = rxBurst_[rxHead_++];
             
             // Get packet headers
             struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
@@ -264,20 +256,21 @@ void DPDKHandler::pollLoop() {
 //                packetCallback_(payload, payload_len);
 //            }
 
-            // Copy to shared memory
-            pthread_mutex_lock(&shared_mem_->rx_buffer.mutex);
-            memcpy(shared_mem_->rx_buffer.data, payload, payload_len);
-            shared_mem_->rx_buffer.size = payload_len;
-            shared_mem_->rx_buffer.has_data = true;
-            //printf("rx_buffer.size: %ld\n", shared_mem_->rx_buffer.size);
+            // Copy to shared memory, tagged with the peer to answer; the
+            // RPC side is woken if it sleeps
+            uint64_t peer = packPeer(ip_hdr->src_addr, udp_hdr->src_port);
+            if (!shared_mem_->rx_ring.tryPush(payload, payload_len, peer)) {
+                if (payload_len > SharedRing::MAX_DATA) {
+                    rte_pktmbuf_free(pkt);
+                    continue;
+                }
+                rxHead_--;  // ring full; retry after draining replies
+                break;
+            }
             
             if (payload_len > 0) {
                 logger.logDPDKToRPC(payload, payload_len);
             } 
-            
-            // Signal RPC layer
-            sem_post(&shared_mem_->rx_buffer.sem);
-            pthread_mutex_unlock(&shared_mem_->rx_buffer.mutex);
              
             // Cache peer address for responses
             peerAddr_.sin_family = AF_INET;
@@ -285,105 +278,57 @@ void DPDKHandler::pollLoop() {
             peerAddr_.sin_addr.s_addr = ip_hdr->src_addr;
 
             rte_pktmbuf_free(pkt);
-            break;
         }
 
-        // Check if RPC has data to send
-        if (sem_trywait(&shared_mem_->tx_buffer.sem) == 0) {
-            pthread_mutex_lock(&shared_mem_->tx_buffer.mutex);
-
-            if (shared_mem_->tx_buffer.has_data) {
-                //printf("tx_buffer.size: %ld\n", shared_mem_->tx_buffer.size);
-                
-                logger.logRPCToDPDK(shared_mem_->tx_buffer.data,
-                               shared_mem_->tx_buffer.size);
-                
-                sendData(shared_mem_->tx_buffer.data,
-                        shared_mem_->tx_buffer.size);
-
-                // Reset buffer state
-                shared_mem_->tx_buffer.has_data = false;
-                shared_mem_->tx_buffer.size = 0;
+        // Send what the RPC side has answered, straight from the ring
+        const SharedRing::Slot* reply;
+        while ((reply = shared_mem_->tx_ring.front()) != nullptr) {
+            // Untagged replies go to the last peer seen
+            if (reply->peer != 0) {
+                unpackPeer(reply->peer, peerAddr_);
             }
+            logger.logRPCToDPDK(reply->data, reply->size);
 
-            pthread_mutex_unlock(&shared_mem_->tx_buffer.mutex);
+            sendData(reply->data, reply->size);
+            shared_mem_->tx_ring.release();
         }
     }
 }
 
 bool DPDKHandler::sendData(const uint8_t* data, uint32_t len) {
+    using apache::thrift::transport::DPDKHeaderCache;
 
     struct rte_mbuf* m = rte_pktmbuf_alloc(mbufPool_);
     if (!m) return false;
 
     // Reserve space for headers + data
-    uint32_t total_len = sizeof(struct rte_ether_hdr) + 
-                        sizeof(struct rte_ipv4_hdr) +
-                        sizeof(struct rte_udp_hdr) + len;
-                        
-    char* pkt = rte_pktmbuf_append(m, total_len);
+    char* pkt = rte_pktmbuf_append(m, DPDKHeaderCache::HEADERS_LEN + len);
     if (!pkt) {
         rte_pktmbuf_free(m);
         return false; 
     }
 
-    // Set up headers...
-    struct rte_ether_hdr* eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
-    struct rte_ipv4_hdr* ip_hdr = (struct rte_ipv4_hdr*)(eth_hdr + 1);
-    struct rte_udp_hdr* udp_hdr = (struct rte_udp_hdr*)(ip_hdr + 1);
-    uint8_t* payload = (uint8_t*)(udp_hdr + 1);
-    
-    // Ethernet header
-    rte_eth_macaddr_get(portId_, &eth_hdr->src_addr);
-    // Destination MAC should be set based on ARP or known destination
-    // For now using broadcast
-    // memset(&eth_hdr->dst_addr, 0xff, RTE_ETHER_ADDR_LEN);
-    // Set destination MAC directly
-    // Converting 0c:42:a1:cc:83:82 to bytes
-    eth_hdr->dst_addr.addr_bytes[0] = 0x0c;
-    eth_hdr->dst_addr.addr_bytes[1] = 0x42;
-    eth_hdr->dst_addr.addr_bytes[2] = 0xa1;
-    eth_hdr->dst_addr.addr_bytes[3] = 0xcc;
-    eth_hdr->dst_addr.addr_bytes[4] = 0x83;
-    eth_hdr->dst_addr.addr_bytes[5] = 0x82;
-  
-    eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
-
-    // IP header
-    memset(ip_hdr, 0, sizeof(*ip_hdr));
-    ip_hdr->version_ihl = (4 << 4) | (sizeof(*ip_hdr) >> 2);
-    ip_hdr->type_of_service = 0;
-    ip_hdr->total_length = rte_cpu_to_be_16(sizeof(*ip_hdr) + sizeof(*udp_hdr) + len);
-    ip_hdr->packet_id = 0;
-    ip_hdr->fragment_offset = 0;
-    ip_hdr->time_to_live = 64;
-    ip_hdr->next_proto_id = IPPROTO_UDP;
-    // Source IP should be interface IP
-    ip_hdr->src_addr = localIpAddress_; //use configured Ip
-    // Destination IP from peer address
-    ip_hdr->dst_addr = peerAddr_.sin_addr.s_addr;
-    ip_hdr->hdr_checksum = 0;
-    ip_hdr->hdr_checksum = rte_ipv4_cksum(ip_hdr);
-
-    // UDP header
-    udp_hdr->src_port = rte_cpu_to_be_16(port_);
-    udp_hdr->dst_port = peerAddr_.sin_port;
-//    printf("port_: %d\n", port_);
-//    printf("dst_port: %d\n", udp_hdr->dst_port);
-//    printf("src_port: %d\n", udp_hdr->src_port);
-    udp_hdr->dgram_len = rte_cpu_to_be_16(sizeof(*udp_hdr) + len);
-    udp_hdr->dgram_cksum = 0;
+    // Headers from the peer's template, for the MAC of its next hop
+    uint32_t nextHop = neighbors_.nextHop(peerAddr_.sin_addr.s_addr);
+    struct rte_ether_addr mac;
+    memset(&mac, 0, sizeof(mac));
+    bool resolved = neighbors_.resolve(nextHop, &mac, mbufPool_, txBuffer_);
+    headers_.write(reinterpret_cast<uint8_t*>(pkt), mac, peerAddr_.sin_addr.s_addr,
+                   peerAddr_.sin_port, rte_cpu_to_be_16(port_), static_cast<uint16_t>(len));
 
     // Copy payload
-    rte_memcpy(payload, data, total_len);
+    rte_memcpy(pkt + DPDKHeaderCache::HEADERS_LEN, data, len);
 
-    // Send packet
-    uint16_t nb_tx = rte_eth_tx_burst(portId_, 0, &m, 1);
-    if (nb_tx == 0) {
-        rte_pktmbuf_free(m);
-        return false;
+    // Waits in the neighbor table until the next hop answers
+    if (!resolved) {
+        neighbors_.hold(nextHop, m, mbufPool_, txBuffer_);
+        return true;
     }
-    return true;
+
+    // Queued; the TX buffer decides when it leaves
+    uint16_t dropped = txBuffer_.add(m);
+    dropped += txBuffer_.messageDone();
+    return dropped == 0;
 }
 
 // DPDKHandler.cpp
@@ -396,6 +341,13 @@ void DPDKHandler::cleanup() {
         }
     }
 
+    // Replies still held by the flush policy leave; packets not handed
+    // over yet go back before the pool is freed
+    txBuffer_.flush();
+    while (rxHead_ < rxCount_) {
+        rte_pktmbuf_free(rxBurst_[rxHead_++]);
+    }
+
     // Cleanup DPDK resources
     if (portId_ != RTE_MAX_ETHPORTS) {
         rte_eth_dev_stop(portId_);
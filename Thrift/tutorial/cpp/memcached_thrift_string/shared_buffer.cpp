@@ -1,6 +1,8 @@
 // shared_buffer.cpp
 #include "shared_buffer.h"
 #include <iostream>
+#include <chrono>
+#include <thread>
 
 SharedMemoryManager& SharedMemoryManager::getInstance() {
    static SharedMemoryManager instance;
@@ -12,66 +14,95 @@ SharedMemory* SharedMemoryManager::initSharedMemory() {
        return shared_mem_; // Already initialized
    }
 
-   // Create shared memory segment
-   shm_fd_ = shm_open("/dpdk_rpc_shm", O_CREAT | O_RDWR, 0666);
+   // Create shared memory segment, unless the other side already has
+   shm_fd_ = shm_open("/dpdk_rpc_shm", O_CREAT | O_EXCL | O_RDWR, 0666);
+   creator_ = shm_fd_ != -1;
+   if (!creator_ && errno == EEXIST) {
+       shm_fd_ = shm_open("/dpdk_rpc_shm", O_RDWR, 0666);
+       // The creator may not have sized it yet
+       struct stat st;
+       st.st_size = 0;
+       for (int i = 0; shm_fd_ != -1 && i < 1000; ++i) {
+           if (fstat(shm_fd_, &st) != 0 || st.st_size != 0) {
+               break;
+           }
+           std::this_thread::sleep_for(std::chrono::milliseconds(1));
+       }
+       // Left behind by an older build, with another layout
+       if (shm_fd_ != -1 && st.st_size != (off_t)sizeof(SharedMemory)) {
+           close(shm_fd_);
+           shm_unlink("/dpdk_rpc_shm");
+           shm_fd_ = shm_open("/dpdk_rpc_shm", O_CREAT | O_EXCL | O_RDWR, 0666);
+           creator_ = shm_fd_ != -1;
+       }
+   }
    if (shm_fd_ == -1) {
        std::cerr << "Failed to create shared memory: " << strerror(errno) << std::endl;
        return nullptr;
    }
 
    // Set size of shared memory
-   if (ftruncate(shm_fd_, sizeof(SharedMemory)) == -1) {
+   if (creator_ && ftruncate(shm_fd_, sizeof(SharedMemory)) == -1) {
        std::cerr << "Failed to set shared memory size: " << strerror(errno) << std::endl;
        close(shm_fd_);
        return nullptr;
    }
 
    // Map shared memory
-   shared_mem_ = (SharedMemory*)mmap(NULL, 
-                                   sizeof(SharedMemory),
-                                   PROT_READ | PROT_WRITE,
-                                   MAP_SHARED,
-                                   shm_fd_,
-                                   0);
-   printf("Shared memory mapped at: %p, size: %zu\n",
-           (void*)shared_mem_, sizeof(SharedMemory));
-
-   if (shared_mem_ == MAP_FAILED) {
+   void* addr = mmap(NULL,
+                     sizeof(SharedMemory),
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     shm_fd_,
+                     0);
+   if (addr == MAP_FAILED) {
        std::cerr << "Failed to map shared memory: " << strerror(errno) << std::endl;
        close(shm_fd_);
        return nullptr;
    }
+   shared_mem_ = (SharedMemory*)addr;
+   printf("Shared memory mapped at: %p, size: %zu\n",
+           (void*)shared_mem_, sizeof(SharedMemory));
 
-   // Initialize semaphores and mutexes
-   sem_init(&shared_mem_->rx_buffer.sem, 1, 0);
-   sem_init(&shared_mem_->tx_buffer.sem, 1, 0);
-   pthread_mutex_init(&shared_mem_->rx_buffer.mutex, NULL);
-   pthread_mutex_init(&shared_mem_->tx_buffer.mutex, NULL);
-
-   // Initialize buffer states
-   shared_mem_->rx_buffer.has_data = false;
-   shared_mem_->rx_buffer.size = 0;
-   shared_mem_->tx_buffer.has_data = false;
-   shared_mem_->tx_buffer.size = 0;
+   if (creator_) {
+       // Initialize rings; the other side waits for ready
+       shared_mem_->rx_ring.init();
+       shared_mem_->tx_ring.init();
+       shared_mem_->ready.store(SharedMemory::MAGIC, std::memory_order_release);
+   } else {
+       while (shared_mem_->ready.load(std::memory_order_acquire) != SharedMemory::MAGIC) {
+           std::this_thread::sleep_for(std::chrono::milliseconds(1));
+       }
+   }
 
    return shared_mem_;
 }
 
+void SharedMemoryManager::setWaitMode(SharedRing::WaitMode mode, uint32_t spins) {
+   if (shared_mem_) {
+       shared_mem_->rx_ring.setWaitMode(mode, spins);
+       shared_mem_->tx_ring.setWaitMode(mode, spins);
+   }
+}
+
 void SharedMemoryManager::cleanup() {
    if (shared_mem_) {
-       // Destroy semaphores and mutexes
-       sem_destroy(&shared_mem_->rx_buffer.sem);
-       sem_destroy(&shared_mem_->tx_buffer.sem);
-       pthread_mutex_destroy(&shared_mem_->rx_buffer.mutex);
-       pthread_mutex_destroy(&shared_mem_->tx_buffer.mutex);
+       // The creator owns the semaphores and the name
+       if (creator_) {
+           shared_mem_->ready.store(0);
+           shared_mem_->rx_ring.destroy();
+           shared_mem_->tx_ring.destroy();
+       }
 
        // Unmap shared memory
        munmap(shared_mem_, sizeof(SharedMemory));
-       
+
        // Close and unlink shared memory
        close(shm_fd_);
-       shm_unlink("/dpdk_rpc_shm");
-       
+       if (creator_) {
+           shm_unlink("/dpdk_rpc_shm");
+       }
+
        shared_mem_ = nullptr;
    }
 }
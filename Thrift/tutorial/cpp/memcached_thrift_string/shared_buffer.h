@@ -7,33 +7,38 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <atomic>
+#include <cerrno>
 #include <cstring>
 #include <cstdint>
 #include <algorithm>
 
-struct SharedBuffer {
-   static const size_t BUFFER_SIZE = 1 * 1024 * 1024;  // 512MB
-   alignas(64) uint8_t data[BUFFER_SIZE];
-   size_t size;      // Amount of valid data
-   bool has_data;    // Flag to indicate data availability
-   sem_t sem;        // Synchronization
-   pthread_mutex_t mutex;  // Protect access
-};
+#include <thrift/transport/SharedRing.h>
+
+using apache::thrift::transport::SharedRing;
 
 struct SharedMemory {
-   SharedBuffer rx_buffer;  // For DPDK -> RPC
-   SharedBuffer tx_buffer;  // For RPC -> DPDK
+   static const uint32_t MAGIC = 0x52494e47;  // "RING"
+
+   std::atomic<uint32_t> ready;  // MAGIC once the creator has set it up
+   SharedRing rx_ring;  // For DPDK -> RPC
+   SharedRing tx_ring;  // For RPC -> DPDK
 };
 
 class SharedMemoryManager {
 public:
    static SharedMemoryManager& getInstance();
+   // The first process to call this creates and initializes the segment;
+   // later ones, in the same process or not, attach to it
    SharedMemory* initSharedMemory();
+   // How the RPC side waits for requests; DPDK always polls
+   void setWaitMode(SharedRing::WaitMode mode, uint32_t spins = 2048);
    void cleanup();
 
 private:
    SharedMemoryManager() = default;
    ~SharedMemoryManager();
    int shm_fd_;
+   bool creator_ = false;
    SharedMemory* shared_mem_ = nullptr;
 };